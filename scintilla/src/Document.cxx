@@ -15,6 +15,11 @@
 #include <vector>
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FIND_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "Platform.h"
 
 #include "ILexer.h"
@@ -1521,6 +1526,88 @@ void Document::SetCaseFolder(CaseFolder *pcf_) {
 	pcf = pcf_;
 }
 
+/**
+ * Find the first position in [start, end) of a contiguous block of text whose byte is
+ * one of first[] and whose byte lastOffset further on is one of last[]. When highBytes
+ * is set, any byte >= 0x80 is also a candidate and the last byte is not checked.
+ * The text must be readable up to end + lastOffset. Returns end when not found.
+ */
+static int FindCandidateInBlock(const char *text, int start, int end,
+	const unsigned char first[2], const unsigned char last[2], int lastOffset, bool highBytes) {
+	int i = start;
+#ifdef FIND_USE_SSE2
+	// Test 16 bytes at once, first and last bytes of the search together like memmem does
+	const __m128i first0 = _mm_set1_epi8(static_cast<char>(first[0]));
+	const __m128i first1 = _mm_set1_epi8(static_cast<char>(first[1]));
+	const __m128i last0 = _mm_set1_epi8(static_cast<char>(last[0]));
+	const __m128i last1 = _mm_set1_epi8(static_cast<char>(last[1]));
+	for (; i + 16 <= end; i += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+		__m128i match = _mm_or_si128(_mm_cmpeq_epi8(block, first0), _mm_cmpeq_epi8(block, first1));
+		if (highBytes) {
+			// Bytes >= 0x80 have their top bit set which is what movemask collects
+			match = _mm_or_si128(match, block);
+		} else {
+			const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + lastOffset));
+			match = _mm_and_si128(match,
+				_mm_or_si128(_mm_cmpeq_epi8(blockLast, last0), _mm_cmpeq_epi8(blockLast, last1)));
+		}
+		unsigned int mask = _mm_movemask_epi8(match);
+		if (mask) {
+			while (!(mask & 1)) {
+				mask >>= 1;
+				i++;
+			}
+			return i;
+		}
+	}
+#endif
+	for (; i < end; i++) {
+		const unsigned char ch = static_cast<unsigned char>(text[i]);
+		if (highBytes) {
+			if (ch == first[0] || ch == first[1] || ch >= 0x80)
+				return i;
+		} else if (ch == first[0] || ch == first[1]) {
+			const unsigned char chLast = static_cast<unsigned char>(text[i + lastOffset]);
+			if (chLast == last[0] || chLast == last[1])
+				return i;
+		}
+	}
+	return end;
+}
+
+/**
+ * Skip forward to the next position in [pos, endPos) where a literal search can match,
+ * as for FindCandidateInBlock. The two halves either side of the gap are scanned in place
+ * so the gap is not moved; positions whose candidate window straddles the gap are all
+ * returned for checking by the caller.
+ */
+int Document::NextFindCandidate(int pos, int endPos, const unsigned char first[2],
+	const unsigned char last[2], int lastOffset, bool highBytes) {
+	const int gap = cb.GapPosition();
+	if (pos < gap) {
+		const int endBefore = Platform::Minimum(endPos, gap - lastOffset);
+		if (pos < endBefore) {
+			pos = FindCandidateInBlock(RangePointer(0, gap), pos, endBefore,
+				first, last, lastOffset, highBytes);
+			if (pos < endBefore)
+				return pos;
+		}
+		// Windows over the gap are rare, leave them to the caller
+		pos = Platform::Maximum(pos, gap - lastOffset);
+		if (pos < Platform::Minimum(endPos, gap))
+			return pos;
+		pos = gap;
+	}
+	if (pos < endPos) {
+		const int lengthAfter = Length() - gap;
+		// Index the part after the gap by document position
+		const char *textAfter = RangePointer(gap, lengthAfter) - gap;
+		pos = FindCandidateInBlock(textAfter, pos, endPos, first, last, lastOffset, highBytes);
+	}
+	return pos;
+}
+
 /**
  * Find text in document, supporting both forward and backward
  * searches (just pass minPos > maxPos to do a backward search)
@@ -1557,7 +1644,20 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 		if (caseSensitive) {
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			const char charStartSearch =  search[0];
+			// DBCS trail bytes can look like the start of the search so only skip ahead
+			// when every byte that matches is the start of a character
+			const bool skipAhead = forward && ((dbcsCodePage == 0) ||
+				((SC_CP_UTF8 == dbcsCodePage) && !UTF8IsTrailByte(static_cast<unsigned char>(search[0]))));
+			const unsigned char first[2] = {
+				static_cast<unsigned char>(search[0]), static_cast<unsigned char>(search[0]) };
+			const unsigned char last[2] = {
+				static_cast<unsigned char>(search[lengthFind - 1]), static_cast<unsigned char>(search[lengthFind - 1]) };
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+				if (skipAhead) {
+					pos = NextFindCandidate(pos, endSearch, first, last, lengthFind - 1, false);
+					if (pos >= endSearch)
+						break;
+				}
 				if (CharAt(pos) == charStartSearch) {
 					bool found = (pos + lengthFind) <= limitPos;
 					for (int indexSearch = 1; (indexSearch < lengthFind) && found; indexSearch++) {
@@ -1577,7 +1677,18 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 				pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind));
 			char bytes[UTF8MaxBytes + 1];
 			char folded[UTF8MaxBytes * maxFoldingExpansion + 1];
+			// ASCII characters only fold to themselves in lower case while other characters
+			// may fold to ASCII (such as the Kelvin sign or ligatures), so skip ahead over
+			// the ASCII characters which can't start a match and check all others.
+			const unsigned char firstFolded = static_cast<unsigned char>(searchThing[0]);
+			const unsigned char first[2] = {
+				firstFolded, static_cast<unsigned char>(MakeUpperCase(searchThing[0])) };
 			while (forward ? (pos < endPos) : (pos >= endPos)) {
+				if (forward && (lenSearch > 0)) {
+					pos = NextFindCandidate(pos, endPos, first, first, 0, true);
+					if (pos >= endPos)
+						break;
+				}
 				int widthFirstCharacter = 0;
 				int posIndexDocument = pos;
 				int indexSearch = 0;
@@ -1662,7 +1773,40 @@ long Document::FindText(int minPos, int maxPos, const char *search,
 			const int endSearch = (startPos <= endPos) ? endPos - lengthFind + 1 : endPos;
 			std::vector<char> searchThing(lengthFind + 1);
 			pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			// Find which bytes fold to the first and last bytes of the search so the
+			// text can be skipped over quickly, unless the case folder maps more than two
+			// bytes (upper and lower case) to either of them.
+			unsigned char first[2] = { 0, 0 };
+			unsigned char last[2] = { 0, 0 };
+			int countFirst = 0;
+			int countLast = 0;
+			for (int ch = 0; ch < 0x100; ch++) {
+				const char chDoc = static_cast<char>(ch);
+				char folded[2];
+				pcf->Fold(folded, sizeof(folded), &chDoc, 1);
+				if (folded[0] == searchThing[0]) {
+					if (countFirst < 2)
+						first[countFirst] = static_cast<unsigned char>(ch);
+					countFirst++;
+				}
+				if (folded[0] == searchThing[lengthFind - 1]) {
+					if (countLast < 2)
+						last[countLast] = static_cast<unsigned char>(ch);
+					countLast++;
+				}
+			}
+			if (countFirst == 1)
+				first[1] = first[0];
+			if (countLast == 1)
+				last[1] = last[0];
+			const bool skipAhead = forward && (countFirst >= 1) && (countFirst <= 2) &&
+				(countLast >= 1) && (countLast <= 2);
 			while (forward ? (pos < endSearch) : (pos >= endSearch)) {
+				if (skipAhead) {
+					pos = NextFindCandidate(pos, endSearch, first, last, lengthFind - 1, false);
+					if (pos >= endSearch)
+						break;
+				}
 				bool found = (pos + lengthFind) <= limitPos;
 				for (int indexSearch = 0; (indexSearch < lengthFind) && found; indexSearch++) {
 					char ch = CharAt(pos + indexSearch);
@@ -409,6 +409,8 @@ private:
 	bool IsWordStartAt(int pos) const;
 	bool IsWordEndAt(int pos) const;
 	bool IsWordAt(int start, int end) const;
+	int NextFindCandidate(int pos, int endPos, const unsigned char first[2],
+		const unsigned char last[2], int lastOffset, bool highBytes);
 
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
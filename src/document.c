@@ -874,16 +874,51 @@ GeanyDocument *document_open_file(const gchar *locale_filename, gboolean readonl
 
 typedef struct
 {
-	gchar		*data;	/* null-terminated file data */
+	gchar		*data;	/* file data, null-terminated unless it is in map */
 	gsize		 len;	/* string length of data */
 	gchar		*enc;
 	gboolean	 bom;
 	time_t		 mtime;	/* modification time, read by stat::st_mtime */
 	gboolean	 readonly;
+	GMappedFile	*map;	/* the mapped file when data points into it, or NULL */
 } FileData;
 
 
-/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
+/* Files are passed to Scintilla in parts of this size, and the progress is shown for
+ * files with more than one part */
+#define LOAD_CHUNK_SIZE (8 * 1024 * 1024)
+/* Files from this size are mapped rather than read. A mapped file that another program
+ * truncates while it is loaded raises SIGBUS, so only large files, which are expensive
+ * to copy, take that risk. */
+#define LOAD_MAP_MIN_SIZE (4 * 1024 * 1024)
+
+
+static void unmap_file(GMappedFile *map)
+{
+#if GLIB_CHECK_VERSION(2, 22, 0)
+	g_mapped_file_unref(map);
+#else
+	g_mapped_file_free(map);
+#endif
+}
+
+
+static void file_data_free(FileData *filedata)
+{
+	if (filedata->map != NULL)
+	{
+		unmap_file(filedata->map);
+		filedata->map = NULL;
+	}
+	else
+		g_free(filedata->data);
+	filedata->data = NULL;
+}
+
+
+/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM.
+ * Large UTF-8 files are mapped and used as they are, so that loading them only takes
+ * the memory of the copy Scintilla makes. */
 static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
 	FileData *filedata, const gchar *forced_enc)
 {
@@ -895,6 +930,7 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 	filedata->enc = NULL;
 	filedata->bom = FALSE;
 	filedata->readonly = FALSE;
+	filedata->map = NULL;
 
 	if (g_stat(locale_filename, &st) != 0)
 	{
@@ -905,14 +941,49 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 
 	filedata->mtime = st.st_mtime;
 
-	if (! g_file_get_contents(locale_filename, &filedata->data, NULL, &err))
+	/* Scintilla positions are ints */
+	if (st.st_size >= G_MAXINT)
+	{
+		ui_set_statusbar(TRUE, _("The file \"%s\" is too large to be opened."), display_filename);
+		return FALSE;
+	}
+
+	/* files like those in /proc have a size of 0 although they aren't empty, so they are
+	 * read like small files */
+	if (st.st_size >= LOAD_MAP_MIN_SIZE)
+		filedata->map = g_mapped_file_new(locale_filename, FALSE, NULL);
+	if (filedata->map != NULL)
+	{
+		gchar *contents = g_mapped_file_get_contents(filedata->map);
+		gsize length = g_mapped_file_get_length(filedata->map);
+		guint bom_len;
+
+		if (contents != NULL &&
+			encodings_is_utf8_auto(contents, length, forced_enc, &bom_len))
+		{
+			filedata->data = contents + bom_len;
+			filedata->len = length - bom_len;
+			filedata->enc = g_strdup(forced_enc != NULL ? forced_enc : "UTF-8");
+			filedata->bom = bom_len > 0;
+			return TRUE;
+		}
+
+		/* the conversion needs a null-terminated copy it can change */
+		filedata->data = g_malloc(length + 1);
+		if (contents != NULL)
+			memcpy(filedata->data, contents, length);
+		filedata->data[length] = '\0';
+		unmap_file(filedata->map);
+		filedata->map = NULL;
+		filedata->len = length;
+	}
+	else if (! g_file_get_contents(locale_filename, &filedata->data, &filedata->len, &err))
 	{
 		ui_set_statusbar(TRUE, "%s", err->message);
 		g_error_free(err);
 		return FALSE;
 	}
 
-	filedata->len = (gsize) st.st_size;
 	if (! encodings_convert_to_utf8_auto(&filedata->data, &filedata->len, forced_enc,
 				&filedata->enc, &filedata->bom, &filedata->readonly))
 	{
@@ -948,6 +1019,49 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 }
 
 
+/* Replaces the text of sci with len bytes of data, which needn't be null-terminated.
+ * Large files are added in parts while the progress bar shows how far loading is. */
+static void load_text_into_sci(ScintillaObject *sci, const gchar *data, gsize len)
+{
+	GtkWidget *bar = main_widgets.progressbar;
+	gboolean show_progress;
+	gsize pos;
+
+	/* like SCI_SETTEXT, this removes the old text when reloading */
+	sci_set_text(sci, "");
+	sci_allocate(sci, (gint) len + 1);
+
+	/* don't take over the progress bar if something else is using it */
+	show_progress = len > LOAD_CHUNK_SIZE && interface_prefs.statusbar_visible &&
+		main_status.main_window_realized && ! gtk_widget_get_visible(bar);
+	if (show_progress)
+	{
+		gtk_progress_bar_set_text(GTK_PROGRESS_BAR(bar), _("Loading..."));
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(bar), 0.0);
+		gtk_widget_show(bar);
+	}
+
+	for (pos = 0; pos < len; pos += LOAD_CHUNK_SIZE)
+	{
+		sci_append_text(sci, data + pos, (gint) MIN(LOAD_CHUNK_SIZE, len - pos));
+
+		if (show_progress)
+		{
+			gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(bar),
+				(gdouble) MIN(pos + LOAD_CHUNK_SIZE, len) / len);
+			/* only repaint, handling input while the document is half loaded isn't safe.
+			 * GTK 3.22 paints from the frame clock, so the bar only shows the start there */
+#if ! GTK_CHECK_VERSION(3, 22, 0)
+			gdk_window_process_updates(gtk_widget_get_window(bar), TRUE);
+#endif
+		}
+	}
+
+	if (show_progress)
+		gtk_widget_hide(bar);
+}
+
+
 /* Sets the cursor position on opening a file. First it sets the line when cl_options.goto_line
  * is set, otherwise it sets the line when pos is greater than zero and finally it sets the column
  * if cl_options.goto_column is set.
@@ -1273,13 +1387,13 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 
 		/* add the text to the ScintillaObject */
 		sci_set_readonly(doc->editor->sci, FALSE);	/* to allow replacing text */
-		sci_set_text(doc->editor->sci, filedata.data);	/* NULL terminated data */
+		load_text_into_sci(doc->editor->sci, filedata.data, filedata.len);
 		queue_colourise(doc);	/* Ensure the document gets colourised. */
 
 		/* detect & set line endings */
 		editor_mode = utils_get_line_endings(filedata.data, filedata.len);
 		sci_set_eol_mode(doc->editor->sci, editor_mode);
-		g_free(filedata.data);
+		file_data_free(&filedata);
 
 		sci_set_undo_collection(doc->editor->sci, TRUE);
 
@@ -83,6 +83,8 @@ typedef struct GeanyDocumentPrivate
 	time_t			 mtime;
 	/* ID of the idle callback updating the tag list */
 	guint			 tag_list_update_source;
+	/* Words of the document for autocompletion, NULL until needed. See editor.c. */
+	struct DocWords	*words;
 }
 GeanyDocumentPrivate;
 
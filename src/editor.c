@@ -108,6 +108,8 @@ static const gchar *snippets_find_completion_by_name(const gchar *type, const gc
 static void snippets_make_replacements(GeanyEditor *editor, GString *pattern);
 static gssize replace_cursor_markers(GeanyEditor *editor, GString *pattern);
 static GeanyFiletype *editor_get_filetype_at_line(GeanyEditor *editor, gint line);
+static void update_doc_words(GeanyEditor *editor, SCNotification *nt);
+static void doc_words_free(GeanyDocument *doc);
 static gboolean sci_is_blank_line(ScintillaObject *sci, gint line);
 
 
@@ -610,7 +612,11 @@ static void check_line_breaking(GeanyEditor *editor, gint pos)
 }
 
 
-static void show_autocomplete(ScintillaObject *sci, gsize rootlen, GString *words)
+/* sorted is not set when words are ranked some other way than by name.
+ * approximate is set when words also contains words which don't start with the
+ * typed text, after those that do */
+static void show_autocomplete(ScintillaObject *sci, gsize rootlen, GString *words,
+		gboolean sorted, gboolean approximate)
 {
 	/* hide autocompletion if only option is already typed */
 	if (rootlen >= words->len ||
@@ -619,13 +625,19 @@ static void show_autocomplete(ScintillaObject *sci, gsize rootlen, GString *word
 		sci_send_command(sci, SCI_AUTOCCANCEL);
 		return;
 	}
+	/* Scintilla would hide an approximate list when none of the words start with
+	 * the typed text */
+	SSM(sci, SCI_AUTOCSETORDER, sorted ? SC_ORDER_PRESORTED : SC_ORDER_CUSTOM, 0);
+	SSM(sci, SCI_AUTOCSETAUTOHIDE, !approximate, 0);
 	/* store whether a calltip is showing, so we can reshow it after autocompletion */
 	calltip.set = (gboolean) SSM(sci, SCI_CALLTIPACTIVE, 0, 0);
 	SSM(sci, SCI_AUTOCSHOW, rootlen, (sptr_t) words->str);
 }
 
 
-static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize rootlen)
+/* the first prefix_count tags start with the typed text */
+static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize rootlen,
+		guint prefix_count)
 {
 	ScintillaObject *sci = editor->sci;
 
@@ -673,7 +685,8 @@ static void show_tags_list(GeanyEditor *editor, const GPtrArray *tags, gsize roo
 			else
 				g_string_append(words, "?1");
 		}
-		show_autocomplete(sci, rootlen, words);
+		show_autocomplete(sci, rootlen, words, prefix_count == tags->len,
+			prefix_count < tags->len);
 		g_string_free(words, TRUE);
 	}
 }
@@ -781,7 +794,7 @@ static void autocomplete_scope(GeanyEditor *editor)
 		tags = tm_workspace_find_scope_members(obj ? obj->tags_array : NULL,
 			name, TRUE, FALSE);
 		if (tags)
-			show_tags_list(editor, tags, 0);
+			show_tags_list(editor, tags, 0, tags->len);
 	}
 }
 
@@ -1119,6 +1132,11 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 			{
 				document_update_tag_list_in_idle(doc);
 			}
+			if (nt->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE |
+				SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+			{
+				update_doc_words(editor, nt);
+			}
 			break;
 
 		case SCN_CHARADDED:
@@ -2084,7 +2102,7 @@ autocomplete_html(ScintillaObject *sci, const gchar *root, gsize rootlen)
 		}
 	}
 	if (found)
-		show_autocomplete(sci, rootlen, words);
+		show_autocomplete(sci, rootlen, words, TRUE, FALSE);
 
 	g_string_free(words, TRUE);
 	return found;
@@ -2095,18 +2113,20 @@ autocomplete_html(ScintillaObject *sci, const gchar *root, gsize rootlen)
 static gboolean
 autocomplete_tags(GeanyEditor *editor, const gchar *root, gsize rootlen)
 {
-	TMTagAttrType attrs[] = { tm_tag_attr_name_t, 0 };
 	const GPtrArray *tags;
 	GeanyDocument *doc;
+	guint prefix_count;
 
 	g_return_val_if_fail(editor, FALSE);
 
 	doc = editor->document;
 
-	tags = tm_workspace_find(root, tm_tag_max_t & ~tm_tag_member_t, attrs, TRUE, doc->file_type->lang);
+	/* one more than shown, so show_tags_list() knows to add "..." */
+	tags = tm_workspace_find_completions(root, tm_tag_max_t & ~tm_tag_member_t,
+		doc->file_type->lang, editor_prefs.autocompletion_max_entries + 1, TRUE, &prefix_count);
 	if (tags)
 	{
-		show_tags_list(editor, tags, rootlen);
+		show_tags_list(editor, tags, rootlen, prefix_count);
 		return tags->len > 0;
 	}
 	return FALSE;
@@ -2142,59 +2162,286 @@ static gboolean autocomplete_check_html(GeanyEditor *editor, gint style, gint po
 }
 
 
-/* Algorithm based on based on Scite's StartAutoCompleteWord()
- * @returns a sorted list of words matching @p root */
-static GSList *get_doc_words(ScintillaObject *sci, gchar *root, gsize rootlen)
+/* The words of a document and how often they occur, kept up to date as the
+ * document changes so completing a word doesn't need to search the document */
+struct DocWords
 {
-	gchar *word;
-	gint len, current, word_end;
-	gint pos_find, flags;
-	guint word_length;
-	gsize nmatches = 0;
-	GSList *words = NULL;
-	struct Sci_TextToFind ttf;
+	GHashTable *counts;	/* word -> number of occurrences, owns the words */
+	GPtrArray *sorted;	/* the words in counts, sorted with strcmp() */
+	gchar wordchars[257];	/* the filetype's word characters the words were read with */
+	gboolean is_word_char[256];
+};
 
-	len = sci_get_length(sci);
-	current = sci_get_current_position(sci) - rootlen;
+/* changes bigger than this drop the index instead of updating it */
+#define DOC_WORDS_MAX_UPDATE 65536
 
-	ttf.lpstrText = root;
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = len;
-	ttf.chrgText.cpMin = 0;
-	ttf.chrgText.cpMax = 0;
-	flags = SCFIND_WORDSTART | SCFIND_MATCHCASE;
+#define IS_DOC_WORD_CHAR(words, c) ((words)->is_word_char[(guchar) (c)])
+
+
+/* Returns the position of the first word not before word */
+static guint doc_words_lower_bound(GPtrArray *sorted, const gchar *word, gsize len)
+{
+	guint lo = 0, hi = sorted->len;
 
-	/* search the whole document for the word root and collect results */
-	pos_find = scintilla_send_message(sci, SCI_FINDTEXT, flags, (uptr_t) &ttf);
-	while (pos_find >= 0 && pos_find < len)
+	while (lo < hi)
 	{
-		word_end = pos_find + rootlen;
-		if (pos_find != current)
-		{
-			word_end = sci_word_end_position(sci, word_end, TRUE);
+		guint mid = lo + (hi - lo) / 2;
 
-			word_length = word_end - pos_find;
-			if (word_length > rootlen)
-			{
-				word = sci_get_contents_range(sci, pos_find, word_end);
-				/* search whether we already have the word in, otherwise add it */
-				if (g_slist_find_custom(words, word, (GCompareFunc)strcmp) != NULL)
-					g_free(word);
-				else
-				{
-					words = g_slist_prepend(words, word);
-					nmatches++;
-				}
+		if (strncmp(sorted->pdata[mid], word, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
 
-				if (nmatches == editor_prefs.autocompletion_max_entries)
-					break;
-			}
-		}
-		ttf.chrg.cpMin = word_end;
-		pos_find = scintilla_send_message(sci, SCI_FINDTEXT, flags, (uptr_t) &ttf);
+
+static void doc_words_add(struct DocWords *words, const gchar *word)
+{
+	gpointer key, value;
+
+	if (g_hash_table_lookup_extended(words->counts, word, &key, &value))
+		g_hash_table_insert(words->counts, key, GUINT_TO_POINTER(GPOINTER_TO_UINT(value) + 1));
+	else
+	{
+		gchar *copy = g_strdup(word);
+		guint pos;
+
+		g_hash_table_insert(words->counts, copy, GUINT_TO_POINTER(1));
+		/* sorted is built at once after reading the whole document */
+		if (words->sorted == NULL)
+			return;
+		pos = doc_words_lower_bound(words->sorted, copy, strlen(copy) + 1);
+		g_ptr_array_add(words->sorted, NULL);
+		memmove(words->sorted->pdata + pos + 1, words->sorted->pdata + pos,
+			(words->sorted->len - 1 - pos) * sizeof(gpointer));
+		words->sorted->pdata[pos] = copy;
+	}
+}
+
+
+static void doc_words_remove(struct DocWords *words, const gchar *word)
+{
+	gpointer key, value;
+	guint count;
+
+	if (! g_hash_table_lookup_extended(words->counts, word, &key, &value))
+		return;
+	count = GPOINTER_TO_UINT(value);
+	if (count > 1)
+		g_hash_table_insert(words->counts, key, GUINT_TO_POINTER(count - 1));
+	else
+	{
+		guint pos = doc_words_lower_bound(words->sorted, key, strlen(key) + 1);
+
+		g_ptr_array_remove_index(words->sorted, pos);
+		g_hash_table_remove(words->counts, key);
+	}
+}
+
+
+/* Adds or removes all words of text, which is changed but restored */
+static void doc_words_scan(struct DocWords *words, gchar *text, gboolean add)
+{
+	gchar *p = text;
+
+	while (*p)
+	{
+		gchar *start, c;
+
+		while (*p && ! IS_DOC_WORD_CHAR(words, *p))
+			p++;
+		start = p;
+		while (*p && IS_DOC_WORD_CHAR(words, *p))
+			p++;
+		/* single characters can't complete anything */
+		if (p - start < 2)
+			continue;
+		c = *p;
+		*p = '\0';
+		if (add)
+			doc_words_add(words, start);
+		else
+			doc_words_remove(words, start);
+		*p = c;
+	}
+}
+
+
+static void doc_words_free(GeanyDocument *doc)
+{
+	struct DocWords *words = doc->priv->words;
+
+	if (words == NULL)
+		return;
+	g_ptr_array_free(words->sorted, TRUE);
+	g_hash_table_destroy(words->counts);
+	g_free(words);
+	doc->priv->words = NULL;
+}
+
+
+static gint compare_doc_words(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+
+/* Returns the words of the document, reading them all if this is the first time
+ * or the word characters have changed, e.g. with the filetype */
+static struct DocWords *doc_words_get(GeanyDocument *doc)
+{
+	struct DocWords *words = doc->priv->words;
+	gchar wordchars[257] = {0};
+	gint i;
+
+	/* Scintilla's word characters, as set from the filetype's wordchars */
+	SSM(doc->editor->sci, SCI_GETWORDCHARS, 0, (sptr_t) wordchars);
+	if (words != NULL && ! utils_str_equal(words->wordchars, wordchars))
+	{
+		doc_words_free(doc);
+		words = NULL;
+	}
+	if (words == NULL)
+	{
+		gchar *text = sci_get_contents(doc->editor->sci, -1);
+
+		GHashTableIter iter;
+		gpointer word;
+
+		words = g_new0(struct DocWords, 1);
+		words->counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		words->sorted = NULL;
+		memcpy(words->wordchars, wordchars, sizeof(wordchars));
+		for (i = 0; wordchars[i]; i++)
+			words->is_word_char[(guchar) wordchars[i]] = TRUE;
+		doc_words_scan(words, text, TRUE);
+		g_free(text);
+
+		words->sorted = g_ptr_array_sized_new(g_hash_table_size(words->counts));
+		g_hash_table_iter_init(&iter, words->counts);
+		while (g_hash_table_iter_next(&iter, &word, NULL))
+			g_ptr_array_add(words->sorted, word);
+		g_ptr_array_sort(words->sorted, compare_doc_words);
+		doc->priv->words = words;
+	}
+	return words;
+}
+
+
+/* Extends start and end to the word boundaries around them */
+static void doc_words_expand_range(struct DocWords *words, ScintillaObject *sci,
+		gint *start, gint *end)
+{
+	gint len = sci_get_length(sci);
+
+	while (*start > 0 && IS_DOC_WORD_CHAR(words, sci_get_char_at(sci, *start - 1)))
+		(*start)--;
+	while (*end < len && IS_DOC_WORD_CHAR(words, sci_get_char_at(sci, *end)))
+		(*end)++;
+}
+
+
+/* Updates the word index from SCN_MODIFIED. Before a change, the words it touches
+ * are removed, and after it the words around the changed text are added again. */
+static void update_doc_words(GeanyEditor *editor, SCNotification *nt)
+{
+	GeanyDocument *doc = editor->document;
+	gint start = nt->position, end = nt->position;
+	gboolean add;
+	gchar *text;
+
+	if (doc->priv->words == NULL)
+		return;
+	if (nt->modificationType & (SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE) &&
+		nt->length > DOC_WORDS_MAX_UPDATE)
+	{
+		/* cheaper to read the document again when it's next needed */
+		doc_words_free(doc);
+		return;
 	}
 
-	return g_slist_sort(words, (GCompareFunc)utils_str_casecmp);
+	if (nt->modificationType & SC_MOD_BEFOREINSERT)
+		add = FALSE;
+	else if (nt->modificationType & SC_MOD_BEFOREDELETE)
+	{
+		end += nt->length;
+		add = FALSE;
+	}
+	else if (nt->modificationType & SC_MOD_INSERTTEXT)
+	{
+		end += nt->length;
+		add = TRUE;
+	}
+	else if (nt->modificationType & SC_MOD_DELETETEXT)
+		add = TRUE;
+	else
+		return;
+
+	doc_words_expand_range(doc->priv->words, editor->sci, &start, &end);
+	if (start == end)
+		return;
+	text = sci_get_contents_range(editor->sci, start, end);
+	doc_words_scan(doc->priv->words, text, add);
+	g_free(text);
+}
+
+
+static gint compare_doc_word_counts(gconstpointer a, gconstpointer b, gpointer data)
+{
+	GHashTable *counts = data;
+	gint diff = GPOINTER_TO_INT(g_hash_table_lookup(counts, *(const gchar **) b)) -
+		GPOINTER_TO_INT(g_hash_table_lookup(counts, *(const gchar **) a));
+
+	return diff ? diff : utils_str_casecmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+
+/* @returns the words starting with @p root, most frequent first */
+static GSList *get_doc_words(GeanyEditor *editor, gchar *root, gsize rootlen)
+{
+	ScintillaObject *sci = editor->sci;
+	struct DocWords *words = doc_words_get(editor->document);
+	GPtrArray *matches = g_ptr_array_new();
+	GHashTable *counts = g_hash_table_new(g_str_hash, g_str_equal);
+	gint current, current_end;
+	gchar *current_word;
+	GSList *list = NULL;
+	guint i;
+
+	/* the word being typed occurs once in the document, but doesn't count */
+	current = sci_get_current_position(sci) - rootlen;
+	current_end = current;
+	while (current_end < sci_get_length(sci) && IS_DOC_WORD_CHAR(words, sci_get_char_at(sci, current_end)))
+		current_end++;
+	current_word = sci_get_contents_range(sci, current, current_end);
+
+	for (i = doc_words_lower_bound(words->sorted, root, rootlen); i < words->sorted->len; i++)
+	{
+		gchar *word = words->sorted->pdata[i];
+		guint count;
+
+		if (strncmp(word, root, rootlen) != 0)
+			break;
+		if (strlen(word) <= rootlen)
+			continue;
+		count = GPOINTER_TO_UINT(g_hash_table_lookup(words->counts, word));
+		if (utils_str_equal(word, current_word))
+			count--;
+		if (count == 0)
+			continue;
+		g_hash_table_insert(counts, word, GUINT_TO_POINTER(count));
+		g_ptr_array_add(matches, word);
+	}
+	g_free(current_word);
+
+	g_ptr_array_sort_with_data(matches, compare_doc_word_counts, counts);
+	for (i = MIN(matches->len, editor_prefs.autocompletion_max_entries); i > 0; i--)
+		list = g_slist_prepend(list, g_strdup(matches->pdata[i - 1]));
+
+	g_ptr_array_free(matches, TRUE);
+	g_hash_table_destroy(counts);
+	return list;
 }
 
 
@@ -2205,7 +2452,7 @@ static gboolean autocomplete_doc_word(GeanyEditor *editor, gchar *root, gsize ro
 	GString *str;
 	guint n_words = 0;
 
-	words = get_doc_words(sci, root, rootlen);
+	words = get_doc_words(editor, root, rootlen);
 	if (!words)
 	{
 		scintilla_send_message(sci, SCI_AUTOCCANCEL, 0, 0);
@@ -2226,7 +2473,7 @@ static gboolean autocomplete_doc_word(GeanyEditor *editor, gchar *root, gsize ro
 
 	g_slist_free(words);
 
-	show_autocomplete(sci, rootlen, str);
+	show_autocomplete(sci, rootlen, str, FALSE, FALSE);
 	g_string_free(str, TRUE);
 	return TRUE;
 }
@@ -4873,6 +5120,7 @@ GeanyEditor *editor_create(GeanyDocument *doc)
 /* in case we need to free some fields in future */
 void editor_destroy(GeanyEditor *editor)
 {
+	doc_words_free(editor->document);
 	g_free(editor);
 }
 
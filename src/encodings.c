@@ -969,3 +969,85 @@ gboolean encodings_convert_to_utf8_auto(gchar **buf, gsize *size, const gchar *f
 	*buf = buffer.data;
 	return TRUE;
 }
+
+
+/* Like g_utf8_validate() with a length, but also fails for null bytes, and skips ASCII
+ * text a machine word at a time, which is most of a source or data file. */
+static gboolean utf8_validate_text(const gchar *buffer, gsize size)
+{
+	const gchar *p = buffer, *end = buffer + size;
+	const gsize ones = (gsize) -1 / 0xFF;	/* 0x0101... */
+	const gsize highs = ones * 0x80;		/* 0x8080... */
+
+	while (p < end)
+	{
+		/* a word without null bytes or bytes >= 0x80 is valid ASCII */
+		if ((gsize) (end - p) >= sizeof(gsize))
+		{
+			gsize word;
+
+			memcpy(&word, p, sizeof(word));
+			if ((((word - ones) | word) & highs) == 0)
+			{
+				p += sizeof(word);
+				continue;
+			}
+		}
+		if (*p == '\0')
+			return FALSE;
+		if ((guchar) *p < 0x80)
+			p++;
+		else
+		{
+			const gchar *valid_end;
+
+			/* check one character, which is at most 4 bytes */
+			g_utf8_validate(p, MIN(4, end - p), &valid_end);
+			if (valid_end == p)
+				return FALSE;
+			p = valid_end;
+		}
+	}
+	return TRUE;
+}
+
+
+/*
+ * Checks whether encodings_convert_to_utf8_auto() would load @a buffer as UTF-8 without
+ * changing anything but removing a BOM, so that it can be used without copying it.
+ * Data with null bytes is rejected because the conversion truncates it.
+ *
+ * @param buffer the data to check, which needn't be null-terminated.
+ * @param size the size of the data.
+ * @param forced_enc forced encoding to use, or @c NULL
+ * @param bom_len return location for the length of a UTF-8 BOM, or 0 without one.
+ *
+ * @return @c TRUE if the data after the BOM is UTF-8 which can be used as it is.
+ */
+gboolean encodings_is_utf8_auto(const gchar *buffer, gsize size, const gchar *forced_enc,
+		guint *bom_len)
+{
+	GeanyEncodingIndex enc_idx;
+	guint len = 0;
+
+	*bom_len = 0;
+	if (forced_enc != NULL && ! utils_str_equal(forced_enc, "UTF-8"))
+		return FALSE;
+
+	enc_idx = encodings_scan_unicode_bom(buffer, size, &len);
+	if (enc_idx == GEANY_ENCODING_UTF_8)
+		*bom_len = len;
+	else if (enc_idx != GEANY_ENCODING_NONE)
+		return FALSE;
+	else if (forced_enc == NULL)
+	{
+		/* like handle_encoding(), the content can name its charset */
+		gchar *regex_charset = encodings_check_regexes(buffer, size);
+		gboolean is_utf8 = encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8;
+
+		g_free(regex_charset);
+		if (! is_utf8)
+			return FALSE;
+	}
+	return utf8_validate_text(buffer, size);
+}
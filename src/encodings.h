@@ -92,6 +92,9 @@ gboolean encodings_is_unicode_charset(const gchar *string);
 gboolean encodings_convert_to_utf8_auto(gchar **buf, gsize *size, const gchar *forced_enc,
 		gchar **used_encoding, gboolean *has_bom, gboolean *partial);
 
+gboolean encodings_is_utf8_auto(const gchar *buffer, gsize size, const gchar *forced_enc,
+		guint *bom_len);
+
 /*
  * The original versions of the following tables are taken from profterm
  *
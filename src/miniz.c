@@ -3491,9 +3491,29 @@ static mz_bool mz_zip_writer_write_zeros(mz_zip_archive *pZip, mz_uint64 cur_fil
   return MZ_TRUE;
 }
 
-mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32)
+// Local header extra field that pads stored data to a multiple of data_alignment, the same field zipalign and apksigner write (header id 0xD935).
+#define MZ_ZIP_ALIGNMENT_EXTRA_HEADER_SIZE 6
+
+static mz_uint16 mz_zip_writer_compute_alignment_extra_size(mz_uint64 local_dir_header_ofs, mz_uint filename_size, mz_uint data_alignment)
+{
+  mz_uint64 data_ofs = local_dir_header_ofs + MZ_ZIP_LOCAL_DIR_HEADER_SIZE + filename_size + MZ_ZIP_ALIGNMENT_EXTRA_HEADER_SIZE;
+  return (mz_uint16)(MZ_ZIP_ALIGNMENT_EXTRA_HEADER_SIZE + ((data_alignment - (data_ofs % data_alignment)) % data_alignment));
+}
+
+static mz_bool mz_zip_writer_write_alignment_extra(mz_zip_archive *pZip, mz_uint64 cur_file_ofs, mz_uint16 extra_size, mz_uint data_alignment)
+{
+  mz_uint8 hdr[MZ_ZIP_ALIGNMENT_EXTRA_HEADER_SIZE];
+  MZ_WRITE_LE16(hdr, 0xD935);
+  MZ_WRITE_LE16(hdr + 2, extra_size - 4);
+  MZ_WRITE_LE16(hdr + 4, data_alignment);
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_file_ofs, hdr, sizeof(hdr)) != sizeof(hdr))
+    return MZ_FALSE;
+  return mz_zip_writer_write_zeros(pZip, cur_file_ofs + sizeof(hdr), extra_size - MZ_ZIP_ALIGNMENT_EXTRA_HEADER_SIZE);
+}
+
+static mz_bool mz_zip_writer_add_mem_internal(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32, const void *pLast_modified, mz_uint data_alignment)
 {
-  mz_uint16 method = 0, dos_time = 0, dos_date = 0;
+  mz_uint16 method = 0, dos_time = 0, dos_date = 0, extra_size = 0;
   mz_uint level, ext_attributes = 0, num_alignment_padding_bytes;
   mz_uint64 local_dir_header_ofs = pZip->m_archive_size, cur_archive_file_ofs = pZip->m_archive_size, comp_size = 0;
   size_t archive_name_size;
@@ -3522,9 +3542,15 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
 
 #ifndef MINIZ_NO_TIME
   {
-    time_t cur_time; time(&cur_time);
+    time_t cur_time;
+    if (pLast_modified)
+      cur_time = *(const time_t *)pLast_modified;
+    else
+      time(&cur_time);
     mz_zip_time_to_dos_time(cur_time, &dos_time, &dos_date);
   }
+#else
+  (void)pLast_modified;
 #endif // #ifndef MINIZ_NO_TIME
 
   archive_name_size = strlen(pArchive_name);
@@ -3584,6 +3610,17 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
     }
   }
 
+  if ((data_alignment > 1) && (store_data_uncompressed) && (!(level_and_flags & MZ_ZIP_FLAG_COMPRESSED_DATA)))
+  {
+    extra_size = mz_zip_writer_compute_alignment_extra_size(local_dir_header_ofs, (mz_uint)archive_name_size, data_alignment);
+    if (!mz_zip_writer_write_alignment_extra(pZip, cur_archive_file_ofs, extra_size, data_alignment))
+    {
+      pZip->m_pFree(pZip->m_pAlloc_opaque, pComp);
+      return MZ_FALSE;
+    }
+    cur_archive_file_ofs += extra_size;
+  }
+
   if (store_data_uncompressed)
   {
     if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_archive_file_ofs, pBuf, buf_size) != buf_size)
@@ -3626,7 +3663,7 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
   if ((comp_size > 0xFFFFFFFF) || (cur_archive_file_ofs > 0xFFFFFFFF))
     return MZ_FALSE;
 
-  if (!mz_zip_writer_create_local_dir_header(pZip, local_dir_header, (mz_uint16)archive_name_size, 0, uncomp_size, comp_size, uncomp_crc32, method, 0, dos_time, dos_date))
+  if (!mz_zip_writer_create_local_dir_header(pZip, local_dir_header, (mz_uint16)archive_name_size, extra_size, uncomp_size, comp_size, uncomp_crc32, method, 0, dos_time, dos_date))
     return MZ_FALSE;
 
   if (pZip->m_pWrite(pZip->m_pIO_opaque, local_dir_header_ofs, local_dir_header, sizeof(local_dir_header)) != sizeof(local_dir_header))
@@ -3641,6 +3678,18 @@ mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name
   return MZ_TRUE;
 }
 
+mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32)
+{
+  return mz_zip_writer_add_mem_internal(pZip, pArchive_name, pBuf, buf_size, pComment, comment_size, level_and_flags, uncomp_size, uncomp_crc32, NULL, 0);
+}
+
+#ifndef MINIZ_NO_TIME
+mz_bool mz_zip_writer_add_mem_ex_v2(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32, const time_t *pLast_modified, mz_uint data_alignment)
+{
+  return mz_zip_writer_add_mem_internal(pZip, pArchive_name, pBuf, buf_size, pComment, comment_size, level_and_flags, uncomp_size, uncomp_crc32, pLast_modified, data_alignment);
+}
+#endif // #ifndef MINIZ_NO_TIME
+
 #ifndef MINIZ_NO_STDIO
 mz_bool mz_zip_writer_add_file(mz_zip_archive *pZip, const char *pArchive_name, const char *pSrc_filename, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags)
 {
@@ -3943,6 +3992,134 @@ mz_bool mz_zip_writer_add_from_zip_reader(mz_zip_archive *pZip, mz_zip_archive *
   return MZ_TRUE;
 }
 
+mz_bool mz_zip_writer_add_from_zip_reader_v2(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index, mz_uint data_alignment)
+{
+  mz_uint n, num_alignment_padding_bytes, filename_size;
+  mz_uint16 extra_size;
+  mz_uint64 comp_bytes_remaining, local_dir_header_ofs;
+  mz_uint64 cur_src_file_ofs, cur_dst_file_ofs;
+  mz_uint32 local_header_u32[(MZ_ZIP_LOCAL_DIR_HEADER_SIZE + sizeof(mz_uint32) - 1) / sizeof(mz_uint32)]; mz_uint8 *pLocal_header = (mz_uint8 *)local_header_u32;
+  mz_uint8 central_header[MZ_ZIP_CENTRAL_DIR_HEADER_SIZE];
+  size_t orig_central_dir_size;
+  mz_zip_internal_state *pState;
+  void *pBuf; const mz_uint8 *pSrc_central_header;
+
+  if ((!pZip) || (!pZip->m_pState) || (pZip->m_zip_mode != MZ_ZIP_MODE_WRITING))
+    return MZ_FALSE;
+  if (NULL == (pSrc_central_header = mz_zip_reader_get_cdh(pSource_zip, file_index)))
+    return MZ_FALSE;
+
+  // only stored data needs aligning, entries with a data descriptor are copied as they are
+  if ((data_alignment <= 1) || (data_alignment > 0xFFFF) || (MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_METHOD_OFS) != 0) || (MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_BIT_FLAG_OFS) & 8))
+    return mz_zip_writer_add_from_zip_reader(pZip, pSource_zip, file_index);
+
+  pState = pZip->m_pState;
+
+  num_alignment_padding_bytes = mz_zip_writer_compute_padding_needed_for_file_alignment(pZip);
+
+  // no zip64 support yet
+  if ((pZip->m_total_files == 0xFFFF) || ((pZip->m_archive_size + num_alignment_padding_bytes + MZ_ZIP_LOCAL_DIR_HEADER_SIZE + MZ_ZIP_CENTRAL_DIR_HEADER_SIZE) > 0xFFFFFFFF))
+    return MZ_FALSE;
+
+  cur_src_file_ofs = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_LOCAL_HEADER_OFS);
+  cur_dst_file_ofs = pZip->m_archive_size;
+
+  if (pSource_zip->m_pRead(pSource_zip->m_pIO_opaque, cur_src_file_ofs, pLocal_header, MZ_ZIP_LOCAL_DIR_HEADER_SIZE) != MZ_ZIP_LOCAL_DIR_HEADER_SIZE)
+    return MZ_FALSE;
+  if (MZ_READ_LE32(pLocal_header) != MZ_ZIP_LOCAL_DIR_HEADER_SIG)
+    return MZ_FALSE;
+  cur_src_file_ofs += MZ_ZIP_LOCAL_DIR_HEADER_SIZE;
+
+  if (!mz_zip_writer_write_zeros(pZip, cur_dst_file_ofs, num_alignment_padding_bytes))
+    return MZ_FALSE;
+  cur_dst_file_ofs += num_alignment_padding_bytes;
+  local_dir_header_ofs = cur_dst_file_ofs;
+  if (pZip->m_file_offset_alignment) { MZ_ASSERT((local_dir_header_ofs & (pZip->m_file_offset_alignment - 1)) == 0); }
+
+  // replace the source's local extra field with the alignment padding
+  filename_size = MZ_READ_LE16(pLocal_header + MZ_ZIP_LDH_FILENAME_LEN_OFS);
+  extra_size = mz_zip_writer_compute_alignment_extra_size(local_dir_header_ofs, filename_size, data_alignment);
+  n = MZ_READ_LE16(pLocal_header + MZ_ZIP_LDH_EXTRA_LEN_OFS);
+  MZ_WRITE_LE16(pLocal_header + MZ_ZIP_LDH_EXTRA_LEN_OFS, extra_size);
+
+  if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pLocal_header, MZ_ZIP_LOCAL_DIR_HEADER_SIZE) != MZ_ZIP_LOCAL_DIR_HEADER_SIZE)
+    return MZ_FALSE;
+  cur_dst_file_ofs += MZ_ZIP_LOCAL_DIR_HEADER_SIZE;
+
+  comp_bytes_remaining = MZ_READ_LE32(pSrc_central_header + MZ_ZIP_CDH_COMPRESSED_SIZE_OFS);
+  if (NULL == (pBuf = pZip->m_pAlloc(pZip->m_pAlloc_opaque, 1, (size_t)MZ_MAX(0xFFFF, MZ_MIN(MZ_ZIP_MAX_IO_BUF_SIZE, comp_bytes_remaining)))))
+    return MZ_FALSE;
+
+  if ((pSource_zip->m_pRead(pSource_zip->m_pIO_opaque, cur_src_file_ofs, pBuf, filename_size) != filename_size) ||
+      (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pBuf, filename_size) != filename_size))
+  {
+    pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+    return MZ_FALSE;
+  }
+  cur_src_file_ofs += filename_size + n;
+  cur_dst_file_ofs += filename_size;
+
+  if (!mz_zip_writer_write_alignment_extra(pZip, cur_dst_file_ofs, extra_size, data_alignment))
+  {
+    pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+    return MZ_FALSE;
+  }
+  cur_dst_file_ofs += extra_size;
+
+  while (comp_bytes_remaining)
+  {
+    n = (mz_uint)MZ_MIN(MZ_ZIP_MAX_IO_BUF_SIZE, comp_bytes_remaining);
+    if (pSource_zip->m_pRead(pSource_zip->m_pIO_opaque, cur_src_file_ofs, pBuf, n) != n)
+    {
+      pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+      return MZ_FALSE;
+    }
+    cur_src_file_ofs += n;
+
+    if (pZip->m_pWrite(pZip->m_pIO_opaque, cur_dst_file_ofs, pBuf, n) != n)
+    {
+      pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+      return MZ_FALSE;
+    }
+    cur_dst_file_ofs += n;
+
+    comp_bytes_remaining -= n;
+  }
+  pZip->m_pFree(pZip->m_pAlloc_opaque, pBuf);
+
+  // no zip64 support yet
+  if (cur_dst_file_ofs > 0xFFFFFFFF)
+    return MZ_FALSE;
+
+  orig_central_dir_size = pState->m_central_dir.m_size;
+
+  memcpy(central_header, pSrc_central_header, MZ_ZIP_CENTRAL_DIR_HEADER_SIZE);
+  MZ_WRITE_LE32(central_header + MZ_ZIP_CDH_LOCAL_HEADER_OFS, local_dir_header_ofs);
+  if (!mz_zip_array_push_back(pZip, &pState->m_central_dir, central_header, MZ_ZIP_CENTRAL_DIR_HEADER_SIZE))
+    return MZ_FALSE;
+
+  n = MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_FILENAME_LEN_OFS) + MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_EXTRA_LEN_OFS) + MZ_READ_LE16(pSrc_central_header + MZ_ZIP_CDH_COMMENT_LEN_OFS);
+  if (!mz_zip_array_push_back(pZip, &pState->m_central_dir, pSrc_central_header + MZ_ZIP_CENTRAL_DIR_HEADER_SIZE, n))
+  {
+    mz_zip_array_resize(pZip, &pState->m_central_dir, orig_central_dir_size, MZ_FALSE);
+    return MZ_FALSE;
+  }
+
+  if (pState->m_central_dir.m_size > 0xFFFFFFFF)
+    return MZ_FALSE;
+  n = (mz_uint32)orig_central_dir_size;
+  if (!mz_zip_array_push_back(pZip, &pState->m_central_dir_offsets, &n, 1))
+  {
+    mz_zip_array_resize(pZip, &pState->m_central_dir, orig_central_dir_size, MZ_FALSE);
+    return MZ_FALSE;
+  }
+
+  pZip->m_total_files++;
+  pZip->m_archive_size = cur_dst_file_ofs;
+
+  return MZ_TRUE;
+}
+
 mz_bool mz_zip_writer_finalize_archive(mz_zip_archive *pZip)
 {
   mz_zip_internal_state *pState;
@@ -486,6 +486,15 @@ mz_bool mz_zip_writer_init_from_reader(mz_zip_archive *pZip, const char *pFilena
 mz_bool mz_zip_writer_add_mem(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, mz_uint level_and_flags);
 mz_bool mz_zip_writer_add_mem_ex(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32);
 
+#ifndef MINIZ_NO_TIME
+// Same as mz_zip_writer_add_mem_ex(), but records *pLast_modified into the archive instead of the current time (pass NULL for the current time).
+// Use this with MZ_ZIP_FLAG_COMPRESSED_DATA to add data that was deflated elsewhere while keeping the source file's modified time, which
+// gives the same entry mz_zip_writer_add_file() would have written.
+// If data_alignment is above 1 and the data is stored uncompressed, the local header gets an extra field that pads the start of the data
+// to a multiple of data_alignment, like zipalign does for APKs.
+mz_bool mz_zip_writer_add_mem_ex_v2(mz_zip_archive *pZip, const char *pArchive_name, const void *pBuf, size_t buf_size, const void *pComment, mz_uint16 comment_size, mz_uint level_and_flags, mz_uint64 uncomp_size, mz_uint32 uncomp_crc32, const time_t *pLast_modified, mz_uint data_alignment);
+#endif
+
 #ifndef MINIZ_NO_STDIO
 // Adds the contents of a disk file to an archive. This function also records the disk file's modified time into the archive.
 // level_and_flags - compression level (0-10, see MZ_BEST_SPEED, MZ_BEST_COMPRESSION, etc.) logically OR'd with zero or more mz_zip_flags, or just set to MZ_DEFAULT_COMPRESSION.
@@ -496,6 +505,10 @@ mz_bool mz_zip_writer_add_file(mz_zip_archive *pZip, const char *pArchive_name,
 // This function fully clones the source file's compressed data (no recompression), along with its full filename, extra data, and comment fields.
 mz_bool mz_zip_writer_add_from_zip_reader(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index);
 
+// Same as mz_zip_writer_add_from_zip_reader(), but the data of stored entries is padded to a multiple of data_alignment
+// (see mz_zip_writer_add_mem_ex_v2()). The source's local extra field is replaced by the padding.
+mz_bool mz_zip_writer_add_from_zip_reader_v2(mz_zip_archive *pZip, mz_zip_archive *pSource_zip, mz_uint file_index, mz_uint data_alignment);
+
 // Finalizes the archive by writing the central directory records followed by the end of central directory record.
 // After an archive is finalized, the only valid call on the mz_zip_archive struct is mz_zip_writer_end().
 // An archive must be manually finalized by calling this function for it to be valid.
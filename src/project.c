@@ -28,6 +28,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 
 #include <glib/gstdio.h>
 
@@ -49,6 +52,7 @@
 #include "sidebar.h"
 #include "filetypes.h"
 #include "templates.h"
+#include "symbols.h"
 
 #include "miniz.h"
 
@@ -64,7 +68,7 @@ ProjectPrefs project_prefs = { NULL, FALSE, FALSE };
 
 static GSList *stash_groups = NULL;
 
-GlobalProjectPrefs global_project_prefs = { NULL };
+GlobalProjectPrefs global_project_prefs = { NULL, 2 };
 
 static gboolean entries_modified;
 
@@ -94,8 +98,11 @@ static void apply_editor_prefs(void);
 static void init_stash_prefs(void);
 
 
-#define SHOW_ERR(args) dialogs_show_msgbox(GTK_MESSAGE_ERROR, args)
-#define SHOW_ERR1(args, more) dialogs_show_msgbox(GTK_MESSAGE_ERROR, args, more)
+static void project_show_error(const gchar *format, ...) G_GNUC_PRINTF (1, 2);
+
+/* safe to use from export jobs, see project_show_error() */
+#define SHOW_ERR(args) project_show_error(args)
+#define SHOW_ERR1(args, more) project_show_error(args, more)
 #define MAX_NAME_LEN 50
 /* "projects" is part of the default project base path so be careful when translating
  * please avoid special characters and spaces, look at the source for details or ask Frank */
@@ -114,6 +121,242 @@ void make_path( char* path )
 	*slash = '/';
 }
 
+/* Export jobs
+ * The slow part of an export runs on a worker thread so the editor stays usable while it
+ * is going. The job function must not touch any widgets or app->project, it gets everything
+ * it needs in its data. It is always called, even if the job was cancelled while queued, so
+ * it can free its data, and it should check export_job_is_cancelled() between stages.
+ * The done function is then called from the main loop to update the UI. */
+typedef struct ExportJob ExportJob;
+
+typedef gboolean (*ExportJobFunc)(ExportJob *job, gpointer data);
+typedef void (*ExportJobDoneFunc)(ExportJob *job, gboolean success, gpointer data);
+
+struct ExportJob
+{
+	gchar *name;
+	ExportJobFunc func;
+	ExportJobDoneFunc done_func;
+	gpointer done_data;
+	gpointer data;
+	volatile gint cancelled;
+	gboolean success;
+	gint slot;		/* set while running, see export_job_get_folder() */
+
+	/* progress, written by the job and read by the status timer while holding export_job_lock */
+	gchar *stage;
+	guint64 bytes_done;
+	guint64 bytes_total;
+};
+
+G_LOCK_DEFINE_STATIC(export_job_lock);
+
+static GThread *project_main_thread = NULL;
+static GThreadPool *export_job_pool = NULL;
+static GList *export_jobs = NULL;	/* queued and running jobs, main thread only */
+static guint export_job_status_id = 0;
+static guint32 export_job_slots = 0;	/* slots of the running jobs, protected by export_job_lock */
+
+
+static gboolean project_show_error_idle(gpointer data)
+{
+	dialogs_show_msgbox(GTK_MESSAGE_ERROR, "%s", (gchar*) data);
+	g_free(data);
+	return FALSE;
+}
+
+
+/* shows an error message box, when called from an export job the message is shown from the main loop */
+static void project_show_error(const gchar *format, ...)
+{
+	gchar *msg;
+	va_list args;
+
+	va_start(args, format);
+	msg = g_strdup_vprintf(format, args);
+	va_end(args);
+
+	if (project_main_thread == NULL || g_thread_self() == project_main_thread)
+		project_show_error_idle(msg);
+	else
+		g_idle_add(project_show_error_idle, msg);
+}
+
+
+static void export_job_set_stage(ExportJob *job, const gchar *stage)
+{
+	G_LOCK(export_job_lock);
+	SETPTR(job->stage, g_strdup(stage));
+	job->bytes_done = 0;
+	job->bytes_total = 0;
+	G_UNLOCK(export_job_lock);
+}
+
+
+static void export_job_set_progress(ExportJob *job, guint64 bytes_done, guint64 bytes_total)
+{
+	G_LOCK(export_job_lock);
+	job->bytes_done = bytes_done;
+	job->bytes_total = bytes_total;
+	G_UNLOCK(export_job_lock);
+}
+
+
+static gboolean export_job_is_cancelled(ExportJob *job)
+{
+	return g_atomic_int_get(&job->cancelled) != 0;
+}
+
+
+/* main thread only, the job stops at its next check */
+static void export_job_cancel(ExportJob *job)
+{
+	g_atomic_int_set(&job->cancelled, 1);
+}
+
+
+/* Returns base_path/name for the build folder of a job. Jobs running at the same time get
+ * name2, name3... instead so that two exports of the same project don't share a folder, and
+ * the number of folders left behind is limited by the number of jobs that can run at once. */
+static gchar *export_job_get_folder(ExportJob *job, const gchar *base_path, const gchar *name)
+{
+	gchar *folder_name, *folder;
+
+	if (job->slot == 0)
+		return g_build_filename(base_path, name, NULL);
+
+	folder_name = g_strdup_printf("%s%d", name, job->slot + 1);
+	folder = g_build_filename(base_path, folder_name, NULL);
+	g_free(folder_name);
+	return folder;
+}
+
+
+static gint export_job_get_max_jobs(void)
+{
+	return CLAMP(global_project_prefs.export_max_jobs, 1, 16);
+}
+
+
+/* can be passed to utils_zip_packer_set_progress_func() */
+static gboolean export_job_zip_progress(guint64 bytes_done, guint64 bytes_total, gpointer user_data)
+{
+	ExportJob *job = user_data;
+
+	export_job_set_progress(job, bytes_done, bytes_total);
+	return !export_job_is_cancelled(job);
+}
+
+
+static gboolean export_job_update_status(gpointer data)
+{
+	ExportJob *job;
+	gchar *stage, *text;
+	guint64 bytes_done, bytes_total;
+	guint others;
+
+	if (export_jobs == NULL)
+	{
+		export_job_status_id = 0;
+		return FALSE;
+	}
+
+	/* jobs start in the order they were queued, so show the oldest */
+	job = export_jobs->data;
+	others = g_list_length(export_jobs) - 1;
+
+	G_LOCK(export_job_lock);
+	stage = g_strdup(job->stage);
+	bytes_done = job->bytes_done;
+	bytes_total = job->bytes_total;
+	G_UNLOCK(export_job_lock);
+
+	if (stage == NULL)
+		text = g_strdup_printf(_("Waiting to export %s"), job->name);
+	else if (bytes_total > 0)
+		text = g_strdup_printf(_("Exporting %s: %s (%d%%)"), job->name, stage, (gint) (bytes_done * 100 / bytes_total));
+	else
+		text = g_strdup_printf(_("Exporting %s: %s"), job->name, stage);
+
+	if (others > 0)
+		ui_set_statusbar(FALSE, ngettext("%s (%u more export)", "%s (%u more exports)", others), text, others);
+	else
+		ui_set_statusbar(FALSE, "%s", text);
+
+	g_free(text);
+	g_free(stage);
+	return TRUE;
+}
+
+
+static gboolean export_job_finish(gpointer data)
+{
+	ExportJob *job = data;
+
+	export_jobs = g_list_remove(export_jobs, job);
+
+	if (export_job_is_cancelled(job))
+		ui_set_statusbar(TRUE, _("Export of %s was cancelled"), job->name);
+	else if (job->success)
+		ui_set_statusbar(TRUE, _("Exported %s"), job->name);
+	else
+		ui_set_statusbar(TRUE, _("Export of %s failed"), job->name);
+
+	if (job->done_func)
+		job->done_func(job, job->success && !export_job_is_cancelled(job), job->done_data);
+
+	g_free(job->name);
+	g_free(job->stage);
+	g_free(job);
+	return FALSE;
+}
+
+
+static void export_job_thread_func(gpointer data, gpointer user_data)
+{
+	ExportJob *job = data;
+
+	G_LOCK(export_job_lock);
+	for (job->slot = 0; export_job_slots & (1u << job->slot); job->slot++);
+	export_job_slots |= 1u << job->slot;
+	G_UNLOCK(export_job_lock);
+
+	job->success = job->func(job, job->data);
+
+	G_LOCK(export_job_lock);
+	export_job_slots &= ~(1u << job->slot);
+	G_UNLOCK(export_job_lock);
+
+	g_idle_add(export_job_finish, job);
+}
+
+
+/* Queues an export, the returned job stays valid until its done function has been called.
+ * Up to export_max_jobs exports run at the same time. */
+static ExportJob *export_job_start(const gchar *name, ExportJobFunc func, gpointer data,
+		ExportJobDoneFunc done_func, gpointer done_data)
+{
+	ExportJob *job = g_new0(ExportJob, 1);
+
+	job->name = g_strdup(name);
+	job->func = func;
+	job->data = data;
+	job->done_func = done_func;
+	job->done_data = done_data;
+
+	if (export_job_pool == NULL)
+		export_job_pool = g_thread_pool_new(export_job_thread_func, NULL, export_job_get_max_jobs(), FALSE, NULL);
+	else
+		g_thread_pool_set_max_threads(export_job_pool, export_job_get_max_jobs(), NULL);
+
+	export_jobs = g_list_append(export_jobs, job);
+	if (export_job_status_id == 0)
+		export_job_status_id = g_timeout_add(250, export_job_update_status, NULL);
+
+	g_thread_pool_push(export_job_pool, job, NULL);
+	return job;
+}
+
 /* TODO: this should be ported to Glade like the project preferences dialog,
  * then we can get rid of the PropertyDialogElements struct altogether as
  * widgets pointers can be accessed through ui_lookup_widget(). */
@@ -471,11 +714,350 @@ void project_import(void)
 	}
 }
 
+typedef struct Html5ExportData
+{
+	gchar *project_base_path;
+	gchar *project_name;
+	gchar *output_file;
+	int commands_mode;
+	int dynamic_memory;
+} Html5ExportData;
+
+static ExportJob *html5_export_job = NULL;
+
+static gboolean html5_export_run(ExportJob *job, gpointer user_data)
+{
+	Html5ExportData *data = user_data;
+	gchar *output_file = data->output_file;
+	int commands_mode = data->commands_mode;
+	int dynamic_memory = data->dynamic_memory;
+	gboolean success = FALSE;
+
+	export_job_set_stage( job, _("Copying files") );
+
+	// CHECKS COMPLETE, START EXPORT
+
+	// make temporary folder
+	gchar* tmp_folder = export_job_get_folder( job, data->project_base_path, "build_tmp" );
+	utils_str_replace_char( tmp_folder, '\\', '/' );
+	
+	const gchar *szCommandsFolder = "";
+	if ( dynamic_memory ) szCommandsFolder = commands_mode ? "3Ddynamic" : "2Ddynamic";
+	else szCommandsFolder = commands_mode ? "3D" : "2D";
+
+	gchar* src_folder = g_build_path( "/", app->datadir, "html5", szCommandsFolder, NULL );
+	utils_str_replace_char( src_folder, '\\', '/' );
+
+	// decalrations
+	GString *newcontents = NULL;
+	GString *load_package_string = g_string_new( "" );
+	GString *additional_folders_string = g_string_new( "" );
+	gchar* agkplayer_file = NULL;
+	gchar* html5data_file = NULL;
+	gchar *contents = NULL;
+	gchar *contents2 = NULL;
+	gchar *contents3 = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+	FILE *pHTML5File = 0;
+	gchar *media_folder = 0;
+
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+	gchar *str_out = NULL;
+			
+	if ( !utils_copy_folder( src_folder, tmp_folder, TRUE, NULL ) )
+	{
+		SHOW_ERR( _("Failed to copy source folder") );
+		goto html5_dialog_cleanup2;
+	}
+
+	if ( export_job_is_cancelled(job) ) goto html5_dialog_cleanup2;
+	export_job_set_stage( job, _("Packing media files") );
+
+	// create HTML5 data file that we'll add all the media files to
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
+	pHTML5File = fopen( html5data_file, "wb" );
+	if ( !pHTML5File )
+	{
+		SHOW_ERR( _("Failed to open HTML5 data file for writing") );
+		goto html5_dialog_cleanup2;
+	}
+
+	// start the load package string that will store the list of files, it will be built at the same time as adding the media files
+	g_string_assign( load_package_string, "loadPackage({\"files\":[" );
+	g_string_assign( additional_folders_string, "Module[\"FS_createPath\"](\"/\", \"media\", true, true);" );
+	media_folder = g_build_path( "/", data->project_base_path, "media", NULL );
+	guint64 currpos = 0;
+
+	if ( g_file_test (media_folder, G_FILE_TEST_EXISTS) )
+	{
+		// add the media files and construct the load package string, currpos will have the total data size afterwards
+		if ( !utils_add_folder_to_html5_data_file( pHTML5File, media_folder, "/media", load_package_string, additional_folders_string, &currpos ) )
+		{
+			fclose( pHTML5File );
+			pHTML5File = 0;
+
+			SHOW_ERR( _("Failed to write HTML5 data file") );
+			goto html5_dialog_cleanup2;
+		}
+	}
+
+	fclose( pHTML5File );
+	pHTML5File = 0;
+
+	// remove the final comma that was added
+	if ( load_package_string->len > 0 && load_package_string->str[load_package_string->len-1] == ',' ) g_string_truncate( load_package_string, load_package_string->len - 1 );
+
+	// finsh the load package string 
+	g_string_append_printf( load_package_string, "],\"remote_package_size\":%" G_GUINT64_FORMAT, currpos );
+	g_string_append( load_package_string, ",\"package_uuid\":\"e3c8dd30-b68a-4332-8c93-d0cf8f9d28a0\"})" );
+
+	
+	// edit AGKplayer.js to add our load package string
+	agkplayer_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
+
+	if ( !g_file_get_contents( agkplayer_file, &contents, &length, &error ) )
+	{
+		SHOW_ERR1( _("Failed to read AGKPlayer.js file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto html5_dialog_cleanup2;
+	}
+
+	newcontents = g_string_sized_new( length + load_package_string->len + additional_folders_string->len );
+
+	contents2 = contents;
+	contents3 = 0;
+
+	// the order of these relacements is important (if more than one), they must occur in the same order as they occur in the file
+
+	// replace %%ADDITIONALFOLDERS%%
+	contents3 = strstr( contents2, "%%ADDITIONALFOLDERS%%" );
+	if ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("%%ADDITIONALFOLDERS%%");
+
+		g_string_append( newcontents, contents2 );
+		g_string_append_len( newcontents, additional_folders_string->str, additional_folders_string->len );
+					
+		contents2 = contents3;
+	}
+	else
+	{
+		SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%ADDITIONALFOLDERS%% variable") );
+		goto html5_dialog_cleanup2;
+	}
+
+	// replace %%LOADPACKAGE%%
+	contents3 = strstr( contents2, "%%LOADPACKAGE%%" );
+	if ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("%%LOADPACKAGE%%");
+
+		g_string_append( newcontents, contents2 );
+		g_string_append_len( newcontents, load_package_string->str, load_package_string->len );
+					
+		contents2 = contents3;
+	}
+	else
+	{
+		SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%LOADPACKAGE%% variable") );
+		goto html5_dialog_cleanup2;
+	}
+
+	// write the rest of the file
+	g_string_append( newcontents, contents2 );
+
+	// write new AGKPlayer.js file
+	if ( !g_file_set_contents( agkplayer_file, newcontents->str, newcontents->len, &error ) )
+	{
+		SHOW_ERR1( _("Failed to write AGKPlayer.js file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto html5_dialog_cleanup2;
+	}
+
+	if ( export_job_is_cancelled(job) ) goto html5_dialog_cleanup2;
+
+	// reuse variables
+	if ( html5data_file ) g_free(html5data_file);
+	if ( agkplayer_file ) g_free(agkplayer_file);
+
+	// create zip file
+	/*
+	if ( !mz_zip_writer_init_file( &zip_archive, output_file, 0 ) )
+	{
+		SHOW_ERR( "Failed to initialise zip file for writing" );
+		goto html5_dialog_cleanup2;
+	}
+
+	// copy files to zip
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.asm.js", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.js", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.data", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
+	mz_zip_writer_add_file( &zip_archive, "AGKPlayer.html.mem", html5data_file, NULL, 0, 9 );
+	g_free( html5data_file );
+
+	// create main html5 file with project name so it stands out as the file to run
+	agkplayer_file = g_new0( gchar, 1024 );
+	strcpy( agkplayer_file, data->project_name );
+	utils_str_replace_char( agkplayer_file, ' ', '_' );
+	strcat( agkplayer_file, ".html" );
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
+	mz_zip_writer_add_file( &zip_archive, agkplayer_file, html5data_file, NULL, 0, 9 );
+	*/
+
+	export_job_set_stage( job, _("Writing output files") );
+	utils_mkdir( output_file, TRUE );
+
+	// copy files to folder
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.asm.js", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.js", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	// the data file holds all the media so it can be very large, move it if possible, otherwise
+	// stream it across instead of reading it all into memory
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.data", NULL );
+	g_unlink( agkplayer_file );
+	if ( g_rename( html5data_file, agkplayer_file ) != 0 )
+	{
+		guint64 data_length = 0;
+		gboolean copied = FALSE;
+
+		pHTML5File = g_fopen( agkplayer_file, "wb" );
+		if ( pHTML5File )
+		{
+			copied = utils_append_file_to_stream( pHTML5File, html5data_file, &data_length );
+			if ( fclose( pHTML5File ) != 0 ) copied = FALSE;
+			pHTML5File = 0;
+		}
+
+		if ( !copied )
+		{
+			SHOW_ERR( _("Failed to write HTML5 data file") );
+			goto html5_dialog_cleanup2;
+		}
+	}
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.html.mem", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "background.jpg", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "background.jpg", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	html5data_file = g_build_path( "/", tmp_folder, "made-with-appgamekit.png", NULL );
+	agkplayer_file = g_build_path( "/", output_file, "made-with-appgamekit.png", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+	g_free( agkplayer_file );
+	g_free( html5data_file );
+
+	// create main html5 file with project name so it stands out as the file to run
+	html5data_file = g_new0( gchar, 1024 );
+	strcpy( html5data_file, data->project_name );
+	utils_str_replace_char( html5data_file, ' ', '_' );
+	strcat( html5data_file, ".html" );
+	agkplayer_file = g_build_path( "/", output_file, html5data_file, NULL );
+	g_free( html5data_file );
+	html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
+	utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
+
+	if ( export_job_is_cancelled(job) ) goto html5_dialog_cleanup2;
+
+	/*
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to finalize zip file") );
+		goto html5_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to end zip file") );
+		goto html5_dialog_cleanup2;
+	}
+	*/
+
+	if ( export_job_is_cancelled(job) ) goto html5_dialog_cleanup2;
+
+	success = TRUE;
+
+html5_dialog_cleanup2:
+
+	utils_remove_folder_recursive( tmp_folder );
+
+	if ( newcontents ) g_string_free(newcontents, TRUE);
+	if ( contents ) g_free(contents);
+	g_string_free(load_package_string, TRUE);
+	g_string_free(additional_folders_string, TRUE);
+	if ( agkplayer_file ) g_free(agkplayer_file);
+	if ( html5data_file ) g_free(html5data_file);
+	if ( media_folder ) g_free(media_folder);
+	if ( pHTML5File ) fclose(pHTML5File);
+
+	if ( error ) g_error_free(error);
+	
+	if ( tmp_folder ) g_free(tmp_folder);
+	if ( src_folder ) g_free(src_folder);
+	if ( output_file ) g_free(output_file);
+
+	if ( data->project_base_path ) g_free(data->project_base_path);
+	if ( data->project_name ) g_free(data->project_name);
+	g_free(data);
+
+	return success;
+}
+
+static void html5_export_done(ExportJob *job, gboolean success, gpointer user_data)
+{
+	html5_export_job = NULL;
+
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
+
+	if ( success ) gtk_widget_hide(ui_widgets.html5_dialog);
+}
+
 static void on_html5_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
 {
 	static int running = 0;
 	if ( running ) return;
 
+	// while exporting the cancel button stops the export, closing the dialog leaves it running
+	if ( html5_export_job )
+	{
+		if ( response == GTK_RESPONSE_CANCEL ) export_job_cancel( html5_export_job );
+		if ( response != 1 ) gtk_widget_hide(GTK_WIDGET(dialog));
+		return;
+	}
+
 	running = 1;
 
 	// save current values
@@ -503,10 +1085,6 @@ static void on_html5_dialog_response(GtkDialog *dialog, gint response, gpointer
 		GtkWidget *widget;
 
 		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
 
 		// app details
 		widget = ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo");
@@ -533,330 +1111,55 @@ html5_dialog_clean_up:
 		if ( output_file ) g_free(output_file);
 
 		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), TRUE );
 		running = 0;
 		return;
 
 html5_dialog_continue:
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// CHECKS COMPLETE, START EXPORT
-
-		// make temporary folder
-		gchar* tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
-		
-		const gchar *szCommandsFolder = "";
-		if ( dynamic_memory ) szCommandsFolder = commands_mode ? "3Ddynamic" : "2Ddynamic";
-		else szCommandsFolder = commands_mode ? "3D" : "2D";
-
-		gchar* src_folder = g_build_path( "/", app->datadir, "html5", szCommandsFolder, NULL );
-		utils_str_replace_char( src_folder, '\\', '/' );
-
-		// decalrations
-		gchar sztemp[30];
-		gchar *newcontents = 0;
-		gchar *load_package_string = g_new0( gchar, 200000 );
-		gchar *additional_folders_string = g_new0( gchar, 200000 );
-		gchar* agkplayer_file = NULL;
-		gchar* html5data_file = NULL;
-		gchar *contents = NULL;
-		gchar *contents2 = NULL;
-		gchar *contents3 = NULL;
-		gsize length = 0;
-		GError *error = NULL;
-		FILE *pHTML5File = 0;
-		gchar *media_folder = 0;
-
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-		gchar *str_out = NULL;
-				
-		if ( !utils_copy_folder( src_folder, tmp_folder, TRUE, NULL ) )
 		{
-			SHOW_ERR( _("Failed to copy source folder") );
-			goto html5_dialog_cleanup2;
-		}
+			Html5ExportData *data = g_new0( Html5ExportData, 1 );
+			data->project_base_path = g_strdup( app->project->base_path );
+			data->project_name = g_strdup( app->project->name );
+			data->output_file = output_file;
+			data->commands_mode = commands_mode;
+			data->dynamic_memory = dynamic_memory;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// create HTML5 data file that we'll add all the media files to
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		pHTML5File = fopen( html5data_file, "wb" );
-		if ( !pHTML5File )
-		{
-			SHOW_ERR( _("Failed to open HTML5 data file for writing") );
-			goto html5_dialog_cleanup2;
+			html5_export_job = export_job_start( app->project->name, html5_export_run, data, html5_export_done, NULL );
 		}
+	}
 
-		// start the load package string that will store the list of files, it will be built at the same time as adding the media files
-		strcpy( load_package_string, "loadPackage({\"files\":[" );
-		strcpy( additional_folders_string, "Module[\"FS_createPath\"](\"/\", \"media\", true, true);" );
-		media_folder = g_build_path( "/", app->project->base_path, "media", NULL );
-		int currpos = 0;
+	running = 0;
+}
 
-		if ( g_file_test (media_folder, G_FILE_TEST_EXISTS) )
-		{
-			// add the media files and construct the load package string, currpos will have the total data size afterwards
-			if ( !utils_add_folder_to_html5_data_file( pHTML5File, media_folder, "/media", load_package_string, additional_folders_string, &currpos ) )
-			{
-				fclose( pHTML5File );
-				pHTML5File = 0;
+void project_export_html5()
+{
+	static gchar *last_proj_path = 0;
 
-				SHOW_ERR( _("Failed to write HTML5 data file") );
-				goto html5_dialog_cleanup2;
-			}
-		}
+	if ( !app->project ) 
+	{
+		SHOW_ERR( _("You must have a project open to export it") );
+		return;
+	}
 
-		fclose( pHTML5File );
-		pHTML5File = 0;
+	// make sure the project is up to date
+	build_compile_project(0);
 
-		// remove the final comma that was added
-		if ( *load_package_string && load_package_string[strlen(load_package_string)-1] == ',' ) load_package_string[ strlen(load_package_string) - 1 ] = 0;
+	if (ui_widgets.html5_dialog == NULL)
+	{
+		ui_widgets.html5_dialog = create_html5_dialog();
+		gtk_widget_set_name(ui_widgets.html5_dialog, _("Export HTML5"));
+		gtk_window_set_transient_for(GTK_WINDOW(ui_widgets.html5_dialog), GTK_WINDOW(main_widgets.window));
 
-		// finsh the load package string 
-		strcat( load_package_string, "],\"remote_package_size\":" );
-		sprintf( sztemp, "%d", currpos );
-		strcat( load_package_string, sztemp );
-		strcat( load_package_string, ",\"package_uuid\":\"e3c8dd30-b68a-4332-8c93-d0cf8f9d28a0\"})" );
+		g_signal_connect(ui_widgets.html5_dialog, "response", G_CALLBACK(on_html5_dialog_response), NULL);
+        g_signal_connect(ui_widgets.html5_dialog, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
 
+		//ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_path"), NULL,
+		//	GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_entry")));
 		
-		// edit AGKplayer.js to add our load package string
-		agkplayer_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
-
-		if ( !g_file_get_contents( agkplayer_file, &contents, &length, &error ) )
-		{
-			SHOW_ERR1( _("Failed to read AGKPlayer.js file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto html5_dialog_cleanup2;
-		}
-
-		newcontents = g_new0( gchar, length + 400000 );
-
-		contents2 = contents;
-		contents3 = 0;
+		ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_path"), NULL,
+			GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry")));
 
-		// the order of these relacements is important (if more than one), they must occur in the same order as they occur in the file
-
-		// replace %%ADDITIONALFOLDERS%%
-		contents3 = strstr( contents2, "%%ADDITIONALFOLDERS%%" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("%%ADDITIONALFOLDERS%%");
-
-			strcat( newcontents, contents2 );
-			strcat( newcontents, additional_folders_string );
-						
-			contents2 = contents3;
-		}
-		else
-		{
-			SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%ADDITIONALFOLDERS%% variable") );
-			goto html5_dialog_cleanup2;
-		}
-
-		// replace %%LOADPACKAGE%%
-		contents3 = strstr( contents2, "%%LOADPACKAGE%%" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("%%LOADPACKAGE%%");
-
-			strcat( newcontents, contents2 );
-			strcat( newcontents, load_package_string );
-						
-			contents2 = contents3;
-		}
-		else
-		{
-			SHOW_ERR( _("AGKPlayer.js is corrupt, it is missing the %%LOADPACKAGE%% variable") );
-			goto html5_dialog_cleanup2;
-		}
-
-		// write the rest of the file
-		strcat( newcontents, contents2 );
-	
-		// write new AGKPlayer.js file
-		if ( !g_file_set_contents( agkplayer_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write AGKPlayer.js file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto html5_dialog_cleanup2;
-		}
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// reuse variables
-		if ( html5data_file ) g_free(html5data_file);
-		if ( agkplayer_file ) g_free(agkplayer_file);
-
-		// create zip file
-		/*
-		if ( !mz_zip_writer_init_file( &zip_archive, output_file, 0 ) )
-		{
-			SHOW_ERR( "Failed to initialise zip file for writing" );
-			goto html5_dialog_cleanup2;
-		}
-
-		// copy files to zip
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.asm.js", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.js", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.data", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
-		mz_zip_writer_add_file( &zip_archive, "AGKPlayer.html.mem", html5data_file, NULL, 0, 9 );
-		g_free( html5data_file );
-
-		// create main html5 file with project name so it stands out as the file to run
-		agkplayer_file = g_new0( gchar, 1024 );
-		strcpy( agkplayer_file, app->project->name );
-		utils_str_replace_char( agkplayer_file, ' ', '_' );
-		strcat( agkplayer_file, ".html" );
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
-		mz_zip_writer_add_file( &zip_archive, agkplayer_file, html5data_file, NULL, 0, 9 );
-		*/
-
-		utils_mkdir( output_file, TRUE );
-
-		// copy files to folder
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.asm.js", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.asm.js", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.js", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.js", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.data", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.data", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html.mem", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "AGKPlayer.html.mem", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "background.jpg", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "background.jpg", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		html5data_file = g_build_path( "/", tmp_folder, "made-with-appgamekit.png", NULL );
-		agkplayer_file = g_build_path( "/", output_file, "made-with-appgamekit.png", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-		g_free( agkplayer_file );
-		g_free( html5data_file );
-
-		// create main html5 file with project name so it stands out as the file to run
-		html5data_file = g_new0( gchar, 1024 );
-		strcpy( html5data_file, app->project->name );
-		utils_str_replace_char( html5data_file, ' ', '_' );
-		strcat( html5data_file, ".html" );
-		agkplayer_file = g_build_path( "/", output_file, html5data_file, NULL );
-		g_free( html5data_file );
-		html5data_file = g_build_path( "/", tmp_folder, "AGKPlayer.html", NULL );
-		utils_copy_file( html5data_file, agkplayer_file, TRUE, NULL );
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		/*
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
-		{
-			SHOW_ERR( _("Failed to finalize zip file") );
-			goto html5_dialog_cleanup2;
-		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
-		{
-			SHOW_ERR( _("Failed to end zip file") );
-			goto html5_dialog_cleanup2;
-		}
-		*/
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		gtk_widget_hide(GTK_WIDGET(dialog));
-
-html5_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "html5_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.html5_dialog, "button12"), TRUE );
-
-		utils_remove_folder_recursive( tmp_folder );
-
-		if ( newcontents ) g_free(newcontents);
-		if ( contents ) g_free(contents);
-		if ( load_package_string ) g_free(load_package_string);
-		if ( additional_folders_string ) g_free(additional_folders_string);
-		if ( agkplayer_file ) g_free(agkplayer_file);
-		if ( html5data_file ) g_free(html5data_file);
-		if ( media_folder ) g_free(media_folder);
-		if ( pHTML5File ) fclose(pHTML5File);
-
-		if ( error ) g_error_free(error);
-		
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( output_file ) g_free(output_file);
-	}
-
-	running = 0;
-}
-
-void project_export_html5()
-{
-	static gchar *last_proj_path = 0;
-
-	if ( !app->project ) 
-	{
-		SHOW_ERR( _("You must have a project open to export it") );
-		return;
-	}
-
-	// make sure the project is up to date
-	build_compile_project(0);
-
-	if (ui_widgets.html5_dialog == NULL)
-	{
-		ui_widgets.html5_dialog = create_html5_dialog();
-		gtk_widget_set_name(ui_widgets.html5_dialog, _("Export HTML5"));
-		gtk_window_set_transient_for(GTK_WINDOW(ui_widgets.html5_dialog), GTK_WINDOW(main_widgets.window));
-
-		g_signal_connect(ui_widgets.html5_dialog, "response", G_CALLBACK(on_html5_dialog_response), NULL);
-        g_signal_connect(ui_widgets.html5_dialog, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
-
-		//ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_path"), NULL,
-		//	GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_app_icon_entry")));
-		
-		ui_setup_open_button_callback_html5(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_ENTRY(ui_lookup_widget(ui_widgets.html5_dialog, "html5_output_file_entry")));
-
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo")), 0 );
-	}
+		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.html5_dialog, "html5_commands_combo")), 0 );
+	}
 
 	if ( strcmp( FALLBACK(last_proj_path,""), FALLBACK(app->project->file_name,"") ) != 0 )
 	{
@@ -889,1031 +1192,751 @@ void project_export_html5()
 	gtk_window_present(GTK_WINDOW(ui_widgets.html5_dialog));
 }
 
-static void on_android_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+typedef struct AndroidExportData
 {
-	static int running = 0;
-	if ( running ) return;
+	gchar *project_base_path;
+
+	gchar *app_name;
+	gchar *package_name;
+	gchar *app_icon;
+	gchar *app_icon_new;
+	gchar *notif_icon;
+	gchar *ouya_icon;
+	gchar *firebase_config;
+	gchar *url_scheme;
+	gchar *deep_link;
+	gchar *google_play_app_id;
+	gchar *admob_app_id;
+	gchar *snapchat_client_id;
+	gchar *keystore_file;
+	gchar *keystore_password;
+	gchar *version_number;
+	gchar *alias_name;
+	gchar *alias_password;
+	gchar *output_file;
+	gchar szSDK[ 20 ];
+	gchar szBuildNum[ 20 ];
+
+	int orientation;
+	int arcore_mode;
+	int permission_external_storage;
+	int permission_location_fine;
+	int permission_location_coarse;
+	int permission_internet;
+	int permission_wake;
+	int permission_billing;
+	int permission_push;
+	int permission_camera;
+	int permission_notifications;
+	int permission_vibrate;
+	int permission_record_audio;
+	int isGoogle;
+	int isAmazon;
+	int isOuya;
+	int isBundle;
+	int includeFirebase;
+	int includePushNotify;
+	int includeGooglePlay;
+	int includeAdMob;
+
+	// entries shared with other variants of the same project, may be NULL
+	UtilsZipShared *zip_shared;
+
+	// compression levels from the project's export settings
+	UtilsZipPolicy *zip_policy;
+} AndroidExportData;
+
+static ExportJob *android_export_job = NULL;
+
+static void android_icon_set_add( UtilsIconSet *icon_set, const gchar *tmp_folder, const gchar *res_folder, const gchar *name, gint width, gint height )
+{
+	gchar *image_filename = g_build_path( "/", tmp_folder, "resOrig", res_folder, name, NULL );
+	utils_icon_set_add( icon_set, image_filename, width, height, FALSE );
+	g_free( image_filename );
+}
 
-	running = 1;
-    
-#ifdef __APPLE__
-    gchar* android_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2-bundle", NULL );
-    if ( !g_file_test(android_path, G_FILE_TEST_EXISTS) )
-    {
-        g_free( android_path);
-        if ( m_connection ) SHOW_ERR( "Android export files have not finished downloading, please wait and try again" );
-        else SHOW_ERR( "Android export files not found. Please close the export dialog and reopen it to try downloading again" );
-        return;
-    }
-    g_free( android_path);
-#endif
+/* Compiled resources are cached in build_cache/aapt2, named after the SHA1 of the resource
+ * contents, its name and the aapt2 build, so resources that are the same as in an earlier export
+ * (usually all of them) are copied into resMerged instead of being compiled again. */
+typedef struct AndroidResCompiler
+{
+	int fd;				// stdin of the aapt2 daemon
+	gchar *tmp_folder;
+	gchar *cache_folder;	// NULL if aapt2 can't be identified
+	gchar *tool_key;
+	GPtrArray *pending;	// resMerged path and cache path pairs to store once aapt2 has finished
+} AndroidResCompiler;
+
+static void android_res_compiler_init( AndroidResCompiler *compiler, int fd, const gchar *tmp_folder, const gchar *project_base_path, const gchar *path_to_aapt2 )
+{
+	struct stat st;
 
-	// save default settings
-	if ( app->project && user_data == 0 )
+	memset( compiler, 0, sizeof(AndroidResCompiler) );
+	compiler->fd = fd;
+	compiler->tmp_folder = g_strdup( tmp_folder );
+	compiler->pending = g_ptr_array_new();
+
+	// the size and time of the executable change with every aapt2 update, which is cheaper than asking it for its version
+	if ( g_stat( path_to_aapt2, &st ) == 0 )
 	{
-		GtkWidget *widget;
+		compiler->tool_key = g_strdup_printf( "aapt2 %" G_GINT64_FORMAT " %" G_GINT64_FORMAT, (gint64) st.st_size, (gint64) st.st_mtime );
+		compiler->cache_folder = g_build_path( "/", project_base_path, "build_cache", "aapt2", NULL );
+		g_mkdir_with_parents( compiler->cache_folder, 0755 );
+	}
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.package_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+static void android_res_compiler_clear( AndroidResCompiler *compiler )
+{
+	if ( compiler->pending )
+	{
+		g_ptr_array_foreach( compiler->pending, (GFunc) g_free, NULL );
+		g_ptr_array_free( compiler->pending, TRUE );
+	}
+	g_free( compiler->tmp_folder );
+	g_free( compiler->cache_folder );
+	g_free( compiler->tool_key );
+	memset( compiler, 0, sizeof(AndroidResCompiler) );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// name aapt2 gives the compiled file, values files are compiled to a resource table
+static gchar* android_res_get_flat_name( const gchar *res_folder, const gchar *name )
+{
+	if ( strncmp( res_folder, "values", 6 ) == 0 )
+	{
+		gchar *base = g_strdup( name );
+		gchar *ext = strrchr( base, '.' );
+		gchar *flat_name;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.app_icon_new_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( ext ) *ext = 0;
+		flat_name = g_strdup_printf( "%s_%s.arsc.flat", res_folder, base );
+		g_free( base );
+		return flat_name;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.notif_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	return g_strdup_printf( "%s_%s.flat", res_folder, name );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.ouya_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// takes resOrig/res_folder/name from the cache or sends a compile command for it to the aapt2 daemon
+static void android_aapt2_compile_res( AndroidResCompiler *compiler, const gchar *res_folder, const gchar *name )
+{
+	gchar *aaptcommand;
+	gchar *contents = NULL;
+	gsize length = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( compiler->cache_folder )
+	{
+		gchar *src_path = g_build_path( "/", compiler->tmp_folder, "resOrig", res_folder, name, NULL );
+
+		if ( g_file_get_contents( src_path, &contents, &length, NULL ) )
+		{
+			GChecksum *checksum = g_checksum_new( G_CHECKSUM_SHA1 );
+			gchar *flat_name = android_res_get_flat_name( res_folder, name );
+			gchar *flat_path = g_build_path( "/", compiler->tmp_folder, "resMerged", flat_name, NULL );
+			gchar *cache_name, *cache_path;
+
+			g_checksum_update( checksum, (const guchar*) compiler->tool_key, -1 );
+			g_checksum_update( checksum, (const guchar*) "\n", 1 );
+			g_checksum_update( checksum, (const guchar*) flat_name, -1 );
+			g_checksum_update( checksum, (const guchar*) "\n", 1 );
+			g_checksum_update( checksum, (const guchar*) contents, length );
+			cache_name = g_strconcat( g_checksum_get_string( checksum ), ".flat", NULL );
+			cache_path = g_build_path( "/", compiler->cache_folder, cache_name, NULL );
+			g_checksum_free( checksum );
+			g_free( cache_name );
+			g_free( flat_name );
+			g_free( contents );
+
+			if ( g_file_test( cache_path, G_FILE_TEST_IS_REGULAR ) && utils_copy_file( cache_path, flat_path, TRUE, NULL ) )
+			{
+				g_free( cache_path );
+				g_free( flat_path );
+				g_free( src_path );
+				return;
+			}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		app->project->apk_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		app->project->apk_settings.arcore = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		app->project->apk_settings.sdk_version = 1; // 4.1
-		if ( strncmp(app_sdk,"4.2",3) == 0 ) app->project->apk_settings.sdk_version = 2;
-		if ( strncmp(app_sdk,"4.3",3) == 0 ) app->project->apk_settings.sdk_version = 3;
-		if ( strncmp(app_sdk,"4.4",3) == 0 ) app->project->apk_settings.sdk_version = 4;
-		if ( strncmp(app_sdk,"5.0",3) == 0 ) app->project->apk_settings.sdk_version = 5;
-		if ( strncmp(app_sdk,"5.1",3) == 0 ) app->project->apk_settings.sdk_version = 6;
-		if ( strncmp(app_sdk,"6.0",3) == 0 ) app->project->apk_settings.sdk_version = 7;
-		if ( strncmp(app_sdk,"7.0",3) == 0 ) app->project->apk_settings.sdk_version = 8;
-		if ( strncmp(app_sdk,"7.1",3) == 0 ) app->project->apk_settings.sdk_version = 9;
-		if ( strncmp(app_sdk,"8.0",3) == 0 ) app->project->apk_settings.sdk_version = 10;
-		if ( strncmp(app_sdk,"8.1",3) == 0 ) app->project->apk_settings.sdk_version = 11;
-		if ( strncmp(app_sdk,"9.0",3) == 0 ) app->project->apk_settings.sdk_version = 12;
-		if ( strncmp(app_sdk,"10.0",3) == 0 ) app->project->apk_settings.sdk_version = 13;
-		g_free(app_sdk);
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		AGK_CLEAR_STR(app->project->apk_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+			g_ptr_array_add( compiler->pending, flat_path );
+			g_ptr_array_add( compiler->pending, cache_path );
+		}
+		g_free( src_path );
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		AGK_CLEAR_STR(app->project->apk_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+#ifdef G_OS_WIN32
+	aaptcommand = g_strdup_printf( "compile\n-o\nresMerged\nresOrig\\%s\\%s\n\n", res_folder, name );
+#else
+	aaptcommand = g_strdup_printf( "compile\n-o\nresMerged\nresOrig/%s/%s\n\n", res_folder, name );
+#endif
+	write( compiler->fd, aaptcommand, strlen(aaptcommand) );
+	g_free( aaptcommand );
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		AGK_CLEAR_STR(app->project->apk_settings.play_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+// copies the files compiled by the aapt2 daemon into the cache, call once it has finished
+static void android_res_compiler_store( AndroidResCompiler *compiler )
+{
+	guint i;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		AGK_CLEAR_STR(app->project->apk_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	for ( i = 0; i + 1 < compiler->pending->len; i += 2 )
+	{
+		const gchar *flat_path = g_ptr_array_index( compiler->pending, i );
+		const gchar *cache_path = g_ptr_array_index( compiler->pending, i + 1 );
+		gchar *temp_path;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		AGK_CLEAR_STR(app->project->apk_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( !g_file_test( flat_path, G_FILE_TEST_IS_REGULAR ) )
+			continue;
 
-		// permissions
-		app->project->apk_settings.permission_flags = 0;
+		// another export may be storing the same file
+		temp_path = g_strdup_printf( "%s.%p.tmp", cache_path, (gpointer) compiler );
+		if ( utils_copy_file( flat_path, temp_path, TRUE, NULL ) )
+		{
+			g_unlink( cache_path );
+			if ( g_rename( temp_path, cache_path ) != 0 )
+				g_unlink( temp_path );
+		}
+		g_free( temp_path );
+	}
+}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WRITE;
+static gboolean android_export_run(ExportJob *job, gpointer user_data)
+{
+	AndroidExportData *data = user_data;
+	gboolean success = FALSE;
+	gchar *szSDK = data->szSDK;
+	gchar *szBuildNum = data->szBuildNum;
+	char *ext;
+
+	// the strings belong to this function now and are freed below
+	gchar *app_name = data->app_name;
+	gchar *package_name = data->package_name;
+	gchar *app_icon = data->app_icon;
+	gchar *app_icon_new = data->app_icon_new;
+	gchar *notif_icon = data->notif_icon;
+	gchar *ouya_icon = data->ouya_icon;
+	gchar *firebase_config = data->firebase_config;
+	gchar *url_scheme = data->url_scheme;
+	gchar *deep_link = data->deep_link;
+	gchar *google_play_app_id = data->google_play_app_id;
+	gchar *admob_app_id = data->admob_app_id;
+	gchar *snapchat_client_id = data->snapchat_client_id;
+	gchar *keystore_file = data->keystore_file;
+	gchar *keystore_password = data->keystore_password;
+	gchar *version_number = data->version_number;
+	gchar *alias_name = data->alias_name;
+	gchar *alias_password = data->alias_password;
+	gchar *output_file = data->output_file;
+
+	int orientation = data->orientation;
+	int arcore_mode = data->arcore_mode;
+	int permission_external_storage = data->permission_external_storage;
+	int permission_location_fine = data->permission_location_fine;
+	int permission_location_coarse = data->permission_location_coarse;
+	int permission_internet = data->permission_internet;
+	int permission_wake = data->permission_wake;
+	int permission_billing = data->permission_billing;
+	int permission_push = data->permission_push;
+	int permission_camera = data->permission_camera;
+	int permission_notifications = data->permission_notifications;
+	int permission_vibrate = data->permission_vibrate;
+	int permission_record_audio = data->permission_record_audio;
+	int isGoogle = data->isGoogle;
+	int isAmazon = data->isAmazon;
+	int isOuya = data->isOuya;
+	int isBundle = data->isBundle;
+	int includeFirebase = data->includeFirebase;
+	int includePushNotify = data->includePushNotify;
+	int includeGooglePlay = data->includeGooglePlay;
+	int includeAdMob = data->includeAdMob;
+
+	export_job_set_stage( job, _("Preparing files") );
+
+	// CHECKS COMPLETE, START EXPORT
+
+	const char* androidJar = "android31.jar";
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_GPS;
+#if defined(G_OS_WIN32)
+	gchar* path_to_aapt2 = g_build_path( "\\", app->datadir, "android", "aapt2-bundle.exe", NULL );
+	gchar* path_to_android_jar = g_build_path( "\\", app->datadir, "android", androidJar, NULL );
+	gchar* path_to_bundletool = g_build_path( "\\", app->datadir, "android", "bundletool.jar", NULL );
+	gchar* path_to_apksigner = g_build_path( "\\", app->datadir, "android", "apksigner.jar", NULL );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_LOCATION;
+	// convert forward slashes to backward slashes for parameters that will be passed to aapt2
+	gchar *pathPtr = path_to_android_jar;
+	while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_INTERNET;
+	pathPtr = output_file;
+	while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
+    
+    gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
+    gchar* src_folder;
+    if ( isOuya ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
+    else if ( isAmazon ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
+    else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
+#elif defined(__APPLE__)
+    gchar* path_to_aapt2 = g_build_path( "/", app->configdir, "AndroidExport", "aapt2-bundle", NULL );
+    gchar* path_to_android_jar = g_build_path( "/", app->configdir, "AndroidExport", androidJar, NULL );
+    gchar* path_to_bundletool = g_build_path( "/", app->configdir, "AndroidExport", "bundletool.jar", NULL );
+	gchar* path_to_apksigner = g_build_path( "/", app->configdir, "AndroidExport", "apksigner.jar", NULL );
+    
+    gchar* android_folder = g_build_filename( app->configdir, "AndroidExport", NULL );
+    gchar* src_folder;
+    if ( isOuya ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceOuya", NULL );
+    else if ( isAmazon ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceAmazon", NULL );
+    else src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceGoogle", NULL );
+#else
+	//SHOW_ERR1 ( _ ( "Path: %s" ), app->datadir );
+	gchar* path_to_aapt2 = g_build_path( "/", app->datadir, "android", "aapt2-bundle", NULL );
+	gchar* path_to_android_jar = g_build_path( "/", app->datadir, "android", androidJar, NULL );
+    gchar* path_to_bundletool = g_build_path( "/", app->datadir, "android", "bundletool.jar", NULL );
+	gchar* path_to_apksigner = g_build_path( "/", app->datadir, "android", "apksigner.jar", NULL );
+    
+    gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
+    gchar* src_folder;
+    if ( isOuya ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
+    else if ( isAmazon ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
+    else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
+#endif
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WAKE;
+	// staging folder, kept between exports and synced with the source folder below
+	gchar* tmp_folder = export_job_get_folder( job, data->project_base_path, isOuya ? "build_stage_ouya" : (isAmazon ? "build_stage_amazon" : "build_stage_google") );
+	
+	utils_str_replace_char( android_folder, '\\', '/' );
+	utils_str_replace_char( tmp_folder, '\\', '/' );
+	utils_str_replace_char( src_folder, '\\', '/' );
+	
+	gchar *output_file_zip = g_strdup( output_file );
+	ext = strrchr( output_file_zip, '.' );
+	if ( ext && strlen(ext) < 6 ) *ext = 0;
+	SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_IAP;
+	if ( g_file_test( output_file_zip, G_FILE_TEST_EXISTS ) )
+	{
+		g_unlink( output_file_zip );
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_PUSH;
+	if ( !keystore_file || !*keystore_file )
+	{
+		if ( keystore_file ) g_free(keystore_file);
+		if ( keystore_password ) g_free(keystore_password);
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_CAMERA;
+		keystore_file = g_build_path( "/", android_folder, "debug.keystore", NULL );
+		keystore_password = g_strdup("android");
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_notifications");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_NOTIFY;
+		if ( alias_name ) g_free(alias_name);
+		if ( alias_password ) g_free(alias_password);
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_VIBRATE;
+		alias_name = g_strdup("androiddebugkey");
+		alias_password = g_strdup("android");
+	}
+	else
+	{
+		if ( !alias_name || !*alias_name )
+		{
+			if ( alias_name ) g_free(alias_name);
+			if ( alias_password ) g_free(alias_password);
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_RECORD_AUDIO;
+			alias_name = g_strdup("mykeystore");
+			alias_password = g_strdup(keystore_password);
+		}
+	}
 
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.keystore_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.version_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
-		app->project->apk_settings.version_number = build_number;
+#define AGK_NEW_CONTENTS_SIZE 1000000
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.alias) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// declarations
+	gchar *newcontents = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
+	gchar *newcontents2 = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
+	gchar* manifest_file = NULL;
+	gchar *contents = NULL;
+	gchar *contents2 = NULL;
+	gchar *contents3 = NULL;
+	gchar *contentsOther = NULL;
+	gchar *contentsOther2 = NULL;
+	gchar *contentsOther3 = NULL;
+	gsize length = 0;
+	gchar* resources_file = NULL;
+	GError *error = NULL;
+	UtilsIconSet *icon_set = NULL;
+	gchar *linked_file = NULL;
+	gchar *icon_cache_folder = NULL;
+	gchar *image_filename = NULL;
+	gchar **argv = NULL;
+	gint status = 0;
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+	UtilsZipPacker *zip_packer = NULL;
+	gchar *zip_add_file = 0;
+	gchar *str_out = NULL;
+	gsize resLength = 0;
+	gint package_count = 0;
+	gint package_index = 0;
+	gchar *aaptcommand = NULL;
+	GPid aapt2_pid = 0;
+	gboolean aapt2_ok = FALSE;
+	AndroidResCompiler res_compiler;
+	memset( &res_compiler, 0, sizeof(res_compiler) );
+
+	gchar* path_to_java = 0;
+	gchar* path_to_jarsigner = 0;
+
+	// check for java
+	argv = g_new0( gchar*, 3 );
+	argv[0] = g_strdup( "/usr/bin/which" );
+	argv[1] = g_strdup( "java" );
+	argv[2] = NULL;
 
-		// output
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
-		AGK_CLEAR_STR(app->project->apk_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	#ifdef G_OS_WIN32
+		g_free(argv [ 0 ]);
+		argv [ 0 ] = g_strdup ( "where" );
+	#endif
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		app->project->apk_settings.app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+	if ( !utils_spawn_sync( data->project_base_path, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to check for Java: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
 	}
 
-	if ( response != 1 )
+#ifdef G_OS_WIN32
+	if ( !str_out || str_out[0] == 0 || str_out[1] != ':' ) 
+#else
+	if ( !str_out || str_out[0] != '/' ) 
+#endif
 	{
-		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+		const char* java_home = getenv( "JAVA_HOME" );
+		if ( !java_home )
+		{
+			SHOW_ERR( _("Could not find Java, make sure you have the Java Development Kit (JDK) 8 or above installed. If it is installed then make sure that the JAVA_HOME environment variable is defined or that the Java bin folder is in your PATH environment variable") );
+			goto android_dialog_cleanup2;
+		}
+		else
+		{
+			const char* separator = "/";
+			const char* binary = "java";
+#ifdef G_OS_WIN32
+			separator = "\\";
+			binary = "java.exe";
+#endif
+			path_to_java = g_build_path( separator, java_home, "bin", binary, NULL );
+
+			if ( !g_file_test( path_to_java, G_FILE_TEST_EXISTS ) )
+			{
+				SHOW_ERR1( _("Could not find java program, expected to find it in \"%s\", make sure your JAVA_HOME environment variable is correct"), path_to_java );
+				goto android_dialog_cleanup2;
+			}
+		}
 	}
 	else
 	{
-		int i;
-		GtkWidget *widget;
-
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// app details
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		gchar *package_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_entry");
-		gchar *app_icon_new = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		gchar *notif_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		gchar *ouya_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		int app_orientation_int = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		int orientation = 10;
-		if ( app_orientation_int == 0 ) orientation = 6;
-		else if ( app_orientation_int == 1 ) orientation = 7;
-		gchar szOrientation[ 20 ];
-		sprintf( szOrientation, "%d", orientation );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		int arcore_mode = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		int sdk = 16;
-		if ( strncmp(app_sdk,"4.2",3) == 0 ) sdk = 17;
-		if ( strncmp(app_sdk,"4.3",3) == 0 ) sdk = 18;
-		if ( strncmp(app_sdk,"4.4",3) == 0 ) sdk = 19;
-		if ( strncmp(app_sdk,"5.0",3) == 0 ) sdk = 21;
-		if ( strncmp(app_sdk,"5.1",3) == 0 ) sdk = 22;
-		if ( strncmp(app_sdk,"6.0",3) == 0 ) sdk = 23;
-		if ( strncmp(app_sdk,"7.0",3) == 0 ) sdk = 24;
-		if ( strncmp(app_sdk,"7.1",3) == 0 ) sdk = 25;
-		if ( strncmp(app_sdk,"8.0",3) == 0 ) sdk = 26;
-		if ( strncmp(app_sdk,"8.1",3) == 0 ) sdk = 27;
-		if ( strncmp(app_sdk,"9.0",3) == 0 ) sdk = 28;
-		if ( strncmp(app_sdk,"10.0",3) == 0 ) sdk = 29;
-		g_free(app_sdk);
-		gchar szSDK[ 20 ];
-		sprintf( szSDK, "%d", sdk );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		gchar *google_play_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		// permissions
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		int permission_external_storage = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+#ifdef G_OS_WIN32
+		path_to_java = g_strdup( "java" );
+#else
+		path_to_java = g_strdup( str_out );
+		if ( path_to_java[ strlen(path_to_java)-1 ] == '\n' )
+		{
+			path_to_java[ strlen(path_to_java)-1 ] = 0;
+		}
+#endif
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		int permission_location_fine = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		int permission_location_coarse = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	argv[1] = g_strdup( "jarsigner" );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		int permission_internet = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	if ( !utils_spawn_sync( data->project_base_path, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to check for Jarsigner: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		int permission_wake = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+#ifdef G_OS_WIN32
+	if ( !str_out || str_out[0] == 0 || str_out[1] != ':' ) 
+#else
+	if ( !str_out || str_out[0] != '/' ) 
+#endif
+	{
+		const char* java_home = getenv( "JAVA_HOME" );
+		if ( !java_home )
+		{
+			SHOW_ERR( _("Could not find jarsigner, make sure you have the Java Development Kit (JDK) 8 or above installed. If it is installed then make sure that the JAVA_HOME environment variable is defined or that the Java bin folder is in your PATH environment variable") );
+			goto android_dialog_cleanup2;
+		}
+		else
+		{
+			const char* separator = "/";
+			const char* binary = "jarsigner";
+#ifdef G_OS_WIN32
+			separator = "\\";
+			binary = "jarsigner.exe";
+#endif
+			path_to_jarsigner = g_build_path( separator, java_home, "bin", binary, NULL );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		int permission_billing = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+			if ( !g_file_test( path_to_jarsigner, G_FILE_TEST_EXISTS ) )
+			{
+				SHOW_ERR1( _("Could not find jarsigner program, expected to find it in \"%s\", make sure your JAVA_HOME environment variable is correct"), path_to_jarsigner );
+				goto android_dialog_cleanup2;
+			}
+		}
+	}
+	else
+	{
+#ifdef G_OS_WIN32
+		path_to_jarsigner = g_strdup( "jarsigner" );
+#else
+		path_to_jarsigner = g_strdup( str_out );
+		if ( path_to_jarsigner[ strlen(path_to_jarsigner)-1 ] == '\n' )
+		{
+			path_to_jarsigner[ strlen(path_to_jarsigner)-1 ] = 0;
+		}
+#endif
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		int permission_push = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		int permission_camera = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	g_strfreev(argv);
+	argv = 0;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_notifications");
-		int permission_notifications = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		int permission_vibrate = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	// bring the staging folder up to date with the android export files, files left unchanged
+	// since the last export keep their timestamps so later stages can tell they haven't changed
+	if ( !utils_sync_folder( src_folder, tmp_folder, NULL ) )
+	{
+		SHOW_ERR1( _("Failed to copy source folder %s"), src_folder );
+		goto android_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		int permission_record_audio = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
+	
+	// edit AndroidManifest.xml
+	manifest_file = g_build_path( "/", tmp_folder, "AndroidManifest.xml", NULL );
 
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		gchar *keystore_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
-		gchar *keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	if ( !g_file_get_contents( manifest_file, &contents, &length, NULL ) )
+	{
+		SHOW_ERR( _("Failed to read AndroidManifest.xml file") );
+		goto android_dialog_cleanup2;
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
+	strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\
+<manifest xmlns:android=\"http://schemas.android.com/apk/res/android\"\n\
+      android:versionCode=\"" );
+	strcat( newcontents, szBuildNum );
+	strcat( newcontents, "\"\n      android:versionName=\"" );
+	strcat( newcontents, version_number );
+	strcat( newcontents, "\" package=\"" );
+	strcat( newcontents, package_name );
+	strcat( newcontents, "\"" );
+	strcat( newcontents, " android:installLocation=\"auto\">\n\
+    <uses-feature android:glEsVersion=\"0x00020000\"></uses-feature>\n\
+    <uses-sdk android:minSdkVersion=\"" );
+	
+	strcat( newcontents, szSDK );
+	
+	// mike - 021221 - ensure we target SDK version 30
+	strcat( newcontents, "\" android:targetSdkVersion=\"" );
+	if ( isOuya ) strcat( newcontents, "16" );
+	else strcat( newcontents, "31" );
+	strcat( newcontents, "\" />\n\n" );
+
+	if ( permission_external_storage ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WRITE_EXTERNAL_STORAGE\" />\n" );
+	if ( permission_internet ) 
+	{
+		strcat( newcontents, "    <uses-permission android:name=\"android.permission.INTERNET\" />\n" );
+		strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_NETWORK_STATE\" />\n" );
+		strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_WIFI_STATE\" />\n" );
+	}
+	if ( permission_wake ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WAKE_LOCK\" />\n" );
+	if ( isGoogle )
+	{
+		if ( permission_location_coarse || permission_location_fine ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_COARSE_LOCATION\" />\n" );
+		if ( permission_location_fine ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_FINE_LOCATION\" />\n" );
+		if ( permission_billing ) strcat( newcontents, "    <uses-permission android:name=\"com.android.vending.BILLING\" />\n" );
+		if ( permission_push ) 
+		{
+			strcat( newcontents, "    <permission android:name=\"" );
+			strcat( newcontents, package_name );
+			strcat( newcontents, ".permission.C2D_MESSAGE\" android:protectionLevel=\"signature\" />\n" );
+			strcat( newcontents, "    <uses-permission android:name=\"" );
+			strcat( newcontents, package_name );
+			strcat( newcontents, ".permission.C2D_MESSAGE\" />\n" );
+		}
+		if ( (google_play_app_id && *google_play_app_id) || permission_push ) strcat( newcontents, "    <uses-permission android:name=\"com.google.android.c2dm.permission.RECEIVE\" />\n" );
+	}
+	if ( permission_camera ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.CAMERA\" />\n" );
+	if ( permission_push || permission_notifications ) strcat(newcontents, "    <uses-permission android:name=\"android.permission.POST_NOTIFICATIONS\" />\n" );
+	if ( permission_vibrate ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.VIBRATE\" />\n" );
+	if ( permission_record_audio ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.RECORD_AUDIO\" />\n" );
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( build_number == 0 ) build_number = 1;
-		gchar szBuildNum[ 20 ];
-		sprintf( szBuildNum, "%d", build_number );
+	// if ARCore required
+	if ( arcore_mode == 2 )
+	{
+		strcat( newcontents, "    <uses-feature android:name=\"android.hardware.camera.ar\" android:required=\"true\" />" );
+	}
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		gchar *alias_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	/*<uses-permission android:name="com.google.android.gms.permission.AD_ID" /> Required on Android 13*/
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
-		gchar *alias_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	contents2 = contents;
+	contents3 = 0;
 
-		// output
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
-		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	// the order of these relacements is important, they must occur in the same order as they occur in the file
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gchar *output_type = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
-		int app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+	// package queries
+	contents3 = strstr(contents2, "<!--ADDITIONAL_QUERIES-->");
+	if (contents3)
+	{
+		*contents3 = 0;
+		contents3 += strlen("<!--ADDITIONAL_QUERIES-->");
 
-		int isGoogle = (app_type == 0 || app_type == 1) ? 1 : 0;
-		int isAmazon = (app_type == 2) ? 1 : 0;
-		int isOuya = (app_type == 3) ? 1 : 0;
-		int isBundle = (app_type == 0) ? 1 : 0;
+		strcat(newcontents, contents2);
 				
-		gchar *percent = 0;
-		while ( (percent = strchr(output_file, '%')) != 0 )
+		if ( snapchat_client_id && *snapchat_client_id )
 		{
-			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[version]") + 1;
-				gchar *new_output = g_strconcat( output_file, szBuildNum, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
-
-			if ( strncmp( percent+1, "[type]", strlen("[type]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[type]") + 1;
-				gchar *new_output = g_strconcat( output_file, output_type, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
-
-			break;
+			strcat(newcontents, "<package android:name=\"com.snapchat.android\" />\n" );
 		}
 
-		g_free(output_type);
-
-		// START CHECKS
-
-		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your APK")); goto android_dialog_clean_up; }
-		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto android_dialog_clean_up; }
-
-		const char* desiredExt = ".apk";
-		if ( isBundle ) desiredExt = ".aab";
+		if ( arcore_mode > 0 )
+		{
+			strcat(newcontents, "<package android:name=\"com.google.ar.core\" />\n" );
+		}
 
-		char* ext = strrchr( output_file, '.' );
-		if ( ext && strlen(ext) < 6 ) strcpy( ext, desiredExt );
-		else strcat( output_file, desiredExt );
+		contents2 = contents3;
+	}
 
-		if ( g_file_test( output_file, G_FILE_TEST_EXISTS ) )
-		{
-			if ( !dialogs_show_question("Output file already exists, do you want to overwrite it?") )
-			{
-				goto android_dialog_clean_up;
-			}
+	// replace orientation
+	contents3 = strstr( contents2, "screenOrientation=\"fullSensor\"" );
+	if ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("screenOrientation=\"fullSensor");
 
-			g_unlink( output_file );
-		}
+		strcat( newcontents, contents2 );
 
-		// check app name
-		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto android_dialog_clean_up; }
-		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto android_dialog_clean_up; }
-		for( i = 0; i < strlen(app_name); i++ )
+		switch( orientation )
 		{
-			/*
-			if ( (app_name[i] < 97 || app_name[i] > 122)
-			  && (app_name[i] < 65 || app_name[i] > 90) 
-			  && (app_name[i] < 48 || app_name[i] > 57) 
-			  && app_name[i] != 32 
-			  && app_name[i] != 45
-			  && app_name[i] != 95 ) 
-			{ 
-				SHOW_ERR(_("App name contains invalid characters, must be A-Z, 0-9, dash, spaces, and undersore only")); 
-				goto android_dialog_clean_up; 
-			}
-			*/
-			//switch to black list
-			if ( app_name[i] == 34 || app_name[i] == 60 || app_name[i] == 62 || app_name[i] == 39 )
+			case 6: strcat( newcontents, "screenOrientation=\"sensorLandscape" ); break;
+			case 7: 
 			{
-				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or < > characters.")); 
-				goto android_dialog_clean_up; 
+				// all now use API 23 with correct spelling
+				strcat( newcontents, "screenOrientation=\"sensorPortrait" ); 
+				break;
 			}
+			default: strcat( newcontents, "screenOrientation=\"fullSensor" ); break;
 		}
-		
-		// check package name
-		if ( !package_name || !*package_name ) { SHOW_ERR(_("You must enter a package name")); goto android_dialog_clean_up; }
-		if ( strlen(package_name) > 100 ) { SHOW_ERR(_("Package name must be less than 100 characters")); goto android_dialog_clean_up; }
-		if ( strchr(package_name,'.') == NULL ) { SHOW_ERR(_("Package name must contain at least one dot character")); goto android_dialog_clean_up; }
-		if ( (package_name[0] < 65 || package_name[0] > 90) && (package_name[0] < 97 || package_name[0] > 122) ) { SHOW_ERR(_("Package name must begin with a letter")); goto android_dialog_clean_up; }
-		if ( package_name[strlen(package_name)-1] == '.' ) { SHOW_ERR(_("Package name must not end with a dot")); goto android_dialog_clean_up; }
 
-		gchar last = 0;
-		for( i = 0; i < strlen(package_name); i++ )
-		{
-			if ( last == '.' && (package_name[i] < 65 || package_name[i] > 90) && (package_name[i] < 97 || package_name[i] > 122) )
-			{
-				SHOW_ERR(_("Package name invalid, a dot must be followed by a letter"));
-				goto android_dialog_clean_up; 
-			}
+		contents2 = contents3;
+	}
 
-			if ( (package_name[i] < 97 || package_name[i] > 122) // a-z
-			  && (package_name[i] < 65 || package_name[i] > 90) // A-Z
-			  && (package_name[i] < 48 || package_name[i] > 57) //0-9
-			  && package_name[i] != 46 // .
-			  && package_name[i] != 95 ) // _
-			{ 
-				SHOW_ERR(_("Package name contains invalid characters, must be A-Z 0-9 . and undersore only")); 
-				goto android_dialog_clean_up; 
-			}
+	// add intent filters
+	contents3 = strstr( contents2, "<!--ADDITIONAL_INTENT_FILTERS-->" );
+	if ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("<!--ADDITIONAL_INTENT_FILTERS-->");
 
-			last = package_name[i];
-		}
+		strcat( newcontents, contents2 );
 
 		if ( url_scheme && *url_scheme )
 		{
-			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
-			{
-				SHOW_ERR(_("URL scheme must not contain : or /"));
-				goto android_dialog_clean_up; 
-			}
+			strcat( newcontents, "<intent-filter android:autoVerify=\"true\">\n\
+			<action android:name=\"android.intent.action.VIEW\" />\n\
+			<category android:name=\"android.intent.category.DEFAULT\" />\n\
+			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
+			<data android:scheme=\"" );
+		
+			strcat( newcontents, url_scheme );
+			strcat( newcontents, "\" />\n    </intent-filter>\n" );
 		}
 
 		if ( deep_link && *deep_link )
 		{
-			if ( strncmp( deep_link, "https://", strlen("https://") ) != 0 && strncmp( deep_link, "http://", strlen("http://") ) != 0 )
+			gchar *szScheme = 0;
+			gchar *szHost = 0;
+			gchar *szPath = 0;
+			gchar *szTemp = strstr( deep_link, "://" );
+			if ( szTemp )
 			{
-				SHOW_ERR(_("Deep link must start with http:// or https://"));
-				goto android_dialog_clean_up; 
+				*szTemp = 0;
+				szScheme = g_strdup( deep_link );
+				*szTemp = ':';
+
+				szTemp += 3;
+				gchar *szTemp2 = strstr( szTemp, "/" );
+				if ( szTemp2 )
+				{
+					szPath = g_strdup( szTemp2 );
+					*szTemp2 = 0;
+					szHost = g_strdup( szTemp );
+					*szTemp2 = '/';
+				}
+				else szHost = g_strdup( szTemp );
 			}
 
-			if ( strcmp( deep_link, "https://" ) == 0 || strcmp( deep_link, "http://" ) == 0 )
+			if ( szScheme && *szScheme )
 			{
-				SHOW_ERR(_("Deep link must have a domain after http:// or https://"));
-				goto android_dialog_clean_up; 
-			}
-		}
+				strcat( newcontents, "<intent-filter android:autoVerify=\"true\">\n\
+			<action android:name=\"android.intent.action.VIEW\" />\n\
+			<category android:name=\"android.intent.category.DEFAULT\" />\n\
+			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
+			<data android:scheme=\"" );
+		
+				strcat( newcontents, szScheme );
+				if ( szHost && *szHost )
+				{
+					strcat( newcontents, "\" android:host=\"" );
+					strcat( newcontents, szHost );
 
-		// check icon
-		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto android_dialog_clean_up; }
-		if ( app_icon && *app_icon )
-		{
-			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Legacy app icon must be a PNG file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find legacy app icon location")); goto android_dialog_clean_up; }
-		}
-
-		if ( app_icon_new && *app_icon_new )
-		{
-			if ( !strrchr( app_icon_new, '.' ) || utils_str_casecmp( strrchr( app_icon_new, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( app_icon_new, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto android_dialog_clean_up; }
-		}
-
-		if ( notif_icon && *notif_icon )
-		{
-			if ( !strrchr( notif_icon, '.' ) || utils_str_casecmp( strrchr( notif_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Notification icon must be a PNG file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( notif_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find notification icon location")); goto android_dialog_clean_up; }
-		}
-
-		if ( isOuya )
-		{
-			//if ( !ouya_icon || !*ouya_icon ) { SHOW_ERR(_("You must select an Ouya large icon")); goto android_dialog_clean_up; }
-			if ( ouya_icon && *ouya_icon )
-			{
-				if ( !strrchr( ouya_icon, '.' ) || utils_str_casecmp( strrchr( ouya_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Ouya large icon must be a PNG file")); goto android_dialog_clean_up; }
-				if ( !g_file_test( ouya_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find ouya large icon location")); goto android_dialog_clean_up; }
-			}
-		}
-
-		// check firebase config file
-		if ( firebase_config && *firebase_config )
-		{
-			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".json" ) != 0 ) { SHOW_ERR(_("Google services config file must be a .json file")); goto android_dialog_clean_up; }
-			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Google services config file")); goto android_dialog_clean_up; }
-		}
-				
-		// check version
-		if ( version_number && *version_number )
-		{
-			for( i = 0; i < strlen(version_number); i++ )
-			{
-				if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
-				{ 
-					SHOW_ERR(_("Version name contains invalid characters, must be 0-9 and . only")); 
-					goto android_dialog_clean_up; 
-				}
-			}
-		}
-
-		// check keystore
-		if ( keystore_file && *keystore_file )
-		{
-			if ( !g_file_test( keystore_file, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find keystore file location")); goto android_dialog_clean_up; }
-		}
-
-		// check passwords
-		if ( keystore_password && strchr(keystore_password,'"') ) { SHOW_ERR(_("Keystore password cannot contain double quotes")); goto android_dialog_clean_up; }
-		if ( alias_password && strchr(alias_password,'"') ) { SHOW_ERR(_("Alias password cannot contain double quotes")); goto android_dialog_clean_up; }
-
-		if ( keystore_file && *keystore_file )
-		{
-			if ( !keystore_password || !*keystore_password ) { SHOW_ERR(_("You must enter your keystore password when using your own keystore")); goto android_dialog_clean_up; }
-		}
-
-		if ( alias_name && *alias_name )
-		{
-			if ( !alias_password || !*alias_password ) { SHOW_ERR(_("You must enter your alias password when using a custom alias")); goto android_dialog_clean_up; }
-		}
-		
-		int includeFirebase = (firebase_config && *firebase_config && (isGoogle || isAmazon)) ? 1 : 0;
-		int includePushNotify = (permission_push && isGoogle) ? 1 : 0;
-		int includeGooglePlay = (google_play_app_id && *google_play_app_id && isGoogle) ? 1 : 0;
-		int includeAdMob = (admob_app_id && *admob_app_id && isGoogle) ? 1 : 0;
-
-		if ( includePushNotify && !includeFirebase )
-		{
-			SHOW_ERR( _("Push Notifications on Android now use Firebase, so you must include a Firebase config file to use them") );
-			goto android_dialog_clean_up;
-		}
-
-		goto android_dialog_continue;
-
-android_dialog_clean_up:
-		if ( app_name ) g_free(app_name);
-		if ( package_name ) g_free(package_name);
-		if ( app_icon ) g_free(app_icon);
-		if ( app_icon_new ) g_free(app_icon_new);
-		if ( ouya_icon ) g_free(ouya_icon);
-		if ( notif_icon ) g_free(notif_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( google_play_app_id ) g_free(google_play_app_id);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
-
-		if ( keystore_file ) g_free(keystore_file);
-		if ( keystore_password ) g_free(keystore_password);
-		if ( version_number ) g_free(version_number);
-		if ( alias_name ) g_free(alias_name);
-		if ( alias_password ) g_free(alias_password);
-
-		if ( output_file ) g_free(output_file);
-
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), TRUE );
-		running = 0;
-		return;
-
-android_dialog_continue:
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// CHECKS COMPLETE, START EXPORT
-
-		const char* androidJar = "android31.jar";
-
-#if defined(G_OS_WIN32)
-		gchar* path_to_aapt2 = g_build_path( "\\", app->datadir, "android", "aapt2-bundle.exe", NULL );
-		gchar* path_to_android_jar = g_build_path( "\\", app->datadir, "android", androidJar, NULL );
-		gchar* path_to_bundletool = g_build_path( "\\", app->datadir, "android", "bundletool.jar", NULL );
-		gchar* path_to_apksigner = g_build_path( "\\", app->datadir, "android", "apksigner.jar", NULL );
-		gchar* path_to_zipalign = g_build_path( "\\", app->datadir, "android", "zipalign.exe", NULL );
-
-		// convert forward slashes to backward slashes for parameters that will be passed to aapt2
-		gchar *pathPtr = path_to_android_jar;
-		while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
-
-		pathPtr = output_file;
-		while( *pathPtr ) { if ( *pathPtr == '/' ) *pathPtr = '\\'; pathPtr++; }
-        
-        gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
-        gchar* src_folder;
-        if ( isOuya ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
-        else if ( isAmazon ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
-#elif defined(__APPLE__)
-        gchar* path_to_aapt2 = g_build_path( "/", app->configdir, "AndroidExport", "aapt2-bundle", NULL );
-        gchar* path_to_android_jar = g_build_path( "/", app->configdir, "AndroidExport", androidJar, NULL );
-        gchar* path_to_bundletool = g_build_path( "/", app->configdir, "AndroidExport", "bundletool.jar", NULL );
-		gchar* path_to_apksigner = g_build_path( "/", app->configdir, "AndroidExport", "apksigner.jar", NULL );
-        gchar* path_to_zipalign = g_build_path( "/", app->configdir, "AndroidExport", "zipalign", NULL );
-        
-        gchar* android_folder = g_build_filename( app->configdir, "AndroidExport", NULL );
-        gchar* src_folder;
-        if ( isOuya ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceOuya", NULL );
-        else if ( isAmazon ) src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->configdir, "AndroidExport", "sourceGoogle", NULL );
-#else
-		//SHOW_ERR1 ( _ ( "Path: %s" ), app->datadir );
-		gchar* path_to_aapt2 = g_build_path( "/", app->datadir, "android", "aapt2-bundle", NULL );
-		gchar* path_to_android_jar = g_build_path( "/", app->datadir, "android", androidJar, NULL );
-        gchar* path_to_bundletool = g_build_path( "/", app->datadir, "android", "bundletool.jar", NULL );
-		gchar* path_to_apksigner = g_build_path( "/", app->datadir, "android", "apksigner.jar", NULL );
-		gchar* path_to_zipalign = g_build_path( "/", app->datadir, "android", "zipalign", NULL );
-        
-        gchar* android_folder = g_build_filename( app->datadir, "android", NULL );
-        gchar* src_folder;
-        if ( isOuya ) src_folder = g_build_path( "/", app->datadir, "android", "sourceOuya", NULL );
-        else if ( isAmazon ) src_folder = g_build_path( "/", app->datadir, "android", "sourceAmazon", NULL );
-        else src_folder = g_build_path( "/", app->datadir, "android", "sourceGoogle", NULL );
-#endif
-
-		// make temporary folder
-		gchar* tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
-		
-		utils_str_replace_char( android_folder, '\\', '/' );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
-		utils_str_replace_char( src_folder, '\\', '/' );
-
-		utils_remove_folder_recursive( tmp_folder );
-		
-		gchar *output_file_zip = g_strdup( output_file );
-		ext = strrchr( output_file_zip, '.' );
-		if ( ext && strlen(ext) < 6 ) *ext = 0;
-		SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
-
-		if ( g_file_test( output_file_zip, G_FILE_TEST_EXISTS ) )
-		{
-			g_unlink( output_file_zip );
-		}
-
-		if ( !keystore_file || !*keystore_file )
-		{
-			if ( keystore_file ) g_free(keystore_file);
-			if ( keystore_password ) g_free(keystore_password);
-
-			keystore_file = g_build_path( "/", android_folder, "debug.keystore", NULL );
-			keystore_password = g_strdup("android");
-
-			if ( alias_name ) g_free(alias_name);
-			if ( alias_password ) g_free(alias_password);
-
-			alias_name = g_strdup("androiddebugkey");
-			alias_password = g_strdup("android");
-		}
-		else
-		{
-			if ( !alias_name || !*alias_name )
-			{
-				if ( alias_name ) g_free(alias_name);
-				if ( alias_password ) g_free(alias_password);
-
-				alias_name = g_strdup("mykeystore");
-				alias_password = g_strdup(keystore_password);
-			}
-		}
-
-#define AGK_NEW_CONTENTS_SIZE 1000000
-
-		// declarations
-		gchar *newcontents = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
-		gchar *newcontents2 = g_new0( gchar, AGK_NEW_CONTENTS_SIZE );
-		gchar* manifest_file = NULL;
-		gchar *contents = NULL;
-		gchar *contents2 = NULL;
-		gchar *contents3 = NULL;
-		gchar *contentsOther = NULL;
-		gchar *contentsOther2 = NULL;
-		gchar *contentsOther3 = NULL;
-		gsize length = 0;
-		gchar* resources_file = NULL;
-		GError *error = NULL;
-		GdkPixbuf *icon_image = NULL;
-		gchar *image_filename = NULL;
-		GdkPixbuf *icon_scaled_image = NULL;
-		gchar **argv = NULL;
-		gint status = 0;
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-		gchar *zip_add_file = 0;
-		gchar *str_out = NULL;
-		gsize resLength = 0;
-		gint package_count = 0;
-		gint package_index = 0;
-
-		gchar* path_to_java = 0;
-		gchar* path_to_jarsigner = 0;
-
-		// check for java
-		argv = g_new0( gchar*, 3 );
-		argv[0] = g_strdup( "/usr/bin/which" );
-		argv[1] = g_strdup( "java" );
-		argv[2] = NULL;
-
-		#ifdef G_OS_WIN32
-			g_free(argv [ 0 ]);
-			argv [ 0 ] = g_strdup ( "where" );
-		#endif
-
-		if ( !utils_spawn_sync( app->project->base_path, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to check for Java: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
-
-#ifdef G_OS_WIN32
-		if ( !str_out || str_out[0] == 0 || str_out[1] != ':' ) 
-#else
-		if ( !str_out || str_out[0] != '/' ) 
-#endif
-		{
-			const char* java_home = getenv( "JAVA_HOME" );
-			if ( !java_home )
-			{
-				SHOW_ERR( _("Could not find Java, make sure you have the Java Development Kit (JDK) 8 or above installed. If it is installed then make sure that the JAVA_HOME environment variable is defined or that the Java bin folder is in your PATH environment variable") );
-				goto android_dialog_cleanup2;
-			}
-			else
-			{
-				const char* separator = "/";
-				const char* binary = "java";
-#ifdef G_OS_WIN32
-				separator = "\\";
-				binary = "java.exe";
-#endif
-				path_to_java = g_build_path( separator, java_home, "bin", binary, NULL );
-
-				if ( !g_file_test( path_to_java, G_FILE_TEST_EXISTS ) )
-				{
-					SHOW_ERR1( _("Could not find java program, expected to find it in \"%s\", make sure your JAVA_HOME environment variable is correct"), path_to_java );
-					goto android_dialog_cleanup2;
-				}
-			}
-		}
-		else
-		{
-#ifdef G_OS_WIN32
-			path_to_java = g_strdup( "java" );
-#else
-			path_to_java = g_strdup( str_out );
-			if ( path_to_java[ strlen(path_to_java)-1 ] == '\n' )
-			{
-				path_to_java[ strlen(path_to_java)-1 ] = 0;
-			}
-#endif
-		}
-
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
-
-		argv[1] = g_strdup( "jarsigner" );
-
-		if ( !utils_spawn_sync( app->project->base_path, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to check for Jarsigner: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
-
-#ifdef G_OS_WIN32
-		if ( !str_out || str_out[0] == 0 || str_out[1] != ':' ) 
-#else
-		if ( !str_out || str_out[0] != '/' ) 
-#endif
-		{
-			const char* java_home = getenv( "JAVA_HOME" );
-			if ( !java_home )
-			{
-				SHOW_ERR( _("Could not find jarsigner, make sure you have the Java Development Kit (JDK) 8 or above installed. If it is installed then make sure that the JAVA_HOME environment variable is defined or that the Java bin folder is in your PATH environment variable") );
-				goto android_dialog_cleanup2;
-			}
-			else
-			{
-				const char* separator = "/";
-				const char* binary = "jarsigner";
-#ifdef G_OS_WIN32
-				separator = "\\";
-				binary = "jarsigner.exe";
-#endif
-				path_to_jarsigner = g_build_path( separator, java_home, "bin", binary, NULL );
-
-				if ( !g_file_test( path_to_jarsigner, G_FILE_TEST_EXISTS ) )
-				{
-					SHOW_ERR1( _("Could not find jarsigner program, expected to find it in \"%s\", make sure your JAVA_HOME environment variable is correct"), path_to_jarsigner );
-					goto android_dialog_cleanup2;
+					if ( szPath && *szPath )
+					{
+						strcat( newcontents, "\" android:pathPrefix=\"" );
+						strcat( newcontents, szPath );
+					}
 				}
-			}
-		}
-		else
-		{
-#ifdef G_OS_WIN32
-			path_to_jarsigner = g_strdup( "jarsigner" );
-#else
-			path_to_jarsigner = g_strdup( str_out );
-			if ( path_to_jarsigner[ strlen(path_to_jarsigner)-1 ] == '\n' )
-			{
-				path_to_jarsigner[ strlen(path_to_jarsigner)-1 ] = 0;
-			}
-#endif
-		}
-
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
-
-		g_strfreev(argv);
-		argv = 0;
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// copy android export files to tmp folder
-		if ( !utils_copy_folder( src_folder, tmp_folder, TRUE, NULL ) )
-		{
-			SHOW_ERR1( _("Failed to copy source folder %s"), src_folder );
-			goto android_dialog_cleanup2;
-		}
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-		
-		// edit AndroidManifest.xml
-		manifest_file = g_build_path( "/", tmp_folder, "AndroidManifest.xml", NULL );
-
-		if ( !g_file_get_contents( manifest_file, &contents, &length, NULL ) )
-		{
-			SHOW_ERR( _("Failed to read AndroidManifest.xml file") );
-			goto android_dialog_cleanup2;
-		}
-
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\
-<manifest xmlns:android=\"http://schemas.android.com/apk/res/android\"\n\
-      android:versionCode=\"" );
-		strcat( newcontents, szBuildNum );
-		strcat( newcontents, "\"\n      android:versionName=\"" );
-		strcat( newcontents, version_number );
-		strcat( newcontents, "\" package=\"" );
-		strcat( newcontents, package_name );
-		strcat( newcontents, "\"" );
-		strcat( newcontents, " android:installLocation=\"auto\">\n\
-    <uses-feature android:glEsVersion=\"0x00020000\"></uses-feature>\n\
-    <uses-sdk android:minSdkVersion=\"" );
-		
-		strcat( newcontents, szSDK );
 		
-		// mike - 021221 - ensure we target SDK version 30
-		strcat( newcontents, "\" android:targetSdkVersion=\"" );
-		if ( isOuya ) strcat( newcontents, "16" );
-		else strcat( newcontents, "31" );
-		strcat( newcontents, "\" />\n\n" );
-
-		if ( permission_external_storage ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WRITE_EXTERNAL_STORAGE\" />\n" );
-		if ( permission_internet ) 
-		{
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.INTERNET\" />\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_NETWORK_STATE\" />\n" );
-			strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_WIFI_STATE\" />\n" );
-		}
-		if ( permission_wake ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.WAKE_LOCK\" />\n" );
-		if ( isGoogle )
-		{
-			if ( permission_location_coarse || permission_location_fine ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_COARSE_LOCATION\" />\n" );
-			if ( permission_location_fine ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.ACCESS_FINE_LOCATION\" />\n" );
-			if ( permission_billing ) strcat( newcontents, "    <uses-permission android:name=\"com.android.vending.BILLING\" />\n" );
-			if ( permission_push ) 
-			{
-				strcat( newcontents, "    <permission android:name=\"" );
-				strcat( newcontents, package_name );
-				strcat( newcontents, ".permission.C2D_MESSAGE\" android:protectionLevel=\"signature\" />\n" );
-				strcat( newcontents, "    <uses-permission android:name=\"" );
-				strcat( newcontents, package_name );
-				strcat( newcontents, ".permission.C2D_MESSAGE\" />\n" );
-			}
-			if ( (google_play_app_id && *google_play_app_id) || permission_push ) strcat( newcontents, "    <uses-permission android:name=\"com.google.android.c2dm.permission.RECEIVE\" />\n" );
-		}
-		if ( permission_camera ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.CAMERA\" />\n" );
-		if ( permission_push || permission_notifications ) strcat(newcontents, "    <uses-permission android:name=\"android.permission.POST_NOTIFICATIONS\" />\n" );
-		if ( permission_vibrate ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.VIBRATE\" />\n" );
-		if ( permission_record_audio ) strcat( newcontents, "    <uses-permission android:name=\"android.permission.RECORD_AUDIO\" />\n" );
-
-		// if ARCore required
-		if ( arcore_mode == 2 )
-		{
-			strcat( newcontents, "    <uses-feature android:name=\"android.hardware.camera.ar\" android:required=\"true\" />" );
-		}
-
-		/*<uses-permission android:name="com.google.android.gms.permission.AD_ID" /> Required on Android 13*/
-
-		contents2 = contents;
-		contents3 = 0;
-
-		// the order of these relacements is important, they must occur in the same order as they occur in the file
-
-		// package queries
-		contents3 = strstr(contents2, "<!--ADDITIONAL_QUERIES-->");
-		if (contents3)
-		{
-			*contents3 = 0;
-			contents3 += strlen("<!--ADDITIONAL_QUERIES-->");
-
-			strcat(newcontents, contents2);
-					
-			if ( snapchat_client_id && *snapchat_client_id )
-			{
-				strcat(newcontents, "<package android:name=\"com.snapchat.android\" />\n" );
-			}
-
-			if ( arcore_mode > 0 )
-			{
-				strcat(newcontents, "<package android:name=\"com.google.ar.core\" />\n" );
-			}
-
-			contents2 = contents3;
-		}
-
-		// replace orientation
-		contents3 = strstr( contents2, "screenOrientation=\"fullSensor\"" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("screenOrientation=\"fullSensor");
-
-			strcat( newcontents, contents2 );
-
-			switch( orientation )
-			{
-				case 6: strcat( newcontents, "screenOrientation=\"sensorLandscape" ); break;
-				case 7: 
-				{
-					// all now use API 23 with correct spelling
-					strcat( newcontents, "screenOrientation=\"sensorPortrait" ); 
-					break;
-				}
-				default: strcat( newcontents, "screenOrientation=\"fullSensor" ); break;
-			}
-
-			contents2 = contents3;
-		}
-
-		// add intent filters
-		contents3 = strstr( contents2, "<!--ADDITIONAL_INTENT_FILTERS-->" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("<!--ADDITIONAL_INTENT_FILTERS-->");
-
-			strcat( newcontents, contents2 );
-
-			if ( url_scheme && *url_scheme )
-			{
-				strcat( newcontents, "<intent-filter android:autoVerify=\"true\">\n\
-			<action android:name=\"android.intent.action.VIEW\" />\n\
-			<category android:name=\"android.intent.category.DEFAULT\" />\n\
-			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
-			<data android:scheme=\"" );
-			
-				strcat( newcontents, url_scheme );
 				strcat( newcontents, "\" />\n    </intent-filter>\n" );
 			}
-
-			if ( deep_link && *deep_link )
-			{
-				gchar *szScheme = 0;
-				gchar *szHost = 0;
-				gchar *szPath = 0;
-				gchar *szTemp = strstr( deep_link, "://" );
-				if ( szTemp )
-				{
-					*szTemp = 0;
-					szScheme = g_strdup( deep_link );
-					*szTemp = ':';
-
-					szTemp += 3;
-					gchar *szTemp2 = strstr( szTemp, "/" );
-					if ( szTemp2 )
-					{
-						szPath = g_strdup( szTemp2 );
-						*szTemp2 = 0;
-						szHost = g_strdup( szTemp );
-						*szTemp2 = '/';
-					}
-					else szHost = g_strdup( szTemp );
-				}
-
-				if ( szScheme && *szScheme )
-				{
-					strcat( newcontents, "<intent-filter android:autoVerify=\"true\">\n\
-			<action android:name=\"android.intent.action.VIEW\" />\n\
-			<category android:name=\"android.intent.category.DEFAULT\" />\n\
-			<category android:name=\"android.intent.category.BROWSABLE\" />\n\
-			<data android:scheme=\"" );
 			
-					strcat( newcontents, szScheme );
-					if ( szHost && *szHost )
-					{
-						strcat( newcontents, "\" android:host=\"" );
-						strcat( newcontents, szHost );
 
-						if ( szPath && *szPath )
-						{
-							strcat( newcontents, "\" android:pathPrefix=\"" );
-							strcat( newcontents, szPath );
-						}
-					}
-			
-					strcat( newcontents, "\" />\n    </intent-filter>\n" );
-				}
-				
-
-				if ( szScheme ) g_free( szScheme );
-				if ( szHost ) g_free( szHost );
-				if ( szPath ) g_free( szPath );
-			}
-
-			contents2 = contents3;
+			if ( szScheme ) g_free( szScheme );
+			if ( szHost ) g_free( szHost );
+			if ( szPath ) g_free( szPath );
 		}
 
-		// replace package name
-		contents3 = strstr( contents2, "YOUR_PACKAGE_NAME_HERE" );
-		if ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("YOUR_PACKAGE_NAME_HERE");
+		contents2 = contents3;
+	}
 
-			strcat( newcontents, contents2 );
-			strcat( newcontents, package_name );
-			contents2 = contents3;
-		}
+	// replace package name
+	contents3 = strstr( contents2, "YOUR_PACKAGE_NAME_HERE" );
+	if ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("YOUR_PACKAGE_NAME_HERE");
 
-		// replace application ID
-		contents3 = strstr( contents2, "${applicationId}" );
-		while ( contents3 )
-		{
-			*contents3 = 0;
-			contents3 += strlen("${applicationId}");
+		strcat( newcontents, contents2 );
+		strcat( newcontents, package_name );
+		contents2 = contents3;
+	}
 
-			strcat( newcontents, contents2 );
-			strcat( newcontents, package_name );
-			contents2 = contents3;
-			contents3 = strstr( contents2, "${applicationId}" );
-		}
+	// replace application ID
+	contents3 = strstr( contents2, "${applicationId}" );
+	while ( contents3 )
+	{
+		*contents3 = 0;
+		contents3 += strlen("${applicationId}");
 
-		// write the rest of the manifest file
 		strcat( newcontents, contents2 );
+		strcat( newcontents, package_name );
+		contents2 = contents3;
+		contents3 = strstr( contents2, "${applicationId}" );
+	}
 
-		// Google sign in
-		if ( isGoogle )
-		{
-			strcat( newcontents, "\n\
+	// write the rest of the manifest file
+	strcat( newcontents, contents2 );
+
+	// Google sign in
+	if ( isGoogle )
+	{
+		strcat( newcontents, "\n\
 		<activity android:name=\"com.google.android.gms.auth.api.signin.internal.SignInHubActivity\"\n\
             android:excludeFromRecents=\"true\"\n\
             android:exported=\"false\"\n\
@@ -1921,12 +1944,12 @@ android_dialog_continue:
         <service android:name=\"com.google.android.gms.auth.api.signin.RevocationBoundService\"\n\
             android:exported=\"true\"\n\
             android:permission=\"com.google.android.gms.auth.api.signin.permission.REVOCATION_NOTIFICATION\" />\n" );
-		}
+	}
 
-		// IAP Purchase Activity
-		if ( permission_billing && isGoogle )
-		{
-			strcat(newcontents, "\n\
+	// IAP Purchase Activity
+	if ( permission_billing && isGoogle )
+	{
+		strcat(newcontents, "\n\
 			<meta-data\n\
 				android:name=\"com.google.android.play.billingclient.version\"\n\
 				android:value=\"5.0.0\" />\n\
@@ -1935,33 +1958,33 @@ android_dialog_continue:
 				android:configChanges=\"keyboard|keyboardHidden|screenLayout|screenSize|orientation\"\n\
 				android:exported=\"false\"\n\
 				android:theme=\"@android:style/Theme.Translucent.NoTitleBar\" />\n");
-		}
+	}
 
-		// Google API Activity - for Game Services
-		if ( includeGooglePlay )
-		{
-			strcat( newcontents, "\n\
+	// Google API Activity - for Game Services
+	if ( includeGooglePlay )
+	{
+		strcat( newcontents, "\n\
         <activity android:name=\"com.google.android.gms.common.api.GoogleApiActivity\" \n\
                   android:exported=\"false\" \n\
                   android:theme=\"@android:style/Theme.Translucent.NoTitleBar\" />" );
-		}
+	}
 
-		// Firebase Init Provider - for Game Services and Firebase
-		if ( includeGooglePlay || includeFirebase || includePushNotify )
-		{
-			strcat( newcontents, "\n        <provider android:authorities=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".firebaseinitprovider\"\n\
+	// Firebase Init Provider - for Game Services and Firebase
+	if ( includeGooglePlay || includeFirebase || includePushNotify )
+	{
+		strcat( newcontents, "\n        <provider android:authorities=\"" );
+		strcat( newcontents, package_name );
+		strcat( newcontents, ".firebaseinitprovider\"\n\
                   android:directBootAware=\"true\"\n\
                   android:name=\"com.google.firebase.provider.FirebaseInitProvider\"\n\
                   android:exported=\"false\"\n\
                   android:initOrder=\"100\" />\n" );
-		}
+	}
 
-		// Firebase activities
-		if ( includeFirebase )
-		{
-			strcat( newcontents, "\n\
+	// Firebase activities
+	if ( includeFirebase )
+	{
+		strcat( newcontents, "\n\
         <receiver\n\
             android:name=\"com.google.android.gms.measurement.AppMeasurementReceiver\"\n\
             android:enabled=\"true\"\n\
@@ -2008,11 +2031,11 @@ android_dialog_continue:
         <receiver\n\
             android:name=\"com.google.android.datatransport.runtime.scheduling.jobscheduling.AlarmManagerSchedulerBroadcastReceiver\"\n\
             android:exported=\"false\" />" );
-		}
+	}
 
-		if ( includeFirebase || includePushNotify )
-		{
-			strcat( newcontents, "\n\
+	if ( includeFirebase || includePushNotify )
+	{
+		strcat( newcontents, "\n\
         <receiver android:name=\"com.google.firebase.iid.FirebaseInstanceIdReceiver\" \n\
                   android:exported=\"true\" \n\
                   android:permission=\"com.google.android.c2dm.permission.SEND\" > \n\
@@ -2020,11 +2043,11 @@ android_dialog_continue:
                 <action android:name=\"com.google.android.c2dm.intent.RECEIVE\" /> \n\
             </intent-filter> \n\
         </receiver>" );
-		}
+	}
 
-		if ( includePushNotify )
-		{
-			strcat( newcontents, "\n\
+	if ( includePushNotify )
+	{
+		strcat( newcontents, "\n\
 		<meta-data android:name=\"com.google.firebase.messaging.default_notification_icon\"\n\
             android:resource=\"@drawable/icon_white\" />\n\
 		<service android:name=\"com.google.firebase.messaging.FirebaseMessagingService\" \n\
@@ -2033,28 +2056,28 @@ android_dialog_continue:
                 <action android:name=\"com.google.firebase.MESSAGING_EVENT\" /> \n\
             </intent-filter> \n\
         </service>" );
-		}
+	}
 
-		if ( includeAdMob )
-		{
-			strcat( newcontents, "\n\
+	if ( includeAdMob )
+	{
+		strcat( newcontents, "\n\
         <provider\n\
             android:name=\"com.google.android.gms.ads.MobileAdsInitProvider\"\n\
             android:authorities=\"" );
-			strcat( newcontents, package_name );
-			strcat( newcontents, ".mobileadsinitprovider\"\n\
+		strcat( newcontents, package_name );
+		strcat( newcontents, ".mobileadsinitprovider\"\n\
             android:exported=\"false\"\n\
             android:initOrder=\"100\" />" );
-		}
+	}
 
-		// arcore activity
-		if ( arcore_mode > 0 )
-		{
-			strcat( newcontents, "\n\
+	// arcore activity
+	if ( arcore_mode > 0 )
+	{
+		strcat( newcontents, "\n\
 		<meta-data android:name=\"com.google.ar.core\" android:value=\"");
-			if ( arcore_mode == 1 ) strcat( newcontents, "optional" );
-			else strcat( newcontents, "required" );
-			strcat( newcontents, "\" />\n\
+		if ( arcore_mode == 1 ) strcat( newcontents, "optional" );
+		else strcat( newcontents, "required" );
+		strcat( newcontents, "\" />\n\
 		<meta-data android:name=\"com.google.ar.core.min_apk_version\" android:value=\"190519000\" />\n\
         <activity\n\
             android:name=\"com.google.ar.core.InstallActivity\"\n\
@@ -2063,1551 +2086,1886 @@ android_dialog_continue:
             android:exported=\"false\"\n\
             android:launchMode=\"singleTop\"\n\
             android:theme=\"@android:style/Theme.Material.Light.Dialog.Alert\" />" );
-		}
+	}
 
 
-		strcat( newcontents, "\n    </application>\n</manifest>\n" );
-	
-		// write new Android Manifest.xml file
-		if ( !g_file_set_contents( manifest_file, newcontents, strlen(newcontents), &error ) )
+	strcat( newcontents, "\n    </application>\n</manifest>\n" );
+
+	// write new Android Manifest.xml file
+	if ( !g_file_set_contents( manifest_file, newcontents, strlen(newcontents), &error ) )
+	{
+		SHOW_ERR1( _("Failed to write AndroidManifest.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+
+	if ( contents ) g_free(contents);
+	contents = 0;
+
+	// read resources file
+	resources_file = g_build_path( "/", tmp_folder, "resOrig", "values", "values.xml", NULL );
+	if ( !g_file_get_contents( resources_file, &contents, &resLength, &error ) )
+	{
+		SHOW_ERR1( _("Failed to read resource values.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
+
+	contents2 = strstr( contents, "<string name=\"app_name\">" );
+	if ( !contents2 )
+	{
+		SHOW_ERR( _("Could not find app name entry in values.xml file") );
+		goto android_dialog_cleanup2;
+	}
+
+	contents2 += strlen("<string name=\"app_name\"");
+	*contents2 = 0;
+	contents3 = contents2;
+	contents3++;
+	contents3 = strstr( contents3, "</string>" );
+	if ( !contents3 )
+	{
+		SHOW_ERR( _("Could not find end of app name entry in values.xml file") );
+		goto android_dialog_cleanup2;
+	}
+
+	// write resources file
+	strcpy( newcontents, contents );
+	strcat( newcontents, ">" );
+	strcat( newcontents, app_name );
+	strcat( newcontents, contents3 );
+
+	// repair original file
+	*contents2 = '>';
+
+	if ( isGoogle && google_play_app_id && *google_play_app_id )
+	{
+		memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		contents2 = strstr( newcontents2, "<string name=\"games_app_id\">" );
+		if ( !contents2 )
 		{
-			SHOW_ERR1( _("Failed to write AndroidManifest.xml file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
+			SHOW_ERR( _("Could not find games_app_id entry in values.xml file") );
 			goto android_dialog_cleanup2;
 		}
 
-		if ( contents ) g_free(contents);
-		contents = 0;
+		contents2 += strlen("<string name=\"games_app_id\"");
+		*contents2 = 0;
+		contents3 = contents2;
+		contents3++;
+		contents3 = strstr( contents3, "</string>" );
+		if ( !contents3 )
+		{
+			SHOW_ERR( _("Could not find end of games_app_id entry in values.xml file") );
+			goto android_dialog_cleanup2;
+		}
 
-		// read resources file
-		resources_file = g_build_path( "/", tmp_folder, "resOrig", "values", "values.xml", NULL );
-		if ( !g_file_get_contents( resources_file, &contents, &resLength, &error ) )
+		// write resources file
+		strcpy( newcontents, newcontents2 );
+		strcat( newcontents, ">" );
+		strcat( newcontents, google_play_app_id );
+		strcat( newcontents, contents3 );
+
+		// repair original file
+		*contents2 = '>';
+	}
+
+	// admob app id
+	if ( isGoogle && admob_app_id && *admob_app_id )
+	{
+		memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		contents2 = strstr( newcontents2, "<string name=\"admob_app_id\">" );
+		if ( !contents2 )
 		{
-			SHOW_ERR1( _("Failed to read resource values.xml file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
+			SHOW_ERR( _("Could not find admob_app_id entry in values.xml file") );
+			goto android_dialog_cleanup2;
+		}
+
+		contents2 += strlen("<string name=\"admob_app_id\"");
+		*contents2 = 0;
+		contents3 = contents2;
+		contents3++;
+		contents3 = strstr( contents3, "</string>" );
+		if ( !contents3 )
+		{
+			SHOW_ERR( _("Could not find end of admob_app_id entry in values.xml file") );
 			goto android_dialog_cleanup2;
 		}
 
-		contents2 = strstr( contents, "<string name=\"app_name\">" );
+		// write resources file
+		strcpy( newcontents, newcontents2 );
+		strcat( newcontents, ">" );
+		strcat( newcontents, admob_app_id );
+		strcat( newcontents, contents3 );
+
+		// repair original file
+		*contents2 = '>';
+	}
+
+	// snapchat client id
+	if ( isGoogle && snapchat_client_id && *snapchat_client_id )
+	{
+		memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		contents2 = strstr( newcontents2, "<string name=\"snap_chat_id\">" );
 		if ( !contents2 )
 		{
-			SHOW_ERR( _("Could not find app name entry in values.xml file") );
+			SHOW_ERR( _("Could not find snap_chat_id entry in values.xml file") );
 			goto android_dialog_cleanup2;
 		}
 
-		contents2 += strlen("<string name=\"app_name\"");
+		contents2 += strlen("<string name=\"snap_chat_id\"");
 		*contents2 = 0;
 		contents3 = contents2;
 		contents3++;
 		contents3 = strstr( contents3, "</string>" );
 		if ( !contents3 )
 		{
-			SHOW_ERR( _("Could not find end of app name entry in values.xml file") );
+			SHOW_ERR( _("Could not find end of snap_chat_id entry in values.xml file") );
 			goto android_dialog_cleanup2;
 		}
 
 		// write resources file
-		strcpy( newcontents, contents );
+		strcpy( newcontents, newcontents2 );
 		strcat( newcontents, ">" );
-		strcat( newcontents, app_name );
+		strcat( newcontents, snapchat_client_id );
 		strcat( newcontents, contents3 );
 
 		// repair original file
 		*contents2 = '>';
+	}
 
-		if ( isGoogle && google_play_app_id && *google_play_app_id )
+	// firebase
+	if ( firebase_config && *firebase_config && (isGoogle || isAmazon) ) // Google and Amazon only
+	{
+		// read json values
+		if ( !g_file_get_contents( firebase_config, &contentsOther, &resLength, &error ) )
 		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"games_app_id\">" );
+			SHOW_ERR1( _("Failed to read firebase config file: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+
+		memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+
+		// find project_number value
+		{
+			contentsOther2 = strstr( contentsOther, "\"project_number\": \"" );
+			if ( !contentsOther2 )
+			{
+				SHOW_ERR( _("Could not find project_number entry in Firebase config file") );
+				goto android_dialog_cleanup2;
+			}
+
+			contentsOther2 += strlen("\"project_number\": \"");
+			contentsOther3 = strstr( contentsOther2, "\"" );
+			if ( !contentsOther3 )
+			{
+				SHOW_ERR( _("Could not find end of project_number entry in Firebase config file") );
+				goto android_dialog_cleanup2;
+			}
+			*contentsOther3 = 0;
+
+			// find entry in newcontents2
+			contents2 = strstr( newcontents2, "<string name=\"gcm_defaultSenderId\" translatable=\"false\"" );
 			if ( !contents2 )
 			{
-				SHOW_ERR( _("Could not find games_app_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find gcm_defaultSenderId entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
-			contents2 += strlen("<string name=\"games_app_id\"");
+			contents2 += strlen("<string name=\"gcm_defaultSenderId\" translatable=\"false\"");
 			*contents2 = 0;
 			contents3 = contents2;
 			contents3++;
 			contents3 = strstr( contents3, "</string>" );
 			if ( !contents3 )
 			{
-				SHOW_ERR( _("Could not find end of games_app_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find end of gcm_defaultSenderId entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
 			// write resources file
 			strcpy( newcontents, newcontents2 );
 			strcat( newcontents, ">" );
-			strcat( newcontents, google_play_app_id );
+			strcat( newcontents, contentsOther2 );
 			strcat( newcontents, contents3 );
 
-			// repair original file
-			*contents2 = '>';
+			*contents2 = '>'; // repair file
+			*contentsOther3 = '"'; // repair file
+			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
 		}
-
-		// admob app id
-		if ( isGoogle && admob_app_id && *admob_app_id )
+		
+		// find firebase_url value
 		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"admob_app_id\">" );
+			contentsOther2 = strstr( contentsOther, "\"firebase_url\": \"" );
+			if ( !contentsOther2 )
+			{
+				SHOW_ERR( _("Could not find firebase_url entry in Firebase config file") );
+				goto android_dialog_cleanup2;
+			}
+
+			contentsOther2 += strlen("\"firebase_url\": \"");
+			contentsOther3 = strstr( contentsOther2, "\"" );
+			if ( !contentsOther3 )
+			{
+				SHOW_ERR( _("Could not find end of firebase_url entry in Firebase config file") );
+				goto android_dialog_cleanup2;
+			}
+			*contentsOther3 = 0;
+
+			// find entry in newcontents2
+			contents2 = strstr( newcontents2, "<string name=\"firebase_database_url\" translatable=\"false\"" );
 			if ( !contents2 )
 			{
-				SHOW_ERR( _("Could not find admob_app_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find firebase_database_url entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
-			contents2 += strlen("<string name=\"admob_app_id\"");
+			contents2 += strlen("<string name=\"firebase_database_url\" translatable=\"false\"");
 			*contents2 = 0;
 			contents3 = contents2;
 			contents3++;
 			contents3 = strstr( contents3, "</string>" );
 			if ( !contents3 )
 			{
-				SHOW_ERR( _("Could not find end of admob_app_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find end of firebase_database_url entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
 			// write resources file
 			strcpy( newcontents, newcontents2 );
 			strcat( newcontents, ">" );
-			strcat( newcontents, admob_app_id );
+			strcat( newcontents, contentsOther2 );
 			strcat( newcontents, contents3 );
 
-			// repair original file
-			*contents2 = '>';
+			*contents2 = '>'; // repair file
+			*contentsOther3 = '"'; // repair file
+			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
 		}
 
-		// snapchat client id
-		if ( isGoogle && snapchat_client_id && *snapchat_client_id )
+		// find mobilesdk_app_id value
+		// if the config file contains multiple Android apps then there will be multiple mobilesdk_app_id's, and only the corect one will work
+		// look for the corresponding package_name that matches this export
 		{
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			contents2 = strstr( newcontents2, "<string name=\"snap_chat_id\">" );
+			package_count = 0;
+			contentsOther2 = contentsOther;
+			while( *contentsOther2 && (contentsOther2 = strstr( contentsOther2, "\"mobilesdk_app_id\": \"" )) )
+			{
+				package_count++;
+				contentsOther2 += strlen("\"mobilesdk_app_id\": \"");
+				contentsOther3 = strstr( contentsOther2, "\"" );
+				if ( !contentsOther3 )
+				{
+					SHOW_ERR( _("Could not find end of mobilesdk_app_id entry in Firebase config file") );
+					goto android_dialog_cleanup2;
+				}
+				*contentsOther3 = 0;
+
+				// look for the package_name for this mobilesdk_app_id
+				gchar* contentsOther4 = strstr( contentsOther3+1, "\"package_name\": \"" );
+				if ( !contentsOther4 )
+				{
+					SHOW_ERR( _("Could not find package_name for mobilesdk_app_id entry in Firebase config file") );
+					goto android_dialog_cleanup2;
+				}
+				contentsOther4 += strlen("\"package_name\": \"");
+				if ( strncmp( contentsOther4, package_name, strlen(package_name) ) == 0 )
+				{
+					contentsOther4 += strlen(package_name);
+					if ( *contentsOther4 == '\"' ) 
+					{
+						break;
+					}
+				}
+
+				*contentsOther3 = '"'; // repair file
+			}
+			
+			if ( !contentsOther2 || !*contentsOther2 )
+			{
+				SHOW_ERR1( _("Could not find mobilesdk_app_id for android package_name \"%s\" in the Firebase config file"), package_name );
+				goto android_dialog_cleanup2;
+			}
+
+			// find entry in newcontents2
+			contents2 = strstr( newcontents2, "<string name=\"google_app_id\" translatable=\"false\"" );
 			if ( !contents2 )
 			{
-				SHOW_ERR( _("Could not find snap_chat_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find google_app_id entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
-			contents2 += strlen("<string name=\"snap_chat_id\"");
+			contents2 += strlen("<string name=\"google_app_id\" translatable=\"false\"");
 			*contents2 = 0;
 			contents3 = contents2;
 			contents3++;
 			contents3 = strstr( contents3, "</string>" );
 			if ( !contents3 )
 			{
-				SHOW_ERR( _("Could not find end of snap_chat_id entry in values.xml file") );
+				SHOW_ERR( _("Could not find end of google_app_id entry in values.xml file") );
 				goto android_dialog_cleanup2;
 			}
 
 			// write resources file
 			strcpy( newcontents, newcontents2 );
 			strcat( newcontents, ">" );
-			strcat( newcontents, snapchat_client_id );
+			strcat( newcontents, contentsOther2 );
 			strcat( newcontents, contents3 );
 
-			// repair original file
-			*contents2 = '>';
+			*contents2 = '>'; // repair file
+			*contentsOther3 = '"'; // repair file
+			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
 		}
 
-		// firebase
-		if ( firebase_config && *firebase_config && (isGoogle || isAmazon) ) // Google and Amazon only
+		// find current_key value
 		{
-			// read json values
-			if ( !g_file_get_contents( firebase_config, &contentsOther, &resLength, &error ) )
+			contentsOther2 = strstr( contentsOther, "\"current_key\": \"" );
+			if ( !contentsOther2 )
 			{
-				SHOW_ERR1( _("Failed to read firebase config file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
+				SHOW_ERR( _("Could not find current_key entry in Firebase config file") );
 				goto android_dialog_cleanup2;
 			}
 
-			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-
-			// find project_number value
+			contentsOther2 += strlen("\"current_key\": \"");
+			contentsOther3 = strstr( contentsOther2, "\"" );
+			if ( !contentsOther3 )
 			{
-				contentsOther2 = strstr( contentsOther, "\"project_number\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find project_number entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
+				SHOW_ERR( _("Could not find end of current_key entry in Firebase config file") );
+				goto android_dialog_cleanup2;
+			}
+			*contentsOther3 = 0;
 
-				contentsOther2 += strlen("\"project_number\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of project_number entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+			// find entry in newcontents2
+			contents2 = strstr( newcontents2, "<string name=\"google_api_key\" translatable=\"false\"" );
+			if ( !contents2 )
+			{
+				SHOW_ERR( _("Could not find google_api_key entry in values.xml file") );
+				goto android_dialog_cleanup2;
+			}
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"gcm_defaultSenderId\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find gcm_defaultSenderId entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+			contents2 += strlen("<string name=\"google_api_key\" translatable=\"false\"");
+			*contents2 = 0;
+			contents3 = contents2;
+			contents3++;
+			contents3 = strstr( contents3, "</string>" );
+			if ( !contents3 )
+			{
+				SHOW_ERR( _("Could not find end of google_api_key entry in values.xml file") );
+				goto android_dialog_cleanup2;
+			}
 
-				contents2 += strlen("<string name=\"gcm_defaultSenderId\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of gcm_defaultSenderId entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+			// write resources file
+			strcpy( newcontents, newcontents2 );
+			strcat( newcontents, ">" );
+			strcat( newcontents, contentsOther2 );
+			strcat( newcontents, contents3 );
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+			*contents2 = '>'; // repair file
+			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
-			
-			// find firebase_url value
+			// also copy it to google_crash_reporting_api_key
+			contents2 = strstr( newcontents2, "<string name=\"google_crash_reporting_api_key\" translatable=\"false\"" );
+			if ( !contents2 )
 			{
-				contentsOther2 = strstr( contentsOther, "\"firebase_url\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find firebase_url entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-
-				contentsOther2 += strlen("\"firebase_url\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of firebase_url entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+				SHOW_ERR( _("Could not find google_crash_reporting_api_key entry in values.xml file") );
+				goto android_dialog_cleanup2;
+			}
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"firebase_database_url\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find firebase_database_url entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+			contents2 += strlen("<string name=\"google_crash_reporting_api_key\" translatable=\"false\"");
+			*contents2 = 0;
+			contents3 = contents2;
+			contents3++;
+			contents3 = strstr( contents3, "</string>" );
+			if ( !contents3 )
+			{
+				SHOW_ERR( _("Could not find end of google_crash_reporting_api_key entry in values.xml file") );
+				goto android_dialog_cleanup2;
+			}
 
-				contents2 += strlen("<string name=\"firebase_database_url\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of firebase_database_url entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+			// write resources file
+			strcpy( newcontents, newcontents2 );
+			strcat( newcontents, ">" );
+			strcat( newcontents, contentsOther2 );
+			strcat( newcontents, contents3 );
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+			*contents2 = '>'; // repair file
+			*contentsOther3 = '"'; // repair file
+			memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		}
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+		if ( contentsOther ) g_free(contentsOther);
+		contentsOther = 0;
+	}
 
-			// find mobilesdk_app_id value
-			// if the config file contains multiple Android apps then there will be multiple mobilesdk_app_id's, and only the corect one will work
-			// look for the corresponding package_name that matches this export
-			{
-				package_count = 0;
-				contentsOther2 = contentsOther;
-				while( *contentsOther2 && (contentsOther2 = strstr( contentsOther2, "\"mobilesdk_app_id\": \"" )) )
-				{
-					package_count++;
-					contentsOther2 += strlen("\"mobilesdk_app_id\": \"");
-					contentsOther3 = strstr( contentsOther2, "\"" );
-					if ( !contentsOther3 )
-					{
-						SHOW_ERR( _("Could not find end of mobilesdk_app_id entry in Firebase config file") );
-						goto android_dialog_cleanup2;
-					}
-					*contentsOther3 = 0;
+	if ( !g_file_set_contents( resources_file, newcontents, strlen(newcontents), &error ) )
+	{
+		SHOW_ERR1( _("Failed to write resource values.xml file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
 
-					// look for the package_name for this mobilesdk_app_id
-					gchar* contentsOther4 = strstr( contentsOther3+1, "\"package_name\": \"" );
-					if ( !contentsOther4 )
-					{
-						SHOW_ERR( _("Could not find package_name for mobilesdk_app_id entry in Firebase config file") );
-						goto android_dialog_cleanup2;
-					}
-					contentsOther4 += strlen("\"package_name\": \"");
-					if ( strncmp( contentsOther4, package_name, strlen(package_name) ) == 0 )
-					{
-						contentsOther4 += strlen(package_name);
-						if ( *contentsOther4 == '\"' ) 
-						{
-							break;
-						}
-					}
+	if ( contents ) g_free(contents);
+	contents = 0;
 
-					*contentsOther3 = '"'; // repair file
-				}
-				
-				if ( !contentsOther2 || !*contentsOther2 )
-				{
-					SHOW_ERR1( _("Could not find mobilesdk_app_id for android package_name \"%s\" in the Firebase config file"), package_name );
-					goto android_dialog_cleanup2;
-				}
+	export_job_set_stage( job, _("Compiling resources") );
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"google_app_id\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_app_id entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	// start packaging app
+	aaptcommand = g_new0( gchar*, 1000000 );
+	if ( !g_file_test( path_to_aapt2, G_FILE_TEST_EXISTS ) )
+	{
+		SHOW_ERR( _("Failed to export project, AAPT2 program not found") );
+		goto android_dialog_cleanup2;
+	}
 
-				contents2 += strlen("<string name=\"google_app_id\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_app_id entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	argv = g_new0(gchar *, 3);
+	argv[0] = g_strdup(path_to_aapt2);
+	argv[1] = g_strdup("m"); // open for stdin commands
+	argv[2] = NULL;
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+	GPollFD aapt2_in = { -1, G_IO_OUT | G_IO_ERR, 0 };
+	if (! g_spawn_async_with_pipes(tmp_folder, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &aapt2_pid, 
+								   &aapt2_in.fd, NULL, NULL, &error))
+	{
+		SHOW_ERR1("g_spawn_async() failed: %s", error->message);
+		g_error_free(error);
+		error = NULL;
+		goto android_dialog_cleanup2;
+	}
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+	if ( aapt2_pid == 0 )
+	{
+		SHOW_ERR( _("Failed to start packaging tool") );
+		goto android_dialog_cleanup2;
+	}
 
-			// find current_key value
-			{
-				contentsOther2 = strstr( contentsOther, "\"current_key\": \"" );
-				if ( !contentsOther2 )
-				{
-					SHOW_ERR( _("Could not find current_key entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
+	g_strfreev(argv);
+	argv = 0;
 
-				contentsOther2 += strlen("\"current_key\": \"");
-				contentsOther3 = strstr( contentsOther2, "\"" );
-				if ( !contentsOther3 )
-				{
-					SHOW_ERR( _("Could not find end of current_key entry in Firebase config file") );
-					goto android_dialog_cleanup2;
-				}
-				*contentsOther3 = 0;
+	android_res_compiler_init( &res_compiler, aapt2_in.fd, tmp_folder, data->project_base_path, path_to_aapt2 );
 
-				// find entry in newcontents2
-				contents2 = strstr( newcontents2, "<string name=\"google_api_key\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	// compile values.xml file
+	android_aapt2_compile_res( &res_compiler, "values", "values.xml" );
 
-				contents2 += strlen("<string name=\"google_api_key\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+	if ( error )
+	{
+		g_error_free(error);
+		error = NULL;
+	}
+
+	// generated icons are kept between exports, they only change when the source image does
+	icon_cache_folder = g_build_path( "/", data->project_base_path, "build_cache", "icons", NULL );
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+	// Adaptive icon
+	if ( !app_icon_new || !*app_icon_new || isOuya )
+	{
+		
+		gchar* nicon_file = g_build_path( "/", tmp_folder, "resMerged", "mipmap-anydpi-v26_ic_launcher.xml.flat", NULL );
+		g_unlink( nicon_file );
+		g_free( nicon_file );
+	}
+	else
+	{
+		const char* szMipmapFolder[] = { "mipmap-xxxhdpi", "mipmap-xxhdpi", "mipmap-xhdpi", "mipmap-hdpi", "mipmap-mdpi" };
+		int iIconSize[] = { 432, 324, 216, 162, 108 };
+		const char* szMainIcon = "ic_launcher_foreground.png";
 
-				*contents2 = '>'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
+		int numIcons = sizeof(szMipmapFolder) / sizeof(const char*);
+		int i;
 
-				// also copy it to google_crash_reporting_api_key
-				contents2 = strstr( newcontents2, "<string name=\"google_crash_reporting_api_key\" translatable=\"false\"" );
-				if ( !contents2 )
-				{
-					SHOW_ERR( _("Could not find google_crash_reporting_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+		icon_set = utils_icon_set_new( icon_cache_folder );
+		for( i = 0; i < numIcons; i++ )
+			android_icon_set_add( icon_set, tmp_folder, szMipmapFolder[i], szMainIcon, iIconSize[i], iIconSize[i] );
 
-				contents2 += strlen("<string name=\"google_crash_reporting_api_key\" translatable=\"false\"");
-				*contents2 = 0;
-				contents3 = contents2;
-				contents3++;
-				contents3 = strstr( contents3, "</string>" );
-				if ( !contents3 )
-				{
-					SHOW_ERR( _("Could not find end of google_crash_reporting_api_key entry in values.xml file") );
-					goto android_dialog_cleanup2;
-				}
+		if ( !utils_icon_set_write( icon_set, app_icon_new, &error ) )
+		{
+			SHOW_ERR1( _("Failed to create adaptive icon: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
 
-				// write resources file
-				strcpy( newcontents, newcontents2 );
-				strcat( newcontents, ">" );
-				strcat( newcontents, contentsOther2 );
-				strcat( newcontents, contents3 );
+		for( i = 0; i < numIcons; i++ )
+			android_aapt2_compile_res( &res_compiler, szMipmapFolder[i], szMainIcon );
+	}
+	
+	// load icon file
+	if ( app_icon && *app_icon )
+	{
+		const gchar* szDrawable_xhdpi = (isOuya) ? "drawable-xhdpi-v4" : "mipmap-xhdpi";
+		const gchar* szDrawable_hdpi = (isOuya) ? "drawable-hdpi-v4" : "mipmap-hdpi";
+		const gchar* szDrawable_mdpi = (isOuya) ? "drawable-mdpi-v4" : "mipmap-mdpi";
+		const gchar* szDrawable_ldpi = (isOuya) ? "drawable-ldpi-v4" : "mipmap-ldpi";
 
-				*contents2 = '>'; // repair file
-				*contentsOther3 = '"'; // repair file
-				memcpy( newcontents2, newcontents, AGK_NEW_CONTENTS_SIZE );
-			}
+		const gchar* szMainIcon = (isOuya) ? "app_icon.png" : "ic_launcher.png";
 
-			if ( contentsOther ) g_free(contentsOther);
-			contentsOther = 0;
+		// scale it and save it
+		icon_set = utils_icon_set_new( icon_cache_folder );
+		if ( isGoogle || isAmazon )
+		{
+			android_icon_set_add( icon_set, tmp_folder, "mipmap-xxxhdpi", "ic_launcher.png", 192, 192 );
+			android_icon_set_add( icon_set, tmp_folder, "mipmap-xxhdpi", "ic_launcher.png", 144, 144 );
 		}
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_xhdpi, szMainIcon, 96, 96 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_hdpi, szMainIcon, 72, 72 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_mdpi, szMainIcon, 48, 48 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_ldpi, szMainIcon, 36, 36 );
 
-		if ( !g_file_set_contents( resources_file, newcontents, strlen(newcontents), &error ) )
+		if ( !utils_icon_set_write( icon_set, app_icon, &error ) )
 		{
-			SHOW_ERR1( _("Failed to write resource values.xml file: %s"), error->message );
+			SHOW_ERR1( _("Failed to create app icon: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto android_dialog_cleanup2;
 		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
 
-		if ( contents ) g_free(contents);
-		contents = 0;
-
-		// start packaging app
-		gchar *aaptcommand = g_new0( gchar*, 1000000 );
-		if ( !g_file_test( path_to_aapt2, G_FILE_TEST_EXISTS ) )
+		if ( isGoogle || isAmazon )
 		{
-			SHOW_ERR( _("Failed to export project, AAPT2 program not found") );
+			android_aapt2_compile_res( &res_compiler, "mipmap-xxxhdpi", "ic_launcher.png" );
+			android_aapt2_compile_res( &res_compiler, "mipmap-xxhdpi", "ic_launcher.png" );
+		}
+		android_aapt2_compile_res( &res_compiler, szDrawable_xhdpi, szMainIcon );
+		android_aapt2_compile_res( &res_compiler, szDrawable_hdpi, szMainIcon );
+		android_aapt2_compile_res( &res_compiler, szDrawable_mdpi, szMainIcon );
+		android_aapt2_compile_res( &res_compiler, szDrawable_ldpi, szMainIcon );
+	}
+
+	// load notification icon file
+	if ( notif_icon && *notif_icon && (isGoogle || isAmazon) )
+	{
+		const gchar* szDrawable_xhdpi = (isOuya) ? "drawable-xhdpi-v4" : "drawable-xhdpi";
+		const gchar* szDrawable_hdpi = (isOuya) ? "drawable-hdpi-v4" : "drawable-hdpi";
+		const gchar* szDrawable_mdpi = (isOuya) ? "drawable-mdpi-v4" : "drawable-mdpi";
+		const gchar* szDrawable_ldpi = (isOuya) ? "drawable-ldpi-v4" : "drawable-ldpi";
+
+		// scale it and save it
+		icon_set = utils_icon_set_new( icon_cache_folder );
+		android_icon_set_add( icon_set, tmp_folder, "drawable-xxxhdpi", "icon_white.png", 96, 96 );
+		android_icon_set_add( icon_set, tmp_folder, "drawable-xxhdpi", "icon_white.png", 72, 72 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_xhdpi, "icon_white.png", 48, 48 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_hdpi, "icon_white.png", 36, 36 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_mdpi, "icon_white.png", 24, 24 );
+		android_icon_set_add( icon_set, tmp_folder, szDrawable_ldpi, "icon_white.png", 24, 24 );
+
+		if ( !utils_icon_set_write( icon_set, notif_icon, &error ) )
+		{
+			SHOW_ERR1( _("Failed to create notification icon: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
 			goto android_dialog_cleanup2;
 		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
 
-		argv = g_new0(gchar *, 3);
-		argv[0] = g_strdup(path_to_aapt2);
-		argv[1] = g_strdup("m"); // open for stdin commands
-		argv[2] = NULL;
+		android_aapt2_compile_res( &res_compiler, "drawable-xxxhdpi", "icon_white.png" );
+		android_aapt2_compile_res( &res_compiler, "drawable-xxhdpi", "icon_white.png" );
+		android_aapt2_compile_res( &res_compiler, szDrawable_xhdpi, "icon_white.png" );
+		android_aapt2_compile_res( &res_compiler, szDrawable_hdpi, "icon_white.png" );
+		android_aapt2_compile_res( &res_compiler, szDrawable_mdpi, "icon_white.png" );
+		android_aapt2_compile_res( &res_compiler, szDrawable_ldpi, "icon_white.png" );
+	}
 
-		GPid aapt2_pid = 0;
-		GPollFD aapt2_in = { -1, G_IO_OUT | G_IO_ERR, 0 };
-		if (! g_spawn_async_with_pipes(tmp_folder, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL | G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, &aapt2_pid, 
-									   &aapt2_in.fd, NULL, NULL, &error))
+	// load ouya icon and check size
+	if ( isOuya && ouya_icon && *ouya_icon )
+	{
+		gint ouya_width = 0;
+		gint ouya_height = 0;
+
+		if ( !gdk_pixbuf_get_file_info( ouya_icon, &ouya_width, &ouya_height ) )
 		{
-			SHOW_ERR1("g_spawn_async() failed: %s", error->message);
-			g_error_free(error);
-			error = NULL;
+			SHOW_ERR1( _("Failed to load Ouya large icon: %s"), ouya_icon );
 			goto android_dialog_cleanup2;
 		}
 
-		if ( aapt2_pid == 0 )
+		if ( ouya_width != 732 || ouya_height != 412 )
 		{
-			SHOW_ERR( _("Failed to start packaging tool") );
+			SHOW_ERR( _("Ouya large icon must be 732x412 pixels") );
 			goto android_dialog_cleanup2;
 		}
 
-		g_strfreev(argv);
-		argv = 0;
+		// copy it to the res folder
+		image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xhdpi-v4", "ouya_icon.png", NULL );
+		utils_copy_file( ouya_icon, image_filename, TRUE, NULL );
+		g_free( image_filename );
+		image_filename = NULL;
 
-		// compile values.xml file
-	#ifdef G_OS_WIN32
-		strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\values\\values.xml\n\n" );
-	#else
-		strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/values/values.xml\n\n" );
-	#endif
-		write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		android_aapt2_compile_res( &res_compiler, "drawable-xhdpi-v4", "ouya_icon.png" );
 
-		if ( error )
+		// 320x180
+		icon_set = utils_icon_set_new( icon_cache_folder );
+		android_icon_set_add( icon_set, tmp_folder, "drawable", "icon.png", 320, 180 );
+		if ( !utils_icon_set_write( icon_set, ouya_icon, &error ) )
 		{
+			SHOW_ERR1( _("Failed to save lean back icon: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
+			goto android_dialog_cleanup2;
 		}
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
+
+		android_aapt2_compile_res( &res_compiler, "drawable", "icon.png" );
+	}
+
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
+	export_job_set_stage( job, _("Linking resources") );
+	
+	strcpy( aaptcommand, "l\n-I\n" );
+	strcat( aaptcommand, path_to_android_jar );
+	strcat( aaptcommand, "\n--manifest\n" );
+	strcat( aaptcommand, tmp_folder );
+	strcat( aaptcommand, "/AndroidManifest.xml\n-o\n" );
+	strcat( aaptcommand, output_file );
+	strcat( aaptcommand, "\n--auto-add-overlay\n--no-version-vectors\n" );
+
+	if ( isBundle )
+	{
+		strcat( aaptcommand, "--proto-format\n" );
+	}
 
-		// Adaptive icon
-		if ( !app_icon_new || !*app_icon_new || isOuya )
+	gchar* resMergedPath = g_build_filename( tmp_folder, "resMerged", NULL );
+	GDir *dir = g_dir_open(resMergedPath, 0, NULL);
+	
+	const gchar *filename;
+	foreach_dir(filename, dir)
+	{
+		gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged", filename, NULL );
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
 		{
-			
-			gchar* nicon_file = g_build_path( "/", tmp_folder, "resMerged", "mipmap-anydpi-v26_ic_launcher.xml.flat", NULL );
-			g_unlink( nicon_file );
-			g_free( nicon_file );
+			strcat( aaptcommand, "-R\n" );
+			strcat( aaptcommand, fullsrcpath );
+			strcat( aaptcommand, "\n" );
 		}
-		else
-		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( app_icon_new, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load image icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
 
-			const char* szMipmapFolder[] = { "mipmap-xxxhdpi", "mipmap-xxhdpi", "mipmap-xhdpi", "mipmap-hdpi", "mipmap-mdpi" };
-			int iIconSize[] = { 432, 324, 216, 162, 108 };
-			const char* szMainIcon = "ic_launcher_foreground.png";
-			char tmp_path[1024];
+		g_free(fullsrcpath);
+	}
 
-			int numIcons = sizeof(szMipmapFolder) / sizeof(const char*);
-			int i;
-			for( i = 0; i < numIcons; i++ )
-			{
-				image_filename = g_build_path( "/", tmp_folder, "resOrig", szMipmapFolder[i], szMainIcon, NULL );
-				icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, iIconSize[i], iIconSize[i], GDK_INTERP_HYPER );
-				make_path( image_filename );
-				if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-				{
-					SHOW_ERR1( _("Failed to save icon: %s"), error->message );
-					g_error_free(error);
-					error = NULL;
-					goto android_dialog_cleanup2;
-				}
-				gdk_pixbuf_unref( icon_scaled_image );
-				g_free( image_filename );
-				image_filename = NULL;
+	g_dir_close(dir);
+	g_free( resMergedPath );
 
-			#ifdef G_OS_WIN32
-				sprintf(tmp_path, "compile\n-o\nresMerged\nresOrig\\%s\\%s\n\n", szMipmapFolder[i], szMainIcon );
-			#else
-				sprintf(tmp_path, "compile\n-o\nresMerged\nresOrig/%s/%s\n\n", szMipmapFolder[i], szMainIcon );
-			#endif
-				strcpy( aaptcommand, tmp_path );
-				write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-			}
+	/*
+	gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged\\values_values.arsc.flat", NULL );
+	strcat( aaptcommand, "-R\n" );
+	strcat( aaptcommand, fullsrcpath );
+	strcat( aaptcommand, "\n" );
+	g_free(fullsrcpath);
+	*/
+
+	strcat( aaptcommand, "\nquit\n\n" );
+
+#ifdef G_OS_WIN32
+	gchar *ptr = aaptcommand;
+	while( *ptr )
+	{
+		if ( *ptr == '/' ) *ptr = '\\';
+		ptr++;
+	}
+#endif
+
+	//gchar* logpath = g_build_filename( tmp_folder, "log.txt", NULL );
+	//FILE *pFile = fopen( logpath, "wb" );
+	//fputs( aaptcommand, pFile );
+	//fclose( pFile );
+
+	write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+
+#ifdef G_OS_WIN32
+	WaitForProcess( aapt2_pid );
+	aapt2_ok = win32_get_exit_status( aapt2_pid );
+#else
+	aapt2_ok = waitpid( aapt2_pid, &status, 0 ) == aapt2_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+	aapt2_pid = 0;
+
+	// a failed run can leave partial .flat files behind, and the daemon carries on after a resource fails
+	// to compile, so only cache them when aapt2 succeeded and the link produced its output
+	if ( aapt2_ok && g_file_test( output_file, G_FILE_TEST_EXISTS ) )
+		android_res_compiler_store( &res_compiler );
+
+	// if we have previously called g_spawn_async then g_spawn_sync will never return the correct exit status due to ECHILD being returned from waitpid()
+	
+	// check the file was created instead
+	if ( !g_file_test( output_file, G_FILE_TEST_EXISTS ) )
+	{
+		SHOW_ERR( _("Failed to write output files, check that your project directory is not in a write protected location") );
+		goto android_dialog_cleanup2;
+	}
+	
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
+	export_job_set_stage( job, _("Packaging") );
+
+	g_rename( output_file, output_file_zip );
+
+	if ( isBundle )
+	{
+		// need to extract and recreate zip file to move AndroidManifest.xml file
+		mz_zip_archive zip_archive;
+		memset(&zip_archive, 0, sizeof(zip_archive));
+		if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
+		{
+			mz_zip_reader_end( &zip_archive );
+			SHOW_ERR( "Failed to open output zip file" );
+			goto android_dialog_cleanup2;
 		}
-		
-		// load icon file
-		if ( app_icon && *app_icon )
+
+		gchar* bundle_folder = export_job_get_folder( job, data->project_base_path, "build_bundle" );
+		utils_str_replace_char( bundle_folder, '\\', '/' );
+		utils_remove_folder_recursive( bundle_folder );
+
+		int numFiles = mz_zip_reader_get_num_files( &zip_archive );
+		char filename[ 1024 ];
+		int i;
+		for( i = 0; i < numFiles; i++ )
 		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( app_icon, &error );
-			if ( !icon_image || error )
+			mz_zip_reader_get_filename( &zip_archive, i, filename, 1024 );
+			gchar* final_path = g_build_path( "/", bundle_folder, filename, NULL );
+			
+			if ( mz_zip_reader_is_file_a_directory( &zip_archive, i ) ) 
 			{
-				SHOW_ERR1( _("Failed to load image icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
+				if ( !g_file_test( final_path, G_FILE_TEST_EXISTS ) ) 
+				{
+					if ( g_mkdir_with_parents( final_path, 0755 ) < 0 )
+					{
+						SHOW_ERR( "Failed to create folder in the projects directory" );
+						mz_zip_reader_end( &zip_archive );
+						g_free(bundle_folder);
+						g_free(final_path);
+						goto android_dialog_cleanup2;
+					}
+				}
+				g_free(final_path);
+				continue;
 			}
-
-			// scale it and save it
-			if ( isGoogle || isAmazon )
+        
+			char* withoutFile = (char*)malloc( strlen(final_path)+1 );
+			strcpy( withoutFile, final_path );
+			char *szSlash = strrchr( withoutFile, '/' );
+			if ( szSlash ) *szSlash = 0;
+        
+			// create directory
+			if ( !g_file_test( withoutFile, G_FILE_TEST_EXISTS ) ) 
 			{
-				// 192x192
-				image_filename = g_build_path( "/", tmp_folder, "resOrig", "mipmap-xxxhdpi", "ic_launcher.png", NULL );
-				icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 192, 192, GDK_INTERP_HYPER );
-				make_path( image_filename );
-				if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
+				if ( g_mkdir_with_parents( withoutFile, 0755 ) < 0 )
 				{
-					SHOW_ERR1( _("Failed to save icon: %s"), error->message );
-					g_error_free(error);
-					error = NULL;
+					SHOW_ERR( "Failed to create folder in the projects directory" );
+					mz_zip_reader_end( &zip_archive );
+					g_free(bundle_folder);
+					g_free(final_path);
+					g_free(withoutFile);
 					goto android_dialog_cleanup2;
 				}
-				gdk_pixbuf_unref( icon_scaled_image );
-				g_free( image_filename );
-
-			#ifdef G_OS_WIN32
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\mipmap-xxxhdpi\\ic_launcher.png\n\n" );
-			#else
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/mipmap-xxxhdpi/ic_launcher.png\n\n" );
-			#endif
-				write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+			}
+        
+			free(withoutFile);
+        
+			mz_zip_reader_extract_to_file( &zip_archive, i, final_path, 0 );
+        
+			g_free(final_path);
+		}
+    
+		mz_zip_reader_end( &zip_archive );
+					
+		// move manifest
+		gchar* old_manifest_path = g_build_path( "/", bundle_folder, "AndroidManifest.xml", NULL );
+		gchar* new_manifest_path = g_build_path( "/", bundle_folder, "manifest", "AndroidManifest.xml", NULL );
+		
+		gchar *contents = 0;
+		gsize length = 0;
 
-				// 144x144
-				image_filename = g_build_path( "/", tmp_folder, "resOrig", "mipmap-xxhdpi", "ic_launcher.png", NULL );
-				icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 144, 144, GDK_INTERP_HYPER );
-				make_path( image_filename );
-				if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-				{
-					SHOW_ERR1( _("Failed to save icon: %s"), error->message );
-					g_error_free(error);
-					error = NULL;
-					goto android_dialog_cleanup2;
-				}
-				gdk_pixbuf_unref( icon_scaled_image );
-				g_free( image_filename );
+		if ( !g_file_get_contents( old_manifest_path, &contents, &length, NULL ) )
+		{
+			SHOW_ERR1( "Failed to read manifest file at %s", old_manifest_path );
+			g_free(bundle_folder);
+			g_free(new_manifest_path);
+			g_free(old_manifest_path);
+			goto android_dialog_cleanup2;
+		}
 
-			#ifdef G_OS_WIN32
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\mipmap-xxhdpi\\ic_launcher.png\n\n" );
-			#else
-				strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/mipmap-xxhdpi/ic_launcher.png\n\n" );
-			#endif
-				write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-			}
+		gchar* new_manifest_folder = g_build_path( "/", bundle_folder, "manifest", NULL );
+		g_mkdir_with_parents( new_manifest_folder, 0755 );
+		g_free( new_manifest_folder );
 
-			const gchar* szDrawable_xhdpi = (isOuya) ? "drawable-xhdpi-v4" : "mipmap-xhdpi";
-			const gchar* szDrawable_hdpi = (isOuya) ? "drawable-hdpi-v4" : "mipmap-hdpi";
-			const gchar* szDrawable_mdpi = (isOuya) ? "drawable-mdpi-v4" : "mipmap-mdpi";
-			const gchar* szDrawable_ldpi = (isOuya) ? "drawable-ldpi-v4" : "mipmap-ldpi";
+		if ( !g_file_set_contents( new_manifest_path, contents, length, NULL ) )
+		{
+			SHOW_ERR1( "Failed to write manifest file at %s", new_manifest_path );
+			g_free(contents);
+			g_free(bundle_folder);
+			g_free(new_manifest_path);
+			g_free(old_manifest_path);
+			goto android_dialog_cleanup2;
+		}
 
-			const gchar* szMainIcon = (isOuya) ? "app_icon.png" : "ic_launcher.png";
-			
-			// 96x96
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_xhdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 96, 96, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+		g_free(contents);
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_xhdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_xhdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		g_unlink( old_manifest_path );
 
-			// 72x72
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_hdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 72, 72, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save hdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+		g_free(new_manifest_path);
+		g_free(old_manifest_path);
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_hdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_hdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		g_unlink( output_file_zip );
 
-			// 48x48
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_mdpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 48, 48, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save mdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+		// zip everything back up
+		memset(&zip_archive, 0, sizeof(zip_archive));
+		if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+		{
+			SHOW_ERR( _("Failed to initialise zip file for writing") );
+			g_free(bundle_folder);
+			goto android_dialog_cleanup2;
+		}
+	
+		if ( !utils_add_folder_to_zip_parallel( &zip_archive, bundle_folder, "", TRUE, TRUE, data->zip_policy ) )
+		{
+			SHOW_ERR( _("Failed to add files to zip file") );
+			g_free(bundle_folder);
+			goto android_dialog_cleanup2;
+		}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_mdpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_mdpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+		{
+			SHOW_ERR( _("Failed to finalize zip file") );
+			g_free(bundle_folder);
+			goto android_dialog_cleanup2;
+		}
+		if ( !mz_zip_writer_end( &zip_archive ) )
+		{
+			SHOW_ERR( _("Failed to end zip file") );
+			g_free(bundle_folder);
+			goto android_dialog_cleanup2;
+		}
 
-			// 36x36
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_ldpi, szMainIcon, NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 36, 36, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save ldpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
+		// remove temp folder
+		utils_remove_folder_recursive( bundle_folder );
+		g_free(bundle_folder);
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_ldpi ); strcat( aaptcommand, "\\" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_ldpi ); strcat( aaptcommand, "/" );
-			strcat( aaptcommand, szMainIcon ); strcat( aaptcommand, "\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	if ( isBundle )
+	{
+		// open APK as a zip file
+		if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
+		{
+			SHOW_ERR( _("Failed to initialise zip file for reading") );
+			goto android_dialog_cleanup2;
+		}
+		if ( !mz_zip_writer_init_from_reader( &zip_archive, output_file_zip ) )
+		{
+			SHOW_ERR( _("Failed to open zip file for writing") );
+			goto android_dialog_cleanup2;
+		}
+	}
+	else
+	{
+		// copy the linked resources into a new APK with their data aligned, the rest is aligned as
+		// it is added, so the APK can be signed as it is without running zipalign
+		mz_zip_archive linked_archive;
+		mz_uint num_files;
+		mz_uint i;
 
-			g_free( image_filename );
-			image_filename = NULL;
+		linked_file = g_strconcat( output_file_zip, ".linked", NULL );
+		g_unlink( linked_file );
+		if ( g_rename( output_file_zip, linked_file ) != 0 )
+		{
+			SHOW_ERR( _("Failed to initialise zip file for reading") );
+			goto android_dialog_cleanup2;
 		}
 
-		// load notification icon file
-		if ( notif_icon && *notif_icon && (isGoogle || isAmazon) )
+		memset(&linked_archive, 0, sizeof(linked_archive));
+		if ( !mz_zip_reader_init_file( &linked_archive, linked_file, 0 ) )
 		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( notif_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load notification icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+			SHOW_ERR( _("Failed to initialise zip file for reading") );
+			goto android_dialog_cleanup2;
+		}
+		if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+		{
+			mz_zip_reader_end( &linked_archive );
+			SHOW_ERR( _("Failed to open zip file for writing") );
+			goto android_dialog_cleanup2;
+		}
 
-			// scale it and save it
-			// 96x96
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxxhdpi", "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 96, 96, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
+		num_files = mz_zip_reader_get_num_files( &linked_archive );
+		for ( i = 0; i < num_files; i++ )
+		{
+			char filename[1024];
+			mz_zip_reader_get_filename( &linked_archive, i, filename, 1024 );
+			if ( !mz_zip_writer_add_from_zip_reader_v2( &zip_archive, &linked_archive, i, utils_zip_get_apk_alignment(filename) ) )
 			{
-				SHOW_ERR1( _("Failed to save xxxhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
+				mz_zip_reader_end( &linked_archive );
+				mz_zip_writer_end( &zip_archive );
+				SHOW_ERR( _("Failed to add resources to APK") );
 				goto android_dialog_cleanup2;
 			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
-
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxxhdpi\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxxhdpi/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		}
 
-			// 72x72
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xxhdpi", "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 72, 72, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xxhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+		mz_zip_reader_end( &linked_archive );
+		g_unlink( linked_file );
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xxhdpi\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xxhdpi/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-			const gchar* szDrawable_xhdpi = (isOuya) ? "drawable-xhdpi-v4" : "drawable-xhdpi";
-			const gchar* szDrawable_hdpi = (isOuya) ? "drawable-hdpi-v4" : "drawable-hdpi";
-			const gchar* szDrawable_mdpi = (isOuya) ? "drawable-mdpi-v4" : "drawable-mdpi";
-			const gchar* szDrawable_ldpi = (isOuya) ? "drawable-ldpi-v4" : "drawable-ldpi";
-
-			// 48x48
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_xhdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 48, 48, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save xhdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+	// queue the remaining files, they are compressed in parallel and written in this order
+	// compressed entries are kept between exports so unchanged files aren't compressed again,
+	// and other store variants being exported take them from memory instead of the cache
+	zip_packer = utils_zip_packer_new();
+	zip_add_file = g_build_path( "/", data->project_base_path, "build_cache", "zip", NULL );
+	utils_zip_packer_set_cache_folder( zip_packer, zip_add_file );
+	utils_zip_packer_set_progress_func( zip_packer, export_job_zip_progress, job );
+	utils_zip_packer_set_shared( zip_packer, data->zip_shared );
+	utils_zip_packer_set_apk_alignment( zip_packer, !isBundle );
+	utils_zip_packer_set_policy( zip_packer, data->zip_policy );
+	g_free( zip_add_file );
+
+	// copy in extra files
+	zip_add_file = g_build_path( "/", src_folder, "classes.dex", NULL );
+	utils_zip_packer_add_file( zip_packer, zip_add_file, (isBundle) ? "dex/classes.dex" : "classes.dex", 9 );
+
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "classes2.dex", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_file( zip_packer, zip_add_file, (isBundle) ? "dex/classes2.dex" : "classes2.dex", 9 );
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_xhdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_xhdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "classes3.dex", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_file( zip_packer, zip_add_file, (isBundle) ? "dex/classes3.dex" : "classes3.dex", 9 );
+	}
 
-			// 36x36
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_hdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 36, 36, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save hdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+	// copy extra files
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "com", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_folder( zip_packer, zip_add_file, (isBundle) ? "root/com" : "com", TRUE, TRUE );
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_hdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_hdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "kotlin", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_folder( zip_packer, zip_add_file, (isBundle) ? "root/kotlin" : "kotlin", TRUE, TRUE );
+	}
 
-			// 24x24
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_mdpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 24, 24, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save mdpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			g_free( image_filename );
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "okhttp3", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_folder( zip_packer, zip_add_file, (isBundle) ? "root/okhttp3" : "okhttp3", TRUE, TRUE );
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_mdpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_mdpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "extra_root", NULL );
+	if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	{
+		utils_zip_packer_add_folder( zip_packer, zip_add_file, (isBundle) ? "root" : "", TRUE, TRUE );
+	}
+	
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libandroid_player.so", NULL );
+	utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/arm64-v8a/libandroid_player.so", 9 );
+	
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libandroid_player.so", NULL );
+	utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/armeabi-v7a/libandroid_player.so", 9 );
+	
+	if ( arcore_mode > 0 )
+	{
+		// use real ARCore lib
+		g_free( zip_add_file );
+		zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libarcore_sdk.so", NULL );
+		utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/arm64-v8a/libarcore_sdk.so", 9 );
 
-			// 24x24
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", szDrawable_ldpi, "icon_white.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 24, 24, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save ldpi icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
+		g_free( zip_add_file );
+		zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libarcore_sdk.so", NULL );
+		utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/armeabi-v7a/libarcore_sdk.so", 9 );
+	}
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\" ); strcat( aaptcommand, szDrawable_ldpi ); 
-			strcat( aaptcommand, "\\icon_white.png\n\n" );
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/" ); strcat( aaptcommand, szDrawable_ldpi );
-			strcat( aaptcommand, "/icon_white.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	if ( snapchat_client_id && *snapchat_client_id )
+	{
+		g_free( zip_add_file );
+		zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libpruneau.so", NULL );
+		utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/arm64-v8a/libpruneau.so", 9 );
 
-			g_free( image_filename );
-			image_filename = NULL;
+		g_free( zip_add_file );
+		zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libpruneau.so", NULL );
+		utils_zip_packer_add_file( zip_packer, zip_add_file, "lib/armeabi-v7a/libpruneau.so", 9 );
+	}
+	
+	// copy assets
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", src_folder, "assets", NULL );
+	if ( g_file_test (zip_add_file, G_FILE_TEST_EXISTS) )
+	{
+		if ( !utils_zip_packer_add_folder( zip_packer, zip_add_file, "assets", TRUE, TRUE ) )
+		{
+			SHOW_ERR( _("Failed to add media files to APK") );
+			goto android_dialog_cleanup2;
 		}
+	}
+	
+	// copy in media files
+	g_free( zip_add_file );
+	zip_add_file = g_build_path( "/", data->project_base_path, "media", NULL );
+	if ( !utils_zip_packer_add_folder( zip_packer, zip_add_file, "assets/media", TRUE, TRUE ) )
+	{
+		SHOW_ERR( _("Failed to add media files to APK") );
+		goto android_dialog_cleanup2;
+	}
 
-		// load ouya icon and check size
-		if ( isOuya && ouya_icon && *ouya_icon )
-		{
-			if ( icon_image ) gdk_pixbuf_unref(icon_image);
-			icon_image = gdk_pixbuf_new_from_file( ouya_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load Ouya large icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+	if ( !utils_zip_packer_write( zip_packer, &zip_archive ) )
+	{
+		if ( !export_job_is_cancelled(job) ) SHOW_ERR( _("Failed to add files to APK") );
+		goto android_dialog_cleanup2;
+	}
 
-			if ( gdk_pixbuf_get_width( icon_image ) != 732 || gdk_pixbuf_get_height( icon_image ) != 412 )
-			{
-				SHOW_ERR( _("Ouya large icon must be 732x412 pixels") );
-				goto android_dialog_cleanup2;
-			}
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to add finalize zip file") );
+		goto android_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to end zip file") );
+		goto android_dialog_cleanup2;
+	}
 
-			// copy it to the res folder
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable-xhdpi-v4", "ouya_icon.png", NULL );
-			utils_copy_file( ouya_icon, image_filename, TRUE, NULL );
-			g_free( image_filename );
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable-xhdpi-v4\\ouya_icon.png\n\n" ); 
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable-xhdpi-v4/ouya_icon.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+	if ( isBundle )
+	{
+		export_job_set_stage( job, _("Building app bundle") );
 
-			// 320x180
-			image_filename = g_build_path( "/", tmp_folder, "resOrig", "drawable", "icon.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 320, 180, GDK_INTERP_HYPER );
-			make_path( image_filename );
-			if ( !gdk_pixbuf_save( icon_scaled_image, image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save lean back icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
-					
-			gdk_pixbuf_unref( icon_scaled_image );
-			icon_scaled_image = NULL;
+		// run bundletool
+		argv = g_new0( gchar*, 11 );
+		argv[0] = g_strdup( path_to_java );
+		argv[1] = g_strdup( "-jar" );
+		argv[2] = g_strdup( path_to_bundletool );
+		argv[3] = g_strdup( "build-bundle" );
+		argv[4] = g_strdup( "--modules" );
+		argv[5] = g_strdup( output_file_zip );
 
-		#ifdef G_OS_WIN32
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig\\drawable\\icon.png\n\n" ); 
-		#else
-			strcpy( aaptcommand, "compile\n-o\nresMerged\nresOrig/drawable/icon.png\n\n" );
-		#endif
-			write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
+		gchar* mapping_file_path = g_build_path( "/", src_folder, "mapping", "mapping.txt", NULL );
+		if ( g_file_test( mapping_file_path, G_FILE_TEST_EXISTS ) )
+		{
+			argv[6] = g_strdup( "--metadata-file" );
+			argv[7] = g_strconcat( "com.android.tools.build.obfuscation/proguard.map:", mapping_file_path, NULL );
 
-			g_free( image_filename );
-			image_filename = NULL;
-		}
+			/*
+			#ifdef G_OS_WIN32
+				// mike - 031221 - use bundle config file - DOES NOT WORK FOR SOME REASON
+				gchar* bundleConfig = g_build_path ( "/", src_folder, "", "BundleConfig.json", NULL );
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
-		
-		strcpy( aaptcommand, "l\n-I\n" );
-		strcat( aaptcommand, path_to_android_jar );
-		strcat( aaptcommand, "\n--manifest\n" );
-		strcat( aaptcommand, tmp_folder );
-		strcat( aaptcommand, "/AndroidManifest.xml\n-o\n" );
-		strcat( aaptcommand, output_file );
-		strcat( aaptcommand, "\n--auto-add-overlay\n--no-version-vectors\n" );
+				argv [ 8 ] = g_strdup ( "--config" );
+				argv [ 9 ] = g_strdup ( bundleConfig );
+				argv [ 10 ] = g_strdup ( "--output" );
+				argv [ 11 ] = g_strdup ( output_file );
+				argv [ 12 ] = NULL;
+			#else
+				argv[8] = g_strdup( "--output" );
+				argv[9] = g_strdup( output_file );
+				argv[10] = NULL;
+			#endif
+			*/
 
-		if ( isBundle )
+			argv [ 8 ] = g_strdup ( "--output" );
+			argv [ 9 ] = g_strdup ( output_file );
+			argv [ 10 ] = NULL;
+		}
+		else
 		{
-			strcat( aaptcommand, "--proto-format\n" );
+			/*
+			#ifdef G_OS_WIN32
+			// mike - 031221 - use bundle config file - DOES NOT WORK FOR SOME REASON
+				gchar* bundleConfig = g_build_path ( "/", src_folder, "", "BundleConfig.json", NULL );
+
+				argv [ 8 ] = g_strdup ( "--config" );
+				argv [ 9 ] = g_strdup ( bundleConfig );
+				argv [ 10 ] = g_strdup ( "--output" );
+				argv [ 11 ] = g_strdup ( output_file );
+				argv [ 12 ] = NULL;
+			#else
+				argv [ 6 ] = g_strdup ( "--output" );
+				argv [ 7 ] = g_strdup ( output_file );
+				argv [ 8 ] = NULL;
+			#endif
+			*/
+
+			
+			argv [ 6 ] = g_strdup ( "--output" );
+			argv [ 7 ] = g_strdup ( output_file );
+			argv [ 8 ] = NULL;
 		}
 
-		gchar* resMergedPath = g_build_filename( tmp_folder, "resMerged", NULL );
-		GDir *dir = g_dir_open(resMergedPath, 0, NULL);
+		g_free(mapping_file_path);
 		
-		const gchar *filename;
-		foreach_dir(filename, dir)
+		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		{
+			SHOW_ERR1( _("Failed to run bundletool: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+	
+		if ( status != 0 && str_out && *str_out )
 		{
-			gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged", filename, NULL );
+			SHOW_ERR1( _("Failed to run bundletool, (output: %s)"), str_out );
+			goto android_dialog_cleanup2;
+		}
 
-			if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
-			{
-				strcat( aaptcommand, "-R\n" );
-				strcat( aaptcommand, fullsrcpath );
-				strcat( aaptcommand, "\n" );
-			}
+		if ( str_out ) g_free(str_out);
+		str_out = 0;
 
-			g_free(fullsrcpath);
-		}
+		g_strfreev(argv);
+		argv = 0;
 
-		g_dir_close(dir);
-		g_free( resMergedPath );
+		if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
+	}
 
-		/*
-		gchar* fullsrcpath = g_build_filename( tmp_folder, "resMerged\\values_values.arsc.flat", NULL );
-		strcat( aaptcommand, "-R\n" );
-		strcat( aaptcommand, fullsrcpath );
-		strcat( aaptcommand, "\n" );
-		g_free(fullsrcpath);
-		*/
+	export_job_set_stage( job, _("Signing") );
 
-		strcat( aaptcommand, "\nquit\n\n" );
+	int argIndex = 0;
+	if ( isBundle )
+	{
+		// sign bundle
+		argv = g_new0( gchar*, 10 );
+		argv[argIndex++] = g_strdup( path_to_jarsigner );
+		argv[argIndex++] = g_strdup("-storepass");
+#ifdef G_OS_WIN32
+		argv[argIndex++] = g_strconcat( "\"", keystore_password, "\"", NULL );
+#else
+		argv[argIndex++] = g_strdup( keystore_password );
+#endif
+		argv[argIndex++] = g_strdup("-keystore");
+		argv[argIndex++] = g_strdup(keystore_file);
+		argv[argIndex++] = g_strdup(output_file);
+		argv[argIndex++] = g_strdup(alias_name);
+		argv[argIndex++] = g_strdup("-keypass");
+#ifdef G_OS_WIN32
+		argv[argIndex++] = g_strconcat( "\"", alias_password, "\"", NULL );
+#else
+		argv[argIndex++] = g_strdup( alias_password );
+#endif
+		argv[argIndex++] = NULL;
 
-	#ifdef G_OS_WIN32
-		gchar *ptr = aaptcommand;
-		while( *ptr )
+		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
 		{
-			if ( *ptr == '/' ) *ptr = '\\';
-			ptr++;
+			SHOW_ERR1( _("Failed to run signing tool: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
 		}
-	#endif
-
-		//gchar* logpath = g_build_filename( tmp_folder, "log.txt", NULL );
-		//FILE *pFile = fopen( logpath, "wb" );
-		//fputs( aaptcommand, pFile );
-		//fclose( pFile );
-
-		write(aapt2_in.fd, aaptcommand, strlen(aaptcommand) );
-
-	#ifdef G_OS_WIN32
-		WaitForProcess( aapt2_pid );
-	#else
-		waitpid( aapt2_pid, &status, 0 );
-	#endif
-		aapt2_pid = 0;
+	
+		if ( status != 0 && str_out && *str_out && strstr(str_out,"jar signed") == 0 )
+		{
+			SHOW_ERR1( _("Failed to sign APK, is your keystore password and alias correct? (error: %s)"), str_out );
+			goto android_dialog_cleanup2;
+		}
+	}
+	else
+	{
+		// sign the aligned APK with the V1, V2 and V3 schemes in one pass, writing the final APK
+		argv = g_new0( gchar*, 17 );
+		argv[argIndex++] = g_strdup( path_to_java );
+		argv[argIndex++] = g_strdup( "-jar" );
+		argv[argIndex++] = g_strdup( path_to_apksigner );
+		argv[argIndex++] = g_strdup( "sign" );
+		argv[argIndex++] = g_strdup( "--ks" );
+		argv[argIndex++] = g_strdup( keystore_file );
+		argv[argIndex++] = g_strdup( "--ks-pass" );
+#ifdef G_OS_WIN32
+		argv[argIndex++] = g_strconcat( "pass:\"", keystore_password, "\"", NULL );
+#else
+		argv[argIndex++] = g_strconcat( "pass:", keystore_password, NULL );
+#endif
+		argv[argIndex++] = g_strdup( "--ks-key-alias" );
+		argv[argIndex++] = g_strdup( alias_name );
+		argv[argIndex++] = g_strdup( "--key-pass" );
+#ifdef G_OS_WIN32
+		argv[argIndex++] = g_strconcat( "pass:\"", alias_password, "\"", NULL );
+#else
+		argv[argIndex++] = g_strconcat( "pass:", alias_password, NULL );
+#endif
+		argv[argIndex++] = g_strdup( "--out" );
+		argv[argIndex++] = g_strdup( output_file );
+		argv[argIndex++] = g_strdup( output_file_zip );
+		argv[argIndex++] = NULL;
 
-		// if we have previously called g_spawn_async then g_spawn_sync will never return the correct exit status due to ECHILD being returned from waitpid()
-		
-		// check the file was created instead
-		if ( !g_file_test( output_file, G_FILE_TEST_EXISTS ) )
+		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		{
+			SHOW_ERR1( _("Failed to run apksigner tool: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto android_dialog_cleanup2;
+		}
+	
+		if ( status != 0 && str_out && *str_out )
 		{
-			SHOW_ERR( _("Failed to write output files, check that your project directory is not in a write protected location") );
+			SHOW_ERR1( _("Failed to sign APK with apksigner, is your keystore password and alias correct? (error: %s)"), str_out );
 			goto android_dialog_cleanup2;
 		}
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	}
 
-		g_rename( output_file, output_file_zip );
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
 
-		if ( isBundle )
-		{
-			// need to extract and recreate zip file to move AndroidManifest.xml file
-			mz_zip_archive zip_archive;
-			memset(&zip_archive, 0, sizeof(zip_archive));
-			if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
-			{
-				mz_zip_reader_end( &zip_archive );
-				SHOW_ERR( "Failed to open output zip file" );
-				goto android_dialog_cleanup2;
-			}
+	g_strfreev(argv);
+	argv = 0;
 
-			gchar* bundle_folder = g_build_filename( app->project->base_path, "build_bundle", NULL );
-			utils_str_replace_char( bundle_folder, '\\', '/' );
-			utils_remove_folder_recursive( bundle_folder );
+	if ( export_job_is_cancelled(job) ) goto android_dialog_cleanup2;
 
-			int numFiles = mz_zip_reader_get_num_files( &zip_archive );
-			char filename[ 1024 ];
-			int i;
-			for( i = 0; i < numFiles; i++ )
-			{
-				mz_zip_reader_get_filename( &zip_archive, i, filename, 1024 );
-				gchar* final_path = g_build_path( "/", bundle_folder, filename, NULL );
-				
-				if ( mz_zip_reader_is_file_a_directory( &zip_archive, i ) ) 
-				{
-					if ( !g_file_test( final_path, G_FILE_TEST_EXISTS ) ) 
-					{
-						if ( g_mkdir_with_parents( final_path, 0755 ) < 0 )
-						{
-							SHOW_ERR( "Failed to create folder in the projects directory" );
-							mz_zip_reader_end( &zip_archive );
-							g_free(bundle_folder);
-							g_free(final_path);
-							goto android_dialog_cleanup2;
-						}
-					}
-					g_free(final_path);
-					continue;
-				}
-            
-				char* withoutFile = (char*)malloc( strlen(final_path)+1 );
-				strcpy( withoutFile, final_path );
-				char *szSlash = strrchr( withoutFile, '/' );
-				if ( szSlash ) *szSlash = 0;
-            
-				// create directory
-				if ( !g_file_test( withoutFile, G_FILE_TEST_EXISTS ) ) 
-				{
-					if ( g_mkdir_with_parents( withoutFile, 0755 ) < 0 )
-					{
-						SHOW_ERR( "Failed to create folder in the projects directory" );
-						mz_zip_reader_end( &zip_archive );
-						g_free(bundle_folder);
-						g_free(final_path);
-						g_free(withoutFile);
-						goto android_dialog_cleanup2;
-					}
-				}
-            
-				free(withoutFile);
-            
-				mz_zip_reader_extract_to_file( &zip_archive, i, final_path, 0 );
-            
-				g_free(final_path);
-			}
-        
-			mz_zip_reader_end( &zip_archive );
-						
-			// move manifest
-			gchar* old_manifest_path = g_build_path( "/", bundle_folder, "AndroidManifest.xml", NULL );
-			gchar* new_manifest_path = g_build_path( "/", bundle_folder, "manifest", "AndroidManifest.xml", NULL );
-			
-			gchar *contents = 0;
-			gsize length = 0;
+	success = TRUE;
 
-			if ( !g_file_get_contents( old_manifest_path, &contents, &length, NULL ) )
-			{
-				SHOW_ERR1( "Failed to read manifest file at %s", old_manifest_path );
-				g_free(bundle_folder);
-				g_free(new_manifest_path);
-				g_free(old_manifest_path);
-				goto android_dialog_cleanup2;
-			}
+android_dialog_cleanup2:
+
+	if ( aapt2_pid ) 
+	{
+	#ifdef G_OS_WIN32
+		TerminateProcess(aapt2_pid, 0);
+	#else
+		kill(aapt2_pid, SIGTERM);
+	#endif
+	}
+	android_res_compiler_clear( &res_compiler );
+
+	g_unlink( output_file_zip );
+	if ( linked_file )
+	{
+		g_unlink( linked_file );
+		g_free( linked_file );
+	}
+
+	if ( path_to_java ) g_free(path_to_java);
+	if ( path_to_jarsigner ) g_free(path_to_jarsigner);
+	if ( path_to_aapt2 ) g_free(path_to_aapt2);
+	if ( path_to_android_jar ) g_free(path_to_android_jar);
+	if ( path_to_bundletool ) g_free(path_to_bundletool);
+	if ( path_to_apksigner ) g_free(path_to_apksigner);
+
+	if ( zip_add_file ) g_free(zip_add_file);
+	if ( zip_packer ) utils_zip_packer_free(zip_packer);
+	if ( manifest_file ) g_free(manifest_file);
+	if ( newcontents ) g_free(newcontents);
+	if ( newcontents2 ) g_free(newcontents2);
+	if ( contents ) g_free(contents);
+	if ( contentsOther ) g_free(contentsOther);
+	if ( resources_file ) g_free(resources_file);
+	if ( error ) g_error_free(error);
+	if ( icon_set ) utils_icon_set_free(icon_set);
+	if ( icon_cache_folder ) g_free(icon_cache_folder);
+	if ( image_filename ) g_free(image_filename);
+	if ( argv ) g_strfreev(argv);
+	if ( aaptcommand ) g_free(aaptcommand);
+	
+	if ( output_file_zip ) g_free(output_file_zip);
+	if ( tmp_folder ) g_free(tmp_folder);
+	if ( android_folder ) g_free(android_folder);
+	if ( src_folder ) g_free(src_folder);
+	if ( str_out ) g_free(str_out);
+
+	if ( output_file ) g_free(output_file);
+	if ( app_name ) g_free(app_name);
+	if ( package_name ) g_free(package_name);
+	if ( app_icon ) g_free(app_icon);
+	if ( ouya_icon ) g_free(ouya_icon);
+	if ( firebase_config ) g_free(firebase_config);
+	if ( url_scheme ) g_free(url_scheme);
+	if ( deep_link ) g_free(deep_link);
+	if ( google_play_app_id ) g_free(google_play_app_id);
+	if ( admob_app_id ) g_free(admob_app_id);
+	if ( snapchat_client_id ) g_free(snapchat_client_id);
+
+	if ( keystore_file ) g_free(keystore_file);
+	if ( keystore_password ) g_free(keystore_password);
+	if ( version_number ) g_free(version_number);
+	if ( alias_name ) g_free(alias_name);
+	if ( alias_password ) g_free(alias_password);
+
+	if ( app_icon_new ) g_free(app_icon_new);
+	if ( notif_icon ) g_free(notif_icon);
+
+	if ( data->project_base_path ) g_free(data->project_base_path);
+	utils_zip_shared_unref( data->zip_shared );
+	utils_zip_policy_free( data->zip_policy );
+	g_free(data);
 
-			gchar* new_manifest_folder = g_build_path( "/", bundle_folder, "manifest", NULL );
-			g_mkdir_with_parents( new_manifest_folder, 0755 );
-			g_free( new_manifest_folder );
+	return success;
+}
 
-			if ( !g_file_set_contents( new_manifest_path, contents, length, NULL ) )
-			{
-				SHOW_ERR1( "Failed to write manifest file at %s", new_manifest_path );
-				g_free(contents);
-				g_free(bundle_folder);
-				g_free(new_manifest_path);
-				g_free(old_manifest_path);
-				goto android_dialog_cleanup2;
-			}
-    
-			g_free(contents);
+/* Checks the settings and turns them into the data for android_export_run(), or shows an error
+ * and returns NULL. Must be called from the main thread. */
+static AndroidExportData *android_export_prepare( GeanyProject *project, const GeanyProjectAPKSettings *settings,
+	const gchar *keystore_password_in, const gchar *alias_password_in, gboolean confirm_overwrite )
+{
+	static const int sdk_versions[] = { 16, 17, 18, 19, 21, 22, 23, 24, 25, 26, 27, 28, 29 };
+	static const gchar *output_types[] = { "Google App Bundle", "Google APK", "Amazon", "Ouya" };
+	AndroidExportData *data;
+	int i;
 
-			g_unlink( old_manifest_path );
+#ifdef __APPLE__
+    gchar* android_path = g_build_path( "/", app->configdir, "AndroidExport", "aapt2-bundle", NULL );
+    if ( !g_file_test(android_path, G_FILE_TEST_EXISTS) )
+    {
+        g_free( android_path);
+        if ( m_connection ) SHOW_ERR( "Android export files have not finished downloading, please wait and try again" );
+        else SHOW_ERR( "Android export files not found. Please close the export dialog and reopen it to try downloading again" );
+        return NULL;
+    }
+    g_free( android_path);
+#endif
 
-			g_free(new_manifest_path);
-			g_free(old_manifest_path);
+	// app details
+	gchar *app_name = g_strdup( FALLBACK(settings->app_name, "") );
+	gchar *package_name = g_strdup( FALLBACK(settings->package_name, "") );
+	gchar *app_icon = g_strdup( FALLBACK(settings->app_icon_path, "") );
+	gchar *app_icon_new = g_strdup( FALLBACK(settings->app_icon_new_path, "") );
+	gchar *notif_icon = g_strdup( FALLBACK(settings->notif_icon_path, "") );
+	gchar *ouya_icon = g_strdup( FALLBACK(settings->ouya_icon_path, "") );
+	gchar *firebase_config = g_strdup( FALLBACK(settings->firebase_config_path, "") );
+
+	int orientation = 10;
+	if ( settings->orientation == 0 ) orientation = 6;
+	else if ( settings->orientation == 1 ) orientation = 7;
+
+	int arcore_mode = settings->arcore;
+
+	int sdk = 16;
+	if ( settings->sdk_version >= 1 && settings->sdk_version <= G_N_ELEMENTS(sdk_versions) ) sdk = sdk_versions[ settings->sdk_version - 1 ];
+	gchar szSDK[ 20 ];
+	sprintf( szSDK, "%d", sdk );
+
+	gchar *url_scheme = g_strdup( FALLBACK(settings->url_scheme, "") );
+	gchar *deep_link = g_strdup( FALLBACK(settings->deep_link, "") );
+	gchar *google_play_app_id = g_strdup( FALLBACK(settings->play_app_id, "") );
+	gchar *admob_app_id = g_strdup( FALLBACK(settings->admob_app_id, "") );
+	gchar *snapchat_client_id = g_strdup( FALLBACK(settings->snapchat_client_id, "") );
+
+	// permissions
+	int permission_external_storage = (settings->permission_flags & AGK_ANDROID_PERMISSION_WRITE) ? 1 : 0;
+	int permission_location_fine = (settings->permission_flags & AGK_ANDROID_PERMISSION_GPS) ? 1 : 0;
+	int permission_location_coarse = (settings->permission_flags & AGK_ANDROID_PERMISSION_LOCATION) ? 1 : 0;
+	int permission_internet = (settings->permission_flags & AGK_ANDROID_PERMISSION_INTERNET) ? 1 : 0;
+	int permission_wake = (settings->permission_flags & AGK_ANDROID_PERMISSION_WAKE) ? 1 : 0;
+	int permission_billing = (settings->permission_flags & AGK_ANDROID_PERMISSION_IAP) ? 1 : 0;
+	int permission_push = (settings->permission_flags & AGK_ANDROID_PERMISSION_PUSH) ? 1 : 0;
+	int permission_camera = (settings->permission_flags & AGK_ANDROID_PERMISSION_CAMERA) ? 1 : 0;
+	int permission_notifications = (settings->permission_flags & AGK_ANDROID_PERMISSION_NOTIFY) ? 1 : 0;
+	int permission_vibrate = (settings->permission_flags & AGK_ANDROID_PERMISSION_VIBRATE) ? 1 : 0;
+	int permission_record_audio = (settings->permission_flags & AGK_ANDROID_PERMISSION_RECORD_AUDIO) ? 1 : 0;
+
+	// signing
+	gchar *keystore_file = g_strdup( FALLBACK(settings->keystore_path, "") );
+	gchar *keystore_password = g_strdup( FALLBACK(keystore_password_in, "") );
+
+	gchar *version_number = g_strdup( FALLBACK(settings->version_name, "") );
+	if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
 
-			g_unlink( output_file_zip );
+	int build_number = settings->version_number;
+	if ( build_number == 0 ) build_number = 1;
+	gchar szBuildNum[ 20 ];
+	sprintf( szBuildNum, "%d", build_number );
 
-			// zip everything back up
-			memset(&zip_archive, 0, sizeof(zip_archive));
-			if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
-			{
-				SHOW_ERR( _("Failed to initialise zip file for writing") );
-				g_free(bundle_folder);
-				goto android_dialog_cleanup2;
-			}
-		
-			if ( !utils_add_folder_to_zip( &zip_archive, bundle_folder, "", TRUE, TRUE ) )
-			{
-				SHOW_ERR( _("Failed to add files to zip file") );
-				g_free(bundle_folder);
-				goto android_dialog_cleanup2;
-			}
+	gchar *alias_name = g_strdup( FALLBACK(settings->alias, "") );
+	gchar *alias_password = g_strdup( FALLBACK(alias_password_in, "") );
 
-			if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
-			{
-				SHOW_ERR( _("Failed to finalize zip file") );
-				g_free(bundle_folder);
-				goto android_dialog_cleanup2;
-			}
-			if ( !mz_zip_writer_end( &zip_archive ) )
-			{
-				SHOW_ERR( _("Failed to end zip file") );
-				g_free(bundle_folder);
-				goto android_dialog_cleanup2;
-			}
+	// output
+	gchar *output_file = g_strdup( FALLBACK(settings->output_path, "") );
 
-			// remove temp folder
-			utils_remove_folder_recursive( bundle_folder );
-			g_free(bundle_folder);
-		}
+	int app_type = settings->app_type;
+	const gchar *output_type = (app_type >= 0 && app_type < G_N_ELEMENTS(output_types)) ? output_types[ app_type ] : "";
 
-		// open APK as a zip file
-		if ( !mz_zip_reader_init_file( &zip_archive, output_file_zip, 0 ) )
+	int isGoogle = (app_type == 0 || app_type == 1) ? 1 : 0;
+	int isAmazon = (app_type == 2) ? 1 : 0;
+	int isOuya = (app_type == 3) ? 1 : 0;
+	int isBundle = (app_type == 0) ? 1 : 0;
+			
+	gchar *percent = 0;
+	while ( (percent = strchr(output_file, '%')) != 0 )
+	{
+		if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
 		{
-			SHOW_ERR( _("Failed to initialise zip file for reading") );
-			goto android_dialog_cleanup2;
+			*percent = 0;
+			percent += strlen("[version]") + 1;
+			gchar *new_output = g_strconcat( output_file, szBuildNum, percent, NULL );
+			g_free(output_file);
+			output_file = new_output;
+			continue;
 		}
-		if ( !mz_zip_writer_init_from_reader( &zip_archive, output_file_zip ) )
+
+		if ( strncmp( percent+1, "[type]", strlen("[type]") ) == 0 )
 		{
-			SHOW_ERR( _("Failed to open zip file for writing") );
-			goto android_dialog_cleanup2;
+			*percent = 0;
+			percent += strlen("[type]") + 1;
+			gchar *new_output = g_strconcat( output_file, output_type, percent, NULL );
+			g_free(output_file);
+			output_file = new_output;
+			continue;
 		}
 
-		// copy in extra files
-		zip_add_file = g_build_path( "/", src_folder, "classes.dex", NULL );
-		mz_zip_writer_add_file( &zip_archive, (isBundle) ? "dex/classes.dex" : "classes.dex", zip_add_file, NULL, 0, 9 );
+		break;
+	}
 
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "classes2.dex", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
-		{
-			mz_zip_writer_add_file( &zip_archive, (isBundle) ? "dex/classes2.dex" : "classes2.dex", zip_add_file, NULL, 0, 9 );
-		}
+	// START CHECKS
 
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "classes3.dex", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
-		{
-			mz_zip_writer_add_file( &zip_archive, (isBundle) ? "dex/classes3.dex" : "classes3.dex", zip_add_file, NULL, 0, 9 );
-		}
+	if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your APK")); goto android_dialog_clean_up; }
+	if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto android_dialog_clean_up; }
 
-		// copy extra files
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "com", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
-		{
-			utils_add_folder_to_zip( &zip_archive, zip_add_file, (isBundle) ? "root/com" : "com", TRUE, TRUE );
-		}
+	const char* desiredExt = ".apk";
+	if ( isBundle ) desiredExt = ".aab";
 
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "kotlin", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
-		{
-			utils_add_folder_to_zip( &zip_archive, zip_add_file, (isBundle) ? "root/kotlin" : "kotlin", TRUE, TRUE );
-		}
+	char* ext = strrchr( output_file, '.' );
+	if ( ext && strlen(ext) < 6 ) strcpy( ext, desiredExt );
+	else strcat( output_file, desiredExt );
 
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "okhttp3", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+	if ( g_file_test( output_file, G_FILE_TEST_EXISTS ) )
+	{
+		if ( confirm_overwrite && !dialogs_show_question("Output file already exists, do you want to overwrite it?") )
 		{
-			utils_add_folder_to_zip( &zip_archive, zip_add_file, (isBundle) ? "root/okhttp3" : "okhttp3", TRUE, TRUE );
+			goto android_dialog_clean_up;
 		}
 
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "extra_root", NULL );
-		if ( g_file_test( zip_add_file, G_FILE_TEST_EXISTS ) )
+		g_unlink( output_file );
+	}
+
+	// check app name
+	if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto android_dialog_clean_up; }
+	if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto android_dialog_clean_up; }
+	for( i = 0; i < strlen(app_name); i++ )
+	{
+		/*
+		if ( (app_name[i] < 97 || app_name[i] > 122)
+		  && (app_name[i] < 65 || app_name[i] > 90) 
+		  && (app_name[i] < 48 || app_name[i] > 57) 
+		  && app_name[i] != 32 
+		  && app_name[i] != 45
+		  && app_name[i] != 95 ) 
+		{ 
+			SHOW_ERR(_("App name contains invalid characters, must be A-Z, 0-9, dash, spaces, and undersore only")); 
+			goto android_dialog_clean_up; 
+		}
+		*/
+		//switch to black list
+		if ( app_name[i] == 34 || app_name[i] == 60 || app_name[i] == 62 || app_name[i] == 39 )
 		{
-			utils_add_folder_to_zip( &zip_archive, zip_add_file, (isBundle) ? "root" : "", TRUE, TRUE );
+			SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or < > characters.")); 
+			goto android_dialog_clean_up; 
 		}
-		
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libandroid_player.so", NULL );
-		mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libandroid_player.so", zip_add_file, NULL, 0, 9 );
-		
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libandroid_player.so", NULL );
-		mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libandroid_player.so", zip_add_file, NULL, 0, 9 );
-		
-		if ( arcore_mode > 0 )
+	}
+	
+	// check package name
+	if ( !package_name || !*package_name ) { SHOW_ERR(_("You must enter a package name")); goto android_dialog_clean_up; }
+	if ( strlen(package_name) > 100 ) { SHOW_ERR(_("Package name must be less than 100 characters")); goto android_dialog_clean_up; }
+	if ( strchr(package_name,'.') == NULL ) { SHOW_ERR(_("Package name must contain at least one dot character")); goto android_dialog_clean_up; }
+	if ( (package_name[0] < 65 || package_name[0] > 90) && (package_name[0] < 97 || package_name[0] > 122) ) { SHOW_ERR(_("Package name must begin with a letter")); goto android_dialog_clean_up; }
+	if ( package_name[strlen(package_name)-1] == '.' ) { SHOW_ERR(_("Package name must not end with a dot")); goto android_dialog_clean_up; }
+
+	gchar last = 0;
+	for( i = 0; i < strlen(package_name); i++ )
+	{
+		if ( last == '.' && (package_name[i] < 65 || package_name[i] > 90) && (package_name[i] < 97 || package_name[i] > 122) )
 		{
-			// use real ARCore lib
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libarcore_sdk.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libarcore_sdk.so", zip_add_file, NULL, 0, 9 );
+			SHOW_ERR(_("Package name invalid, a dot must be followed by a letter"));
+			goto android_dialog_clean_up; 
+		}
 
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libarcore_sdk.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libarcore_sdk.so", zip_add_file, NULL, 0, 9 );
+		if ( (package_name[i] < 97 || package_name[i] > 122) // a-z
+		  && (package_name[i] < 65 || package_name[i] > 90) // A-Z
+		  && (package_name[i] < 48 || package_name[i] > 57) //0-9
+		  && package_name[i] != 46 // .
+		  && package_name[i] != 95 ) // _
+		{ 
+			SHOW_ERR(_("Package name contains invalid characters, must be A-Z 0-9 . and undersore only")); 
+			goto android_dialog_clean_up; 
 		}
 
-		if ( snapchat_client_id && *snapchat_client_id )
-		{
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "arm64-v8a", "libpruneau.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/arm64-v8a/libpruneau.so", zip_add_file, NULL, 0, 9 );
+		last = package_name[i];
+	}
 
-			g_free( zip_add_file );
-			zip_add_file = g_build_path( "/", android_folder, "lib", "armeabi-v7a", "libpruneau.so", NULL );
-			mz_zip_writer_add_file( &zip_archive, "lib/armeabi-v7a/libpruneau.so", zip_add_file, NULL, 0, 9 );
+	if ( url_scheme && *url_scheme )
+	{
+		if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
+		{
+			SHOW_ERR(_("URL scheme must not contain : or /"));
+			goto android_dialog_clean_up; 
 		}
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	}
 
-		// copy assets
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", src_folder, "assets", NULL );
-		if ( g_file_test (zip_add_file, G_FILE_TEST_EXISTS) )
+	if ( deep_link && *deep_link )
+	{
+		if ( strncmp( deep_link, "https://", strlen("https://") ) != 0 && strncmp( deep_link, "http://", strlen("http://") ) != 0 )
 		{
-			if ( !utils_add_folder_to_zip( &zip_archive, zip_add_file, "assets", TRUE, TRUE ) )
-			{
-				SHOW_ERR( _("Failed to add media files to APK") );
-				goto android_dialog_cleanup2;
-			}
+			SHOW_ERR(_("Deep link must start with http:// or https://"));
+			goto android_dialog_clean_up; 
 		}
-		
-		// copy in media files
-		g_free( zip_add_file );
-		zip_add_file = g_build_path( "/", app->project->base_path, "media", NULL );
-		if ( !utils_add_folder_to_zip( &zip_archive, zip_add_file, "assets/media", TRUE, TRUE ) )
+
+		if ( strcmp( deep_link, "https://" ) == 0 || strcmp( deep_link, "http://" ) == 0 )
 		{
-			SHOW_ERR( _("Failed to add media files to APK") );
-			goto android_dialog_cleanup2;
+			SHOW_ERR(_("Deep link must have a domain after http:// or https://"));
+			goto android_dialog_clean_up; 
 		}
+	}
 
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	// check icon
+	//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto android_dialog_clean_up; }
+	if ( app_icon && *app_icon )
+	{
+		if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Legacy app icon must be a PNG file")); goto android_dialog_clean_up; }
+		if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find legacy app icon location")); goto android_dialog_clean_up; }
+	}
+
+	if ( app_icon_new && *app_icon_new )
+	{
+		if ( !strrchr( app_icon_new, '.' ) || utils_str_casecmp( strrchr( app_icon_new, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto android_dialog_clean_up; }
+		if ( !g_file_test( app_icon_new, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto android_dialog_clean_up; }
+	}
+
+	if ( notif_icon && *notif_icon )
+	{
+		if ( !strrchr( notif_icon, '.' ) || utils_str_casecmp( strrchr( notif_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Notification icon must be a PNG file")); goto android_dialog_clean_up; }
+		if ( !g_file_test( notif_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find notification icon location")); goto android_dialog_clean_up; }
+	}
+
+	if ( isOuya )
+	{
+		//if ( !ouya_icon || !*ouya_icon ) { SHOW_ERR(_("You must select an Ouya large icon")); goto android_dialog_clean_up; }
+		if ( ouya_icon && *ouya_icon )
 		{
-			SHOW_ERR( _("Failed to add finalize zip file") );
-			goto android_dialog_cleanup2;
+			if ( !strrchr( ouya_icon, '.' ) || utils_str_casecmp( strrchr( ouya_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Ouya large icon must be a PNG file")); goto android_dialog_clean_up; }
+			if ( !g_file_test( ouya_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find ouya large icon location")); goto android_dialog_clean_up; }
 		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
+	}
+
+	// check firebase config file
+	if ( firebase_config && *firebase_config )
+	{
+		if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".json" ) != 0 ) { SHOW_ERR(_("Google services config file must be a .json file")); goto android_dialog_clean_up; }
+		if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Google services config file")); goto android_dialog_clean_up; }
+	}
+			
+	// check version
+	if ( version_number && *version_number )
+	{
+		for( i = 0; i < strlen(version_number); i++ )
 		{
-			SHOW_ERR( _("Failed to end zip file") );
-			goto android_dialog_cleanup2;
+			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
+			{ 
+				SHOW_ERR(_("Version name contains invalid characters, must be 0-9 and . only")); 
+				goto android_dialog_clean_up; 
+			}
 		}
+	}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	// check keystore
+	if ( keystore_file && *keystore_file )
+	{
+		if ( !g_file_test( keystore_file, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find keystore file location")); goto android_dialog_clean_up; }
+	}
 
-		if ( isBundle )
-		{
-			// run bundletool
-			argv = g_new0( gchar*, 11 );
-			argv[0] = g_strdup( path_to_java );
-			argv[1] = g_strdup( "-jar" );
-			argv[2] = g_strdup( path_to_bundletool );
-			argv[3] = g_strdup( "build-bundle" );
-			argv[4] = g_strdup( "--modules" );
-			argv[5] = g_strdup( output_file_zip );
+	// check passwords
+	if ( keystore_password && strchr(keystore_password,'"') ) { SHOW_ERR(_("Keystore password cannot contain double quotes")); goto android_dialog_clean_up; }
+	if ( alias_password && strchr(alias_password,'"') ) { SHOW_ERR(_("Alias password cannot contain double quotes")); goto android_dialog_clean_up; }
 
-			gchar* mapping_file_path = g_build_path( "/", src_folder, "mapping", "mapping.txt", NULL );
-			if ( g_file_test( mapping_file_path, G_FILE_TEST_EXISTS ) )
-			{
-				argv[6] = g_strdup( "--metadata-file" );
-				argv[7] = g_strconcat( "com.android.tools.build.obfuscation/proguard.map:", mapping_file_path, NULL );
+	if ( keystore_file && *keystore_file )
+	{
+		if ( !keystore_password || !*keystore_password ) { SHOW_ERR(_("You must enter your keystore password when using your own keystore")); goto android_dialog_clean_up; }
+	}
 
-				/*
-				#ifdef G_OS_WIN32
-					// mike - 031221 - use bundle config file - DOES NOT WORK FOR SOME REASON
-					gchar* bundleConfig = g_build_path ( "/", src_folder, "", "BundleConfig.json", NULL );
-
-					argv [ 8 ] = g_strdup ( "--config" );
-					argv [ 9 ] = g_strdup ( bundleConfig );
-					argv [ 10 ] = g_strdup ( "--output" );
-					argv [ 11 ] = g_strdup ( output_file );
-					argv [ 12 ] = NULL;
-				#else
-					argv[8] = g_strdup( "--output" );
-					argv[9] = g_strdup( output_file );
-					argv[10] = NULL;
-				#endif
-				*/
+	if ( alias_name && *alias_name )
+	{
+		if ( !alias_password || !*alias_password ) { SHOW_ERR(_("You must enter your alias password when using a custom alias")); goto android_dialog_clean_up; }
+	}
+	
+	int includeFirebase = (firebase_config && *firebase_config && (isGoogle || isAmazon)) ? 1 : 0;
+	int includePushNotify = (permission_push && isGoogle) ? 1 : 0;
+	int includeGooglePlay = (google_play_app_id && *google_play_app_id && isGoogle) ? 1 : 0;
+	int includeAdMob = (admob_app_id && *admob_app_id && isGoogle) ? 1 : 0;
 
-				argv [ 8 ] = g_strdup ( "--output" );
-				argv [ 9 ] = g_strdup ( output_file );
-				argv [ 10 ] = NULL;
-			}
-			else
-			{
-				/*
-				#ifdef G_OS_WIN32
-				// mike - 031221 - use bundle config file - DOES NOT WORK FOR SOME REASON
-					gchar* bundleConfig = g_build_path ( "/", src_folder, "", "BundleConfig.json", NULL );
-
-					argv [ 8 ] = g_strdup ( "--config" );
-					argv [ 9 ] = g_strdup ( bundleConfig );
-					argv [ 10 ] = g_strdup ( "--output" );
-					argv [ 11 ] = g_strdup ( output_file );
-					argv [ 12 ] = NULL;
-				#else
-					argv [ 6 ] = g_strdup ( "--output" );
-					argv [ 7 ] = g_strdup ( output_file );
-					argv [ 8 ] = NULL;
-				#endif
-				*/
+	if ( includePushNotify && !includeFirebase )
+	{
+		SHOW_ERR( _("Push Notifications on Android now use Firebase, so you must include a Firebase config file to use them") );
+		goto android_dialog_clean_up;
+	}
 
-				
-				argv [ 6 ] = g_strdup ( "--output" );
-				argv [ 7 ] = g_strdup ( output_file );
-				argv [ 8 ] = NULL;
-			}
 
-			g_free(mapping_file_path);
-			
-			if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-			{
-				SHOW_ERR1( _("Failed to run bundletool: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+	data = g_new0( AndroidExportData, 1 );
+	data->project_base_path = g_strdup( project->base_path );
+	data->app_name = app_name;
+	data->package_name = package_name;
+	data->app_icon = app_icon;
+	data->app_icon_new = app_icon_new;
+	data->notif_icon = notif_icon;
+	data->ouya_icon = ouya_icon;
+	data->firebase_config = firebase_config;
+	data->url_scheme = url_scheme;
+	data->deep_link = deep_link;
+	data->google_play_app_id = google_play_app_id;
+	data->admob_app_id = admob_app_id;
+	data->snapchat_client_id = snapchat_client_id;
+	data->keystore_file = keystore_file;
+	data->keystore_password = keystore_password;
+	data->version_number = version_number;
+	data->alias_name = alias_name;
+	data->alias_password = alias_password;
+	data->output_file = output_file;
+	strcpy( data->szSDK, szSDK );
+	strcpy( data->szBuildNum, szBuildNum );
+	data->orientation = orientation;
+	data->arcore_mode = arcore_mode;
+	data->permission_external_storage = permission_external_storage;
+	data->permission_location_fine = permission_location_fine;
+	data->permission_location_coarse = permission_location_coarse;
+	data->permission_internet = permission_internet;
+	data->permission_wake = permission_wake;
+	data->permission_billing = permission_billing;
+	data->permission_push = permission_push;
+	data->permission_camera = permission_camera;
+	data->permission_notifications = permission_notifications;
+	data->permission_vibrate = permission_vibrate;
+	data->permission_record_audio = permission_record_audio;
+	data->isGoogle = isGoogle;
+	data->isAmazon = isAmazon;
+	data->isOuya = isOuya;
+	data->isBundle = isBundle;
+	data->includeFirebase = includeFirebase;
+	data->includePushNotify = includePushNotify;
+	data->includeGooglePlay = includeGooglePlay;
+	data->includeAdMob = includeAdMob;
+	data->zip_policy = utils_zip_policy_new( project->export_settings.compression_rules,
+	                                         project->export_settings.compression_fast_level,
+	                                         project->export_settings.compression_budget );
+	return data;
+
+android_dialog_clean_up:
+	if ( app_name ) g_free(app_name);
+	if ( package_name ) g_free(package_name);
+	if ( app_icon ) g_free(app_icon);
+	if ( app_icon_new ) g_free(app_icon_new);
+	if ( ouya_icon ) g_free(ouya_icon);
+	if ( notif_icon ) g_free(notif_icon);
+	if ( firebase_config ) g_free(firebase_config);
+	if ( url_scheme ) g_free(url_scheme);
+	if ( deep_link ) g_free(deep_link);
+	if ( google_play_app_id ) g_free(google_play_app_id);
+	if ( admob_app_id ) g_free(admob_app_id);
+	if ( snapchat_client_id ) g_free(snapchat_client_id);
+
+	if ( keystore_file ) g_free(keystore_file);
+	if ( keystore_password ) g_free(keystore_password);
+	if ( version_number ) g_free(version_number);
+	if ( alias_name ) g_free(alias_name);
+	if ( alias_password ) g_free(alias_password);
+
+	if ( output_file ) g_free(output_file);
+	return NULL;
+}
+
+static void android_export_done(ExportJob *job, gboolean success, gpointer user_data)
+{
+	// Export All doesn't use the dialog
+	if ( job != android_export_job ) return;
+	android_export_job = NULL;
+
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
+
+	if ( success ) gtk_widget_hide(ui_widgets.android_dialog);
+}
+
+static gboolean android_export_start_headless( GeanyProject *project, const GeanyProjectAPKSettings *settings,
+	const gchar *keystore_password, const gchar *alias_password, UtilsZipShared *zip_shared )
+{
+	AndroidExportData *data;
+	gchar *name;
+
+	data = android_export_prepare( project, settings, keystore_password, alias_password, FALSE );
+	if ( !data ) return FALSE;
+
+	if ( zip_shared ) data->zip_shared = utils_zip_shared_ref( zip_shared );
+
+	if ( data->isAmazon ) name = g_strconcat( project->name, " (Amazon)", NULL );
+	else if ( data->isOuya ) name = g_strconcat( project->name, " (Ouya)", NULL );
+	else name = g_strconcat( project->name, " (Google)", NULL );
+
+	export_job_start( name, android_export_run, data, android_export_done, NULL );
+	g_free( name );
+	return TRUE;
+}
+
+/* Exports the project with the given settings without using the export dialog. The export runs in
+ * the background alongside any other exports, returns FALSE if it could not be started because
+ * the settings are invalid. An existing output file is overwritten. */
+gboolean project_export_apk_headless( GeanyProject *project, const GeanyProjectAPKSettings *settings,
+	const gchar *keystore_password, const gchar *alias_password )
+{
+	g_return_val_if_fail( project != NULL && settings != NULL, FALSE );
+
+	return android_export_start_headless( project, settings, keystore_password, alias_password, NULL );
+}
+
+static void on_android_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	static int running = 0;
+	if ( running ) return;
+
+	// while exporting the cancel button stops the export, closing the dialog leaves it running
+	if ( android_export_job )
+	{
+		if ( response == GTK_RESPONSE_CANCEL ) export_job_cancel( android_export_job );
+		if ( response != 1 && dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+		return;
+	}
+
+	running = 1;
+
+	// save default settings, the export uses them
+	if ( app->project )
+	{
+		GtkWidget *widget;
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-			if ( status != 0 && str_out && *str_out )
-			{
-				SHOW_ERR1( _("Failed to run bundletool, (output: %s)"), str_out );
-				goto android_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.package_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.app_icon_new_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.notif_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.ouya_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
+		app->project->apk_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
+		app->project->apk_settings.arcore = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
+		gchar *app_sdk = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(widget));
+		app->project->apk_settings.sdk_version = 1; // 4.1
+		if ( strncmp(app_sdk,"4.2",3) == 0 ) app->project->apk_settings.sdk_version = 2;
+		if ( strncmp(app_sdk,"4.3",3) == 0 ) app->project->apk_settings.sdk_version = 3;
+		if ( strncmp(app_sdk,"4.4",3) == 0 ) app->project->apk_settings.sdk_version = 4;
+		if ( strncmp(app_sdk,"5.0",3) == 0 ) app->project->apk_settings.sdk_version = 5;
+		if ( strncmp(app_sdk,"5.1",3) == 0 ) app->project->apk_settings.sdk_version = 6;
+		if ( strncmp(app_sdk,"6.0",3) == 0 ) app->project->apk_settings.sdk_version = 7;
+		if ( strncmp(app_sdk,"7.0",3) == 0 ) app->project->apk_settings.sdk_version = 8;
+		if ( strncmp(app_sdk,"7.1",3) == 0 ) app->project->apk_settings.sdk_version = 9;
+		if ( strncmp(app_sdk,"8.0",3) == 0 ) app->project->apk_settings.sdk_version = 10;
+		if ( strncmp(app_sdk,"8.1",3) == 0 ) app->project->apk_settings.sdk_version = 11;
+		if ( strncmp(app_sdk,"9.0",3) == 0 ) app->project->apk_settings.sdk_version = 12;
+		if ( strncmp(app_sdk,"10.0",3) == 0 ) app->project->apk_settings.sdk_version = 13;
+		g_free(app_sdk);
+				
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
+		AGK_CLEAR_STR(app->project->apk_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
+		AGK_CLEAR_STR(app->project->apk_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
+		AGK_CLEAR_STR(app->project->apk_settings.play_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
+		AGK_CLEAR_STR(app->project->apk_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( str_out ) g_free(str_out);
-			str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
+		AGK_CLEAR_STR(app->project->apk_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			g_strfreev(argv);
-			argv = 0;
+		// permissions
+		app->project->apk_settings.permission_flags = 0;
 
-			while (gtk_events_pending())
-				gtk_main_iteration();
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WRITE;
 
-		// sign apk
-		int argIndex = 0;
-		argv = g_new0( gchar*, 14 );
-		argv[argIndex++] = g_strdup( path_to_jarsigner );
-		if ( !isBundle )
-		{
-			argv[argIndex++] = g_strdup("-sigalg");
-			argv[argIndex++] = g_strdup("MD5withRSA");
-			argv[argIndex++] = g_strdup("-digestalg");
-			argv[argIndex++] = g_strdup("SHA1");
-		}
-		argv[argIndex++] = g_strdup("-storepass");
-#ifdef G_OS_WIN32
-		argv[argIndex++] = g_strconcat( "\"", keystore_password, "\"", NULL );
-#else
-		argv[argIndex++] = g_strdup( keystore_password );
-#endif
-		argv[argIndex++] = g_strdup("-keystore");
-		argv[argIndex++] = g_strdup(keystore_file);
-		if ( isBundle ) argv[argIndex++] = g_strdup(output_file);
-		else argv[argIndex++] = g_strdup(output_file_zip);
-		argv[argIndex++] = g_strdup(alias_name);
-		argv[argIndex++] = g_strdup("-keypass");
-#ifdef G_OS_WIN32
-		argv[argIndex++] = g_strconcat( "\"", alias_password, "\"", NULL );
-#else
-		argv[argIndex++] = g_strdup( alias_password );
-#endif
-		argv[argIndex++] = NULL;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_GPS;
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run signing tool: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
-		
-		if ( status != 0 && str_out && *str_out && strstr(str_out,"jar signed") == 0 )
-		{
-			SHOW_ERR1( _("Failed to sign APK, is your keystore password and alias correct? (error: %s)"), str_out );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_LOCATION;
 
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_INTERNET;
 
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_WAKE;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_IAP;
 
-		// align apk
-		argv = g_new0( gchar*, 5 );
-		argv[0] = g_strdup( path_to_zipalign );
-		argv[1] = g_strdup("4");
-		argv[2] = g_strdup(output_file_zip);
-		argv[3] = g_strdup(output_file);
-		argv[4] = NULL;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_PUSH;
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run zipalign tool: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto android_dialog_cleanup2;
-		}
-		
-		if ( status != 0 && str_out && *str_out )
-		{
-			SHOW_ERR1( _("Zip align tool returned error: %s"), str_out );
-			goto android_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
+		if ( gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_CAMERA;
 
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_notifications");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_NOTIFY;
 
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_VIBRATE;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		if ( !isBundle )
-		{
-			// sign with V2 signature
-			argIndex = 0;
-			argv = g_new0( gchar*, 15 );
-			argv[argIndex++] = g_strdup( path_to_java );
-			argv[argIndex++] = g_strdup( "-jar" );
-			argv[argIndex++] = g_strdup( path_to_apksigner );
-			argv[argIndex++] = g_strdup( "sign" );
-			argv[argIndex++] = g_strdup( "--ks" );
-			argv[argIndex++] = g_strdup( keystore_file );
-			argv[argIndex++] = g_strdup( "--ks-pass" );
-	#ifdef G_OS_WIN32
-			argv[argIndex++] = g_strconcat( "pass:\"", keystore_password, "\"", NULL );
-	#else
-			argv[argIndex++] = g_strconcat( "pass:", keystore_password, NULL );
-	#endif
-			argv[argIndex++] = g_strdup( "--ks-key-alias" );
-			argv[argIndex++] = g_strdup( alias_name );
-			argv[argIndex++] = g_strdup( "--key-pass" );
-	#ifdef G_OS_WIN32
-			argv[argIndex++] = g_strconcat( "pass:\"", alias_password, "\"", NULL );
-	#else
-			argv[argIndex++] = g_strconcat( "pass:", alias_password, NULL );
-	#endif
-			argv[argIndex++] = g_strdup( output_file );
-			argv[argIndex++] = NULL;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
+		if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)) ) app->project->apk_settings.permission_flags |= AGK_ANDROID_PERMISSION_RECORD_AUDIO;
 
-			if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-			{
-				SHOW_ERR1( _("Failed to run apksigner tool: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto android_dialog_cleanup2;
-			}
+		// signing
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.keystore_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-			if ( status != 0 && str_out && *str_out )
-			{
-				SHOW_ERR1( _("Failed to sign APK with apksigner, is your keystore password and alias correct? (error: %s)"), str_out );
-				goto android_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.version_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
+		int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
+		app->project->apk_settings.version_number = build_number;
 
-			if ( str_out ) g_free(str_out);
-			str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.alias) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			g_strfreev(argv);
-			argv = 0;
+		// output
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry");
+		AGK_CLEAR_STR(app->project->apk_settings.output_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			while (gtk_events_pending())
-				gtk_main_iteration();
-		}
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
+		app->project->apk_settings.app_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+	}
 
+	if ( response != 1 || !app->project )
+	{
 		if ( dialog ) gtk_widget_hide(GTK_WIDGET(dialog));
+	}
+	else
+	{
+		GtkWidget *widget;
+		AndroidExportData *data;
 
-android_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "button7"), TRUE );
+		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), FALSE );
 
-		if ( aapt2_pid ) 
-		{
-		#ifdef G_OS_WIN32
-			TerminateProcess(aapt2_pid, 0);
-		#else
-			kill(aapt2_pid, SIGTERM);
-		#endif
-		}
+		// passwords aren't saved with the project
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
+		gchar *keystore_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_unlink( output_file_zip );
-		utils_remove_folder_recursive( tmp_folder );
-
-		if ( path_to_java ) g_free(path_to_java);
-		if ( path_to_jarsigner ) g_free(path_to_jarsigner);
-		if ( path_to_aapt2 ) g_free(path_to_aapt2);
-		if ( path_to_android_jar ) g_free(path_to_android_jar);
-		if ( path_to_bundletool ) g_free(path_to_bundletool);
-		if ( path_to_apksigner ) g_free(path_to_apksigner);
-		if ( path_to_zipalign ) g_free(path_to_zipalign);
-
-		if ( zip_add_file ) g_free(zip_add_file);
-		if ( manifest_file ) g_free(manifest_file);
-		if ( newcontents ) g_free(newcontents);
-		if ( newcontents2 ) g_free(newcontents2);
-		if ( contents ) g_free(contents);
-		if ( contentsOther ) g_free(contentsOther);
-		if ( resources_file ) g_free(resources_file);
-		if ( error ) g_error_free(error);
-		if ( icon_image ) gdk_pixbuf_unref(icon_image);
-		if ( image_filename ) g_free(image_filename);
-		if ( icon_scaled_image ) gdk_pixbuf_unref(icon_scaled_image);
-		if ( argv ) g_strfreev(argv);
-		if ( aaptcommand ) g_free(aaptcommand);
-		
-		if ( output_file_zip ) g_free(output_file_zip);
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( android_folder ) g_free(android_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( str_out ) g_free(str_out);
+		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
+		gchar *alias_password = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		if ( output_file ) g_free(output_file);
-		if ( app_name ) g_free(app_name);
-		if ( package_name ) g_free(package_name);
-		if ( app_icon ) g_free(app_icon);
-		if ( ouya_icon ) g_free(ouya_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( google_play_app_id ) g_free(google_play_app_id);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
+		data = android_export_prepare( app->project, &app->project->apk_settings, keystore_password, alias_password, TRUE );
+		g_free( keystore_password );
+		g_free( alias_password );
 
-		if ( keystore_file ) g_free(keystore_file);
-		if ( keystore_password ) g_free(keystore_password);
-		if ( version_number ) g_free(version_number);
-		if ( alias_name ) g_free(alias_name);
-		if ( alias_password ) g_free(alias_password);
+		if ( data ) android_export_job = export_job_start( app->project->name, android_export_run, data, android_export_done, NULL );
+		else gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.android_dialog, "android_export1"), TRUE );
 	}
 
 	running = 0;
@@ -4012,8 +4370,6 @@ void on_android_all_dialog_response(GtkDialog *dialog, gint response, gpointer u
 		return;
 	}
 
-	GeanyProject *orig_project = app->project;
-
 	// export all output folder
 	GtkWidget *widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_output_file_entry");
 	gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
@@ -4034,171 +4390,49 @@ void on_android_all_dialog_response(GtkDialog *dialog, gint response, gpointer u
 	if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
 
 	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_build_number_entry");
-	gchar* build_number = gtk_entry_get_text(GTK_ENTRY(widget));
-	if ( !*build_number ) SETPTR( build_number, g_strdup("1") );
-	
-	int i;
-	for ( i = 0; i < projects_array->len; i++ )
-	{
-		if ( !projects[i]->is_valid ) continue;
-		
-		GtkWidget *export_all_progress = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_progress");
-		gchar *text = g_strconcat( "Exporting: ", projects[i]->name, " - Google", NULL );
-		gtk_label_set_text( GTK_LABEL(export_all_progress), text );
-		g_free(text);
-
-		while (gtk_events_pending()) gtk_main_iteration();
-
-		// change current project
-		app->project = projects[i];
-
-		// set up the android export dialog
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_name_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.app_name, "") );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_package_name_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.package_name, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.app_icon_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.app_icon_new_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.notif_icon_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.ouya_icon_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.firebase_config_path, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), app->project->apk_settings.orientation );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), app->project->apk_settings.arcore );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo");
-		int version = app->project->apk_settings.sdk_version - 1;
-		if ( version < 0 ) version = 0;
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), version );
-								
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_url_scheme");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.url_scheme, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_deep_link");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.deep_link, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_google_play_app_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.play_app_id, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_admob_app_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.admob_app_id, "") );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_snapchat_client_id");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.snapchat_client_id, "") );
-
-		// permissions
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_external_storage");
-		int mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_WRITE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_fine");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_GPS) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_location_coarse");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_LOCATION) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_internet");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_INTERNET) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_wake");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_WAKE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_billing");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_IAP) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_push_notifications");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_PUSH) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_camera");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_CAMERA) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_notifications");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_NOTIFY) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_vibrate");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_VIBRATE) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_permission_record_audio");
-		mode = (app->project->apk_settings.permission_flags & AGK_ANDROID_PERMISSION_RECORD_AUDIO) ? 1 : 0;
-		gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(widget), mode );
-
-		// signing
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.keystore_path, "") );
+	int build_number = atoi(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_password_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), keystore_password );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_version_number_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), version_number );
-		
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_build_number_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), build_number );
-				
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), FALLBACK(app->project->apk_settings.alias, "") );
+	widget = ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_jobs_spin");
+	global_project_prefs.export_max_jobs = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widget));
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_alias_password_entry");
-		gtk_entry_set_text( GTK_ENTRY(widget), keystore_password );
+	// each project is exported for Google and Amazon, all of them are queued at once and run up to
+	// export_max_jobs at a time. The variants of a project share their compressed media and
+	// libraries, so those are only compressed once
+	static const int variant_types[] = { 0, 2 };
+	static const gchar *variant_names[] = { "Google", "Amazon" };
+	int i, v;
+	for ( i = 0; i < projects_array->len; i++ )
+	{
+		if ( !projects[i]->is_valid ) continue;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), 0 ); // Google
-		
-		gchar *filename = g_strconcat( app->project->name, "-Google-", version_number, ".apk", NULL );
-		gchar* apk_path = g_build_filename( output_file, filename, NULL );
-		gtk_entry_set_text( GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry")), apk_path );
-		g_free(apk_path);
-		g_free(filename);
+		UtilsZipShared *zip_shared = utils_zip_shared_new();
 
-		on_android_dialog_response( 0, 1, 1 ); // no dialog, export response, don't save settings
+		for ( v = 0; v < G_N_ELEMENTS(variant_types); v++ )
+		{
+			GeanyProjectAPKSettings settings = projects[i]->apk_settings;
 
-		widget = ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo");
-		gtk_combo_box_set_active( GTK_COMBO_BOX(widget), 2 ); // Amazon
+			gchar *filename = g_strconcat( projects[i]->name, "-", variant_names[v], "-", version_number, ".apk", NULL );
+			gchar* apk_path = g_build_filename( output_file, filename, NULL );
 
-		filename = g_strconcat( app->project->name, "-Amazon-", version_number, ".apk", NULL );
-		apk_path = g_build_filename( output_file, filename, NULL );
-		gtk_entry_set_text( GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry")), apk_path );
-		g_free(apk_path);
-		g_free(filename);
+			settings.app_type = variant_types[v];
+			settings.version_name = version_number;
+			settings.version_number = build_number;
+			settings.output_path = apk_path;
 
-		text = g_strconcat( "Exporting: ", projects[i]->name, " - Amazon", NULL );
-		gtk_label_set_text( GTK_LABEL(export_all_progress), text );
-		g_free(text);
+			android_export_start_headless( projects[i], &settings, keystore_password, keystore_password, zip_shared );
 
-		while (gtk_events_pending()) gtk_main_iteration();
+			g_free(apk_path);
+			g_free(filename);
+		}
 
-		on_android_dialog_response( 0, 1, 1 ); // no dialog, export response, don't save settings
+		utils_zip_shared_unref( zip_shared );
 	}
 
-	gtk_widget_hide(GTK_WIDGET(dialog));
+	g_free(output_file);
+	g_free(keystore_password);
+	g_free(version_number);
 
-	// reset current project and set future exports to reload normal settings
-	app->project = orig_project;
-	if ( last_proj_path_android ) g_free(last_proj_path_android);
-	last_proj_path_android = g_strdup( "" );
+	gtk_widget_hide(GTK_WIDGET(dialog));
 }
 
 void project_export_apk_all()
@@ -4209,38 +4443,6 @@ void project_export_apk_all()
 		return;
 	}
 
-	// make sure original android dialog exists
-	if (ui_widgets.android_dialog == NULL)
-	{
-		ui_widgets.android_dialog = create_android_dialog();
-		gtk_widget_set_name(ui_widgets.android_dialog, "Export APK");
-		gtk_window_set_transient_for(GTK_WINDOW(ui_widgets.android_dialog), GTK_WINDOW(main_widgets.window));
-
-		g_signal_connect(ui_widgets.android_dialog, "response", G_CALLBACK(on_android_dialog_response), NULL);
-        g_signal_connect(ui_widgets.android_dialog, "delete-event", G_CALLBACK(gtk_widget_hide_on_delete), NULL);
-
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_entry")));
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_app_icon_new_entry")));
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_notif_icon_entry")));
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_ouya_icon_entry")));
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_keystore_file_entry")));
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_OPEN, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_firebase_config_entry")));
-
-		ui_setup_open_button_callback_android(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_path"), NULL,
-			GTK_FILE_CHOOSER_ACTION_SAVE, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_dialog, "android_output_file_entry")));
-
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.android_dialog, "android_output_type_combo")), 0 );
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.android_dialog, "android_orientation_combo")), 0 );
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.android_dialog, "android_sdk_combo")), 0 ); 
-		gtk_combo_box_set_active( GTK_COMBO_BOX(ui_lookup_widget(ui_widgets.android_dialog, "android_arcore_combo")), 0 ); 
-	}
-
 	// make sure export all dialog exists
 	if (ui_widgets.android_all_dialog == NULL)
 	{
@@ -4255,6 +4457,9 @@ void project_export_apk_all()
 			GTK_FILE_CHOOSER_ACTION_SELECT_FOLDER, GTK_ENTRY(ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_output_file_entry")));
 	}
 
+	gtk_spin_button_set_value( GTK_SPIN_BUTTON(ui_lookup_widget(ui_widgets.android_all_dialog, "export_all_android_jobs_spin")),
+		export_job_get_max_jobs() );
+
 	gtk_window_present(GTK_WINDOW(ui_widgets.android_all_dialog));
 }
 
@@ -4596,40 +4801,8 @@ void project_generate_keystore()
 	gtk_window_present(GTK_WINDOW(ui_widgets.keystore_dialog));
 }
 
-static int ios_convert_to_cgbi_png( const char* oldfilename, const char* newfilename )
-{
-	gint status = 0;
-	GError *error = NULL;
-
-	gchar** argv = g_new0( gchar*, 8 );
-	argv[0] = g_strdup( "/usr/bin/xcrun" );
-	argv[1] = g_strdup("-sdk");
-	argv[2] = g_strdup("iphoneos");
-	argv[3] = g_strdup("pngcrush");
-	argv[4] = g_strdup("-iphone");
-	argv[5] = g_strdup(oldfilename);
-	argv[6] = g_strdup(newfilename);
-	argv[7] = NULL;
-
-	if ( !utils_spawn_sync( "/", argv, NULL, 0, NULL, NULL, NULL, NULL, &status, &error) )
-	{
-		SHOW_ERR1( _("Failed to run \"pngcrush\" program: %s"), error->message );
-		g_error_free(error);
-		error = NULL;
-		g_strfreev(argv);
-		return 0;
-	}
-		
-	if ( !g_file_test (newfilename, G_FILE_TEST_EXISTS) )
-	{
-		SHOW_ERR1( _("Failed to convert png file \"%s\" to Apple's CgBI format"), newfilename );
-		g_strfreev(argv);
-		return 0;
-	}
-
-	g_strfreev(argv);
-	return 1;
-}
+// app icon sizes for the asset catalog, must match the icons listed in its Contents.json
+static const gint ios_icon_sizes[] = { 152, 180, 167, 120, 76, 1024 };
 
 static int hextoint( unsigned char letter )
 {
@@ -4639,2056 +4812,2066 @@ static int hextoint( unsigned char letter )
 	return 0;
 }
 
-static void on_ios_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+typedef struct IosExportData
 {
-	static int running = 0;
-	if ( running ) return;
+	gchar *project_base_path; // NULL when exporting the player
+	gchar *default_base_path;
+
+	gchar *app_name;
+	gchar *profile;
+	gchar *app_icon;
+	gchar *firebase_config;
+	gchar *app_splash_logo;
+	gchar *app_splash_color;
+	gchar *url_scheme;
+	gchar *deep_link;
+	gchar *admob_app_id;
+	gchar *snapchat_client_id;
+	gchar *version_number;
+	gchar *build_number;
+	gchar *output_file;
+
+	int orientation;
+	int device_type;
+	int uses_ads;
+} IosExportData;
+
+static ExportJob *ios_export_job = NULL;
+
+static gboolean ios_export_run(ExportJob *job, gpointer user_data)
+{
+	IosExportData *data = user_data;
+	gboolean success = FALSE;
+
+	// the strings belong to this function now and are freed below
+	gchar *app_name = data->app_name;
+	gchar *profile = data->profile;
+	gchar *app_icon = data->app_icon;
+	gchar *firebase_config = data->firebase_config;
+	gchar *app_splash_logo = data->app_splash_logo;
+	gchar *app_splash_color = data->app_splash_color;
+	gchar *url_scheme = data->url_scheme;
+	gchar *deep_link = data->deep_link;
+	gchar *admob_app_id = data->admob_app_id;
+	gchar *snapchat_client_id = data->snapchat_client_id;
+	gchar *version_number = data->version_number;
+	gchar *build_number = data->build_number;
+	gchar *output_file = data->output_file;
+
+	int orientation = data->orientation;
+	int device_type = data->device_type;
+	int uses_ads = data->uses_ads;
+
+	export_job_set_stage( job, _("Preparing files") );
+
+	// CHECKS COMPLETE, START EXPORT
+
+	const gchar* path_to_codesign = "/usr/bin/codesign";
+	const gchar* path_to_security = "/usr/bin/security";
+	const gchar* path_to_actool = "/Applications/XCode.app/Contents/Developer/usr/bin/actool";
+	const gchar* path_to_ibtool = "/Applications/XCode.app/Contents/Developer/usr/bin/ibtool";
+
+	// make temporary folder
+	gchar* ios_folder = g_build_filename( app->datadir, "ios", NULL );
+	gchar* tmp_folder;
+    if ( data->project_base_path )
+        tmp_folder = export_job_get_folder( job, data->project_base_path, "build_stage_ios" );
+    else
+        tmp_folder = export_job_get_folder( job, data->default_base_path, "build_stage_ios" );
+	
+    gchar* app_folder = g_build_filename( tmp_folder, app_name, NULL );
+	SETPTR(app_folder, g_strconcat( app_folder, ".app", NULL ));
 
-	running = 1;
+	gchar* app_folder_name = g_strdup( app_name );
+	SETPTR(app_folder_name, g_strconcat( app_folder_name, ".app", NULL ));
 
-	if ( app->project && !ios_exporting_player )
+	utils_str_replace_char( ios_folder, '\\', '/' );
+	utils_str_replace_char( tmp_folder, '\\', '/' );
+	
+	gchar* src_folder = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player.app", NULL );
+	utils_str_replace_char( src_folder, '\\', '/' );
+
+	gchar* no_ads_binary = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player No Ads", NULL );
+	utils_str_replace_char( no_ads_binary, '\\', '/' );
+
+	gchar* icons_src_folder = g_build_path( "/", app->datadir, "ios", "source", "Icons.xcassets", NULL );
+	utils_str_replace_char( icons_src_folder, '\\', '/' );
+
+	gchar* icons_dst_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", NULL );
+	utils_str_replace_char( icons_dst_folder, '\\', '/' );
+
+	gchar* icons_sub_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", "AppIcon.appiconset", NULL );
+	utils_str_replace_char( icons_sub_folder, '\\', '/' );
+
+	gchar *output_file_zip = g_strdup( output_file );
+	gchar *ext = strrchr( output_file_zip, '.' );
+	if ( ext ) *ext = 0;
+	SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
+
+	// decalrations
+	gchar newcontents[ 32000 ];
+	gchar *contents = NULL;
+	gsize length = 0;
+	gchar *certificate_data = NULL;
+	gchar *bundle_id = NULL;
+	gchar *app_group_data = 0;
+	gchar *team_id = NULL;
+	gchar *cert_hash = NULL;
+	gchar *cert_temp = NULL;
+	gchar **argv = NULL;
+	gchar *str_out = NULL;
+	gint status = 0;
+	GError *error = NULL;
+	gchar *entitlements_file = NULL;
+	gchar *expanded_entitlements_file = NULL;
+	gchar *temp_filename1 = NULL;
+	gchar *temp_filename2 = NULL;
+	gchar *version_string = NULL;
+	gchar *build_string = NULL;
+	gchar *bundle_id2 = NULL; // don't free, pointer to sub string
+	gchar *image_filename = NULL;
+	UtilsIconSet *icon_set = NULL;
+	gchar *icon_cache_folder = NULL;
+	guint icon_index;
+	GdkPixbuf *splash_image = NULL;
+	gchar *user_name = NULL;
+	gchar *group_name = NULL;
+	mz_zip_archive zip_archive;
+	memset(&zip_archive, 0, sizeof(zip_archive));
+	const gchar *stage_keep[] = { app_folder_name, NULL };
+	const gchar *app_keep[] = { "media", NULL };
+
+	// the app folder is kept between exports and synced with the source app, the media folder is synced below
+	utils_prune_folder( tmp_folder, stage_keep );
+	if ( !utils_sync_folder( src_folder, app_folder, app_keep ) )
 	{
-		GtkWidget *widget; 
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.prov_profile_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		// splash screens
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.splash_logo) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
-		AGK_CLEAR_STR(app->project->ipa_settings.splash_color) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
-		//AGK_CLEAR_STR(app->project->ipa_settings.facebook_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
-		app->project->ipa_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.version_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
-		AGK_CLEAR_STR(app->project->ipa_settings.build_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
-		app->project->ipa_settings.device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
-		app->project->ipa_settings.uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
-
-		// output
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
-		app->project->ipa_settings.output_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		SHOW_ERR( _("Failed to copy source folder") );
+		goto ios_dialog_cleanup2;
 	}
 
-	if ( response != 1 )
+	if ( !uses_ads )
 	{
-		gtk_widget_hide(GTK_WIDGET(dialog));
+		gchar *binary_path = g_build_filename( app_folder, "AppGameKit Player", NULL );
+		utils_copy_file( no_ads_binary, binary_path, TRUE, NULL );
+		g_free( binary_path );
 	}
-	else
-	{
-		int i;
-		GtkWidget *widget;
-
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), FALSE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), FALSE );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		// app details
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
-		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
-		gchar *profile = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
-		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
-		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		// splash screens
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
-		gchar *app_splash_logo = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
-		gchar *app_splash_color = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
-		//gchar *facebook_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
-		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
-		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
-		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
-		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
-		int orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
-				
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
-		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
-		gchar *build_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-		if ( !*build_number ) SETPTR( build_number, g_strdup("1.0") );
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
-		int device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));;
-
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
-		int uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
-
-		// output
-		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
-		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
-
-		gchar *percent = 0;
-		while ( (percent = strchr(output_file, '%')) != 0 )
-		{
-			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
-			{
-				*percent = 0;
-				percent += strlen("[version]") + 1;
-				gchar *new_output = g_strconcat( output_file, build_number, percent, NULL );
-				g_free(output_file);
-				output_file = new_output;
-				continue;
-			}
-
-			break;
-		}
-
+	
+	// rename executable, using full paths as changing the working directory would affect other threads
+	temp_filename1 = g_build_filename( app_folder, "AppGameKit Player", NULL );
+	temp_filename2 = g_build_filename( app_folder, app_name, NULL );
+	g_rename( temp_filename1, temp_filename2 );
+	g_free( temp_filename1 );
+	g_free( temp_filename2 );
+	temp_filename1 = NULL;
+	temp_filename2 = NULL;
+	
+	if ( export_job_is_cancelled(job) ) goto ios_dialog_cleanup2;
 
-		// START CHECKS
+	// open provisioning profile and extract certificate
+	if ( !g_file_get_contents( profile, &contents, &length, NULL ) )
+	{
+		SHOW_ERR( _("Failed to read provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your IPA")); goto ios_dialog_clean_up; }
-		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto ios_dialog_clean_up; }
+    // provisioning profile starts as binary, so skip 100 bytes to get to text
+	gchar* certificate = strstr( contents+100, "<key>DeveloperCertificates</key>" );
+	if ( !certificate )
+	{
+		SHOW_ERR( _("Failed to read certificate from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// check app name
-		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto ios_dialog_clean_up; }
-		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto ios_dialog_clean_up; }
-		for( i = 0; i < strlen(app_name); i++ )
-		{
-			/*
-			if ( (app_name[i] < 97 || app_name[i] > 122)
-			  && (app_name[i] < 65 || app_name[i] > 90) 
-			  && (app_name[i] < 48 || app_name[i] > 57) 
-			  && app_name[i] != 32 
-			  && app_name[i] != 95 ) 
-			{ 
-				SHOW_ERR(_("App name contains invalid characters, must be A-Z 0-9 spaces and undersore only")); 
-				goto ios_dialog_clean_up; 
-			}
-			*/
-			//switch to black list
-			if ( app_name[i] == 34 || app_name[i] == 60 
-			  || app_name[i] == 62 || app_name[i] == 39
-			  || app_name[i] == 42 || app_name[i] == 46
-			  || app_name[i] == 47 || app_name[i] == 92
-			  || app_name[i] == 58 || app_name[i] == 59
-			  || app_name[i] == 124 || app_name[i] == 61
-			  || app_name[i] == 44 || app_name[i] == 38 )
-			{
-				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or any of the following < > * . / \\ : ; | = , &"));
-				goto ios_dialog_clean_up; 
-			}
-		}
-		
-		// check icon
-		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto ios_dialog_clean_up; }
-		if ( app_icon && *app_icon )
-		{
-			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto ios_dialog_clean_up; }
-		}
+	certificate = strstr( certificate, "<data>" );
+	if ( !certificate )
+	{
+		SHOW_ERR( _("Failed to read certificate data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		if ( firebase_config && *firebase_config )
-		{
-			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".plist" ) != 0 ) { SHOW_ERR(_("Firebase config file must be a .plist file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Firebase config file")); goto ios_dialog_clean_up; }
-		}
+	certificate += strlen("<data>");
+	gchar* certificate_end = strstr( certificate, "</data>" );
+	if ( !certificate_end )
+	{
+		SHOW_ERR( _("Failed to read certificate end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// check splash screen logo
-		if ( app_splash_logo && *app_splash_logo )
+    // copy certificate into local storage
+	gint cert_length = (gint) (certificate_end - certificate);
+	certificate_data = g_new0( gchar, cert_length+1 );
+	strncpy( certificate_data, certificate, cert_length );
+	certificate_data[ cert_length ] = 0;
+
+	utils_str_remove_chars( certificate_data, "\n\r" );
+    
+	// extract bundle ID, reuse variables
+	certificate = strstr( contents+100, "<key>application-identifier</key>" );
+	if ( !certificate )
+	{
+		SHOW_ERR( _("Failed to read bundle ID from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+
+	certificate = strstr( certificate, "<string>" );
+	if ( !certificate )
+	{
+		SHOW_ERR( _("Failed to read bundle ID data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+
+	certificate += strlen("<string>");
+	certificate_end = strstr( certificate, "</string>" );
+	if ( !certificate_end )
+	{
+		SHOW_ERR( _("Failed to read bundle ID end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+	
+    // copy bundle ID to local storage
+	cert_length = (gint) (certificate_end - certificate);
+	bundle_id = g_new0( gchar, cert_length+1 );
+	strncpy( bundle_id, certificate, cert_length );
+	bundle_id[ cert_length ] = 0;
+    
+    // look for beta entitlement
+    int betaReports = 0;
+    if ( strstr(contents+100, "<key>beta-reports-active</key>") != 0 )
+    {
+        betaReports = 1;
+    }
+    
+    // look for push notification entitlement
+    int pushNotifications = 0;
+    gchar* pushStr = strstr(contents+100, "<key>aps-environment</key>");
+    if ( pushStr != 0 )
+    {
+        gchar* pushType = strstr( pushStr, "<string>" );
+        if ( strncmp( pushType, "<string>development</string>", strlen("<string>development</string>") ) == 0 )
+            pushNotifications = 1;
+        else 
+            pushNotifications = 2;
+    }
+
+	// look for app groups
+	certificate = strstr( contents+100, "<key>com.apple.security.application-groups</key>" );
+	if ( certificate )
+	{
+		certificate = strstr( certificate, "<array>" );
+		if ( !certificate )
 		{
-			if ( !strrchr( app_splash_logo, '.' ) || utils_str_casecmp( strrchr( app_splash_logo, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Splash Screen Logo must be a PNG file")); goto ios_dialog_clean_up; }
-			if ( !g_file_test( app_splash_logo, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Splash Screen Logo location")); goto ios_dialog_clean_up; }
+			SHOW_ERR( _("Failed to read App Group data from provisioning profile") );
+			goto ios_dialog_cleanup2;
 		}
 
-		// check splash screen color
-		if ( app_splash_color && *app_splash_color )
+		app_group_data = strstr( certificate, "</array>" );
+		if ( !app_group_data )
 		{
-			if ( strlen( app_splash_color ) != 6 ) { SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); goto ios_dialog_clean_up; }
-			int i;
-			for( i = 0; i < strlen(app_splash_color); i++ )
-			{
-				if ( app_splash_color[i] >= 97 && app_splash_color[i] <= 102 ) app_splash_color[i] -= 32; // change to upper case
-				if ( (app_splash_color[i] < 48 || app_splash_color[i] > 57) && (app_splash_color[i] < 65 || app_splash_color[i] > 70) ) 
-				{ 
-					SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); 
-					goto ios_dialog_clean_up; 
-				}
-			}
+			SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
+			goto ios_dialog_cleanup2;
 		}
 
-		// check profile
-		if ( !profile || !*profile ) { SHOW_ERR(_("You must select a provisioning profile")); goto ios_dialog_clean_up; }
-		if ( !strrchr( profile, '.' ) || utils_str_casecmp( strrchr( profile, '.' ), ".mobileprovision" ) != 0 ) { SHOW_ERR(_("Provisioning profile must have .mobileprovision extension")); goto ios_dialog_clean_up; }
-		if ( !g_file_test( profile, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find provisioning profile location")); goto ios_dialog_clean_up; }
+		// quick hack to prevent next search going beyond the array list
+		*app_group_data = 0;
 
-		// check version
-		if ( !version_number || !*version_number ) { SHOW_ERR(_("You must enter a version number, e.g. 1.0.0")); goto ios_dialog_clean_up; }
-		for( i = 0; i < strlen(version_number); i++ )
-		{
-			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
-			{ 
-				SHOW_ERR(_("Version number contains invalid characters, must be 0-9 and . only")); 
-				goto ios_dialog_clean_up; 
-			}
-		}
+		// check there is at least one string
+		certificate_end = strstr( certificate, "<string>" );
 
-		// check facebook id
-		/*
-		if ( facebook_id && *facebook_id )
+		// repair the string
+		*app_group_data = '<'; 
+		app_group_data = 0;
+
+		if ( certificate_end )
 		{
-			for( i = 0; i < strlen(facebook_id); i++ )
+			// find the end of the list
+			certificate_end = strstr( certificate, "</array>" );
+			if ( !certificate_end )
 			{
-				if ( (facebook_id[i] < 48 || facebook_id[i] > 57) ) 
-				{ 
-					SHOW_ERR(_("Facebook App ID must be numbers only")); 
-					goto ios_dialog_clean_up; 
-				}
+				SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
+				goto ios_dialog_cleanup2;
 			}
+
+			certificate_end += strlen( "</array>" );
+			
+			// copy App Group strings to local storage
+			cert_length = (gint) (certificate_end - certificate);
+			app_group_data = g_new0( gchar, cert_length+1 );
+			strncpy( app_group_data, certificate, cert_length );
+			app_group_data[ cert_length ] = 0;
 		}
-		*/
+	}
 
-		if ( url_scheme && *url_scheme )
+	// look for cloud kit
+	int cloudKit = 0;
+    if ( strstr(contents+100, "<key>com.apple.developer.ubiquity-kvstore-identifier</key>") != 0 )
+    {
+        cloudKit = 1;
+    }
+	
+	// extract team ID, reuse variables
+	certificate = strstr( contents+100, "<key>com.apple.developer.team-identifier</key>" );
+	if ( !certificate )
+	{
+		certificate = strstr( contents+100, "<key>TeamIdentifier</key>" );
+		if ( !certificate )
 		{
-			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
-			{
-				SHOW_ERR(_("URL scheme must not contain : or /"));
-				goto ios_dialog_clean_up; 
-			}
+			SHOW_ERR( _("Failed to read team ID from provisioning profile") );
+			goto ios_dialog_cleanup2;
 		}
+	}
 
-		if ( deep_link && *deep_link )
+	certificate = strstr( certificate, "<string>" );
+	if ( !certificate )
+	{
+		SHOW_ERR( _("Failed to read team ID data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+
+	certificate += strlen("<string>");
+	certificate_end = strstr( certificate, "</string>" );
+	if ( !certificate_end )
+	{
+		SHOW_ERR( _("Failed to read team ID end data from provisioning profile") );
+		goto ios_dialog_cleanup2;
+	}
+	
+    // copy team ID to local storage
+	cert_length = (gint) (certificate_end - certificate);
+	team_id = g_new0( gchar, cert_length+1 );
+	strncpy( team_id, certificate, cert_length );
+	team_id[ cert_length ] = 0;
+	
+	if ( strncmp( team_id, bundle_id, strlen(team_id) ) == 0 )
+	{
+		// remove team ID
+		bundle_id2 = strchr( bundle_id, '.' );
+		if ( bundle_id2 ) bundle_id2++;
+		else bundle_id2 = bundle_id;
+	}
+	else
+	{
+		bundle_id2 = bundle_id;
+	}
+
+	// find all certificates, the identity is just the hash of the certificate
+	argv = g_new0( gchar*, 8 );
+	argv[0] = g_strdup( path_to_security );
+	argv[1] = g_strdup("find-certificate");
+	argv[2] = g_strdup("-a");
+	// certificate not guaranteed to have "iPhone" in the name
+	argv[3] = g_strdup("-p"); // use PEM format, same as provisioning profile
+	argv[4] = g_strdup("-Z"); // display hash
+	argv[5] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+
+	g_strfreev(argv);
+	argv = 0;
+	
+	if ( status != 0 && strstr(str_out,"SHA-1") == 0 )
+	{
+		if ( str_out && *str_out ) project_show_error(_("Failed to get code signing identities (error %d: %s)"), status, str_out );
+		else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+    // cycle through each certificate looking for one that matches provisioning profile
+	gchar *sha = strstr( str_out, "SHA-1 hash: " );
+	while ( sha )
+	{
+		sha += strlen( "SHA-1 hash: " );
+		gchar *sha_end = strchr( sha, '\n' );
+		if ( !sha_end )
 		{
-			if ( strchr( deep_link, '.' ) == 0 )
-			{
-				SHOW_ERR(_("Universal link must be a domain, e.g. www.appgamekit.com"));
-				goto ios_dialog_clean_up; 
-			}
+			SHOW_ERR( _("Failed to read code signing identity from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( admob_app_id && *admob_app_id )
+		gint length = (gint) (sha_end - sha);
+
+        // save hash for later, if this is the correct certificate then this will be the codesigning identity
+		if ( cert_hash ) g_free(cert_hash);
+		cert_hash = g_new0( gchar, length+1 );
+		strncpy( cert_hash, sha, length );
+		cert_hash[ length ] = 0;
+
+		sha = sha_end + 1;
+		sha = strstr( sha, "-----BEGIN CERTIFICATE-----" );
+		if ( !sha )
 		{
-			if ( strchr( admob_app_id, '~' ) == 0 )
-			{
-				SHOW_ERR(_("AdMob App ID must include a ~ character, for example \"ca-app-pub-3940256099942544~1458002511\""));
-				goto ios_dialog_clean_up; 
-			}
+			SHOW_ERR( _("Failed to read certificate data from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( !g_file_test( "/Applications/XCode.app/Contents/Developer/usr/bin/actool", G_FILE_TEST_EXISTS ) )
+		sha += strlen( "-----BEGIN CERTIFICATE-----" ) + 1;
+		sha_end = strstr( sha, "-----END CERTIFICATE-----" );
+		if ( !sha_end )
 		{
-			SHOW_ERR(_("You must install XCode to export iOS apps from the AGK IDE. XCode can be downloaded from the Mac AppStore")); 
-			goto ios_dialog_clean_up;
+			SHOW_ERR( _("Failed to read certificate end data from certificate list") );
+			goto ios_dialog_cleanup2;
 		}
-	
-		goto ios_dialog_continue;
 
-ios_dialog_clean_up:
-		if ( app_name ) g_free(app_name);
-		if ( profile ) g_free(profile);
-		if ( app_icon ) g_free(app_icon);
-		if ( firebase_config ) g_free(firebase_config);
-		if ( app_splash_logo ) g_free(app_splash_logo);
-		if ( app_splash_color ) g_free(app_splash_color);
-		//if ( facebook_id ) g_free(facebook_id);
-		if ( url_scheme ) g_free(url_scheme);
-		if ( deep_link ) g_free(deep_link);
-		if ( admob_app_id ) g_free(admob_app_id);
-		if ( snapchat_client_id ) g_free(snapchat_client_id);
-		if ( version_number ) g_free(version_number);
-		if ( output_file ) g_free(output_file);
+		length = (gint) (sha_end - sha);
 
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), TRUE );
-		running = 0;
-		return;
+        // copy certificate to temp variable and check it
+		if ( cert_temp ) g_free(cert_temp);
+		cert_temp = g_new0( gchar, length+1 );
+		strncpy( cert_temp, sha, length );
+		cert_temp[ length ] = 0;
 
-ios_dialog_continue:
+        // remove new line characters
+		utils_str_remove_chars( cert_temp, "\n\r" );
+        
+		if ( strcmp( cert_temp, certificate_data ) == 0 ) break; // we found the certificate
+
+		if ( cert_hash ) g_free(cert_hash);
+		cert_hash = 0;
+
+        // look for next certificate
+		sha = sha_end+1;
+		sha = strstr( sha, "SHA-1 hash: " );
+	}
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( !cert_hash )
+	{
+		SHOW_ERR( _("Could not find the certificate used to create the provisioning profile, have you added the certificate to your keychain?") );
+		goto ios_dialog_cleanup2;
+	}
 
-		// CHECKS COMPLETE, START EXPORT
+	g_free(str_out);
+	str_out = 0;
 
-		const gchar* path_to_codesign = "/usr/bin/codesign";
-		const gchar* path_to_security = "/usr/bin/security";
-		const gchar* path_to_actool = "/Applications/XCode.app/Contents/Developer/usr/bin/actool";
-		const gchar* path_to_ibtool = "/Applications/XCode.app/Contents/Developer/usr/bin/ibtool";
+	// find all valid identities
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( path_to_security );
+	argv[1] = g_strdup("find-identity");
+	argv[2] = g_strdup("-p");
+	argv[3] = g_strdup("codesigning");
+	argv[4] = g_strdup("-v");
+	argv[5] = NULL;
 
-		// make temporary folder
-		gchar* ios_folder = g_build_filename( app->datadir, "ios", NULL );
-		gchar* tmp_folder;
-        if ( !ios_exporting_player && app->project )
-            tmp_folder = g_build_filename( app->project->base_path, "build_tmp", NULL );
-        else
-            tmp_folder = g_build_filename( global_project_prefs.project_file_path, "build_tmp", NULL );
-		
-        gchar* app_folder = g_build_filename( tmp_folder, app_name, NULL );
-		SETPTR(app_folder, g_strconcat( app_folder, ".app", NULL ));
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+
+	g_strfreev(argv);
+	argv = 0;
+	
+	if ( status != 0 && strncmp(str_out,"  1) ",strlen("  1) ") != 0) )
+	{
+		if ( str_out && *str_out ) project_show_error(_("Failed to get code signing identities (error %d: %s)"), status, str_out );
+		else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+
+	// parse identities, look for the identity we found earlier
+	if ( strstr( str_out, cert_hash ) == 0 )
+	{
+		SHOW_ERR( _("Signing certificate is not valid, either the private key is missing from your keychain, or the certificate has expired") );
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( str_out ) g_free(str_out);
+	str_out = 0;
 
-		gchar* app_folder_name = g_strdup( app_name );
-		SETPTR(app_folder_name, g_strconcat( app_folder_name, ".app", NULL ));
+	if ( export_job_is_cancelled(job) ) goto ios_dialog_cleanup2;
 
-		utils_str_replace_char( ios_folder, '\\', '/' );
-		utils_str_replace_char( tmp_folder, '\\', '/' );
+	// write entitlements file
+	strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
+<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
+<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
+	strcat( newcontents, bundle_id );
+	strcat( newcontents, "</string>\n	<key>com.apple.developer.team-identifier</key>\n	<string>" );
+	strcat( newcontents, team_id );
+	strcat( newcontents, "</string>\n" );
+	
+	if ( betaReports )
+		strcat( newcontents, "	<key>beta-reports-active</key>\n	<true/>\n" );
 		
-		gchar* src_folder = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player.app", NULL );
-		utils_str_replace_char( src_folder, '\\', '/' );
 
-		gchar* no_ads_binary = g_build_path( "/", app->datadir, "ios", "source", "AppGameKit Player No Ads", NULL );
-		utils_str_replace_char( no_ads_binary, '\\', '/' );
+	if ( pushNotifications == 1 )
+		strcat( newcontents, "	<key>aps-environment</key>\n	<string>development</string>\n" );
+	else if ( pushNotifications == 2 )
+		strcat( newcontents, "	<key>aps-environment</key>\n	<string>production</string>\n" );
 
-		gchar* icons_src_folder = g_build_path( "/", app->datadir, "ios", "source", "Icons.xcassets", NULL );
-		utils_str_replace_char( icons_src_folder, '\\', '/' );
+	strcat( newcontents, "	<key>get-task-allow</key>\n	<false/>\n" );
 
-		gchar* icons_dst_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", NULL );
-		utils_str_replace_char( icons_dst_folder, '\\', '/' );
+	if ( app_group_data ) 
+	{
+		strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
+		strcat( newcontents, app_group_data );
+		strcat( newcontents, "\n" );
+	}
 
-		gchar* icons_sub_folder = g_build_path( "/", tmp_folder, "Icons.xcassets", "AppIcon.appiconset", NULL );
-		utils_str_replace_char( icons_sub_folder, '\\', '/' );
+	if ( cloudKit )
+	{
+		strcat( newcontents, "  <key>com.apple.developer.icloud-container-identifiers</key>\n	<array/>" );
+		strcat( newcontents, "  <key>com.apple.developer.ubiquity-kvstore-identifier</key>\n	<string>" );
+		strcat( newcontents, bundle_id );
+		strcat( newcontents, "</string>\n" );
+	}
 
-		gchar *output_file_zip = g_strdup( output_file );
-		gchar *ext = strrchr( output_file_zip, '.' );
-		if ( ext ) *ext = 0;
-		SETPTR( output_file_zip, g_strconcat( output_file_zip, ".zip", NULL ) );
+	if ( deep_link && *deep_link )
+	{
+		gchar *szDomain = strstr( deep_link, "://" );
+		if ( szDomain ) szDomain += 3;
+		else szDomain = deep_link;
+
+		gchar *szSlash = strchr( szDomain, '/' );
+		if ( szSlash ) *szSlash = 0;
+		strcat( newcontents, "  <key>com.apple.developer.associated-domains</key>\n <array>\n  <string>applinks:" );
+		strcat( newcontents, szDomain );
+		strcat( newcontents, "</string>\n</array>\n" );
+	}
 
-		// decalrations
-		gchar newcontents[ 32000 ];
-		gchar *contents = NULL;
-		gsize length = 0;
-		gchar *certificate_data = NULL;
-		gchar *bundle_id = NULL;
-		gchar *app_group_data = 0;
-		gchar *team_id = NULL;
-		gchar *cert_hash = NULL;
-		gchar *cert_temp = NULL;
-		gchar **argv = NULL;
-		gchar *str_out = NULL;
-		gint status = 0;
-		GError *error = NULL;
-		gchar *entitlements_file = NULL;
-		gchar *expanded_entitlements_file = NULL;
-		gchar *temp_filename1 = NULL;
-		gchar *temp_filename2 = NULL;
-		gchar *version_string = NULL;
-		gchar *build_string = NULL;
-		gchar *bundle_id2 = NULL; // don't free, pointer to sub string
-		gchar *image_filename = NULL;
-		gchar *temp_image_filename = NULL;
-		GdkPixbuf *icon_scaled_image = NULL;
-		GdkPixbuf *icon_image = NULL;
-		GdkPixbuf *splash_image = NULL;
-		gchar *user_name = NULL;
-		gchar *group_name = NULL;
-		mz_zip_archive zip_archive;
-		memset(&zip_archive, 0, sizeof(zip_archive));
-		
-		if ( !utils_copy_folder( src_folder, app_folder, TRUE, NULL ) )
-		{
-			SHOW_ERR( _("Failed to copy source folder") );
-			goto ios_dialog_cleanup2;
-		}
+	strcat( newcontents, "</dict>\n</plist>" );
 
-		if ( !uses_ads )
-		{
-			gchar *binary_path = g_build_filename( app_folder, "AppGameKit Player", NULL );
-			utils_copy_file( no_ads_binary, binary_path, TRUE, NULL );
-			g_free( binary_path );
-		}
-		
-		// rename executable
-		g_chdir( app_folder );
-		g_rename( "AppGameKit Player", app_name );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	entitlements_file = g_build_filename( tmp_folder, "entitlements.xcent", NULL );
 
-		// open provisioning profile and extract certificate
-		if ( !g_file_get_contents( profile, &contents, &length, NULL ) )
-		{
-			SHOW_ERR( _("Failed to read provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( !g_file_set_contents( entitlements_file, newcontents, strlen(newcontents), &error ) )
+	{
+		SHOW_ERR1( _("Failed to write entitlements file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-        // provisioning profile starts as binary, so skip 100 bytes to get to text
-		gchar* certificate = strstr( contents+100, "<key>DeveloperCertificates</key>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read certificate from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	// write archived expanded entitlements file
+	strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
+<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
+<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
+	strcat( newcontents, bundle_id );
+	strcat( newcontents, "</string>\n" );
 
-		certificate = strstr( certificate, "<data>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read certificate data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( app_group_data )
+	{
+		strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
+		strcat( newcontents, app_group_data );
+		strcat( newcontents, "\n" );
+	}
 
-		certificate += strlen("<data>");
-		gchar* certificate_end = strstr( certificate, "</data>" );
-		if ( !certificate_end )
-		{
-			SHOW_ERR( _("Failed to read certificate end data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	strcat( newcontents, "</dict>\n</plist>" );
 
-        // copy certificate into local storage
-		gint cert_length = (gint) (certificate_end - certificate);
-		certificate_data = g_new0( gchar, cert_length+1 );
-		strncpy( certificate_data, certificate, cert_length );
-		certificate_data[ cert_length ] = 0;
+	expanded_entitlements_file = g_build_filename( app_folder, "archived-expanded-entitlements.xcent", NULL );
 
-		utils_str_remove_chars( certificate_data, "\n\r" );
-        
-		// extract bundle ID, reuse variables
-		certificate = strstr( contents+100, "<key>application-identifier</key>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read bundle ID from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( !g_file_set_contents( expanded_entitlements_file, newcontents, strlen(newcontents), &error ) )
+	{
+		SHOW_ERR1( _("Failed to write expanded entitlements file: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-		certificate = strstr( certificate, "<string>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read bundle ID data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	// copy Firebase config file
+	if ( firebase_config && *firebase_config )
+	{
+		temp_filename1 = g_build_filename( app_folder, "GoogleService-Info.plist", NULL );
+		utils_copy_file( firebase_config, temp_filename1, TRUE, NULL );
+		g_free(temp_filename1);
+	}
 
-		certificate += strlen("<string>");
-		certificate_end = strstr( certificate, "</string>" );
-		if ( !certificate_end )
-		{
-			SHOW_ERR( _("Failed to read bundle ID end data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
-		
-        // copy bundle ID to local storage
-		cert_length = (gint) (certificate_end - certificate);
-		bundle_id = g_new0( gchar, cert_length+1 );
-		strncpy( bundle_id, certificate, cert_length );
-		bundle_id[ cert_length ] = 0;
-        
-        // look for beta entitlement
-        int betaReports = 0;
-        if ( strstr(contents+100, "<key>beta-reports-active</key>") != 0 )
+	// copy provisioning profile
+	temp_filename1 = g_build_filename( app_folder, "embedded.mobileprovision", NULL );
+	utils_copy_file( profile, temp_filename1, TRUE, NULL );
+	// edit Info.plist
+	g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "Info.plist", NULL );
+
+	if ( contents ) g_free(contents);
+	contents = 0;
+	if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
+	{
+		SHOW_ERR( _("Failed to read Info.plist file") );
+		goto ios_dialog_cleanup2;
+	}
+
+	utils_str_replace_all( &contents, "${PRODUCT_NAME}", app_name );
+	utils_str_replace_all( &contents, "${EXECUTABLE_NAME}", app_name );
+	if ( admob_app_id && *admob_app_id ) utils_str_replace_all( &contents, "${ADMOB_APP_ID}", admob_app_id );
+	else utils_str_replace_all( &contents, "${ADMOB_APP_ID}", "ca-app-pub-3940256099942544~1458002511" ); // needs something, use TGC Admob value
+	if ( snapchat_client_id && *snapchat_client_id ) utils_str_replace_all( &contents, "${SNAPCHAT_ID}", snapchat_client_id );
+	utils_str_replace_all( &contents, "com.thegamecreators.agk2player", bundle_id2 );
+	//if ( facebook_id && *facebook_id ) utils_str_replace_all( &contents, "358083327620324", facebook_id );
+	const char* urlschemereplacement = "<string>${URLSCHEMES}</string>\n";
+	if ( strstr( contents, urlschemereplacement ) == 0 ) urlschemereplacement = "<string>${URLSCHEMES}</string>\r\n";
+	if ( url_scheme && *url_scheme ) 
+	{
+		gchar* newUrlSchemes = g_new0( gchar*, strlen(url_scheme) + 30 );
+		strcpy( newUrlSchemes, "<string>" );
+		strcat( newUrlSchemes, url_scheme );
+		strcat( newUrlSchemes, "</string>\n" );
+		utils_str_replace_all( &contents, urlschemereplacement, newUrlSchemes );
+		g_free( newUrlSchemes );
+	}
+	else
+	{
+		utils_str_replace_all( &contents, urlschemereplacement, "" );
+	}
+
+	switch( orientation )
+	{
+		case 0:
+        {
+            utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortrait</string>", "" );
+            utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortraitUpsideDown</string>", "" );
+            utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationLandscapeLeft" );
+            break;
+        }
+		case 1:
         {
-            betaReports = 1;
+            utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeLeft</string>", "" );
+            utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeRight</string>", "" );
+            utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
+            break;
         }
-        
-        // look for push notification entitlement
-        int pushNotifications = 0;
-        gchar* pushStr = strstr(contents+100, "<key>aps-environment</key>");
-        if ( pushStr != 0 )
+		case 2:
         {
-            gchar* pushType = strstr( pushStr, "<string>" );
-            if ( strncmp( pushType, "<string>development</string>", strlen("<string>development</string>") ) == 0 )
-                pushNotifications = 1;
-            else 
-                pushNotifications = 2;
+			utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
+            break;
         }
+	}
+	
+	utils_str_replace_all( &contents, "${VERSION}", version_number );
+	utils_str_replace_all( &contents, "${BUILD}", build_number );
 
-		// look for app groups
-		certificate = strstr( contents+100, "<key>com.apple.security.application-groups</key>" );
-		if ( certificate )
-		{
-			certificate = strstr( certificate, "<array>" );
-			if ( !certificate )
-			{
-				SHOW_ERR( _("Failed to read App Group data from provisioning profile") );
-				goto ios_dialog_cleanup2;
-			}
+	if ( device_type == 1 ) utils_str_replace_all( &contents, "\t\t<integer>2</integer>\n", "" );
+	else if ( device_type == 2 ) utils_str_replace_all( &contents, "\t\t<integer>1</integer>\n", "" );
 
-			app_group_data = strstr( certificate, "</array>" );
-			if ( !app_group_data )
-			{
-				SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
-				goto ios_dialog_cleanup2;
-			}
+	//
+	if ( uses_ads )
+	{
+		//char advert [ 1024 ] = "";
 
-			// quick hack to prevent next search going beyond the array list
-			*app_group_data = 0;
+		
+		gchar* advert = g_new0 ( gchar*, 30000 );
 
-			// check there is at least one string
-			certificate_end = strstr( certificate, "<string>" );
+		
+		strcpy ( advert, "<key>NSUserTrackingUsageDescription</key>\n" );
+		strcat ( advert, "<string>This identifier will be used to deliver personalized ads to you.</string>\n" );
+		strcat ( advert, "<key>SKAdNetworkItems</key>\n" );
+		strcat ( advert, "<array>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>2u9pt9hc89.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>44jx6755aq.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>4fzdc2evr5.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>4pfyvq9l8r.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>737z793b9f.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>7ug5zh24hu.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>8s468mfl3y.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>9rd848q2bz.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>9t245vhmpl.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>av6w8kgt66.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>c6k4g5qg8m.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>cj5566h2ga.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>F38H382JLK.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>glqzh8vgby.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>hs6bdukanm.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>mlmmfzh3r3.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>prcb7njmu6.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>t38b2kh725.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>tl55sbb4fm.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>w9q455wk68.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>wg4vff78zm.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>yclnxrl5pm.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>ydx93a7ass.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>s39g8k73mm.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>m8dbw4sv7c.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>4468km3ulz.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>8s468mfl3y.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>lr83yxwka7.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>9nlqeag3gk.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>mls7yz5dvl.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>p78axxw29g.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>v72qych5uu.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>6xzpu9s2p8.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>g28c52eehv.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>523jb4fst2.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>ggvn48r87g.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>3sh42y64q3.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>24t9a8vw3c.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>ejvt5qm6ak.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>cstr6suwn9.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>wzmmz9fp6w.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>5lm9lj6jb7.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>zmvfpc5aq8.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>7rz58n8ntl.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>feyaarzu9v.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>n9x2a789qt.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>5a6flpkh64.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>424m5254lk.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>5l3tpt7t6e.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>uw77j35x4d.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>gta9lk7p23.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>kbd757ywx3.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>cg4yq2srnc.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>ludvb6z3bs.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>22mmun2rn5.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>su67r6k2v3.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>4w7y6s5ca2.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>klf5c3l5u5.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>dzg6xy7pwj.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>y45688jllp.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>hdw39hrw9y.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>ppxm28t8ap.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>4dzt52r2t5.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>mtkv5xtk9e.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>5tjdwbrq8w.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>3rd42ekr43.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>klf5c3l5u5.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>x44k69ngh6.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>pwa73g5rt2.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>mp6xlyr22a.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>qqp299437r.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>xy9t38ct57.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>54nzkqm89y.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>9b89h5y424.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>32z4fx6l9h.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>79pbpufp6p.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>275upjj5gd.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>294l99pt4k.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>2fnua5tdw4.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>32z4fx6l9h.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>3qcr597p9d.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>44n7hlldy6.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>54nzkqm89y.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>578prtvx9j.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>6g9af3uyq4.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>6p4ks3rnbw.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>79pbpufp6p.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>97r2b46745.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>9b89h5y424.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>e5fvkxwrpn.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>f73kdq92p3.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>g2y4y55b64.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>k674qkevps.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>mp6xlyr22a.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>n6fk4nfna4.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>qqp299437r.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>rx5hdcabgc.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>s69wq72ugq.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>u679fj5vs4.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>xy9t38ct57.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>kbmxgpxpgc.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "<dict>\n" );
+		strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
+		strcat ( advert, "<string>rvh3l7un93.skadnetwork</string>\n" );
+		strcat ( advert, "</dict>\n" );
+		strcat ( advert, "</array>\n" );
+
+		utils_str_replace_all ( &contents, "<key>${ADVERT_ITEMS}</key><string></string>", advert );
+		
 
-			// repair the string
-			*app_group_data = '<'; 
-			app_group_data = 0;
+		g_free ( advert );
+		
+	}
+	
+	//
 
-			if ( certificate_end )
-			{
-				// find the end of the list
-				certificate_end = strstr( certificate, "</array>" );
-				if ( !certificate_end )
-				{
-					SHOW_ERR( _("Failed to read App Group end data from provisioning profile") );
-					goto ios_dialog_cleanup2;
-				}
+	if ( !g_file_set_contents( temp_filename1, contents, strlen(contents), NULL ) )
+	{
+		SHOW_ERR( _("Failed to write Info.plist file") );
+		goto ios_dialog_cleanup2;
+	}
 
-				certificate_end += strlen( "</array>" );
-				
-				// copy App Group strings to local storage
-				cert_length = (gint) (certificate_end - certificate);
-				app_group_data = g_new0( gchar, cert_length+1 );
-				strncpy( app_group_data, certificate, cert_length );
-				app_group_data[ cert_length ] = 0;
-			}
-		}
+	g_free(str_out);
+	str_out = 0;
 
-		// look for cloud kit
-		int cloudKit = 0;
-        if ( strstr(contents+100, "<key>com.apple.developer.ubiquity-kvstore-identifier</key>") != 0 )
-        {
-            cloudKit = 1;
-        }
-		
-		// extract team ID, reuse variables
-		certificate = strstr( contents+100, "<key>com.apple.developer.team-identifier</key>" );
-		if ( !certificate )
-		{
-			certificate = strstr( contents+100, "<key>TeamIdentifier</key>" );
-			if ( !certificate )
-			{
-				SHOW_ERR( _("Failed to read team ID from provisioning profile") );
-				goto ios_dialog_cleanup2;
-			}
-		}
+	// convert plist to binary
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/plutil" );
+	argv[1] = g_strdup("-convert");
+	argv[2] = g_strdup("binary1");
+	argv[3] = g_strdup(temp_filename1);
+	argv[4] = NULL;
 
-		certificate = strstr( certificate, "<string>" );
-		if ( !certificate )
-		{
-			SHOW_ERR( _("Failed to read team ID data from provisioning profile") );
-			goto ios_dialog_cleanup2;
-		}
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+
+	g_strfreev(argv);
+	argv = 0;
+	
+    /*
+	if ( status != 0 )
+	{
+		SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+     */
 
-		certificate += strlen("<string>");
-		certificate_end = strstr( certificate, "</string>" );
-		if ( !certificate_end )
+	export_job_set_stage( job, _("Processing icons") );
+
+	// load icon file
+	if ( app_icon && *app_icon )
+	{
+		// write Icons.xcassets file
+		if ( !utils_copy_folder( icons_src_folder, icons_dst_folder, TRUE, NULL ) )
 		{
-			SHOW_ERR( _("Failed to read team ID end data from provisioning profile") );
+			SHOW_ERR( _("Failed to create icon asset catalog") );
 			goto ios_dialog_cleanup2;
 		}
-		
-        // copy team ID to local storage
-		cert_length = (gint) (certificate_end - certificate);
-		team_id = g_new0( gchar, cert_length+1 );
-		strncpy( team_id, certificate, cert_length );
-		team_id[ cert_length ] = 0;
-		
-		if ( strncmp( team_id, bundle_id, strlen(team_id) ) == 0 )
+
+		// generated icons are kept between exports of a project, they only change when the source image does
+		if ( data->project_base_path )
+			icon_cache_folder = g_build_path( "/", data->project_base_path, "build_cache", "icons", NULL );
+
+		// scale it and save it, 60x60 is no longer needed
+		icon_set = utils_icon_set_new( icon_cache_folder );
+		for ( icon_index = 0; icon_index < G_N_ELEMENTS(ios_icon_sizes); icon_index++ )
 		{
-			// remove team ID
-			bundle_id2 = strchr( bundle_id, '.' );
-			if ( bundle_id2 ) bundle_id2++;
-			else bundle_id2 = bundle_id;
+			gint size = ios_icon_sizes[icon_index];
+			gchar name[32];
+			g_snprintf( name, sizeof(name), "icon-%d.png", size );
+			image_filename = g_build_path( "/", icons_sub_folder, name, NULL );
+			utils_icon_set_add( icon_set, image_filename, size, size, TRUE );
+			g_free( image_filename );
 		}
-		else
+		image_filename = NULL;
+
+		if ( !utils_icon_set_write( icon_set, app_icon, &error ) )
 		{
-			bundle_id2 = bundle_id;
+			SHOW_ERR1( _("Failed to create app icon: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto ios_dialog_cleanup2;
 		}
-
-		// find all certificates, the identity is just the hash of the certificate
-		argv = g_new0( gchar*, 8 );
-		argv[0] = g_strdup( path_to_security );
-		argv[1] = g_strdup("find-certificate");
-		argv[2] = g_strdup("-a");
-		// certificate not guaranteed to have "iPhone" in the name
-		argv[3] = g_strdup("-p"); // use PEM format, same as provisioning profile
-		argv[4] = g_strdup("-Z"); // display hash
-		argv[5] = NULL;
+		utils_icon_set_free( icon_set );
+		icon_set = NULL;
+
+		// run actool to compile asset catalog, it will copy the app icons to the app_folder and create the Assets.car file
+		argv = g_new0( gchar*, 20 );
+		argv[0] = g_strdup( path_to_actool );
+		argv[1] = g_strdup("--output-partial-info-plist");
+		argv[2] = g_strdup("temp.plist");
+		argv[3] = g_strdup("--app-icon");
+		argv[4] = g_strdup("AppIcon");
+		argv[5] = g_strdup("--target-device");
+		argv[6] = g_strdup("iphone");
+		argv[7] = g_strdup("--target-device");
+		argv[8] = g_strdup("ipad");
+		argv[9] = g_strdup("--minimum-deployment-target");
+		argv[10] = g_strdup("9.0");
+		argv[11] = g_strdup("--platform");
+		argv[12] = g_strdup("iphoneos");
+		argv[13] = g_strdup("--product-type");
+		argv[14] = g_strdup("com.apple.product-type.application");
+		argv[15] = g_strdup("--compress-pngs");
+		argv[16] = g_strdup("--compile");
+		argv[17] = g_strdup(app_folder_name);
+		argv[18] = g_strdup("Icons.xcassets");
+		argv[19] = NULL;
 
 		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
 		{
-			SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
+			SHOW_ERR1( _("Failed to run \"actool\" program: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto ios_dialog_cleanup2;
 		}
-
-		g_strfreev(argv);
-		argv = 0;
-		
-		if ( status != 0 && strstr(str_out,"SHA-1") == 0 )
+	
+		if ( !str_out || strstr(str_out,"actool.errors") != 0 || strstr(str_out,"actool.warnings") != 0 || strstr(str_out,"actool.notices") != 0 )
 		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+			if ( str_out && *str_out ) project_show_error(_("Failed to compile asset catalog (error %d: %s)"), status, str_out );
+			else SHOW_ERR1( _("Failed to get compile asset catalog (error: %d)"), status );
 			goto ios_dialog_cleanup2;
 		}
 
-        // cycle through each certificate looking for one that matches provisioning profile
-		gchar *sha = strstr( str_out, "SHA-1 hash: " );
-		while ( sha )
-		{
-			sha += strlen( "SHA-1 hash: " );
-			gchar *sha_end = strchr( sha, '\n' );
-			if ( !sha_end )
-			{
-				SHOW_ERR( _("Failed to read code signing identity from certificate list") );
-				goto ios_dialog_cleanup2;
-			}
-
-			gint length = (gint) (sha_end - sha);
+		g_free(str_out);
+		str_out = 0;
+		g_strfreev(argv);
+		argv = 0;
+	}
 
-            // save hash for later, if this is the correct certificate then this will be the codesigning identity
-			if ( cert_hash ) g_free(cert_hash);
-			cert_hash = g_new0( gchar, length+1 );
-			strncpy( cert_hash, sha, length );
-			cert_hash[ length ] = 0;
+	if ( export_job_is_cancelled(job) ) goto ios_dialog_cleanup2;
 
-			sha = sha_end + 1;
-			sha = strstr( sha, "-----BEGIN CERTIFICATE-----" );
-			if ( !sha )
-			{
-				SHOW_ERR( _("Failed to read certificate data from certificate list") );
-				goto ios_dialog_cleanup2;
-			}
+	// copy splash logo
+	if ( app_splash_logo && *app_splash_logo )
+	{
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "SplashLogo.png", NULL );
+		utils_copy_file( app_splash_logo, temp_filename1, TRUE, NULL );
+	}
+	
+	if ( app_splash_color && *app_splash_color )
+	{
+		int iRed = hextoint( app_splash_color[0] ) * 16 + hextoint( app_splash_color[1] );
+		int iGreen = hextoint( app_splash_color[2] ) * 16 + hextoint( app_splash_color[3] );
+		int iBlue = hextoint( app_splash_color[4] ) * 16 + hextoint( app_splash_color[5] );
 
-			sha += strlen( "-----BEGIN CERTIFICATE-----" ) + 1;
-			sha_end = strstr( sha, "-----END CERTIFICATE-----" );
-			if ( !sha_end )
-			{
-				SHOW_ERR( _("Failed to read certificate end data from certificate list") );
-				goto ios_dialog_cleanup2;
-			}
+		float red = iRed / 255.0f;
+		float green = iGreen / 255.0f;
+		float blue = iBlue / 255.0f;
 
-			length = (gint) (sha_end - sha);
+		// edit UntitledViewController
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
 
-            // copy certificate to temp variable and check it
-			if ( cert_temp ) g_free(cert_temp);
-			cert_temp = g_new0( gchar, length+1 );
-			strncpy( cert_temp, sha, length );
-			cert_temp[ length ] = 0;
+		if ( contents ) g_free(contents);
+		contents = 0;
+		if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
+		{
+			SHOW_ERR( _("Failed to read UntitledViewController.xib file") );
+			goto ios_dialog_cleanup2;
+		}
 
-            // remove new line characters
-			utils_str_remove_chars( cert_temp, "\n\r" );
-            
-			if ( strcmp( cert_temp, certificate_data ) == 0 ) break; // we found the certificate
+		*newcontents = 0;
+		char* start = strstr( contents, "backgroundColor\"" );
+		if ( !start )
+		{
+			SHOW_ERR( _("Failed to modify UntitledViewController.xib, backgroundColor not found") );
+			goto ios_dialog_cleanup2;
+		}
 
-			if ( cert_hash ) g_free(cert_hash);
-			cert_hash = 0;
+		start += strlen("backgroundColor\"");
+		*start = 0;
+		strcpy( newcontents, contents );
+		*start = ' ';
 
-            // look for next certificate
-			sha = sha_end+1;
-			sha = strstr( sha, "SHA-1 hash: " );
-		}
+		char newcolor[ 256 ];
+		*newcolor = 0;
+		sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
+		strcat( newcontents, newcolor );
 
-		if ( !cert_hash )
+		start = strstr( start, "alpha=" );
+		if ( !start )
 		{
-			SHOW_ERR( _("Could not find the certificate used to create the provisioning profile, have you added the certificate to your keychain?") );
+			SHOW_ERR( _("Failed to modify UntitledViewController.xib, alpha not found") );
 			goto ios_dialog_cleanup2;
 		}
 
-		g_free(str_out);
-		str_out = 0;
-
-		// find all valid identities
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( path_to_security );
-		argv[1] = g_strdup("find-identity");
-		argv[2] = g_strdup("-p");
-		argv[3] = g_strdup("codesigning");
-		argv[4] = g_strdup("-v");
-		argv[5] = NULL;
+		strcat( newcontents, start );
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
 		{
-			SHOW_ERR1( _("Failed to run \"security\" program: %s"), error->message );
+			SHOW_ERR1( _("Failed to write UntitledViewController.xib file: %s"), error->message );
 			g_error_free(error);
 			error = NULL;
 			goto ios_dialog_cleanup2;
 		}
-
-		g_strfreev(argv);
-		argv = 0;
 		
-		if ( status != 0 && strncmp(str_out,"  1) ",strlen("  1) ") != 0) )
+		// edit storyboard
+		if ( temp_filename1 ) g_free(temp_filename1);
+		temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
+
+		if ( contents ) g_free(contents);
+		contents = 0;
+		if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
 		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to get code signing identities (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get code signing identities (error: %d)"), status );
+			SHOW_ERR( _("Failed to read LaunchScreen.storyboard file") );
 			goto ios_dialog_cleanup2;
-		}
+		}	
 
-		// parse identities, look for the identity we found earlier
-		if ( strstr( str_out, cert_hash ) == 0 )
+		*newcontents = 0;
+		start = strstr( contents, "backgroundColor\"" );
+		if ( !start )
 		{
-			SHOW_ERR( _("Signing certificate is not valid, either the private key is missing from your keychain, or the certificate has expired") );
+			SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, backgroundColor not found") );
 			goto ios_dialog_cleanup2;
 		}
-		
-		if ( str_out ) g_free(str_out);
-		str_out = 0;
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
 
-		// write entitlements file
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
-<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
-<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
-		strcat( newcontents, bundle_id );
-		strcat( newcontents, "</string>\n	<key>com.apple.developer.team-identifier</key>\n	<string>" );
-		strcat( newcontents, team_id );
-		strcat( newcontents, "</string>\n" );
-		
-		if ( betaReports )
-			strcat( newcontents, "	<key>beta-reports-active</key>\n	<true/>\n" );
-			
-
-		if ( pushNotifications == 1 )
-			strcat( newcontents, "	<key>aps-environment</key>\n	<string>development</string>\n" );
-		else if ( pushNotifications == 2 )
-			strcat( newcontents, "	<key>aps-environment</key>\n	<string>production</string>\n" );
+		start += strlen("backgroundColor\"");
+		*start = 0;
+		strcpy( newcontents, contents );
+		*start = ' ';
 
-		strcat( newcontents, "	<key>get-task-allow</key>\n	<false/>\n" );
+		*newcolor = 0;
+		sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
+		strcat( newcontents, newcolor );
 
-		if ( app_group_data ) 
+		start = strstr( start, "alpha=" );
+		if ( !start )
 		{
-			strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
-			strcat( newcontents, app_group_data );
-			strcat( newcontents, "\n" );
+			SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, alpha not found") );
+			goto ios_dialog_cleanup2;
 		}
 
-		if ( cloudKit )
+		strcat( newcontents, start );
+
+		if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
 		{
-			strcat( newcontents, "  <key>com.apple.developer.icloud-container-identifiers</key>\n	<array/>" );
-			strcat( newcontents, "  <key>com.apple.developer.ubiquity-kvstore-identifier</key>\n	<string>" );
-			strcat( newcontents, bundle_id );
-			strcat( newcontents, "</string>\n" );
+			SHOW_ERR1( _("Failed to write LaunchScreen.storyboard file: %s"), error->message );
+			g_error_free(error);
+			error = NULL;
+			goto ios_dialog_cleanup2;
 		}
+	}
 
-		if ( deep_link && *deep_link )
-		{
-			gchar *szDomain = strstr( deep_link, "://" );
-			if ( szDomain ) szDomain += 3;
-			else szDomain = deep_link;
+	export_job_set_stage( job, _("Compiling interface files") );
+
+	// compile UntitledViewController
+	argv = g_new0( gchar*, 19 );
+	argv[0] = g_strdup( path_to_ibtool );
+	argv[1] = g_strdup("--errors");
+	argv[2] = g_strdup("--warnings");
+	argv[3] = g_strdup("--notices");
+	argv[4] = g_strdup("--module");
+	argv[5] = g_strdup("AppGameKit_Player");
+	argv[6] = g_strdup("--auto-activate-custom-fonts");
+	argv[7] = g_strdup("--target-device");
+	argv[8] = g_strdup("iphone");
+	argv[9] = g_strdup("--target-device");
+	argv[10] = g_strdup("ipad");
+	argv[11] = g_strdup("--minimum-deployment-target");
+	argv[12] = g_strdup("9.0");
+	argv[13] = g_strdup("--output-format");
+	argv[14] = g_strdup("human-readable-text");
+	argv[15] = g_strdup("--compile");
+	argv[16] = g_strdup("UntitledViewController.nib");
+	argv[17] = g_strdup("UntitledViewController.xib");
+	argv[18] = NULL;
+		
+	if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
+	{
+		if ( str_out && *str_out ) project_show_error(_("Failed to compile UntitledViewController.nib (error %d: %s)"), status, str_out );
+		else SHOW_ERR1( _("Failed to get compile UntitledViewController.nib (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-			gchar *szSlash = strchr( szDomain, '/' );
-			if ( szSlash ) *szSlash = 0;
-			strcat( newcontents, "  <key>com.apple.developer.associated-domains</key>\n <array>\n  <string>applinks:" );
-			strcat( newcontents, szDomain );
-			strcat( newcontents, "</string>\n</array>\n" );
-		}
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// delete old UntitledViewController.xib
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
+	g_unlink( temp_filename1 );
+
+
+	// compile storyboard
+	argv = g_new0( gchar*, 19 );
+	argv[0] = g_strdup( path_to_ibtool );
+	argv[1] = g_strdup("--errors");
+	argv[2] = g_strdup("--warnings");
+	argv[3] = g_strdup("--notices");
+	argv[4] = g_strdup("--module");
+	argv[5] = g_strdup("AppGameKit_Player");
+	argv[6] = g_strdup("--auto-activate-custom-fonts");
+	argv[7] = g_strdup("--target-device");
+	argv[8] = g_strdup("iphone");
+	argv[9] = g_strdup("--target-device");
+	argv[10] = g_strdup("ipad");
+	argv[11] = g_strdup("--minimum-deployment-target");
+	argv[12] = g_strdup("9.0");
+	argv[13] = g_strdup("--output-format");
+	argv[14] = g_strdup("human-readable-text");
+	argv[15] = g_strdup("--compilation-directory");
+	argv[16] = g_strdup("./");
+	argv[17] = g_strdup("LaunchScreen.storyboard");
+	argv[18] = NULL;
+		
+	if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
+	{
+		if ( str_out && *str_out ) project_show_error(_("Failed to compile LaunchScreen.storyboard (error %d: %s)"), status, str_out );
+		else SHOW_ERR1( _("Failed to get compile LaunchScreen.storyboard (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-		strcat( newcontents, "</dict>\n</plist>" );
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
 
-		entitlements_file = g_build_filename( tmp_folder, "entitlements.xcent", NULL );
+	// delete old storyboard
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
+	g_unlink( temp_filename1 );
+	
+	if ( export_job_is_cancelled(job) ) goto ios_dialog_cleanup2;
 
-		if ( !g_file_set_contents( entitlements_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write entitlements file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+	// sync media folder, removing media left from an earlier export if there is none now
+    if ( temp_filename2 ) g_free(temp_filename2);
+    temp_filename2 = g_build_filename( app_folder, "media", NULL );
+    if ( data->project_base_path )
+    {
+        if ( temp_filename1 ) g_free(temp_filename1);
+        temp_filename1 = g_build_filename( data->project_base_path, "media", NULL );
+    }
+    if ( data->project_base_path && g_file_test( temp_filename1, G_FILE_TEST_IS_DIR ) )
+        utils_sync_folder( temp_filename1, temp_filename2, NULL );
+    else
+        utils_remove_folder_recursive( temp_filename2 );
+
+	g_free(str_out);
+	str_out = 0;
+
+	// find user name
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/id" );
+	argv[1] = g_strdup("-u");
+	argv[2] = g_strdup("-n");
+	argv[3] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || !*str_out )
+	{
+		SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-		// write archived expanded entitlements file
-		strcpy( newcontents, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\
-<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n\
-<plist version=\"1.0\">\n<dict>\n	<key>application-identifier</key>\n	<string>" );
-		strcat( newcontents, bundle_id );
-		strcat( newcontents, "</string>\n" );
+	user_name = g_strdup( str_out );
+    user_name[ strlen(user_name)-1 ] = 0;
 
-		if ( app_group_data )
-		{
-			strcat( newcontents, "	<key>com.apple.security.application-groups</key>\n" );
-			strcat( newcontents, app_group_data );
-			strcat( newcontents, "\n" );
-		}
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
 
-		strcat( newcontents, "</dict>\n</plist>" );
+	// find group name
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/bin/id" );
+	argv[1] = g_strdup("-g");
+	argv[2] = g_strdup("-n");
+	argv[3] = NULL;
 
-		expanded_entitlements_file = g_build_filename( app_folder, "archived-expanded-entitlements.xcent", NULL );
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run groupid program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( !str_out || !*str_out )
+	{
+		SHOW_ERR1( _("Failed to get group name (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
 
-		if ( !g_file_set_contents( expanded_entitlements_file, newcontents, strlen(newcontents), &error ) )
-		{
-			SHOW_ERR1( _("Failed to write expanded entitlements file: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+	group_name = g_strdup( str_out );
+    group_name[ strlen(group_name)-1 ] = 0;
 
-		// copy Firebase config file
-		if ( firebase_config && *firebase_config )
-		{
-			temp_filename1 = g_build_filename( app_folder, "GoogleService-Info.plist", NULL );
-			utils_copy_file( firebase_config, temp_filename1, TRUE, NULL );
-			g_free(temp_filename1);
-		}
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
 
-		// copy provisioning profile
-		temp_filename1 = g_build_filename( app_folder, "embedded.mobileprovision", NULL );
-		utils_copy_file( profile, temp_filename1, TRUE, NULL );
-		// edit Info.plist
-		g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "Info.plist", NULL );
+	export_job_set_stage( job, _("Signing") );
 
-		if ( contents ) g_free(contents);
-		contents = 0;
-		if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
-		{
-			SHOW_ERR( _("Failed to read Info.plist file") );
-			goto ios_dialog_cleanup2;
-		}
+	// prepare bundle
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/usr/sbin/chown" );
+	argv[1] = g_strdup("-RH");
+	argv[2] = g_strconcat( user_name, ":", group_name, NULL );
+	argv[3] = g_strdup(app_folder);
+	argv[4] = NULL;
+    
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run chown program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+    /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file ownership (error: %s)"), str_out );
+		else SHOW_ERR1( _("Failed to set file ownership (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+     */
 
-		utils_str_replace_all( &contents, "${PRODUCT_NAME}", app_name );
-		utils_str_replace_all( &contents, "${EXECUTABLE_NAME}", app_name );
-		if ( admob_app_id && *admob_app_id ) utils_str_replace_all( &contents, "${ADMOB_APP_ID}", admob_app_id );
-		else utils_str_replace_all( &contents, "${ADMOB_APP_ID}", "ca-app-pub-3940256099942544~1458002511" ); // needs something, use TGC Admob value
-		if ( snapchat_client_id && *snapchat_client_id ) utils_str_replace_all( &contents, "${SNAPCHAT_ID}", snapchat_client_id );
-		utils_str_replace_all( &contents, "com.thegamecreators.agk2player", bundle_id2 );
-		//if ( facebook_id && *facebook_id ) utils_str_replace_all( &contents, "358083327620324", facebook_id );
-		const char* urlschemereplacement = "<string>${URLSCHEMES}</string>\n";
-		if ( strstr( contents, urlschemereplacement ) == 0 ) urlschemereplacement = "<string>${URLSCHEMES}</string>\r\n";
-		if ( url_scheme && *url_scheme ) 
-		{
-			gchar* newUrlSchemes = g_new0( gchar*, strlen(url_scheme) + 30 );
-			strcpy( newUrlSchemes, "<string>" );
-			strcat( newUrlSchemes, url_scheme );
-			strcat( newUrlSchemes, "</string>\n" );
-			utils_str_replace_all( &contents, urlschemereplacement, newUrlSchemes );
-			g_free( newUrlSchemes );
-		}
-		else
-		{
-			utils_str_replace_all( &contents, urlschemereplacement, "" );
-		}
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
 
-		switch( orientation )
-		{
-			case 0:
-            {
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortrait</string>", "" );
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationPortraitUpsideDown</string>", "" );
-                utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationLandscapeLeft" );
-                break;
-            }
-			case 1:
-            {
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeLeft</string>", "" );
-                utils_str_replace_all( &contents, "<string>UIInterfaceOrientationLandscapeRight</string>", "" );
-                utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
-                break;
-            }
-			case 2:
-            {
-				utils_str_replace_all( &contents, "${InitialInterfaceOrientation}", "UIInterfaceOrientationPortrait" );
-                break;
-            }
-		}
-		
-		utils_str_replace_all( &contents, "${VERSION}", version_number );
-		utils_str_replace_all( &contents, "${BUILD}", build_number );
+	// prepare bundle 2
+	argv = g_new0( gchar*, 6 );
+	argv[0] = g_strdup( "/bin/chmod" );
+	argv[1] = g_strdup("-RH");
+	argv[2] = g_strdup("u+w,go-w,a+rX");
+	argv[3] = g_strdup(app_folder);
+	argv[4] = NULL;
 
-		if ( device_type == 1 ) utils_str_replace_all( &contents, "\t\t<integer>2</integer>\n", "" );
-		else if ( device_type == 2 ) utils_str_replace_all( &contents, "\t\t<integer>1</integer>\n", "" );
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run chmod program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
+	
+    /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file permissions (error: %s)"), str_out );
+		else SHOW_ERR1( _("Failed to set file permissions (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+     */
 
-		//
-		if ( uses_ads )
-		{
-			//char advert [ 1024 ] = "";
+	g_free(str_out);
+	str_out = 0;
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign SnapChat
+	if ( temp_filename2 ) g_free(temp_filename2);
+	temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCoreKit.framework", NULL );
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--entitlements");
+	//argv[5] = g_strdup(entitlements_file);
+	argv[4] = g_strdup(temp_filename2);
+	argv[5] = NULL;
+    
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-			
-			gchar* advert = g_new0 ( gchar*, 30000 );
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign SnapChat2
+	if ( temp_filename2 ) g_free(temp_filename2);
+	temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCreativeKit.framework", NULL );
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--entitlements");
+	//argv[5] = g_strdup(entitlements_file);
+	argv[4] = g_strdup(temp_filename2);
+	argv[5] = NULL;
+
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-			
-			strcpy ( advert, "<key>NSUserTrackingUsageDescription</key>\n" );
-			strcat ( advert, "<string>This identifier will be used to deliver personalized ads to you.</string>\n" );
-			strcat ( advert, "<key>SKAdNetworkItems</key>\n" );
-			strcat ( advert, "<array>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>2u9pt9hc89.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>44jx6755aq.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>4fzdc2evr5.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>4pfyvq9l8r.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>737z793b9f.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>7ug5zh24hu.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>8s468mfl3y.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>9rd848q2bz.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>9t245vhmpl.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>av6w8kgt66.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>c6k4g5qg8m.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>cj5566h2ga.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>F38H382JLK.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>glqzh8vgby.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>hs6bdukanm.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>mlmmfzh3r3.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>prcb7njmu6.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>t38b2kh725.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>tl55sbb4fm.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>w9q455wk68.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>wg4vff78zm.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>yclnxrl5pm.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>ydx93a7ass.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>s39g8k73mm.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>m8dbw4sv7c.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>4468km3ulz.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>8s468mfl3y.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>lr83yxwka7.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>9nlqeag3gk.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>mls7yz5dvl.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>p78axxw29g.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>v72qych5uu.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>6xzpu9s2p8.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>g28c52eehv.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>523jb4fst2.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>ggvn48r87g.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>3sh42y64q3.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>24t9a8vw3c.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>ejvt5qm6ak.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>cstr6suwn9.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>wzmmz9fp6w.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>5lm9lj6jb7.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>zmvfpc5aq8.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>7rz58n8ntl.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>feyaarzu9v.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>n9x2a789qt.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>5a6flpkh64.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>424m5254lk.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>5l3tpt7t6e.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>uw77j35x4d.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>gta9lk7p23.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>kbd757ywx3.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>cg4yq2srnc.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>ludvb6z3bs.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>22mmun2rn5.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>su67r6k2v3.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>4w7y6s5ca2.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>klf5c3l5u5.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>dzg6xy7pwj.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>y45688jllp.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>hdw39hrw9y.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>ppxm28t8ap.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>4dzt52r2t5.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>mtkv5xtk9e.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>5tjdwbrq8w.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>3rd42ekr43.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>klf5c3l5u5.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>x44k69ngh6.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>pwa73g5rt2.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>mp6xlyr22a.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>qqp299437r.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>xy9t38ct57.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>54nzkqm89y.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>9b89h5y424.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>32z4fx6l9h.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>79pbpufp6p.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>275upjj5gd.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>294l99pt4k.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>2fnua5tdw4.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>32z4fx6l9h.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>3qcr597p9d.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>44n7hlldy6.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>54nzkqm89y.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>578prtvx9j.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>6g9af3uyq4.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>6p4ks3rnbw.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>79pbpufp6p.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>97r2b46745.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>9b89h5y424.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>e5fvkxwrpn.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>f73kdq92p3.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>g2y4y55b64.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>k674qkevps.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>mp6xlyr22a.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>n6fk4nfna4.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>qqp299437r.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>rx5hdcabgc.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>s69wq72ugq.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>u679fj5vs4.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>xy9t38ct57.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>kbmxgpxpgc.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "<dict>\n" );
-			strcat ( advert, "<key>SKAdNetworkIdentifier</key>\n" );
-			strcat ( advert, "<string>rvh3l7un93.skadnetwork</string>\n" );
-			strcat ( advert, "</dict>\n" );
-			strcat ( advert, "</array>\n" );
-
-			utils_str_replace_all ( &contents, "<key>${ADVERT_ITEMS}</key><string></string>", advert );
-			
+	g_strfreev(argv);
+	argv = 0;
+
+	// sign bundle
+	argv = g_new0( gchar*, 10 );
+	argv[0] = g_strdup( path_to_codesign );
+	argv[1] = g_strdup("--force");
+	argv[2] = g_strdup("--sign");
+	argv[3] = g_strdup(cert_hash);
+	//argv[4] = g_strdup("--resource-rules"); // Apple stopped using resource rules?
+	//argv[5] = g_strconcat( app_folder, "/ResourceRules.plist", NULL );
+	argv[4] = g_strdup("--entitlements");
+	argv[5] = g_strdup(entitlements_file);
+	argv[6] = g_strdup(app_folder);
+	argv[7] = NULL;
+    
+	if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+	{
+		SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
+		g_error_free(error);
+		error = NULL;
+		goto ios_dialog_cleanup2;
+	}
 
-			g_free ( advert );
+	g_strfreev(argv);
+	argv = 0;
+	
+    /*
+	if ( status != 0 && status < 256 )
+	{
+		if ( str_out && *str_out ) SHOW_ERR1( _("Failed to sign app (error: %s)"), str_out );
+		else SHOW_ERR1( _("Failed to sign app (error: %d)"), status );
+		goto ios_dialog_cleanup2;
+	}
+     */
 			
-		}
-		
-		//
-
-		if ( !g_file_set_contents( temp_filename1, contents, strlen(contents), NULL ) )
-		{
-			SHOW_ERR( _("Failed to write Info.plist file") );
-			goto ios_dialog_cleanup2;
-		}
 
-		g_free(str_out);
-		str_out = 0;
+	export_job_set_stage( job, _("Packaging") );
 
-		// convert plist to binary
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/plutil" );
-		argv[1] = g_strdup("-convert");
-		argv[2] = g_strdup("binary1");
-		argv[3] = g_strdup(temp_filename1);
-		argv[4] = NULL;
+	// create IPA zip file
+	if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+	{
+		SHOW_ERR( _("Failed to initialise zip file for writing") );
+		goto ios_dialog_cleanup2;
+	}
+	
+	if ( temp_filename1 ) g_free(temp_filename1);
+	temp_filename1 = g_strconcat( "Payload/", app_name, ".app", NULL );
+	if ( !utils_add_folder_to_zip_parallel( &zip_archive, app_folder, temp_filename1, TRUE, FALSE, NULL ) )
+	{
+		SHOW_ERR( _("Failed to add files to IPA") );
+		goto ios_dialog_cleanup2;
+	}
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+	if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to finalize IPA file") );
+		goto ios_dialog_cleanup2;
+	}
+	if ( !mz_zip_writer_end( &zip_archive ) )
+	{
+		SHOW_ERR( _("Failed to end IPA file") );
+		goto ios_dialog_cleanup2;
+	}
 
-		g_strfreev(argv);
-		argv = 0;
-		
-        /*
-		if ( status != 0 )
-		{
-			SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
-         */
+	g_rename( output_file_zip, output_file );
 
-		// load icon file
-		if ( app_icon && *app_icon )
-		{
-			// write Icons.xcassets file
-			if ( !utils_copy_folder( icons_src_folder, icons_dst_folder, TRUE, NULL ) )
-			{
-				SHOW_ERR( _("Failed to create icon asset catalog") );
-				goto ios_dialog_cleanup2;
-			}
+	success = TRUE;
 
-			icon_image = gdk_pixbuf_new_from_file( app_icon, &error );
-			if ( !icon_image || error )
-			{
-				SHOW_ERR1( _("Failed to load image icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
+ios_dialog_cleanup2:
 
-			temp_image_filename = g_build_path( "/", icons_sub_folder, "temp.png", NULL );
+	// keep the app folder for the next export
+	{
+		const gchar *app_only[] = { app_folder_name, NULL };
+		utils_prune_folder( tmp_folder, app_only );
+	}
 
-			// scale it and save it
-			// 152x152
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-152.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 152, 152, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 152x152 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+	if ( output_file_zip ) g_free(output_file_zip);
+	if ( ios_folder ) g_free(ios_folder);
+	if ( tmp_folder ) g_free(tmp_folder);
+	if ( src_folder ) g_free(src_folder);
+	if ( app_folder ) g_free(app_folder);
+	if ( app_folder_name ) g_free(app_folder_name);
+	if ( no_ads_binary ) g_free(no_ads_binary);
+	if ( icons_src_folder ) g_free(icons_src_folder);
+	if ( icons_dst_folder ) g_free(icons_dst_folder);
+	if ( icons_sub_folder ) g_free(icons_sub_folder);
+
+	if ( error ) g_error_free(error);
+	if ( str_out ) g_free(str_out);
+	if ( argv ) g_strfreev(argv);
+	if ( contents ) g_free(contents);
+	if ( certificate_data ) g_free(certificate_data);
+	if ( team_id ) g_free(team_id);
+	if ( bundle_id ) g_free(bundle_id);
+	if ( cert_hash ) g_free(cert_hash);
+	if ( cert_temp ) g_free(cert_temp);
+	if ( app_group_data ) g_free(app_group_data);
+
+	if ( entitlements_file ) g_free(entitlements_file);
+	if ( expanded_entitlements_file ) g_free(expanded_entitlements_file);
+	if ( temp_filename1 ) g_free(temp_filename1);
+	if ( temp_filename2 ) g_free(temp_filename2);
+	if ( version_string ) g_free(version_string);
+	if ( build_string ) g_free(build_string);
+	if ( image_filename ) g_free(image_filename);
+	if ( user_name ) g_free(user_name);
+	if ( group_name ) g_free(group_name);
+	if ( icon_set ) utils_icon_set_free(icon_set);
+	if ( icon_cache_folder ) g_free(icon_cache_folder);
+	if ( splash_image ) gdk_pixbuf_unref(splash_image);
+	
+	if ( app_name ) g_free(app_name);
+	if ( profile ) g_free(profile);
+	if ( app_icon ) g_free(app_icon);
+	if ( firebase_config ) g_free(firebase_config);
+	//if ( facebook_id ) g_free(facebook_id);
+	if ( url_scheme ) g_free(url_scheme);
+	if ( deep_link ) g_free(deep_link);
+	if ( admob_app_id ) g_free(admob_app_id);
+	if ( snapchat_client_id ) g_free(snapchat_client_id);
+	if ( version_number ) g_free(version_number);
+	if ( build_number ) g_free(build_number);
+	if ( output_file ) g_free(output_file);
+
+	if ( data->project_base_path ) g_free(data->project_base_path);
+	if ( data->default_base_path ) g_free(data->default_base_path);
+	g_free(data);
 
-			// 180x180
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-180.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 180, 180, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 180x180 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+	return success;
+}
 
-			// 167x167
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-167.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 167, 167, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 167x167 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+static void ios_export_done(ExportJob *job, gboolean success, gpointer user_data)
+{
+	ios_export_job = NULL;
 
-			// 120x120
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-120.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 120, 120, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 120x120 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+	gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
 
-			// 76x76
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-76.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 76, 76, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 76x76 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
+	if ( success ) gtk_widget_hide(ui_widgets.ios_dialog);
+}
 
-			/*
-			// 60x60
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-60.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 60, 60, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 60x60 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-			*/
+static void on_ios_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
+{
+	static int running = 0;
+	if ( running ) return;
 
-			// 1024x1024
-			image_filename = g_build_path( "/", icons_sub_folder, "icon-1024.png", NULL );
-			icon_scaled_image = gdk_pixbuf_scale_simple( icon_image, 1024, 1024, GDK_INTERP_HYPER );
-			if ( !gdk_pixbuf_save( icon_scaled_image, temp_image_filename, "png", &error, "compression", "9", NULL ) )
-			{
-				SHOW_ERR1( _("Failed to save 1024x1024 icon: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			gdk_pixbuf_unref( icon_scaled_image );
-			if ( !ios_convert_to_cgbi_png( temp_image_filename, image_filename ) ) goto ios_dialog_cleanup2;
-			g_unlink( temp_image_filename );
-			g_free( image_filename );
-			g_free( temp_image_filename );
-
-			icon_scaled_image = NULL;
-			image_filename = NULL;
-			temp_image_filename = NULL;
-
-			// run actool to compile asset catalog, it will copy the app icons to the app_folder and create the Assets.car file
-			argv = g_new0( gchar*, 20 );
-			argv[0] = g_strdup( path_to_actool );
-			argv[1] = g_strdup("--output-partial-info-plist");
-			argv[2] = g_strdup("temp.plist");
-			argv[3] = g_strdup("--app-icon");
-			argv[4] = g_strdup("AppIcon");
-			argv[5] = g_strdup("--target-device");
-			argv[6] = g_strdup("iphone");
-			argv[7] = g_strdup("--target-device");
-			argv[8] = g_strdup("ipad");
-			argv[9] = g_strdup("--minimum-deployment-target");
-			argv[10] = g_strdup("9.0");
-			argv[11] = g_strdup("--platform");
-			argv[12] = g_strdup("iphoneos");
-			argv[13] = g_strdup("--product-type");
-			argv[14] = g_strdup("com.apple.product-type.application");
-			argv[15] = g_strdup("--compress-pngs");
-			argv[16] = g_strdup("--compile");
-			argv[17] = g_strdup(app_folder_name);
-			argv[18] = g_strdup("Icons.xcassets");
-			argv[19] = NULL;
-
-			if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-			{
-				SHOW_ERR1( _("Failed to run \"actool\" program: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-		
-			if ( !str_out || strstr(str_out,"actool.errors") != 0 || strstr(str_out,"actool.warnings") != 0 || strstr(str_out,"actool.notices") != 0 )
-			{
-				if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile asset catalog (error %d: %s)"), status, str_out );
-				else SHOW_ERR1( _("Failed to get compile asset catalog (error: %d)"), status );
-				goto ios_dialog_cleanup2;
-			}
+	// while exporting the cancel button stops the export, closing the dialog leaves it running
+	if ( ios_export_job )
+	{
+		if ( response == GTK_RESPONSE_CANCEL ) export_job_cancel( ios_export_job );
+		if ( response != 1 ) gtk_widget_hide(GTK_WIDGET(dialog));
+		return;
+	}
 
-			g_free(str_out);
-			str_out = 0;
-			g_strfreev(argv);
-			argv = 0;
-		}
+	running = 1;
 
-		while (gtk_events_pending())
-			gtk_main_iteration();
+	if ( app->project && !ios_exporting_player )
+	{
+		GtkWidget *widget; 
 
-		// copy splash logo
-		if ( app_splash_logo && *app_splash_logo )
-		{
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "SplashLogo.png", NULL );
-			utils_copy_file( app_splash_logo, temp_filename1, TRUE, NULL );
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.app_name) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-		if ( app_splash_color && *app_splash_color )
-		{
-			int iRed = hextoint( app_splash_color[0] ) * 16 + hextoint( app_splash_color[1] );
-			int iGreen = hextoint( app_splash_color[2] ) * 16 + hextoint( app_splash_color[3] );
-			int iBlue = hextoint( app_splash_color[4] ) * 16 + hextoint( app_splash_color[5] );
-
-			float red = iRed / 255.0f;
-			float green = iGreen / 255.0f;
-			float blue = iBlue / 255.0f;
-
-			// edit UntitledViewController
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.prov_profile_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( contents ) g_free(contents);
-			contents = 0;
-			if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
-			{
-				SHOW_ERR( _("Failed to read UntitledViewController.xib file") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.app_icon_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcontents = 0;
-			char* start = strstr( contents, "backgroundColor\"" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify UntitledViewController.xib, backgroundColor not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.firebase_config_path) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start += strlen("backgroundColor\"");
-			*start = 0;
-			strcpy( newcontents, contents );
-			*start = ' ';
+		// splash screens
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.splash_logo) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			char newcolor[ 256 ];
-			*newcolor = 0;
-			sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
-			strcat( newcontents, newcolor );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
+		AGK_CLEAR_STR(app->project->ipa_settings.splash_color) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start = strstr( start, "alpha=" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify UntitledViewController.xib, alpha not found") );
-				goto ios_dialog_cleanup2;
-			}
+		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
+		//AGK_CLEAR_STR(app->project->ipa_settings.facebook_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			strcat( newcontents, start );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.url_scheme) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
-			{
-				SHOW_ERR1( _("Failed to write UntitledViewController.xib file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-			
-			// edit storyboard
-			if ( temp_filename1 ) g_free(temp_filename1);
-			temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.deep_link) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			if ( contents ) g_free(contents);
-			contents = 0;
-			if ( !g_file_get_contents( temp_filename1, &contents, &length, NULL ) )
-			{
-				SHOW_ERR( _("Failed to read LaunchScreen.storyboard file") );
-				goto ios_dialog_cleanup2;
-			}	
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.admob_app_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcontents = 0;
-			start = strstr( contents, "backgroundColor\"" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, backgroundColor not found") );
-				goto ios_dialog_cleanup2;
-			}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.snapchat_client_id) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			start += strlen("backgroundColor\"");
-			*start = 0;
-			strcpy( newcontents, contents );
-			*start = ' ';
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
+		app->project->ipa_settings.orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+				
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.version_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
+		AGK_CLEAR_STR(app->project->ipa_settings.build_number) = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-			*newcolor = 0;
-			sprintf( newcolor, " red=\"%f\" green=\"%f\" blue=\"%f\" ", red, green, blue );
-			strcat( newcontents, newcolor );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
+		app->project->ipa_settings.device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+		
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
+		app->project->ipa_settings.uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
 
-			start = strstr( start, "alpha=" );
-			if ( !start )
-			{
-				SHOW_ERR( _("Failed to modify LaunchScreen.storyboard, alpha not found") );
-				goto ios_dialog_cleanup2;
-			}
+		// output
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
+		app->project->ipa_settings.output_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+	}
 
-			strcat( newcontents, start );
+	if ( response != 1 )
+	{
+		gtk_widget_hide(GTK_WIDGET(dialog));
+	}
+	else
+	{
+		int i;
+		GtkWidget *widget;
 
-			if ( !g_file_set_contents( temp_filename1, newcontents, strlen(newcontents), &error ) )
-			{
-				SHOW_ERR1( _("Failed to write LaunchScreen.storyboard file: %s"), error->message );
-				g_error_free(error);
-				error = NULL;
-				goto ios_dialog_cleanup2;
-			}
-		}
+		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), FALSE );
 
-		// compile UntitledViewController
-		argv = g_new0( gchar*, 19 );
-		argv[0] = g_strdup( path_to_ibtool );
-		argv[1] = g_strdup("--errors");
-		argv[2] = g_strdup("--warnings");
-		argv[3] = g_strdup("--notices");
-		argv[4] = g_strdup("--module");
-		argv[5] = g_strdup("AppGameKit_Player");
-		argv[6] = g_strdup("--auto-activate-custom-fonts");
-		argv[7] = g_strdup("--target-device");
-		argv[8] = g_strdup("iphone");
-		argv[9] = g_strdup("--target-device");
-		argv[10] = g_strdup("ipad");
-		argv[11] = g_strdup("--minimum-deployment-target");
-		argv[12] = g_strdup("9.0");
-		argv[13] = g_strdup("--output-format");
-		argv[14] = g_strdup("human-readable-text");
-		argv[15] = g_strdup("--compile");
-		argv[16] = g_strdup("UntitledViewController.nib");
-		argv[17] = g_strdup("UntitledViewController.xib");
-		argv[18] = NULL;
-			
-		if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
+		// app details
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_name_entry");
+		gchar *app_name = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 		
-		if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
-		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile UntitledViewController.nib (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get compile UntitledViewController.nib (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_provisioning_entry");
+		gchar *profile = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_icon_entry");
+		gchar *app_icon = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// delete old UntitledViewController.xib
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "UntitledViewController.xib", NULL );
-		g_unlink( temp_filename1 );
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_firebase_config_entry");
+		gchar *firebase_config = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
+		// splash screens
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry");
+		gchar *app_splash_logo = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// compile storyboard
-		argv = g_new0( gchar*, 19 );
-		argv[0] = g_strdup( path_to_ibtool );
-		argv[1] = g_strdup("--errors");
-		argv[2] = g_strdup("--warnings");
-		argv[3] = g_strdup("--notices");
-		argv[4] = g_strdup("--module");
-		argv[5] = g_strdup("AppGameKit_Player");
-		argv[6] = g_strdup("--auto-activate-custom-fonts");
-		argv[7] = g_strdup("--target-device");
-		argv[8] = g_strdup("iphone");
-		argv[9] = g_strdup("--target-device");
-		argv[10] = g_strdup("ipad");
-		argv[11] = g_strdup("--minimum-deployment-target");
-		argv[12] = g_strdup("9.0");
-		argv[13] = g_strdup("--output-format");
-		argv[14] = g_strdup("human-readable-text");
-		argv[15] = g_strdup("--compilation-directory");
-		argv[16] = g_strdup("./");
-		argv[17] = g_strdup("LaunchScreen.storyboard");
-		argv[18] = NULL;
-			
-		if ( !utils_spawn_sync( app_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run \"ibtool\" program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || strstr(str_out,"ibtool.errors") != 0 || strstr(str_out,"ibtool.warnings") != 0 || strstr(str_out,"ibtool.notices") != 0 )
-		{
-			if ( str_out && *str_out ) dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Failed to compile LaunchScreen.storyboard (error %d: %s)"), status, str_out );
-			else SHOW_ERR1( _("Failed to get compile LaunchScreen.storyboard (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_splash_entry2");
+		gchar *app_splash_color = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		//widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_facebook_id_entry");
+		//gchar *facebook_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// delete old storyboard
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_build_filename( app_folder, "LaunchScreen.storyboard", NULL );
-		g_unlink( temp_filename1 );
-		
-		while (gtk_events_pending())
-			gtk_main_iteration();
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_url_scheme_entry");
+		gchar *url_scheme = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// copy media folder
-        if ( !ios_exporting_player && app->project )
-        {
-            if ( temp_filename1 ) g_free(temp_filename1);
-            temp_filename1 = g_build_filename( app->project->base_path, "media", NULL );
-            temp_filename2 = g_build_filename( app_folder, "media", NULL );
-            utils_copy_folder( temp_filename1, temp_filename2, TRUE, NULL );
-        }
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_deep_link_entry");
+		gchar *deep_link = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		g_free(str_out);
-		str_out = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_admob_app_id_entry");
+		gchar *admob_app_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		// find user name
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/id" );
-		argv[1] = g_strdup("-u");
-		argv[2] = g_strdup("-n");
-		argv[3] = NULL;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_snapchat_client_id_entry");
+		gchar *snapchat_client_id = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run userid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || !*str_out )
-		{
-			SHOW_ERR1( _("Failed to get user name (error: %d)"), status );
-			goto ios_dialog_cleanup2;
-		}
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_orientation_combo");
+		int orientation = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));
+				
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_version_number_entry");
+		gchar *version_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( !*version_number ) SETPTR( version_number, g_strdup("1.0.0") );
 
-		user_name = g_strdup( str_out );
-        user_name[ strlen(user_name)-1 ] = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_build_number_entry");
+		gchar *build_number = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+		if ( !*build_number ) SETPTR( build_number, g_strdup("1.0") );
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_device_combo");
+		int device_type = gtk_combo_box_get_active(GTK_COMBO_BOX_TEXT(widget));;
 
-		// find group name
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/bin/id" );
-		argv[1] = g_strdup("-g");
-		argv[2] = g_strdup("-n");
-		argv[3] = NULL;
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_app_uses_ads");
+		int uses_ads = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON(widget) );
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run groupid program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-		if ( !str_out || !*str_out )
+		// output
+		widget = ui_lookup_widget(ui_widgets.ios_dialog, "ios_output_file_entry");
+		gchar *output_file = g_strdup(gtk_entry_get_text(GTK_ENTRY(widget)));
+
+		gchar *percent = 0;
+		while ( (percent = strchr(output_file, '%')) != 0 )
 		{
-			SHOW_ERR1( _("Failed to get group name (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( strncmp( percent+1, "[version]", strlen("[version]") ) == 0 )
+			{
+				*percent = 0;
+				percent += strlen("[version]") + 1;
+				gchar *new_output = g_strconcat( output_file, build_number, percent, NULL );
+				g_free(output_file);
+				output_file = new_output;
+				continue;
+			}
+
+			break;
 		}
 
-		group_name = g_strdup( str_out );
-        group_name[ strlen(group_name)-1 ] = 0;
 
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
+		// START CHECKS
 
-		// prepare bundle
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/usr/sbin/chown" );
-		argv[1] = g_strdup("-RH");
-		argv[2] = g_strconcat( user_name, ":", group_name, NULL );
-		argv[3] = g_strdup(app_folder);
-		argv[4] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		if ( !output_file || !*output_file ) { SHOW_ERR(_("You must choose an output location to save your IPA")); goto ios_dialog_clean_up; }
+		if ( strchr(output_file, '.') == 0 ) { SHOW_ERR(_("The output location must be a file not a directory")); goto ios_dialog_clean_up; }
+
+		// check app name
+		if ( !app_name || !*app_name ) { SHOW_ERR(_("You must enter an app name")); goto ios_dialog_clean_up; }
+		if ( strlen(app_name) > 30 ) { SHOW_ERR(_("App name must be less than 30 characters")); goto ios_dialog_clean_up; }
+		for( i = 0; i < strlen(app_name); i++ )
 		{
-			SHOW_ERR1( _("Failed to run chown program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			/*
+			if ( (app_name[i] < 97 || app_name[i] > 122)
+			  && (app_name[i] < 65 || app_name[i] > 90) 
+			  && (app_name[i] < 48 || app_name[i] > 57) 
+			  && app_name[i] != 32 
+			  && app_name[i] != 95 ) 
+			{ 
+				SHOW_ERR(_("App name contains invalid characters, must be A-Z 0-9 spaces and undersore only")); 
+				goto ios_dialog_clean_up; 
+			}
+			*/
+			//switch to black list
+			if ( app_name[i] == 34 || app_name[i] == 60 
+			  || app_name[i] == 62 || app_name[i] == 39
+			  || app_name[i] == 42 || app_name[i] == 46
+			  || app_name[i] == 47 || app_name[i] == 92
+			  || app_name[i] == 58 || app_name[i] == 59
+			  || app_name[i] == 124 || app_name[i] == 61
+			  || app_name[i] == 44 || app_name[i] == 38 )
+			{
+				SHOW_ERR(_("App name contains invalid characters, it must not contain quotes or any of the following < > * . / \\ : ; | = , &"));
+				goto ios_dialog_clean_up; 
+			}
 		}
 		
-        /*
-		if ( status != 0 && status < 256 )
+		// check icon
+		//if ( !app_icon || !*app_icon ) { SHOW_ERR(_("You must select an app icon")); goto ios_dialog_clean_up; }
+		if ( app_icon && *app_icon )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file ownership (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to set file ownership (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( app_icon, '.' ) || utils_str_casecmp( strrchr( app_icon, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("App icon must be a PNG file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( app_icon, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find app icon location")); goto ios_dialog_clean_up; }
 		}
-         */
-
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
-
-		// prepare bundle 2
-		argv = g_new0( gchar*, 6 );
-		argv[0] = g_strdup( "/bin/chmod" );
-		argv[1] = g_strdup("-RH");
-		argv[2] = g_strdup("u+w,go-w,a+rX");
-		argv[3] = g_strdup(app_folder);
-		argv[4] = NULL;
 
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
-		{
-			SHOW_ERR1( _("Failed to run chmod program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
-		}
-		
-        /*
-		if ( status != 0 && status < 256 )
+		if ( firebase_config && *firebase_config )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to set file permissions (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to set file permissions (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( firebase_config, '.' ) || utils_str_casecmp( strrchr( firebase_config, '.' ), ".plist" ) != 0 ) { SHOW_ERR(_("Firebase config file must be a .plist file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( firebase_config, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Firebase config file")); goto ios_dialog_clean_up; }
 		}
-         */
-
-		g_free(str_out);
-		str_out = 0;
-		g_strfreev(argv);
-		argv = 0;
 
-		// sign SnapChat
-		if ( temp_filename2 ) g_free(temp_filename2);
-		temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCoreKit.framework", NULL );
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--entitlements");
-		//argv[5] = g_strdup(entitlements_file);
-		argv[4] = g_strdup(temp_filename2);
-		argv[5] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check splash screen logo
+		if ( app_splash_logo && *app_splash_logo )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( !strrchr( app_splash_logo, '.' ) || utils_str_casecmp( strrchr( app_splash_logo, '.' ), ".png" ) != 0 ) { SHOW_ERR(_("Splash Screen Logo must be a PNG file")); goto ios_dialog_clean_up; }
+			if ( !g_file_test( app_splash_logo, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find Splash Screen Logo location")); goto ios_dialog_clean_up; }
 		}
 
-		g_strfreev(argv);
-		argv = 0;
-
-		// sign SnapChat2
-		if ( temp_filename2 ) g_free(temp_filename2);
-		temp_filename2 = g_build_filename( app_folder, "Frameworks/SCSDKCreativeKit.framework", NULL );
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--entitlements");
-		//argv[5] = g_strdup(entitlements_file);
-		argv[4] = g_strdup(temp_filename2);
-		argv[5] = NULL;
-
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check splash screen color
+		if ( app_splash_color && *app_splash_color )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( strlen( app_splash_color ) != 6 ) { SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); goto ios_dialog_clean_up; }
+			int i;
+			for( i = 0; i < strlen(app_splash_color); i++ )
+			{
+				if ( app_splash_color[i] >= 97 && app_splash_color[i] <= 102 ) app_splash_color[i] -= 32; // change to upper case
+				if ( (app_splash_color[i] < 48 || app_splash_color[i] > 57) && (app_splash_color[i] < 65 || app_splash_color[i] > 70) ) 
+				{ 
+					SHOW_ERR(_("Splash Screen Color must be a 6 digit hex value, e.g. E86C2B")); 
+					goto ios_dialog_clean_up; 
+				}
+			}
 		}
 
-		g_strfreev(argv);
-		argv = 0;
+		// check profile
+		if ( !profile || !*profile ) { SHOW_ERR(_("You must select a provisioning profile")); goto ios_dialog_clean_up; }
+		if ( !strrchr( profile, '.' ) || utils_str_casecmp( strrchr( profile, '.' ), ".mobileprovision" ) != 0 ) { SHOW_ERR(_("Provisioning profile must have .mobileprovision extension")); goto ios_dialog_clean_up; }
+		if ( !g_file_test( profile, G_FILE_TEST_EXISTS ) ) { SHOW_ERR(_("Could not find provisioning profile location")); goto ios_dialog_clean_up; }
 
-		// sign bundle
-		argv = g_new0( gchar*, 10 );
-		argv[0] = g_strdup( path_to_codesign );
-		argv[1] = g_strdup("--force");
-		argv[2] = g_strdup("--sign");
-		argv[3] = g_strdup(cert_hash);
-		//argv[4] = g_strdup("--resource-rules"); // Apple stopped using resource rules?
-		//argv[5] = g_strconcat( app_folder, "/ResourceRules.plist", NULL );
-		argv[4] = g_strdup("--entitlements");
-		argv[5] = g_strdup(entitlements_file);
-		argv[6] = g_strdup(app_folder);
-		argv[7] = NULL;
-        
-		if ( !utils_spawn_sync( tmp_folder, argv, NULL, 0, NULL, NULL, &str_out, NULL, &status, &error) )
+		// check version
+		if ( !version_number || !*version_number ) { SHOW_ERR(_("You must enter a version number, e.g. 1.0.0")); goto ios_dialog_clean_up; }
+		for( i = 0; i < strlen(version_number); i++ )
 		{
-			SHOW_ERR1( _("Failed to run codesign program: %s"), error->message );
-			g_error_free(error);
-			error = NULL;
-			goto ios_dialog_cleanup2;
+			if ( (version_number[i] < 48 || version_number[i] > 57) && version_number[i] != 46 ) 
+			{ 
+				SHOW_ERR(_("Version number contains invalid characters, must be 0-9 and . only")); 
+				goto ios_dialog_clean_up; 
+			}
 		}
 
-		g_strfreev(argv);
-		argv = 0;
-		
-        /*
-		if ( status != 0 && status < 256 )
+		// check facebook id
+		/*
+		if ( facebook_id && *facebook_id )
 		{
-			if ( str_out && *str_out ) SHOW_ERR1( _("Failed to sign app (error: %s)"), str_out );
-			else SHOW_ERR1( _("Failed to sign app (error: %d)"), status );
-			goto ios_dialog_cleanup2;
+			for( i = 0; i < strlen(facebook_id); i++ )
+			{
+				if ( (facebook_id[i] < 48 || facebook_id[i] > 57) ) 
+				{ 
+					SHOW_ERR(_("Facebook App ID must be numbers only")); 
+					goto ios_dialog_clean_up; 
+				}
+			}
 		}
-         */
-				
+		*/
 
-		// create IPA zip file
-		if ( !mz_zip_writer_init_file( &zip_archive, output_file_zip, 0 ) )
+		if ( url_scheme && *url_scheme )
 		{
-			SHOW_ERR( _("Failed to initialise zip file for writing") );
-			goto ios_dialog_cleanup2;
+			if ( strchr(url_scheme, ':') || strchr(url_scheme, '/') )
+			{
+				SHOW_ERR(_("URL scheme must not contain : or /"));
+				goto ios_dialog_clean_up; 
+			}
 		}
-		
-		if ( temp_filename1 ) g_free(temp_filename1);
-		temp_filename1 = g_strconcat( "Payload/", app_name, ".app", NULL );
-		if ( !utils_add_folder_to_zip( &zip_archive, app_folder, temp_filename1, TRUE, FALSE ) )
+
+		if ( deep_link && *deep_link )
 		{
-			SHOW_ERR( _("Failed to add files to IPA") );
-			goto ios_dialog_cleanup2;
+			if ( strchr( deep_link, '.' ) == 0 )
+			{
+				SHOW_ERR(_("Universal link must be a domain, e.g. www.appgamekit.com"));
+				goto ios_dialog_clean_up; 
+			}
 		}
 
-		if ( !mz_zip_writer_finalize_archive( &zip_archive ) )
+		if ( admob_app_id && *admob_app_id )
 		{
-			SHOW_ERR( _("Failed to finalize IPA file") );
-			goto ios_dialog_cleanup2;
+			if ( strchr( admob_app_id, '~' ) == 0 )
+			{
+				SHOW_ERR(_("AdMob App ID must include a ~ character, for example \"ca-app-pub-3940256099942544~1458002511\""));
+				goto ios_dialog_clean_up; 
+			}
 		}
-		if ( !mz_zip_writer_end( &zip_archive ) )
+
+		if ( !g_file_test( "/Applications/XCode.app/Contents/Developer/usr/bin/actool", G_FILE_TEST_EXISTS ) )
 		{
-			SHOW_ERR( _("Failed to end IPA file") );
-			goto ios_dialog_cleanup2;
+			SHOW_ERR(_("You must install XCode to export iOS apps from the AGK IDE. XCode can be downloaded from the Mac AppStore")); 
+			goto ios_dialog_clean_up;
 		}
+	
+		goto ios_dialog_continue;
 
-		g_rename( output_file_zip, output_file );
-
-		while (gtk_events_pending())
-			gtk_main_iteration();
-
-		gtk_widget_hide(GTK_WIDGET(dialog));
-
-ios_dialog_cleanup2:
-        
-        gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
-		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "button6"), TRUE );
-
-		utils_remove_folder_recursive( tmp_folder );
-
-		if ( output_file_zip ) g_free(output_file_zip);
-		if ( ios_folder ) g_free(ios_folder);
-		if ( tmp_folder ) g_free(tmp_folder);
-		if ( src_folder ) g_free(src_folder);
-		if ( app_folder ) g_free(app_folder);
-		if ( app_folder_name ) g_free(app_folder_name);
-		if ( no_ads_binary ) g_free(no_ads_binary);
-		if ( icons_src_folder ) g_free(icons_src_folder);
-		if ( icons_dst_folder ) g_free(icons_dst_folder);
-		if ( icons_sub_folder ) g_free(icons_sub_folder);
-
-		if ( error ) g_error_free(error);
-		if ( str_out ) g_free(str_out);
-		if ( argv ) g_strfreev(argv);
-		if ( contents ) g_free(contents);
-		if ( certificate_data ) g_free(certificate_data);
-		if ( team_id ) g_free(team_id);
-		if ( bundle_id ) g_free(bundle_id);
-		if ( cert_hash ) g_free(cert_hash);
-		if ( cert_temp ) g_free(cert_temp);
-		if ( app_group_data ) g_free(app_group_data);
-
-		if ( entitlements_file ) g_free(entitlements_file);
-		if ( expanded_entitlements_file ) g_free(expanded_entitlements_file);
-		if ( temp_filename1 ) g_free(temp_filename1);
-		if ( temp_filename2 ) g_free(temp_filename2);
-		if ( version_string ) g_free(version_string);
-		if ( build_string ) g_free(build_string);
-		if ( image_filename ) g_free(image_filename);
-		if ( user_name ) g_free(user_name);
-		if ( group_name ) g_free(group_name);
-		if ( icon_scaled_image ) gdk_pixbuf_unref(icon_scaled_image);
-		if ( icon_image ) gdk_pixbuf_unref(icon_image);
-		if ( splash_image ) gdk_pixbuf_unref(splash_image);
-		
+ios_dialog_clean_up:
 		if ( app_name ) g_free(app_name);
 		if ( profile ) g_free(profile);
 		if ( app_icon ) g_free(app_icon);
 		if ( firebase_config ) g_free(firebase_config);
+		if ( app_splash_logo ) g_free(app_splash_logo);
+		if ( app_splash_color ) g_free(app_splash_color);
 		//if ( facebook_id ) g_free(facebook_id);
 		if ( url_scheme ) g_free(url_scheme);
 		if ( deep_link ) g_free(deep_link);
 		if ( admob_app_id ) g_free(admob_app_id);
 		if ( snapchat_client_id ) g_free(snapchat_client_id);
 		if ( version_number ) g_free(version_number);
-		if ( build_number ) g_free(build_number);
 		if ( output_file ) g_free(output_file);
+
+		gtk_widget_set_sensitive( ui_lookup_widget(ui_widgets.ios_dialog, "ios_export1"), TRUE );
+		running = 0;
+		return;
+
+ios_dialog_continue:
+		{
+			IosExportData *data = g_new0( IosExportData, 1 );
+
+			if ( !ios_exporting_player && app->project ) data->project_base_path = g_strdup( app->project->base_path );
+			data->default_base_path = g_strdup( global_project_prefs.project_file_path );
+			data->app_name = app_name;
+			data->profile = profile;
+			data->app_icon = app_icon;
+			data->firebase_config = firebase_config;
+			data->app_splash_logo = app_splash_logo;
+			data->app_splash_color = app_splash_color;
+			data->url_scheme = url_scheme;
+			data->deep_link = deep_link;
+			data->admob_app_id = admob_app_id;
+			data->snapchat_client_id = snapchat_client_id;
+			data->version_number = version_number;
+			data->build_number = build_number;
+			data->output_file = output_file;
+			data->orientation = orientation;
+			data->device_type = device_type;
+			data->uses_ads = uses_ads;
+
+			ios_export_job = export_job_start( app_name, ios_export_run, data, ios_export_done, NULL );
+		}
 	}
 
 	running = 0;
@@ -6982,6 +7165,13 @@ void init_html5_settings( GeanyProject* project )
 	project->html5_settings.output_path = 0;
 }
 
+void init_export_settings( GeanyProject* project )
+{
+	project->export_settings.compression_rules = 0;
+	project->export_settings.compression_fast_level = UTILS_ZIP_DEFAULT_FAST_LEVEL;
+	project->export_settings.compression_budget = UTILS_ZIP_DEFAULT_BUDGET;
+}
+
 void free_android_settings( GeanyProject* project )
 {
 	if ( project->apk_settings.alias ) g_free(project->apk_settings.alias);
@@ -7024,6 +7214,11 @@ void free_html5_settings( GeanyProject* project )
 	if ( project->html5_settings.output_path ) g_free(project->html5_settings.output_path);
 }
 
+void free_export_settings( GeanyProject* project )
+{
+	if ( project->export_settings.compression_rules ) g_free(project->export_settings.compression_rules);
+}
+
 void save_android_settings( GKeyFile *config, GeanyProject* project )
 {
 	g_key_file_set_string( config, "apk_settings", "alias", FALLBACK(project->apk_settings.alias,"") );
@@ -7078,6 +7273,13 @@ void save_html5_settings( GKeyFile *config, GeanyProject* project )
 	g_key_file_set_string( config, "html5_settings", "output_path", FALLBACK(project->html5_settings.output_path,"") );
 }
 
+void save_export_settings( GKeyFile *config, GeanyProject* project )
+{
+	g_key_file_set_string( config, "export_settings", "compression_rules", FALLBACK(project->export_settings.compression_rules,"") );
+	g_key_file_set_integer( config, "export_settings", "compression_fast_level", project->export_settings.compression_fast_level );
+	g_key_file_set_integer( config, "export_settings", "compression_budget", project->export_settings.compression_budget );
+}
+
 void load_android_settings( GKeyFile *config, GeanyProject* project )
 {
 	project->apk_settings.alias = g_key_file_get_string( config, "apk_settings", "alias", 0 );
@@ -7132,6 +7334,13 @@ void load_html5_settings( GKeyFile *config, GeanyProject* project )
 	project->html5_settings.output_path = g_key_file_get_string( config, "html5_settings", "output_path", 0 );
 }
 
+void load_export_settings( GKeyFile *config, GeanyProject* project )
+{
+	project->export_settings.compression_rules = g_key_file_get_string( config, "export_settings", "compression_rules", 0 );
+	project->export_settings.compression_fast_level = utils_get_setting_integer( config, "export_settings", "compression_fast_level", UTILS_ZIP_DEFAULT_FAST_LEVEL );
+	project->export_settings.compression_budget = utils_get_setting_integer( config, "export_settings", "compression_budget", UTILS_ZIP_DEFAULT_BUDGET );
+}
+
 
 /* open_default will make function reload default session files on close */
 gboolean project_close(GeanyProject *project, gboolean open_default)
@@ -7171,6 +7380,12 @@ gboolean project_close(GeanyProject *project, gboolean open_default)
 	free_html5_settings(project);
 	init_html5_settings(project);
 
+	free_export_settings(project);
+	init_export_settings(project);
+
+	/* needs the project file name to save the caches next to it */
+	symbols_unindex_project(project);
+
 	g_free(project->name);
 	g_free(project->description);
 	g_free(project->file_name);
@@ -7178,7 +7393,11 @@ gboolean project_close(GeanyProject *project, gboolean open_default)
 
 	// free file and group arrays
 	for (i = 0; i < project->project_files->len; i++)
+	{
+		if ( project_files_index(project,i)->is_valid )
+			g_free( project_files_index(project,i)->file_name );
 		g_free(project->project_files->pdata[i]);
+	}
 	g_ptr_array_free(project->project_files, TRUE);
 
 	for (i = 0; i < project->project_groups->len; i++)
@@ -7266,6 +7485,7 @@ gboolean project_add_file(GeanyProject *project, gchar* filename, gboolean updat
 	GeanyProjectFile *file = project->project_files->pdata[new_idx];
 	file->is_valid = TRUE;
 	file->file_name = g_strdup( filename );
+	symbols_index_file( filename );
 
 	if ( update_sidebar )
 	{
@@ -7295,6 +7515,7 @@ void project_remove_file(GeanyProject *project, gchar* filename, gboolean update
 		{
 			if ( strcmp( project_files_index(project,i)->file_name, filename ) == 0 )
 			{
+				symbols_unindex_file( filename );
 				g_free( project_files_index(project,i)->file_name );
 				project_files_index(project,i)->is_valid = FALSE;
 			}
@@ -7459,6 +7680,7 @@ static GeanyProject *create_project(void)
 	init_android_settings(project);
 	init_ios_settings(project);
 	init_html5_settings(project);
+	init_export_settings(project);
 
 	app->project = project;
 	return project;
@@ -7892,6 +8114,7 @@ static gboolean load_config(const gchar *filename)
 	ui_project_buttons_update();
 	
 	configuration_load_project_files(config, p);
+	symbols_index_project(p);
 
 	p->is_valid = TRUE;
 
@@ -7907,6 +8130,7 @@ static gboolean load_config(const gchar *filename)
 	load_android_settings( config, p );
 	load_ios_settings( config, p );
 	load_html5_settings( config, p );
+	load_export_settings( config, p );
 
 	g_signal_emit_by_name(geany_object, "project-open", config);
 	g_key_file_free(config);
@@ -7963,6 +8187,7 @@ static gboolean write_config(GeanyProject *project, gboolean emit_signal)
 	save_android_settings( config, project );
 	save_ios_settings( config, project );
 	save_html5_settings( config, project );
+	save_export_settings( config, project );
 	
 	if (emit_signal)
 	{
@@ -8023,6 +8248,7 @@ void project_save_prefs(GKeyFile *config)
 	}
 	g_key_file_set_string(config, "project", "project_file_path",
 		FALLBACK(global_project_prefs.project_file_path, ""));
+	g_key_file_set_integer(config, "project", "export_max_jobs", global_project_prefs.export_max_jobs);
 }
 
 
@@ -8036,6 +8262,8 @@ void project_load_prefs(GKeyFile *config)
 	}
 	global_project_prefs.project_file_path = utils_get_setting_string(config, "project",
 		"project_file_path", NULL);
+	global_project_prefs.export_max_jobs = utils_get_setting_integer(config, "project",
+		"export_max_jobs", 2);
 	
 	if (global_project_prefs.project_file_path == NULL)
 	{
@@ -8120,6 +8348,8 @@ void project_init(void)
 {
 	GtkTreeIter iter;
 
+	project_main_thread = g_thread_self();
+
 	projects_array = g_ptr_array_new();
 
 	project_choice = ui_lookup_widget(main_widgets.window, "combobox1");
@@ -8214,6 +8444,17 @@ void project_update_list(void)
 void project_finalize(void)
 {
 	guint i;
+	GList *node;
+
+	/* stop any exports, queued ones won't do anything once cancelled */
+	foreach_list(node, export_jobs)
+		export_job_cancel(node->data);
+	if (export_job_pool)
+		g_thread_pool_free(export_job_pool, FALSE, TRUE);
+	export_job_pool = NULL;
+	if (export_job_status_id)
+		g_source_remove(export_job_status_id);
+	export_job_status_id = 0;
 
 	for (i = 0; i < projects_array->len; i++)
 		g_free(projects[i]);
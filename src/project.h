@@ -118,6 +118,16 @@ typedef struct GeanyProjectHTML5Settings
 }
 GeanyProjectHTML5Settings;
 
+/* Android packages (APK and app bundle) only, IPAs are always compressed at level 9
+ * and HTML5 exports aren't zipped */
+typedef struct GeanyProjectExportSettings
+{
+	gchar* compression_rules;	/* e.g. "json=fast;dat=auto", see utils_zip_policy_new() */
+	int compression_fast_level;
+	int compression_budget;		/* percent size increase allowed for the fast level */
+}
+GeanyProjectExportSettings;
+
 /** Structure for representing a project. */
 typedef struct GeanyProject
 {
@@ -138,6 +148,7 @@ typedef struct GeanyProject
 	struct GeanyProjectAPKSettings apk_settings;
 	struct GeanyProjectIPASettings ipa_settings;
 	struct GeanyProjectHTML5Settings html5_settings;
+	struct GeanyProjectExportSettings export_settings;
 }
 GeanyProject;
 
@@ -162,6 +173,7 @@ extern ProjectPrefs project_prefs;
 typedef struct GlobalProjectPrefs
 {
 	gchar *project_file_path;
+	gint export_max_jobs;		/* how many exports can run at the same time */
 } GlobalProjectPrefs;
 
 extern GlobalProjectPrefs global_project_prefs;
@@ -169,18 +181,25 @@ extern GlobalProjectPrefs global_project_prefs;
 void init_android_settings( GeanyProject* project );
 void init_ios_settings( GeanyProject* project );
 void init_html5_settings( GeanyProject* project );
+void init_export_settings( GeanyProject* project );
 
 void free_android_settings( GeanyProject* project );
 void free_ios_settings( GeanyProject* project );
 void free_html5_settings( GeanyProject* project );
+void free_export_settings( GeanyProject* project );
 
 void save_android_settings( GKeyFile *config, GeanyProject* project );
 void save_ios_settings( GKeyFile *config, GeanyProject* project );
 void save_html5_settings( GKeyFile *config, GeanyProject* project );
+void save_export_settings( GKeyFile *config, GeanyProject* project );
+
+gboolean project_export_apk_headless( GeanyProject *project, const GeanyProjectAPKSettings *settings,
+	const gchar *keystore_password, const gchar *alias_password );
 
 void load_android_settings( GKeyFile *config, GeanyProject* project );
 void load_ios_settings( GKeyFile *config, GeanyProject* project );
 void load_html5_settings( GKeyFile *config, GeanyProject* project );
+void load_export_settings( GKeyFile *config, GeanyProject* project );
 
 void project_init(void);
 
@@ -180,6 +180,21 @@ void sci_add_text(ScintillaObject *sci, const gchar *text)
 }
 
 
+/* Adds len bytes of text at the end, which needn't be null-terminated. */
+void sci_append_text(ScintillaObject *sci, const gchar *text, gint len)
+{
+	SSM(sci, SCI_APPENDTEXT, (uptr_t) len, (sptr_t) text);
+}
+
+
+/* Makes room for a document of the given size, so adding text up to it doesn't have to
+ * grow the buffer again and again. */
+void sci_allocate(ScintillaObject *sci, gint bytes)
+{
+	SSM(sci, SCI_ALLOCATE, (uptr_t) bytes, 0);
+}
+
+
 /** Sets all text.
  * @param sci Scintilla widget.
  * @param text Text. */
@@ -33,6 +33,8 @@ void				sci_set_mark_long_lines		(ScintillaObject *sci,	gint type, gint column,
 
 void 				sci_set_text				(ScintillaObject *sci,  const gchar *text);
 void 				sci_add_text				(ScintillaObject *sci,  const gchar *text);
+void				sci_append_text				(ScintillaObject *sci,  const gchar *text, gint len);
+void				sci_allocate				(ScintillaObject *sci,  gint bytes);
 gboolean			sci_can_redo				(ScintillaObject *sci);
 gboolean			sci_can_undo				(ScintillaObject *sci);
 gboolean			sci_has_selection			(ScintillaObject *sci);
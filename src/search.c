@@ -46,6 +46,10 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
 
 #ifdef G_OS_UNIX
 # include <sys/types.h>
@@ -151,7 +155,16 @@ static void search_close_pid(GPid child_pid, gint status, gpointer user_data);
 
 static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir);
 
+static gboolean fif_search_start(const gchar *utf8_search_text, const gchar *dir, const gchar *enc);
+static void fif_search_abort(void);
+static void sindex_free(void);
+static const gchar *fif_file_read(const gchar *path, gsize *len, GMappedFile **map);
+static void fif_file_free(const gchar *contents, GMappedFile *map);
+static gboolean fif_is_ascii(const gchar *text);
+static void search_show_usage_count(gint count, const gchar *original_search_text);
+
 static GRegex *compile_regex(const gchar *str, gint sflags);
+static void copy_regex_match(GeanyMatchInfo *match, const GMatchInfo *minfo);
 
 
 static void
@@ -281,6 +294,8 @@ void search_finalize(void)
 	FREE_WIDGET(find_dlg.dialog);
 	FREE_WIDGET(replace_dlg.dialog);
 	FREE_WIDGET(fif_dlg.dialog);
+	fif_search_abort();
+	sindex_free();
 	g_free(search_data.text);
 	g_free(search_data.original_text);
 }
@@ -1177,6 +1192,54 @@ void geany_match_info_free(GeanyMatchInfo *info)
 }
 
 
+/* Finds all regex matches in the range in one pass over the text, instead of
+ * compiling the regex and getting the text from Scintilla again for each match. */
+static GSList *find_range_regex(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf)
+{
+	GSList *matches = NULL;
+	GRegex *regex;
+	GMatchInfo *minfo;
+	const gchar *text;
+	gint len = sci_get_length(sci);
+
+	g_return_val_if_fail(ttf->chrg.cpMin >= 0 && ttf->chrg.cpMin <= len, NULL);
+
+	regex = compile_regex(ttf->lpstrText, flags);
+	if (!regex)
+		return NULL;
+
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER,
+	 * so there must not be any until minfo is freed */
+	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+	/* g_match_info_next() avoids rematching empty matches like "(?=[a-z])" or "^$" */
+	if (g_regex_match_full(regex, text, len, ttf->chrg.cpMin, 0, &minfo, NULL))
+	{
+		do
+		{
+			GeanyMatchInfo *info = match_info_new(flags, 0, 0);
+
+			copy_regex_match(info, minfo);
+			if (info->start >= ttf->chrg.cpMax || info->end > ttf->chrg.cpMax)
+			{
+				/* found text is (partially) out of range */
+				geany_match_info_free(info);
+				break;
+			}
+			matches = g_slist_prepend(matches, info);
+			ttf->chrgText.cpMin = info->start;
+			ttf->chrgText.cpMax = info->end;
+			ttf->chrg.cpMin = info->end;
+		}
+		while (g_match_info_next(minfo, NULL));
+	}
+	g_match_info_free(minfo);
+	g_regex_unref(regex);
+
+	return g_slist_reverse(matches);
+}
+
+
 /* find all in the given range.
  * Returns a list of allocated GeanyMatchInfo, should be freed using:
  *
@@ -1192,6 +1255,9 @@ GSList *find_range(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf)
 	if (! *ttf->lpstrText)
 		return NULL;
 
+	if (flags & SCFIND_REGEXP)
+		return find_range_regex(sci, flags, ttf);
+
 	while (search_find_text(sci, flags, ttf, &info) != -1)
 	{
 		if (ttf->chrgText.cpMax > ttf->chrg.cpMax)
@@ -1610,9 +1676,16 @@ on_find_in_files_dialog_response(GtkDialog *dialog, gint response,
 			const gchar *enc = (enc_idx == GEANY_ENCODING_UTF_8) ? NULL :
 				encodings_get_charset_from_index(enc_idx);
 
+			gboolean started;
+
 			locale_dir = utils_get_locale_from_utf8(utf8_dir);
 
-			if (search_find_in_files(search_text, locale_dir, opts->str, enc))
+			/* extra options are for grep, otherwise the search doesn't need it */
+			if (settings.fif_use_extra_options && *settings.fif_extra_options)
+				started = search_find_in_files(search_text, locale_dir, opts->str, enc);
+			else
+				started = fif_search_start(search_text, locale_dir, enc);
+			if (started)
 			{
 				ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(search_combo), search_text, 0);
 				ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(fif_dlg.files_combo), NULL, 0);
@@ -1934,286 +2007,1799 @@ static void search_close_pid(GPid child_pid, gint status, gpointer user_data)
 }
 
 
-static GRegex *compile_regex(const gchar *str, gint sflags)
+/* Trigram index of the project files.
+ * For each indexed file the trigrams it contains (any three bytes of a line, in ASCII
+ * lower case) are kept, and for each trigram the files which contain it. A search
+ * then only has to read the files which contain all trigrams of the text it looks
+ * for. Files are indexed by a thread pool and the results are merged from the main
+ * loop; the index of a project is saved next to the project file. */
+
+/* What a file looked like when it was read, to tell whether it has been written to since */
+typedef struct SearchIndexStamp
 {
-	GRegex *regex;
-	GError *error = NULL;
-	gint rflags = G_REGEX_MULTILINE;
+	gint64 mtime;		/* in nanoseconds where the system has them, or SINDEX_STAMP_UNKNOWN */
+	gint64 ctime;
+	gint64 size;
+	gint64 inode;
+}
+SearchIndexStamp;
 
-	if (~sflags & SCFIND_MATCHCASE)
-		rflags |= G_REGEX_CASELESS;
-	if (sflags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))
-	{
-		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
-	}
+typedef struct SearchIndexFile
+{
+	gchar *path;		/* locale encoding */
+	SearchIndexStamp stamp;
+	guint32 *trigrams;	/* sorted, NULL while not indexed */
+	guint n_trigrams;
+	guint generation;	/* of the last indexing job, to ignore outdated results */
+}
+SearchIndexFile;
+
+#define SINDEX_CACHE_MAGIC "AGKSIDX2"
+/* mtime of a file which may have been written to in the same clock tick as it was read,
+ * so the stamp can't show later changes; such a file is always read again */
+#define SINDEX_STAMP_UNKNOWN G_GINT64_CONSTANT(-1)
+/* the coarsest file time resolution to expect, FAT has two seconds */
+#define SINDEX_STAMP_RESOLUTION G_GINT64_CONSTANT(2000000000)
+/* the trigrams of a file are deduplicated whenever this many have been collected */
+#define SINDEX_TRIGRAMS_CHUNK 65536
+
+static GHashTable *sindex_files = NULL;		/* path -> SearchIndexFile */
+static GHashTable *sindex_postings = NULL;	/* trigram -> GPtrArray of SearchIndexFile */
+static GHashTable *sindex_cache = NULL;		/* path -> SearchIndexFile read from a cache file */
+static GThreadPool *sindex_pool = NULL;
+static GAsyncQueue *sindex_done = NULL;		/* finished jobs */
+static gint sindex_merge_queued = 0;
+static guint sindex_generation = 0;
+
+
+static void sindex_file_free(gpointer data)
+{
+	SearchIndexFile *file = data;
 
-	regex = g_regex_new(str, rflags, 0, &error);
-	if (!regex)
-	{
-		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
-		g_error_free(error);
-	}
-	return regex;
+	g_free(file->path);
+	g_free(file->trigrams);
+	g_free(file);
 }
 
 
-/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
-static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+static gint sindex_compare_trigrams(gconstpointer a, gconstpointer b)
 {
-	const gint start = match->matches[nth].start;
-	const gint end = match->matches[nth].end;
-	return g_strndup(&text[start], end - start);
+	guint32 ta = *(const guint32 *) a, tb = *(const guint32 *) b;
+
+	return ta < tb ? -1 : ta > tb;
 }
 
 
-static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, GeanyMatchInfo *match)
+static void sindex_sort_unique(GArray *trigrams)
 {
-	const gchar *text;
-	GMatchInfo *minfo;
-	gint ret = -1;
+	guint32 *t = (guint32 *) trigrams->data;
+	guint i, n = 0;
 
-	g_return_val_if_fail(pos <= (guint)sci_get_length(sci), -1);
+	g_array_sort(trigrams, sindex_compare_trigrams);
+	for (i = 0; i < trigrams->len; i++)
+	{
+		if (n == 0 || t[i] != t[n - 1])
+			t[n++] = t[i];
+	}
+	g_array_set_size(trigrams, n);
+}
 
-	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
-	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
 
-	/* Warning: minfo will become invalid when 'text' does! */
-	if (g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL))
-	{
-		guint i;
+/* Returns the sorted trigrams of text, which aren't broken by line ends like
+ * matches can't be (except for multiline regexes, which don't narrow the search) */
+static guint32 *sindex_get_trigrams(const gchar *text, gsize len, guint *n_trigrams)
+{
+	GArray *trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+	guint limit = SINDEX_TRIGRAMS_CHUNK;
+	guint32 t = 0, last = G_MAXUINT32;
+	guint valid = 0;	/* bytes of t which belong to the current line */
+	gsize i;
 
-		/* copy whole match text and offsets before they become invalid */
-		SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
+	for (i = 0; i < len; i++)
+	{
+		guchar c = text[i];
 
-		foreach_range(i, G_N_ELEMENTS(match->matches))
+		if (c == '\n' || c == '\r' || c == '\0')
 		{
-			gint start = -1, end = -1;
-
-			g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
-			match->matches[i].start = start;
-			match->matches[i].end = end;
+			valid = 0;
+			continue;
+		}
+		t = ((t << 8) | g_ascii_tolower(c)) & 0xFFFFFF;
+		/* runs like indentation repeat the same trigram */
+		if (++valid >= 3 && t != last)
+		{
+			g_array_append_val(trigrams, t);
+			last = t;
+			/* keep the memory bounded by the distinct trigrams for large files */
+			if (trigrams->len >= limit)
+			{
+				sindex_sort_unique(trigrams);
+				limit = MAX(limit, trigrams->len * 2);
+			}
 		}
-		match->start = match->matches[0].start;
-		match->end = match->matches[0].end;
-		ret = match->start;
 	}
-	g_match_info_free(minfo);
-	return ret;
+	sindex_sort_unique(trigrams);
+	*n_trigrams = trigrams->len;
+	return (guint32 *) g_array_free(trigrams, FALSE);
 }
 
 
-gint search_find_prev(ScintillaObject *sci, const gchar *str, gint flags, GeanyMatchInfo **match_)
+static gboolean sindex_file_has_trigram(SearchIndexFile *file, guint32 trigram)
 {
-	gint ret;
-
-	g_return_val_if_fail(! (flags & SCFIND_REGEXP), -1);
-
-	ret = sci_search_prev(sci, flags, str);
-	if (ret != -1 && match_)
-		*match_ = match_info_new(flags, ret, ret + strlen(str));
-	return ret;
+	return bsearch(&trigram, file->trigrams, file->n_trigrams, sizeof(guint32),
+		sindex_compare_trigrams) != NULL;
 }
 
 
-gint search_find_next(ScintillaObject *sci, const gchar *str, gint flags, GeanyMatchInfo **match_)
+static void sindex_add_postings(SearchIndexFile *file)
 {
-	GeanyMatchInfo *match;
-	GRegex *regex;
-	gint ret = -1;
-	gint pos;
+	guint i;
 
-	if (~flags & SCFIND_REGEXP)
+	for (i = 0; i < file->n_trigrams; i++)
 	{
-		ret = sci_search_next(sci, flags, str);
-		if (ret != -1 && match_)
-			*match_ = match_info_new(flags, ret, ret + strlen(str));
-		return ret;
-	}
+		gpointer key = GUINT_TO_POINTER(file->trigrams[i]);
+		GPtrArray *list = g_hash_table_lookup(sindex_postings, key);
 
-	regex = compile_regex(str, flags);
-	if (!regex)
-		return -1;
+		if (list == NULL)
+		{
+			list = g_ptr_array_sized_new(4);
+			g_hash_table_insert(sindex_postings, key, list);
+		}
+		g_ptr_array_add(list, file);
+	}
+}
 
-	match = match_info_new(flags, 0, 0);
 
-	pos = sci_get_current_position(sci);
-	ret = find_regex(sci, pos, regex, match);
-	/* avoid re-matching the same position in case of empty matches */
-	if (ret == pos && match->matches[0].start == match->matches[0].end)
-		ret = find_regex(sci, pos + 1, regex, match);
-	if (ret >= 0)
-		sci_set_selection(sci, match->start, match->end);
+static void sindex_remove_postings(SearchIndexFile *file)
+{
+	guint i;
 
-	if (ret != -1 && match_)
-		*match_ = match;
-	else
-		geany_match_info_free(match);
+	for (i = 0; i < file->n_trigrams; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(file->trigrams[i]);
+		GPtrArray *list = g_hash_table_lookup(sindex_postings, key);
 
-	g_regex_unref(regex);
-	return ret;
+		if (list == NULL)
+			continue;
+		g_ptr_array_remove_fast(list, file);
+		if (list->len == 0)
+			g_hash_table_remove(sindex_postings, key);
+	}
 }
 
 
-gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+static void sindex_free_postings_list(gpointer data)
 {
-	GString *str;
-	gint ret = 0;
-	gint i = 0;
+	g_ptr_array_free(data, TRUE);
+}
 
-	sci_set_target_start(sci, match->start);
-	sci_set_target_end(sci, match->end);
 
-	if (! (match->flags & SCFIND_REGEXP))
-		return sci_replace_target(sci, replace_text, FALSE);
+static gboolean sindex_merge_idle(G_GNUC_UNUSED gpointer data)
+{
+	SearchIndexFile *job;
 
-	str = g_string_new(replace_text);
-	while (str->str[i])
+	g_atomic_int_set(&sindex_merge_queued, 0);
+	if (sindex_done == NULL)
+		return FALSE;
+	while ((job = g_async_queue_try_pop(sindex_done)) != NULL)
 	{
-		gchar *ptr = &str->str[i];
-		gchar *grp;
-		gchar c;
+		SearchIndexFile *file = sindex_files ? g_hash_table_lookup(sindex_files, job->path) : NULL;
 
-		if (ptr[0] != '\\')
-		{
-			i++;
-			continue;
-		}
-		c = ptr[1];
-		/* backslash or unnecessary escape */
-		if (c == '\\' || !isdigit(c))
+		if (file != NULL && file->generation == job->generation && job->trigrams != NULL)
 		{
-			g_string_erase(str, i, 1);
-			i++;
-			continue;
+			sindex_remove_postings(file);
+			g_free(file->trigrams);
+			file->trigrams = job->trigrams;
+			file->n_trigrams = job->n_trigrams;
+			file->stamp = job->stamp;
+			job->trigrams = NULL;
+			sindex_add_postings(file);
 		}
-		/* digit escape */
-		g_string_erase(str, i, 2);
-		/* fix match offsets by subtracting index of whole match start from the string */
-		grp = get_regex_match_string(match->match_text - match->matches[0].start, match, c - '0');
-		g_string_insert(str, i, grp);
-		i += strlen(grp);
-		g_free(grp);
+		sindex_file_free(job);
 	}
-	ret = sci_replace_target(sci, str->str, FALSE);
-	g_string_free(str, TRUE);
-	return ret;
+	return FALSE;
 }
 
 
-gint search_find_text(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf, GeanyMatchInfo **match_)
+static void sindex_stamp_set(SearchIndexStamp *stamp, const struct stat *st)
 {
-	GeanyMatchInfo *match = NULL;
-	GRegex *regex;
-	gint ret;
+	stamp->mtime = (gint64) st->st_mtime * 1000000000;
+	stamp->ctime = (gint64) st->st_ctime * 1000000000;
+#if defined(__linux__)
+	stamp->mtime += st->st_mtim.tv_nsec;
+	stamp->ctime += st->st_ctim.tv_nsec;
+#elif defined(__APPLE__)
+	stamp->mtime += st->st_mtimespec.tv_nsec;
+	stamp->ctime += st->st_ctimespec.tv_nsec;
+#endif
+	stamp->size = st->st_size;
+	stamp->inode = st->st_ino;
+}
 
-	if (~flags & SCFIND_REGEXP)
-	{
-		ret = sci_find_text(sci, flags, ttf);
-		if (ret != -1 && match_)
-			*match_ = match_info_new(flags, ttf->chrgText.cpMin, ttf->chrgText.cpMax);
-		return ret;
-	}
 
-	regex = compile_regex(ttf->lpstrText, flags);
-	if (!regex)
-		return -1;
+/* Whether a file with the stamp old hasn't been written to since, as the ctime changes
+ * even when the mtime is set back and the inode when the file is replaced */
+static gboolean sindex_stamp_equal(const SearchIndexStamp *old, const struct stat *st)
+{
+	SearchIndexStamp now;
 
-	match = match_info_new(flags, 0, 0);
+	sindex_stamp_set(&now, st);
+	return old->mtime != SINDEX_STAMP_UNKNOWN && old->mtime == now.mtime &&
+		old->ctime == now.ctime && old->size == now.size && old->inode == now.inode;
+}
 
-	ret = find_regex(sci, ttf->chrg.cpMin, regex, match);
-	if (ret >= ttf->chrg.cpMax)
-		ret = -1;
-	else if (ret >= 0)
-	{
-		ttf->chrgText.cpMin = match->start;
-		ttf->chrgText.cpMax = match->end;
-	}
 
-	if (ret != -1 && match_)
-		*match_ = match;
-	else
-		geany_match_info_free(match);
+/* A job is a SearchIndexFile which isn't in the index, filled in by the pool */
+static void sindex_job_func(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+	SearchIndexFile *job = data;
+	struct stat st;
+	GTimeVal started;
+	GMappedFile *map;
+	const gchar *text;
+	gsize len;
 
-	g_regex_unref(regex);
-	return ret;
+	g_get_current_time(&started);
+	/* stat before reading, so a change while reading makes the result look outdated */
+	if (g_stat(job->path, &st) == 0 && (text = fif_file_read(job->path, &len, &map)) != NULL)
+	{
+		gint64 now = (gint64) started.tv_sec * 1000000000 + (gint64) started.tv_usec * 1000;
+
+		sindex_stamp_set(&job->stamp, &st);
+		/* a write right after reading can leave the times as they were */
+		if (MAX(job->stamp.mtime, job->stamp.ctime) > now - SINDEX_STAMP_RESOLUTION)
+			job->stamp.mtime = SINDEX_STAMP_UNKNOWN;
+		job->trigrams = sindex_get_trigrams(text, len, &job->n_trigrams);
+		fif_file_free(text, map);
+	}
+	g_async_queue_push(sindex_done, job);
+	if (g_atomic_int_compare_and_exchange(&sindex_merge_queued, 0, 1))
+		g_idle_add(sindex_merge_idle, NULL);
 }
 
 
-static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, gint flags)
+static gboolean sindex_file_is_current(SearchIndexFile *file, struct stat *st)
 {
-	gchar *buffer, *short_file_name;
-	struct Sci_TextToFind ttf;
-	gint count = 0;
-	gint prev_line = -1;
-	GSList *match, *matches;
+	return file->trigrams != NULL && sindex_stamp_equal(&file->stamp, st);
+}
 
-	g_return_val_if_fail(DOC_VALID(doc), 0);
 
-	short_file_name = g_path_get_basename(DOC_FILENAME(doc));
+/* Adds a file to the search index, or indexes it again if it has changed.
+ * @param locale_filename The file name, in locale encoding. */
+void search_index_add_file(const gchar *locale_filename)
+{
+	SearchIndexFile *file, *cached, *job;
+	struct stat st;
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
+	g_return_if_fail(locale_filename != NULL);
 
-	matches = find_range(doc->editor->sci, flags, &ttf);
-	foreach_slist (match, matches)
+	if (sindex_files == NULL)
 	{
-		GeanyMatchInfo *info = match->data;
-		gint line = sci_get_line_from_position(doc->editor->sci, info->start);
+		sindex_files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, sindex_file_free);
+		sindex_postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+			sindex_free_postings_list);
+	}
+	file = g_hash_table_lookup(sindex_files, locale_filename);
+	if (file == NULL)
+	{
+		file = g_new0(SearchIndexFile, 1);
+		file->path = g_strdup(locale_filename);
+		g_hash_table_insert(sindex_files, file->path, file);
+	}
 
-		if (line != prev_line)
-		{
-			buffer = sci_get_line(doc->editor->sci, line);
-			msgwin_msg_add(COLOR_BLACK, line + 1, doc,
-				"%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
-			g_free(buffer);
-			prev_line = line;
-		}
-		count++;
+	if (g_stat(locale_filename, &st) != 0 || sindex_file_is_current(file, &st))
+		return;
 
-		geany_match_info_free(info);
+	cached = sindex_cache ? g_hash_table_lookup(sindex_cache, locale_filename) : NULL;
+	if (cached != NULL && sindex_file_is_current(cached, &st))
+	{
+		sindex_remove_postings(file);
+		g_free(file->trigrams);
+		file->trigrams = cached->trigrams;
+		file->n_trigrams = cached->n_trigrams;
+		file->stamp = cached->stamp;
+		file->generation = ++sindex_generation;
+		cached->trigrams = NULL;
+		g_hash_table_remove(sindex_cache, locale_filename);
+		sindex_add_postings(file);
+		return;
 	}
-	g_slist_free(matches);
-	g_free(short_file_name);
-	return count;
+
+	if (sindex_pool == NULL)
+	{
+		/* indexing happens in the background, so leave some cores for the rest */
+		sindex_done = g_async_queue_new();
+		sindex_pool = g_thread_pool_new(sindex_job_func, NULL,
+			MAX(1, utils_get_worker_count() / 2), FALSE, NULL);
+	}
+	job = g_new0(SearchIndexFile, 1);
+	job->path = g_strdup(locale_filename);
+	job->generation = file->generation = ++sindex_generation;
+	g_thread_pool_push(sindex_pool, job, NULL);
 }
 
 
-void search_find_usage(const gchar *search_text, const gchar *original_search_text,
-		gint flags, gboolean in_session)
+/* Removes a file from the search index.
+ * @param locale_filename The file name, in locale encoding. */
+void search_index_remove_file(const gchar *locale_filename)
 {
-	GeanyDocument *doc;
-	gint count = 0;
+	SearchIndexFile *file;
 
-	doc = document_get_current();
-	g_return_if_fail(doc != NULL);
+	g_return_if_fail(locale_filename != NULL);
 
-	if (G_UNLIKELY(EMPTY(search_text)))
-	{
-		utils_beep();
+	if (sindex_files == NULL || (file = g_hash_table_lookup(sindex_files, locale_filename)) == NULL)
 		return;
-	}
+	sindex_remove_postings(file);
+	g_hash_table_remove(sindex_files, locale_filename);
+}
+
+
+static void sindex_put_uint(GString *buf, guint32 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+
+static void sindex_put_int64(GString *buf, gint64 value)
+{
+	g_string_append_len(buf, (const gchar *) &value, sizeof(value));
+}
+
+
+/* Saves the trigrams of indexed files, as differences from the previous trigram in
+ * 7 bit groups, which usually takes one or two bytes each.
+ * @param cache_file The cache file name, in locale encoding.
+ * @param file_names The files to save, in locale encoding.
+ * @return @c TRUE on success. */
+gboolean search_index_save_cache(const gchar *cache_file, GPtrArray *file_names)
+{
+	GString *buf = g_string_sized_new(4096);
+	GString *data = g_string_sized_new(4096);
+	guint i, j, count = 0;
+	gsize count_pos;
+	gboolean ret;
+
+	g_return_val_if_fail(cache_file != NULL && file_names != NULL, FALSE);
+
+	g_string_append_len(buf, SINDEX_CACHE_MAGIC, strlen(SINDEX_CACHE_MAGIC));
+	sindex_put_uint(buf, G_BYTE_ORDER);
+	count_pos = buf->len;
+	sindex_put_uint(buf, 0);
+
+	for (i = 0; i < file_names->len && sindex_files != NULL; i++)
+	{
+		SearchIndexFile *file = g_hash_table_lookup(sindex_files, file_names->pdata[i]);
+		guint32 prev = 0;
+
+		if (file == NULL || file->trigrams == NULL)
+			continue;
+
+		g_string_truncate(data, 0);
+		for (j = 0; j < file->n_trigrams; j++)
+		{
+			guint32 delta = file->trigrams[j] - prev;
+
+			while (delta >= 0x80)
+			{
+				g_string_append_c(data, (gchar) ((delta & 0x7F) | 0x80));
+				delta >>= 7;
+			}
+			g_string_append_c(data, (gchar) delta);
+			prev = file->trigrams[j];
+		}
+		sindex_put_uint(buf, strlen(file->path));
+		g_string_append(buf, file->path);
+		sindex_put_int64(buf, file->stamp.mtime);
+		sindex_put_int64(buf, file->stamp.ctime);
+		sindex_put_int64(buf, file->stamp.size);
+		sindex_put_int64(buf, file->stamp.inode);
+		sindex_put_uint(buf, file->n_trigrams);
+		sindex_put_uint(buf, data->len);
+		g_string_append_len(buf, data->str, data->len);
+		count++;
+	}
+	memcpy(buf->str + count_pos, &count, sizeof(count));
+
+	ret = g_file_set_contents(cache_file, buf->str, buf->len, NULL);
+	g_string_free(data, TRUE);
+	g_string_free(buf, TRUE);
+	return ret;
+}
+
+
+static gboolean sindex_get_bytes(const gchar **p, const gchar *end, gpointer dest, gsize n)
+{
+	if ((gsize) (end - *p) < n)
+		return FALSE;
+	memcpy(dest, *p, n);
+	*p += n;
+	return TRUE;
+}
+
+
+/* Reads the trigrams saved with search_index_save_cache(). Files added to the index
+ * afterwards use them instead of being read if they haven't changed since.
+ * @param cache_file The cache file name, in locale encoding.
+ * @return @c TRUE if the cache was read. */
+gboolean search_index_load_cache(const gchar *cache_file)
+{
+	gchar *contents;
+	const gchar *p, *end;
+	gsize len;
+	guint32 byte_order, count, i;
+
+	g_return_val_if_fail(cache_file != NULL, FALSE);
+
+	if (! g_file_get_contents(cache_file, &contents, &len, NULL))
+		return FALSE;
+	p = contents;
+	end = contents + len;
+	if (len < strlen(SINDEX_CACHE_MAGIC) || memcmp(p, SINDEX_CACHE_MAGIC, strlen(SINDEX_CACHE_MAGIC)) != 0)
+		goto fail;
+	p += strlen(SINDEX_CACHE_MAGIC);
+	if (! sindex_get_bytes(&p, end, &byte_order, sizeof(byte_order)) || byte_order != G_BYTE_ORDER ||
+		! sindex_get_bytes(&p, end, &count, sizeof(count)))
+		goto fail;
+
+	if (sindex_cache == NULL)
+		sindex_cache = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, sindex_file_free);
+
+	for (i = 0; i < count; i++)
+	{
+		SearchIndexFile *file;
+		guint32 path_len, data_len, j, prev = 0;
+		const gchar *data_end;
+
+		if (! sindex_get_bytes(&p, end, &path_len, sizeof(path_len)) || (gsize) (end - p) < path_len)
+			break;
+		file = g_new0(SearchIndexFile, 1);
+		file->path = g_strndup(p, path_len);
+		p += path_len;
+		if (! sindex_get_bytes(&p, end, &file->stamp.mtime, sizeof(file->stamp.mtime)) ||
+			! sindex_get_bytes(&p, end, &file->stamp.ctime, sizeof(file->stamp.ctime)) ||
+			! sindex_get_bytes(&p, end, &file->stamp.size, sizeof(file->stamp.size)) ||
+			! sindex_get_bytes(&p, end, &file->stamp.inode, sizeof(file->stamp.inode)) ||
+			! sindex_get_bytes(&p, end, &file->n_trigrams, sizeof(file->n_trigrams)) ||
+			! sindex_get_bytes(&p, end, &data_len, sizeof(data_len)) ||
+			(gsize) (end - p) < data_len || file->n_trigrams > data_len)
+		{
+			sindex_file_free(file);
+			break;
+		}
+		data_end = p + data_len;
+		file->trigrams = g_new(guint32, file->n_trigrams);
+		for (j = 0; j < file->n_trigrams && p < data_end; j++)
+		{
+			guint32 delta = 0;
+			guint shift = 0;
+
+			while (p < data_end && (*p & 0x80) && shift < 28)
+			{
+				delta |= (guint32) (*p++ & 0x7F) << shift;
+				shift += 7;
+			}
+			if (p < data_end)
+				delta |= (guint32) (guchar) *p++ << shift;
+			prev += delta;
+			file->trigrams[j] = prev;
+		}
+		p = data_end;
+		if (j < file->n_trigrams)
+		{
+			sindex_file_free(file);
+			break;
+		}
+		g_hash_table_insert(sindex_cache, file->path, file);
+	}
+	g_free(contents);
+	return TRUE;
+
+fail:
+	g_free(contents);
+	return FALSE;
+}
+
+
+/* Drops the cached trigrams of files which haven't been added to the index since
+ * search_index_load_cache(). */
+void search_index_release_cache(void)
+{
+	if (sindex_cache != NULL)
+	{
+		g_hash_table_destroy(sindex_cache);
+		sindex_cache = NULL;
+	}
+}
+
+
+/* Appends the literal parts of a regex which every match has to contain to runs,
+ * separated by newlines. Returns FALSE if it can't tell, e.g. for alternatives. */
+static gboolean sindex_get_regex_literals(const gchar *pattern, GString *runs)
+{
+	const gchar *p;
+	gint depth = 0;
+
+	/* options like (?x) change what the pattern means */
+	if (strstr(pattern, "(?") != NULL)
+		return FALSE;
+
+	for (p = pattern; *p; p++)
+	{
+		/* groups can be optional or have alternatives, so their text is not required */
+		if (depth > 0)
+		{
+			if (*p == '\\' && p[1])
+				p++;
+			else if (*p == '(')
+				depth++;
+			else if (*p == ')')
+				depth--;
+			continue;
+		}
+		switch (*p)
+		{
+			case '|':
+				return FALSE;
+			case '(':
+				depth++;
+				g_string_append_c(runs, '\n');
+				break;
+			case '[':
+				/* a class is any of its characters, skip to its end */
+				p++;
+				if (*p == '^')
+					p++;
+				if (*p == ']')
+					p++;
+				while (*p && *p != ']')
+				{
+					if (*p == '\\' && p[1])
+						p++;
+					p++;
+				}
+				if (! *p)
+					return FALSE;
+				g_string_append_c(runs, '\n');
+				break;
+			case '?':
+			case '*':
+			case '{':
+				/* the previous character can be left out */
+				if (runs->len > 0 && runs->str[runs->len - 1] != '\n')
+					g_string_truncate(runs, runs->len - 1);
+				g_string_append_c(runs, '\n');
+				if (*p == '{')
+				{
+					while (*p && *p != '}')
+						p++;
+					if (! *p)
+						return FALSE;
+				}
+				break;
+			case '+':
+			case '.':
+			case '^':
+			case '$':
+				g_string_append_c(runs, '\n');
+				break;
+			case '\\':
+				p++;
+				if (! *p)
+					return FALSE;
+				if (! g_ascii_isalnum(*p))
+					g_string_append_c(runs, *p);
+				else if (strchr("dDwWsSbBAzZG", *p) != NULL)
+					g_string_append_c(runs, '\n');
+				else
+					return FALSE;	/* escapes like \x41 or \1 */
+				break;
+			default:
+				g_string_append_c(runs, *p);
+				break;
+		}
+	}
+	return depth == 0;
+}
+
+
+/* Returns the files of the index which can contain a match of text, including those
+ * not indexed yet, or NULL if the index can't tell because text has no trigrams. */
+static GPtrArray *sindex_query(const gchar *text, gboolean regex, gboolean case_sensitive)
+{
+	GString *runs;
+	GPtrArray *result, *shortest = NULL;
+	GHashTableIter iter;
+	gpointer value;
+	guint32 *trigrams;
+	guint n_trigrams, i, j;
+
+	if (sindex_files == NULL || g_hash_table_size(sindex_files) == 0)
+		return NULL;
+
+	runs = g_string_new(NULL);
+	if (regex)
+	{
+		if (! sindex_get_regex_literals(text, runs))
+		{
+			g_string_free(runs, TRUE);
+			return NULL;
+		}
+	}
+	else
+		g_string_append(runs, text);
+	/* The trigrams only fold the case of ASCII letters, while a case insensitive
+	 * search of a regex or non-ASCII text folds all letters in UTF-8 files (see
+	 * fif_search_new()), so other bytes don't narrow it, and neither do k and s,
+	 * which also match the Kelvin sign and the long s */
+	if (! case_sensitive && (regex || ! fif_is_ascii(runs->str)))
+	{
+		for (i = 0; i < runs->len; i++)
+		{
+			if ((guchar) runs->str[i] >= 0x80 || strchr("kKsS", runs->str[i]) != NULL)
+				runs->str[i] = '\n';
+		}
+	}
+	trigrams = sindex_get_trigrams(runs->str, runs->len, &n_trigrams);
+	g_string_free(runs, TRUE);
+	if (n_trigrams == 0)
+	{
+		g_free(trigrams);
+		return NULL;
+	}
+
+	/* only the files with the rarest trigram have to be checked for the others */
+	for (i = 0; i < n_trigrams; i++)
+	{
+		GPtrArray *list = g_hash_table_lookup(sindex_postings, GUINT_TO_POINTER(trigrams[i]));
+
+		if (list == NULL)
+		{
+			shortest = NULL;
+			break;
+		}
+		if (shortest == NULL || list->len < shortest->len)
+			shortest = list;
+	}
+
+	result = g_ptr_array_new();
+	for (i = 0; shortest != NULL && i < shortest->len; i++)
+	{
+		SearchIndexFile *file = shortest->pdata[i];
+
+		for (j = 0; j < n_trigrams; j++)
+		{
+			if (! sindex_file_has_trigram(file, trigrams[j]))
+				break;
+		}
+		if (j == n_trigrams)
+			g_ptr_array_add(result, file);
+	}
+	g_hash_table_iter_init(&iter, sindex_files);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		if (((SearchIndexFile *) value)->trigrams == NULL)
+			g_ptr_array_add(result, value);
+	}
+	g_free(trigrams);
+	return result;
+}
+
+
+/* Returns the indexed files which can't contain a match of text, with their
+ * modification times and sizes when they were indexed, or NULL for none. */
+static GHashTable *sindex_get_skipped_files(const gchar *text, gboolean regex,
+		gboolean case_sensitive)
+{
+	GPtrArray *candidates = sindex_query(text, regex, case_sensitive);
+	GHashTable *matching, *skipped;
+	GHashTableIter iter;
+	gpointer value;
+	guint i;
+
+	if (candidates == NULL)
+		return NULL;
+
+	matching = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < candidates->len; i++)
+		g_hash_table_insert(matching, candidates->pdata[i], candidates->pdata[i]);
+	g_ptr_array_free(candidates, TRUE);
+
+	skipped = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_iter_init(&iter, sindex_files);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		SearchIndexFile *file = value;
+
+		/* a file whose stamp can't show changes is searched anyway */
+		if (g_hash_table_lookup(matching, file) == NULL &&
+			file->stamp.mtime != SINDEX_STAMP_UNKNOWN)
+		{
+			SearchIndexStamp *stamp = g_new(SearchIndexStamp, 1);
+
+			*stamp = file->stamp;
+			g_hash_table_insert(skipped, g_strdup(file->path), stamp);
+		}
+	}
+	g_hash_table_destroy(matching);
+	return skipped;
+}
+
+
+static void sindex_free(void)
+{
+	if (sindex_pool != NULL)
+	{
+		/* don't wait for files which haven't been started yet */
+		g_thread_pool_free(sindex_pool, TRUE, TRUE);
+		sindex_pool = NULL;
+	}
+	if (sindex_done != NULL)
+	{
+		SearchIndexFile *job;
+
+		while ((job = g_async_queue_try_pop(sindex_done)) != NULL)
+			sindex_file_free(job);
+		g_async_queue_unref(sindex_done);
+		sindex_done = NULL;
+	}
+	search_index_release_cache();
+	if (sindex_files != NULL)
+	{
+		g_hash_table_destroy(sindex_postings);
+		g_hash_table_destroy(sindex_files);
+		sindex_postings = NULL;
+		sindex_files = NULL;
+	}
+}
+
+
+/* Built-in Find in Files.
+ * The files are searched by a thread pool, one of whose threads walks the directory
+ * and queues the files it finds. Each file is mapped and searched as a whole, and
+ * its matching lines are passed to the main thread in batches, which a timeout adds
+ * to the Messages tab. */
+
+typedef struct FifSearch
+{
+	gchar *dir;			/* locale encoding, without trailing separator */
+	const gchar *enc;	/* charset of the files, NULL for UTF-8 */
+	GPtrArray *files;	/* project files to search instead of walking dir, or NULL */
+	GSList *patterns;	/* GPatternSpec the file names have to match, NULL for all */
+	GHashTable *skipped;	/* files the search index shows can't match, or NULL */
+	gboolean recursive;
+	gboolean invert;
+	gboolean whole_word;
+	gboolean case_sensitive;
+	GRegex *regex;		/* NULL for a literal search */
+	GRegex *utf8_regex;	/* with Unicode case folding for UTF-8 files, or NULL */
+	gchar *literal;
+	gsize literal_len;
+
+	GThreadPool *pool;
+	GAsyncQueue *results;	/* GPtrArray of UTF-8 message lines, or FIF_DONE */
+	gint pending;			/* tasks not finished yet */
+	gint cancelled;
+	guint source_id;
+	gint count;
+	gchar *usage_text;	/* UTF-8 text of a Find Usage search, NULL for Find in Files */
+}
+FifSearch;
+
+static gint fif_walk_marker, fif_done_marker;
+#define FIF_WALK_TASK ((gpointer) &fif_walk_marker)
+#define FIF_DONE ((gpointer) &fif_done_marker)
+
+/* lines sent to the main thread at once */
+#define FIF_BATCH_LINES 256
+/* lines added to the Messages tab at once, so the UI stays responsive */
+#define FIF_MAX_SHOWN_LINES 2000
+/* like grep -I, files with a null byte at the start are skipped as binary */
+#define FIF_BINARY_CHECK_SIZE 8192
+/* Files up to this size are read rather than mapped. A mapped file that another program
+ * truncates while it is searched raises SIGBUS, so only large files, which are expensive
+ * to copy, take that risk. */
+#define FIF_MAP_MIN_SIZE (4 * 1024 * 1024)
+
+static FifSearch *fif_current = NULL;
+
+
+static gboolean fif_is_word_char(gchar c)
+{
+	return g_ascii_isalnum(c) || c == '_';
+}
+
+
+/* Finds c in either case. next holds where each case is next found (-1 if not
+ * known yet, G_MAXSSIZE if not at all), so that the rest of the text isn't searched
+ * again each time for a case which is rare. */
+static const gchar *fif_memchr_case(const gchar *text, gsize len, gsize pos, gchar c,
+		gssize next[2])
+{
+	const gchar cases[2] = { g_ascii_tolower(c), g_ascii_toupper(c) };
+	guint i;
+
+	if (cases[0] == cases[1])
+		return memchr(text + pos, c, len - pos);
+
+	for (i = 0; i < 2; i++)
+	{
+		if (next[i] < (gssize) pos)
+		{
+			const gchar *p = memchr(text + pos, cases[i], len - pos);
+
+			next[i] = p ? p - text : G_MAXSSIZE;
+		}
+	}
+	if (MIN(next[0], next[1]) == G_MAXSSIZE)
+		return NULL;
+	return text + MIN(next[0], next[1]);
+}
+
+
+/* Returns the offset of the next match at or after pos, or -1. regex is the one to use
+ * for this text, NULL for a literal search.
+ * next is for fif_memchr_case() and should be set to {-1, -1} for each text. */
+static gssize fif_find(FifSearch *search, GRegex *regex, const gchar *text, gsize len,
+		gsize pos, gssize next[2])
+{
+	const gchar *needle = search->literal;
+	gsize n = search->literal_len;
+
+	if (regex)
+	{
+		GMatchInfo *minfo;
+		gint start = -1;
+
+		if (g_regex_match_full(regex, text, len, pos, 0, &minfo, NULL))
+			g_match_info_fetch_pos(minfo, 0, &start, NULL);
+		g_match_info_free(minfo);
+		return start;
+	}
+
+	/* memchr() skips quickly to the candidates, it's vectorized in most C libraries */
+	while (pos + n <= len)
+	{
+		const gchar *p;
+
+		if (search->case_sensitive)
+			p = memchr(text + pos, needle[0], len - pos);
+		else
+			p = fif_memchr_case(text, len, pos, needle[0], next);
+		if (p == NULL)
+			return -1;
+		pos = p - text;
+		if (pos + n > len)
+			return -1;
+
+		if ((search->case_sensitive ? memcmp(p, needle, n) : g_ascii_strncasecmp(p, needle, n)) == 0 &&
+			(! search->whole_word ||
+				((pos == 0 || ! fif_is_word_char(text[pos - 1])) &&
+				(pos + n == len || ! fif_is_word_char(text[pos + n])))))
+			return pos;
+		pos++;
+	}
+	return -1;
+}
+
+
+static void fif_add_line(FifSearch *search, GPtrArray **lines, const gchar *utf8_name,
+		guint line, const gchar *text, gsize len)
+{
+	gchar *utf8_text = NULL;
+
+	if (len > 0 && text[len - 1] == '\r')
+		len--;
+	/* enc is NULL when encoding is set to UTF-8, so we can skip any conversion */
+	if (! g_utf8_validate(text, len, NULL))
+	{
+		if (search->enc != NULL)
+			utf8_text = g_convert(text, len, "UTF-8", search->enc, NULL, NULL, NULL);
+		if (utf8_text == NULL)
+			utf8_text = g_convert_with_fallback(text, len, "UTF-8", "ISO-8859-1", "?", NULL, NULL, NULL);
+	}
+	if (*lines == NULL)
+		*lines = g_ptr_array_sized_new(FIF_BATCH_LINES);
+	g_ptr_array_add(*lines, g_strchomp(g_strdup_printf("%s:%u:%.*s", utf8_name, line,
+		utf8_text ? (gint) strlen(utf8_text) : (gint) len, utf8_text ? utf8_text : text)));
+	g_free(utf8_text);
+
+	if ((*lines)->len >= FIF_BATCH_LINES)
+	{
+		g_async_queue_push(search->results, *lines);
+		*lines = NULL;
+	}
+}
+
+
+/* Counts the lines from *counted up to pos */
+static void fif_count_lines(const gchar *text, gsize pos, gsize *counted, guint *line)
+{
+	const gchar *p = text + *counted;
+
+	while ((p = memchr(p, '\n', text + pos - p)) != NULL)
+	{
+		(*line)++;
+		p++;
+	}
+	*counted = pos;
+}
+
+
+/* Returns the contents of a file, or NULL. Free them with fif_file_free(). */
+static const gchar *fif_file_read(const gchar *path, gsize *len, GMappedFile **map)
+{
+	struct stat st;
+	gchar *contents;
+
+	*len = 0;
+	*map = NULL;
+	if (g_stat(path, &st) != 0)
+		return NULL;
+	if (st.st_size >= FIF_MAP_MIN_SIZE)
+	{
+		*map = g_mapped_file_new(path, FALSE, NULL);
+		if (*map == NULL)
+			return NULL;
+		*len = g_mapped_file_get_length(*map);
+		return g_mapped_file_get_contents(*map);
+	}
+	if (! g_file_get_contents(path, &contents, len, NULL))
+		return NULL;
+	return contents;
+}
+
+
+static void fif_file_free(const gchar *contents, GMappedFile *map)
+{
+	if (map == NULL)
+		g_free((gchar *) contents);
+	else
+	{
+#if GLIB_CHECK_VERSION(2, 22, 0)
+		g_mapped_file_unref(map);
+#else
+		g_mapped_file_free(map);
+#endif
+	}
+}
+
+
+static void fif_search_file(FifSearch *search, const gchar *path)
+{
+	GMappedFile *map;
+	const gchar *text, *name;
+	gchar *utf8_name = NULL;
+	GPtrArray *lines = NULL;
+	GRegex *regex = search->regex;
+	gsize len, pos = 0, counted = 0;
+	gssize next[2] = { -1, -1 };
+	guint line = 1;
+
+	text = fif_file_read(path, &len, &map);
+	if (text == NULL)
+		return;
+	/* GRegex takes gint offsets */
+	if (len == 0 || (search->regex && len > G_MAXINT) ||
+		memchr(text, '\0', MIN(len, FIF_BINARY_CHECK_SIZE)) != NULL)
+		goto done;
+	/* non-ASCII letters only match in another case in text known to be UTF-8 */
+	if (search->utf8_regex && len <= G_MAXINT && g_utf8_validate(text, len, NULL))
+		regex = search->utf8_regex;
+
+	/* names are shown relative to the searched directory like grep does */
+	name = path;
+	if (*search->dir && g_str_has_prefix(path, search->dir) && G_IS_DIR_SEPARATOR(path[strlen(search->dir)]))
+		name = path + strlen(search->dir) + 1;
+
+	/* pos is always the start of a line */
+	while (pos < len && ! g_atomic_int_get(&search->cancelled))
+	{
+		gssize hit = fif_find(search, regex, text, len, pos, next);
+		gsize start, end;
+		const gchar *p;
+
+		if (hit < 0)
+			start = end = len;
+		else
+		{
+			start = hit;
+			while (start > pos && text[start - 1] != '\n')
+				start--;
+			p = memchr(text + hit, '\n', len - hit);
+			end = p ? (gsize) (p - text) : len;
+		}
+		if (utf8_name == NULL && (hit >= 0 || search->invert))
+			utf8_name = utils_get_utf8_from_locale(name);
+
+		if (search->invert)
+		{
+			/* the lines before the one with the match */
+			while (pos < start)
+			{
+				p = memchr(text + pos, '\n', start - pos);
+				fif_count_lines(text, pos, &counted, &line);
+				fif_add_line(search, &lines, utf8_name, line, text + pos,
+					(p ? (gsize) (p - text) : start) - pos);
+				pos = p ? (gsize) (p - text) + 1 : start;
+			}
+		}
+		else if (hit >= 0)
+		{
+			fif_count_lines(text, start, &counted, &line);
+			fif_add_line(search, &lines, utf8_name, line, text + start, end - start);
+		}
+		pos = end + 1;
+	}
+	if (lines)
+		g_async_queue_push(search->results, lines);
+
+done:
+	g_free(utf8_name);
+	fif_file_free(text, map);
+}
+
+
+static gboolean fif_file_name_matches(FifSearch *search, const gchar *path)
+{
+	const gchar *name = strrchr(path, G_DIR_SEPARATOR);
+	GSList *item;
+
+#ifdef G_OS_WIN32
+	if (strrchr(path, '/') > name)
+		name = strrchr(path, '/');
+#endif
+	name = name ? name + 1 : path;
+	if (search->patterns == NULL)
+		return TRUE;
+	foreach_slist(item, search->patterns)
+	{
+		if (g_pattern_match_string(item->data, name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* Whether the file hasn't changed since the search index showed it can't match */
+static gboolean fif_is_skipped(FifSearch *search, const gchar *path)
+{
+	SearchIndexStamp *stamp = g_hash_table_lookup(search->skipped, path);
+	struct stat st;
+
+	return stamp != NULL && g_stat(path, &st) == 0 && sindex_stamp_equal(stamp, &st);
+}
+
+
+/* takes ownership of path */
+static void fif_queue_file(FifSearch *search, gchar *path)
+{
+	/* like grep -r, skip devices, FIFOs and sockets, reading a FIFO would block */
+	if (! fif_file_name_matches(search, path) ||
+		! g_file_test(path, G_FILE_TEST_IS_REGULAR) ||
+		(search->skipped != NULL && fif_is_skipped(search, path)))
+	{
+		g_free(path);
+		return;
+	}
+	g_atomic_int_inc(&search->pending);
+	g_thread_pool_push(search->pool, path, NULL);
+}
+
+
+static void fif_walk(FifSearch *search, const gchar *dir)
+{
+	GDir *gdir = g_dir_open(dir, 0, NULL);
+	const gchar *name;
+
+	if (gdir == NULL)
+		return;
+	while (! g_atomic_int_get(&search->cancelled) && (name = g_dir_read_name(gdir)) != NULL)
+	{
+		gchar *path = g_build_filename(dir, name, NULL);
+
+		if (! g_file_test(path, G_FILE_TEST_IS_DIR))
+			fif_queue_file(search, path);
+		else
+		{
+			/* like grep -r, don't follow links to directories */
+			if (search->recursive && ! g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+				fif_walk(search, path);
+			g_free(path);
+		}
+	}
+	g_dir_close(gdir);
+}
+
+
+static void fif_queue_project_files(FifSearch *search)
+{
+	gsize dir_len = strlen(search->dir);
+	guint i;
+
+	for (i = 0; i < search->files->len && ! g_atomic_int_get(&search->cancelled); i++)
+	{
+		const gchar *path = search->files->pdata[i];
+
+		/* only the files in the searched directory */
+		if (! g_str_has_prefix(path, search->dir) || ! G_IS_DIR_SEPARATOR(path[dir_len]))
+			continue;
+		if (! search->recursive && strchr(path + dir_len + 1, G_DIR_SEPARATOR) != NULL)
+			continue;
+		fif_queue_file(search, g_strdup(path));
+	}
+}
+
+
+static void fif_task_func(gpointer data, gpointer user_data)
+{
+	FifSearch *search = user_data;
+
+	if (data == FIF_WALK_TASK)
+	{
+		if (search->files)
+			fif_queue_project_files(search);
+		else
+			fif_walk(search, search->dir);
+	}
+	else
+	{
+		if (! g_atomic_int_get(&search->cancelled))
+			fif_search_file(search, data);
+		g_free(data);
+	}
+	if (g_atomic_int_dec_and_test(&search->pending))
+		g_async_queue_push(search->results, FIF_DONE);
+}
+
+
+static void fif_search_free(FifSearch *search)
+{
+	gpointer item;
+
+	if (search->pool)
+		g_thread_pool_free(search->pool, TRUE, TRUE);
+	while ((item = g_async_queue_try_pop(search->results)) != NULL)
+	{
+		if (item != FIF_DONE)
+		{
+			g_ptr_array_foreach(item, (GFunc) g_free, NULL);
+			g_ptr_array_free(item, TRUE);
+		}
+	}
+	g_async_queue_unref(search->results);
+	if (search->files)
+	{
+		g_ptr_array_foreach(search->files, (GFunc) g_free, NULL);
+		g_ptr_array_free(search->files, TRUE);
+	}
+	g_slist_foreach(search->patterns, (GFunc) g_pattern_spec_free, NULL);
+	g_slist_free(search->patterns);
+	if (search->skipped)
+		g_hash_table_destroy(search->skipped);
+	if (search->regex)
+		g_regex_unref(search->regex);
+	if (search->utf8_regex)
+		g_regex_unref(search->utf8_regex);
+	g_free(search->literal);
+	g_free(search->usage_text);
+	g_free(search->dir);
+	g_free(search);
+}
+
+
+static void fif_search_finish(FifSearch *search)
+{
+	if (! search->cancelled && search->usage_text)
+	{
+		search_show_usage_count(search->count, search->usage_text);
+		ui_progress_bar_stop();
+	}
+	else if (! search->cancelled)
+	{
+		if (search->count == 0)
+		{
+			const gchar *msg = _("No matches found.");
+
+			msgwin_msg_add_string(COLOR_BLUE, -1, NULL, msg);
+			ui_set_statusbar(FALSE, "%s", msg);
+		}
+		else
+		{
+			gchar *text = ngettext(
+						"Search completed with %d match.",
+						"Search completed with %d matches.", search->count);
+
+			msgwin_msg_add(COLOR_BLUE, -1, NULL, text, search->count);
+			ui_set_statusbar(FALSE, text, search->count);
+		}
+		ui_progress_bar_stop();
+	}
+	if (fif_current == search)
+		fif_current = NULL;
+	fif_search_free(search);
+}
+
+
+static gboolean fif_show_results(gpointer data)
+{
+	FifSearch *search = data;
+	gpointer item;
+	guint shown = 0;
+
+	while (shown < FIF_MAX_SHOWN_LINES && (item = g_async_queue_try_pop(search->results)) != NULL)
+	{
+		GPtrArray *lines = item;
+		guint i;
+
+		if (item == FIF_DONE)
+		{
+			search->source_id = 0;
+			fif_search_finish(search);
+			return FALSE;
+		}
+		for (i = 0; i < lines->len; i++)
+		{
+			if (! search->cancelled)
+				msgwin_msg_add_string(COLOR_BLACK, -1, NULL, lines->pdata[i]);
+			g_free(lines->pdata[i]);
+		}
+		search->count += lines->len;
+		shown += lines->len;
+		g_ptr_array_free(lines, TRUE);
+	}
+	return TRUE;
+}
+
+
+/* Stops the search. Its tasks finish quickly, and it is freed when they have */
+static void fif_search_cancel(FifSearch *search)
+{
+	g_atomic_int_set(&search->cancelled, TRUE);
+	if (fif_current == search)
+	{
+		fif_current = NULL;
+		ui_progress_bar_stop();
+	}
+}
+
+
+/* Stops and frees the current search without waiting for its results, when quitting */
+static void fif_search_abort(void)
+{
+	FifSearch *search = fif_current;
+
+	if (search == NULL)
+		return;
+	g_atomic_int_set(&search->cancelled, TRUE);
+	if (search->source_id)
+		g_source_remove(search->source_id);
+	fif_current = NULL;
+	fif_search_free(search);
+}
+
+
+/* Returns the files of the project whose directory is dir in locale encoding, or NULL */
+static GPtrArray *fif_get_project_files(const gchar *dir)
+{
+	guint i, j;
+
+	for (i = 0; i < projects_array->len; i++)
+	{
+		GeanyProject *project = projects[i];
+		gchar *project_dir, *locale_project_dir;
+		GPtrArray *files;
+
+		if (! project->is_valid)
+			continue;
+		project_dir = g_path_get_dirname(project->file_name);
+		locale_project_dir = utils_get_locale_from_utf8(project_dir);
+		g_free(project_dir);
+		if (! utils_str_equal(locale_project_dir, dir))
+		{
+			g_free(locale_project_dir);
+			continue;
+		}
+		g_free(locale_project_dir);
+
+		files = g_ptr_array_sized_new(project->project_files->len);
+		for (j = 0; j < project->project_files->len; j++)
+		{
+			if (project_files_index(project, j)->is_valid)
+				g_ptr_array_add(files, utils_get_locale_from_utf8(project_files_index(project, j)->file_name));
+		}
+		return files;
+	}
+	return NULL;
+}
+
+
+static gboolean fif_is_ascii(const gchar *text)
+{
+	for (; *text; text++)
+	{
+		if ((guchar) *text >= 0x80)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* The byte-wise search folds the case of ASCII letters only, like grep -i in the C locale.
+ * This regex folds the case of all letters, like grep -i in a UTF-8 locale, for files
+ * which are valid UTF-8. Returns NULL if the search text can't be compiled as UTF-8. */
+static GRegex *fif_utf8_regex_new(const gchar *search_text, gboolean regexp,
+		gboolean whole_word)
+{
+	gchar *text, *pattern;
+	GRegex *regex;
+
+	if (! g_utf8_validate(search_text, -1, NULL))
+		return NULL;
+	text = regexp ? g_strdup(search_text) : g_regex_escape_string(search_text, -1);
+	pattern = whole_word ? g_strconcat("\\b(?:", text, ")\\b", NULL) : g_strdup(text);
+	regex = g_regex_new(pattern, G_REGEX_MULTILINE | G_REGEX_CASELESS | G_REGEX_OPTIMIZE,
+		0, NULL);
+	g_free(pattern);
+	g_free(text);
+	return regex;
+}
+
+
+/* Returns a search with its matcher set up, or NULL for a bad regex.
+ * search_text must be in the encoding of the files. */
+static FifSearch *fif_search_new(const gchar *search_text, gboolean regexp,
+		gboolean case_sensitive, gboolean whole_word, gboolean invert)
+{
+	FifSearch *search = g_new0(FifSearch, 1);
+
+	search->invert = invert;
+	search->whole_word = whole_word;
+	search->case_sensitive = case_sensitive;
+	search->results = g_async_queue_new();
+
+	/* a regex without special characters is searched for as a literal */
+	regexp = regexp && strpbrk(search_text, "\\^$.[]|()?*+{}") != NULL;
+	if (regexp)
+	{
+		/* the files can be in any encoding, so the regex works on bytes */
+		gint rflags = G_REGEX_MULTILINE | G_REGEX_RAW | G_REGEX_OPTIMIZE;
+		GError *error = NULL;
+		gchar *pattern;
+
+		if (! case_sensitive)
+			rflags |= G_REGEX_CASELESS;
+		pattern = whole_word ?
+			g_strconcat("\\b(?:", search_text, ")\\b", NULL) : g_strdup(search_text);
+		search->regex = g_regex_new(pattern, rflags, 0, &error);
+		g_free(pattern);
+		if (search->regex == NULL)
+		{
+			ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+			g_error_free(error);
+			fif_search_free(search);
+			return NULL;
+		}
+	}
+	else
+	{
+		search->literal = g_strdup(search_text);
+		search->literal_len = strlen(search_text);
+	}
+	if (! case_sensitive && (regexp || ! fif_is_ascii(search_text)))
+		search->utf8_regex = fif_utf8_regex_new(search_text, regexp, whole_word);
+	return search;
+}
+
+
+static gboolean
+fif_search_start(const gchar *utf8_search_text, const gchar *dir, const gchar *enc)
+{
+	FifSearch *search;
+	gchar *search_text = NULL, *dir2, *str;
+	gsize utf8_text_len, len;
+
+	if (EMPTY(utf8_search_text) || ! dir) return TRUE;
+
+	dir2 = g_strdup(dir);
+	len = strlen(dir2);
+	while (len > 1 && G_IS_DIR_SEPARATOR(dir2[len - 1]))
+		dir2[--len] = 0;
+	if (! g_file_test(dir2, G_FILE_TEST_IS_DIR))
+	{
+		ui_set_statusbar(TRUE, _("Could not open directory (%s)"), dir2);
+		g_free(dir2);
+		return FALSE;
+	}
+
+	/* convert the search text in the preferred encoding (if the text is not valid UTF-8. assume
+	 * it is already in the preferred encoding) */
+	utf8_text_len = strlen(utf8_search_text);
+	if (enc != NULL && g_utf8_validate(utf8_search_text, utf8_text_len, NULL))
+	{
+		search_text = g_convert(utf8_search_text, utf8_text_len, enc, "UTF-8", NULL, NULL, NULL);
+	}
+	if (search_text == NULL)
+		search_text = g_strdup(utf8_search_text);
+
+	search = fif_search_new(search_text, settings.fif_regexp, settings.fif_case_sensitive,
+		settings.fif_match_whole_word, settings.fif_invert_results);
+	if (search == NULL)
+	{
+		g_free(search_text);
+		g_free(dir2);
+		return FALSE;
+	}
+	search->dir = dir2;
+	search->enc = enc;
+	search->recursive = settings.fif_recursive;
+	/* indexed project files which can't match don't need to be read */
+	if (! search->invert)
+		search->skipped = sindex_get_skipped_files(search_text, search->regex != NULL,
+			search->case_sensitive);
+	g_free(search_text);
+
+	g_strstrip(settings.fif_files);
+	if (settings.fif_files_mode != FILES_MODE_ALL && *settings.fif_files)
+	{
+		gchar **names = g_strsplit(settings.fif_files, " ", -1);
+		gchar **name;
+
+		foreach_strv(name, names)
+		{
+			if (**name)
+				search->patterns = g_slist_prepend(search->patterns, g_pattern_spec_new(*name));
+		}
+		g_strfreev(names);
+	}
+	/* the project knows its files, so the directory doesn't have to be walked */
+	if (settings.fif_files_mode == FILES_MODE_PROJECT)
+		search->files = fif_get_project_files(dir2);
+
+	if (fif_current)
+		fif_search_cancel(fif_current);
 
-	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
-	gtk_widget_grab_focus(msgwindow.notebook);
 	gtk_list_store_clear(msgwindow.store_msg);
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+	gtk_widget_grab_focus(msgwindow.notebook);
+
+	ui_progress_bar_start(_("Searching..."));
+	msgwin_set_messages_dir(dir2);
+	str = g_strdup_printf(_("Searching for %s (in directory: %s)"), utf8_search_text, dir2);
+	SETPTR(str, utils_get_utf8_from_locale(str));
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, str);
+	g_free(str);
+
+	/* the walk counts as a task until it has queued all files */
+	search->pending = 1;
+	search->pool = g_thread_pool_new(fif_task_func, search, utils_get_worker_count(), FALSE, NULL);
+	g_thread_pool_push(search->pool, FIF_WALK_TASK, NULL);
+	search->source_id = g_timeout_add(50, fif_show_results, search);
+	fif_current = search;
+	return TRUE;
+}
+
+
+static GRegex *compile_regex(const gchar *str, gint sflags)
+{
+	GRegex *regex;
+	GError *error = NULL;
+	/* most regexes are used for many matches, e.g. to replace or mark all */
+	gint rflags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+
+	if (~sflags & SCFIND_MATCHCASE)
+		rflags |= G_REGEX_CASELESS;
+	if (sflags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))
+	{
+		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
+	}
+
+	regex = g_regex_new(str, rflags, 0, &error);
+	if (!regex)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+	}
+	return regex;
+}
+
+
+/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
+static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+{
+	const gint start = match->matches[nth].start;
+	const gint end = match->matches[nth].end;
+	return g_strndup(&text[start], end - start);
+}
+
+
+/* copies the offsets and text of the current match of minfo before they become invalid */
+static void copy_regex_match(GeanyMatchInfo *match, const GMatchInfo *minfo)
+{
+	guint i;
+
+	SETPTR(match->match_text, g_match_info_fetch(minfo, 0));
+
+	foreach_range(i, G_N_ELEMENTS(match->matches))
+	{
+		gint start = -1, end = -1;
+
+		g_match_info_fetch_pos(minfo, (gint)i, &start, &end);
+		match->matches[i].start = start;
+		match->matches[i].end = end;
+	}
+	match->start = match->matches[0].start;
+	match->end = match->matches[0].end;
+}
+
+
+static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, GeanyMatchInfo *match)
+{
+	const gchar *text;
+	GMatchInfo *minfo;
+	gint len = sci_get_length(sci);
+	gint ret = -1;
 
-	if (! in_session)
-	{	/* use current document */
-		count = find_document_usage(doc, search_text, flags);
+	g_return_val_if_fail(pos <= (guint)len, -1);
+
+	/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
+	text = (void*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+	/* Warning: minfo will become invalid when 'text' does! */
+	if (g_regex_match_full(regex, text, len, pos, 0, &minfo, NULL))
+	{
+		copy_regex_match(match, minfo);
+		ret = match->start;
+	}
+	g_match_info_free(minfo);
+	return ret;
+}
+
+
+gint search_find_prev(ScintillaObject *sci, const gchar *str, gint flags, GeanyMatchInfo **match_)
+{
+	gint ret;
+
+	g_return_val_if_fail(! (flags & SCFIND_REGEXP), -1);
+
+	ret = sci_search_prev(sci, flags, str);
+	if (ret != -1 && match_)
+		*match_ = match_info_new(flags, ret, ret + strlen(str));
+	return ret;
+}
+
+
+gint search_find_next(ScintillaObject *sci, const gchar *str, gint flags, GeanyMatchInfo **match_)
+{
+	GeanyMatchInfo *match;
+	GRegex *regex;
+	gint ret = -1;
+	gint pos;
+
+	if (~flags & SCFIND_REGEXP)
+	{
+		ret = sci_search_next(sci, flags, str);
+		if (ret != -1 && match_)
+			*match_ = match_info_new(flags, ret, ret + strlen(str));
+		return ret;
 	}
+
+	regex = compile_regex(str, flags);
+	if (!regex)
+		return -1;
+
+	match = match_info_new(flags, 0, 0);
+
+	pos = sci_get_current_position(sci);
+	ret = find_regex(sci, pos, regex, match);
+	/* avoid re-matching the same position in case of empty matches */
+	if (ret == pos && match->matches[0].start == match->matches[0].end)
+		ret = find_regex(sci, pos + 1, regex, match);
+	if (ret >= 0)
+		sci_set_selection(sci, match->start, match->end);
+
+	if (ret != -1 && match_)
+		*match_ = match;
 	else
+		geany_match_info_free(match);
+
+	g_regex_unref(regex);
+	return ret;
+}
+
+
+gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+{
+	GString *str;
+	gint ret = 0;
+	gint i = 0;
+
+	sci_set_target_start(sci, match->start);
+	sci_set_target_end(sci, match->end);
+
+	if (! (match->flags & SCFIND_REGEXP))
+		return sci_replace_target(sci, replace_text, FALSE);
+
+	str = g_string_new(replace_text);
+	while (str->str[i])
 	{
-		guint i;
-		for (i = 0; i < documents_array->len; i++)
+		gchar *ptr = &str->str[i];
+		gchar *grp;
+		gchar c;
+
+		if (ptr[0] != '\\')
 		{
-			if (documents[i]->is_valid)
-			{
-				count += find_document_usage(documents[i], search_text, flags);
-			}
+			i++;
+			continue;
+		}
+		c = ptr[1];
+		/* backslash or unnecessary escape */
+		if (c == '\\' || !isdigit(c))
+		{
+			g_string_erase(str, i, 1);
+			i++;
+			continue;
+		}
+		/* digit escape */
+		g_string_erase(str, i, 2);
+		/* fix match offsets by subtracting index of whole match start from the string */
+		grp = get_regex_match_string(match->match_text - match->matches[0].start, match, c - '0');
+		g_string_insert(str, i, grp);
+		i += strlen(grp);
+		g_free(grp);
+	}
+	ret = sci_replace_target(sci, str->str, FALSE);
+	g_string_free(str, TRUE);
+	return ret;
+}
+
+
+gint search_find_text(ScintillaObject *sci, gint flags, struct Sci_TextToFind *ttf, GeanyMatchInfo **match_)
+{
+	GeanyMatchInfo *match = NULL;
+	GRegex *regex;
+	gint ret;
+
+	if (~flags & SCFIND_REGEXP)
+	{
+		ret = sci_find_text(sci, flags, ttf);
+		if (ret != -1 && match_)
+			*match_ = match_info_new(flags, ttf->chrgText.cpMin, ttf->chrgText.cpMax);
+		return ret;
+	}
+
+	regex = compile_regex(ttf->lpstrText, flags);
+	if (!regex)
+		return -1;
+
+	match = match_info_new(flags, 0, 0);
+
+	ret = find_regex(sci, ttf->chrg.cpMin, regex, match);
+	if (ret >= ttf->chrg.cpMax)
+		ret = -1;
+	else if (ret >= 0)
+	{
+		ttf->chrgText.cpMin = match->start;
+		ttf->chrgText.cpMax = match->end;
+	}
+
+	if (ret != -1 && match_)
+		*match_ = match;
+	else
+		geany_match_info_free(match);
+
+	g_regex_unref(regex);
+	return ret;
+}
+
+
+static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, gint flags)
+{
+	gchar *buffer, *short_file_name;
+	struct Sci_TextToFind ttf;
+	gint count = 0;
+	gint prev_line = -1;
+	GSList *match, *matches;
+
+	g_return_val_if_fail(DOC_VALID(doc), 0);
+
+	short_file_name = g_path_get_basename(DOC_FILENAME(doc));
+
+	ttf.chrg.cpMin = 0;
+	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
+	ttf.lpstrText = (gchar *)search_text;
+
+	matches = find_range(doc->editor->sci, flags, &ttf);
+	foreach_slist (match, matches)
+	{
+		GeanyMatchInfo *info = match->data;
+		gint line = sci_get_line_from_position(doc->editor->sci, info->start);
+
+		if (line != prev_line)
+		{
+			buffer = sci_get_line(doc->editor->sci, line);
+			msgwin_msg_add(COLOR_BLACK, line + 1, doc,
+				"%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
+			g_free(buffer);
+			prev_line = line;
 		}
+		count++;
+
+		geany_match_info_free(info);
 	}
+	g_slist_free(matches);
+	g_free(short_file_name);
+	return count;
+}
+
+
+/* Starts searching the indexed project files which aren't open, reading only those
+ * which the index shows can contain search_text, with the matches found in the open
+ * documents counted as count. Returns whether it has started, then the search shows
+ * the number of matches when it has finished. */
+static gboolean find_project_usage(const gchar *search_text, const gchar *original_search_text,
+		gint flags, gint count)
+{
+	FifSearch *search;
+	GPtrArray *files;
+	GHashTableIter iter;
+	gpointer value;
+	gchar *utf8_dir = NULL;
+	guint i;
+
+	if (sindex_files == NULL || g_hash_table_size(sindex_files) == 0)
+		return FALSE;
+
+	search = fif_search_new(search_text, flags & SCFIND_REGEXP, flags & SCFIND_MATCHCASE,
+		flags & SCFIND_WHOLEWORD, FALSE);
+	if (search == NULL)
+		return FALSE;
+
+	/* names are shown relative to the current project, like Find in Files does */
+	if (app->project != NULL)
+		utf8_dir = g_path_get_dirname(app->project->file_name);
+	search->dir = utf8_dir ? utils_get_locale_from_utf8(utf8_dir) : g_strdup("");
+	if (utf8_dir != NULL)
+		msgwin_set_messages_dir(search->dir);
+	g_free(utf8_dir);
+	search->usage_text = g_strdup(original_search_text);
+	search->count = count;
+
+	files = sindex_query(search_text, search->regex != NULL, search->case_sensitive);
+	if (files == NULL)
+	{
+		files = g_ptr_array_new();
+		g_hash_table_iter_init(&iter, sindex_files);
+		while (g_hash_table_iter_next(&iter, NULL, &value))
+			g_ptr_array_add(files, value);
+	}
+
+	ui_progress_bar_start(_("Searching..."));
+	/* the main thread counts as a task until it has queued all files */
+	search->pending = 1;
+	search->pool = g_thread_pool_new(fif_task_func, search, utils_get_worker_count(), FALSE, NULL);
+	for (i = 0; i < files->len; i++)
+	{
+		SearchIndexFile *file = files->pdata[i];
+		gchar *utf8_filename = utils_get_utf8_from_locale(file->path);
+
+		/* open documents have already been searched */
+		if (document_find_by_filename(utf8_filename) == NULL)
+			fif_queue_file(search, g_strdup(file->path));
+		g_free(utf8_filename);
+	}
+	g_ptr_array_free(files, TRUE);
+	if (g_atomic_int_dec_and_test(&search->pending))
+		g_async_queue_push(search->results, FIF_DONE);
+
+	search->source_id = g_timeout_add(50, fif_show_results, search);
+	fif_current = search;
+	return TRUE;
+}
+
 
+/* Shows how many matches Find Usage has found */
+static void search_show_usage_count(gint count, const gchar *original_search_text)
+{
 	if (count == 0) /* no matches were found */
 	{
 		ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), original_search_text);
@@ -2231,6 +3817,51 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 }
 
 
+void search_find_usage(const gchar *search_text, const gchar *original_search_text,
+		gint flags, gboolean in_session)
+{
+	GeanyDocument *doc;
+	gint count = 0;
+
+	doc = document_get_current();
+	g_return_if_fail(doc != NULL);
+
+	if (G_UNLIKELY(EMPTY(search_text)))
+	{
+		utils_beep();
+		return;
+	}
+
+	/* a search still running would add its matches to the new ones */
+	if (fif_current)
+		fif_search_cancel(fif_current);
+
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+	gtk_widget_grab_focus(msgwindow.notebook);
+	gtk_list_store_clear(msgwindow.store_msg);
+
+	if (! in_session)
+	{	/* use current document */
+		count = find_document_usage(doc, search_text, flags);
+	}
+	else
+	{
+		guint i;
+		for (i = 0; i < documents_array->len; i++)
+		{
+			if (documents[i]->is_valid)
+			{
+				count += find_document_usage(documents[i], search_text, flags);
+			}
+		}
+		/* the files which aren't open are searched in the background */
+		if (find_project_usage(search_text, original_search_text, flags, count))
+			return;
+	}
+	search_show_usage_count(count, original_search_text);
+}
+
+
 /* ttf is updated to include the last match position (ttf->chrg.cpMin) and
  * the new search range end (ttf->chrg.cpMax).
  * Note: Normally you would call sci_start/end_undo_action() around this call. */
@@ -2238,37 +3869,41 @@ guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		gint flags, const gchar *replace_text)
 {
 	gint count = 0;
-	gint offset = 0; /* difference between search pos and replace pos */
+	gint offset = 0; /* difference between the old and new text length */
+	gint last_start = 0, last_offset = 0;
 	GSList *match, *matches;
 
 	g_return_val_if_fail(sci != NULL && ttf->lpstrText != NULL && replace_text != NULL, 0);
 	if (! *ttf->lpstrText)
 		return 0;
 
-	matches = find_range(sci, flags, ttf);
+	/* replace from the last match backwards, so the positions of the matches
+	 * still to be replaced don't change */
+	matches = g_slist_reverse(find_range(sci, flags, ttf));
 	foreach_slist (match, matches)
 	{
 		GeanyMatchInfo *info = match->data;
 		gint replace_len;
 
-		info->start += offset;
-		info->end += offset;
-
 		replace_len = search_replace_match(sci, info, replace_text);
-		offset += replace_len - (info->end - info->start);
-		count ++;
-
-		/* on last match, update the last match/new range end */
-		if (! match->next)
+		if (count == 0)
 		{
-			ttf->chrg.cpMin = info->start;
-			ttf->chrg.cpMax += offset;
+			last_start = info->start;
+			last_offset = replace_len - (info->end - info->start);
 		}
+		offset += replace_len - (info->end - info->start);
+		count ++;
 
 		geany_match_info_free(info);
 	}
 	g_slist_free(matches);
 
+	/* update the last match/new range end */
+	if (count > 0)
+	{
+		ttf->chrg.cpMin = last_start + offset - last_offset;
+		ttf->chrg.cpMax += offset;
+	}
 	return count;
 }
 
@@ -123,6 +123,16 @@ gint search_replace_match(struct _ScintillaObject *sci, const GeanyMatchInfo *ma
 guint search_replace_range(struct _ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		gint flags, const gchar *replace_text);
 
+void search_index_add_file(const gchar *locale_filename);
+
+void search_index_remove_file(const gchar *locale_filename);
+
+gboolean search_index_load_cache(const gchar *cache_file);
+
+void search_index_release_cache(void);
+
+gboolean search_index_save_cache(const gchar *cache_file, GPtrArray *file_names);
+
 G_END_DECLS
 
 #endif
@@ -56,6 +56,9 @@
 #include "sciwrappers.h"
 #include "filetypesprivate.h"
 #include "search.h"
+#include "project.h"
+
+#include <gio/gio.h>
 
 
 const guint TM_GLOBAL_TYPE_MASK =
@@ -2085,12 +2088,272 @@ static void create_taglist_popup_menu(void)
 }
 
 
+/* Project files are added to the tagmanager's project index, so their tags can be
+ * found (e.g. for autocompletion and Go to Tag) without opening them.
+ * A file can belong to several open projects, so it is reference counted.
+ * Each folder containing indexed files is monitored and changed files are parsed again. */
+typedef struct
+{
+	GFileMonitor	*monitor;
+	guint			 files;
+}
+IndexFolder;
+
+static GHashTable *index_files = NULL;		/* locale filename -> reference count */
+static GHashTable *index_folders = NULL;	/* locale folder -> IndexFolder */
+
+
+static void index_folder_free(gpointer data)
+{
+	IndexFolder *folder = data;
+
+	if (folder->monitor)
+	{
+		g_file_monitor_cancel(folder->monitor);
+		g_object_unref(folder->monitor);
+	}
+	g_free(folder);
+}
+
+
+static gboolean index_add_file(const gchar *locale_filename)
+{
+	GeanyFiletype *ft;
+	gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
+	gboolean result = FALSE;
+
+	ft = filetypes_detect_from_file(utf8_filename);
+	if (ft != NULL && filetype_has_tags(ft))
+		result = tm_workspace_index_add_file(locale_filename, tm_source_file_get_lang_name(ft->lang));
+
+	g_free(utf8_filename);
+	return result;
+}
+
+
+static void on_index_folder_changed(G_GNUC_UNUSED GFileMonitor *monitor, GFile *file,
+		G_GNUC_UNUSED GFile *other_file, GFileMonitorEvent event, G_GNUC_UNUSED gpointer data)
+{
+	gchar *locale_filename = g_file_get_path(file);
+
+	if (locale_filename == NULL)
+		return;
+
+	if (g_hash_table_lookup(index_files, locale_filename) != NULL)
+	{
+		switch (event)
+		{
+			case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+			case G_FILE_MONITOR_EVENT_CREATED:
+				index_add_file(locale_filename);
+				search_index_add_file(locale_filename);
+				break;
+			case G_FILE_MONITOR_EVENT_DELETED:
+				tm_workspace_index_remove_file(locale_filename);
+				search_index_remove_file(locale_filename);
+				break;
+			default:
+				break;
+		}
+	}
+	g_free(locale_filename);
+}
+
+
+static void on_index_updated(G_GNUC_UNUSED gpointer data)
+{
+	GeanyDocument *doc = document_get_current();
+
+	if (doc != NULL)
+		document_highlight_tags(doc);
+}
+
+
+/* Adds a project file to the tag and search indexes.
+ * @param utf8_filename The file name, in UTF-8. */
+void symbols_index_file(const gchar *utf8_filename)
+{
+	gchar *locale_filename;
+	gchar *locale_folder;
+	IndexFolder *folder;
+	guint count;
+
+	g_return_if_fail(utf8_filename != NULL);
+
+	if (index_files == NULL)
+	{
+		index_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		index_folders = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, index_folder_free);
+		tm_workspace_index_set_update_func(on_index_updated, NULL);
+	}
+
+	locale_filename = utils_get_locale_from_utf8(utf8_filename);
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(index_files, locale_filename));
+	g_hash_table_insert(index_files, g_strdup(locale_filename), GUINT_TO_POINTER(count + 1));
+	if (count > 0)
+	{
+		g_free(locale_filename);
+		return;
+	}
+
+	index_add_file(locale_filename);
+	search_index_add_file(locale_filename);
+
+	locale_folder = g_path_get_dirname(locale_filename);
+	folder = g_hash_table_lookup(index_folders, locale_folder);
+	if (folder == NULL)
+	{
+		GFile *file = g_file_new_for_path(locale_folder);
+
+		folder = g_new0(IndexFolder, 1);
+		folder->monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+		if (folder->monitor != NULL)
+			g_signal_connect(folder->monitor, "changed", G_CALLBACK(on_index_folder_changed), NULL);
+		g_object_unref(file);
+		g_hash_table_insert(index_folders, locale_folder, folder);
+	}
+	else
+		g_free(locale_folder);
+	folder->files++;
+
+	g_free(locale_filename);
+}
+
+
+/* Removes a project file from the tag and search indexes, unless another open project still uses it.
+ * @param utf8_filename The file name, in UTF-8. */
+void symbols_unindex_file(const gchar *utf8_filename)
+{
+	gchar *locale_filename;
+	gchar *locale_folder;
+	IndexFolder *folder;
+	guint count;
+
+	g_return_if_fail(utf8_filename != NULL);
+
+	if (index_files == NULL)
+		return;
+
+	locale_filename = utils_get_locale_from_utf8(utf8_filename);
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(index_files, locale_filename));
+	if (count > 1)
+		g_hash_table_insert(index_files, g_strdup(locale_filename), GUINT_TO_POINTER(count - 1));
+	else if (count == 1)
+	{
+		g_hash_table_remove(index_files, locale_filename);
+		tm_workspace_index_remove_file(locale_filename);
+		search_index_remove_file(locale_filename);
+
+		locale_folder = g_path_get_dirname(locale_filename);
+		folder = g_hash_table_lookup(index_folders, locale_folder);
+		if (folder != NULL && --folder->files == 0)
+			g_hash_table_remove(index_folders, locale_folder);
+		g_free(locale_folder);
+	}
+	g_free(locale_filename);
+}
+
+
+/* The tags and search index of a project's files are cached next to the project file,
+ * so files that haven't changed don't need to be read again the next time it's opened. */
+static gchar *get_project_cache_file(GeanyProject *project, const gchar *ext)
+{
+	gchar *utf8_name = utils_remove_ext_from_filename(project->file_name);
+	gchar *locale_name;
+
+	SETPTR(utf8_name, g_strconcat(utf8_name, ext, NULL));
+	locale_name = utils_get_locale_from_utf8(utf8_name);
+	g_free(utf8_name);
+	return locale_name;
+}
+
+
+/* Adds all files of a project to the tag and search indexes, using the project's
+ * caches for files which haven't changed. */
+void symbols_index_project(GeanyProject *project)
+{
+	gchar *cache_file;
+	guint i;
+
+	g_return_if_fail(project != NULL);
+
+	cache_file = get_project_cache_file(project, ".tagcache");
+	tm_workspace_index_load_cache(cache_file);
+	g_free(cache_file);
+	cache_file = get_project_cache_file(project, ".searchindex");
+	search_index_load_cache(cache_file);
+	g_free(cache_file);
+
+	for (i = 0; i < project->project_files->len; i++)
+	{
+		if (project_files_index(project, i)->is_valid)
+			symbols_index_file(project_files_index(project, i)->file_name);
+	}
+	tm_workspace_index_release_cache();
+	search_index_release_cache();
+}
+
+
+/* Saves the project's caches and removes its files from the tag and search indexes. */
+void symbols_unindex_project(GeanyProject *project)
+{
+	GPtrArray *file_names;
+	gchar *cache_file;
+	guint i;
+
+	g_return_if_fail(project != NULL);
+
+	file_names = g_ptr_array_new();
+	for (i = 0; i < project->project_files->len; i++)
+	{
+		if (project_files_index(project, i)->is_valid)
+			g_ptr_array_add(file_names, utils_get_locale_from_utf8(project_files_index(project, i)->file_name));
+	}
+
+	if (file_names->len > 0 && project->file_name != NULL)
+	{
+		cache_file = get_project_cache_file(project, ".tagcache");
+		if (! tm_workspace_index_save_cache(cache_file, file_names))
+			geany_debug("Could not save the tag cache %s", cache_file);
+		g_free(cache_file);
+		cache_file = get_project_cache_file(project, ".searchindex");
+		if (! search_index_save_cache(cache_file, file_names))
+			geany_debug("Could not save the search index %s", cache_file);
+		g_free(cache_file);
+	}
+
+	for (i = 0; i < file_names->len; i++)
+		g_free(file_names->pdata[i]);
+	g_ptr_array_free(file_names, TRUE);
+
+	for (i = 0; i < project->project_files->len; i++)
+	{
+		if (project_files_index(project, i)->is_valid)
+			symbols_unindex_file(project_files_index(project, i)->file_name);
+	}
+}
+
+
 static void on_document_save(G_GNUC_UNUSED GObject *object, GeanyDocument *doc)
 {
 	gchar *f;
 
 	g_return_if_fail(!EMPTY(doc->real_path));
 
+	/* the folder monitor may be missing or late, and a quick edit can keep the size and
+	 * the modification time, which only has a resolution of a second */
+	if (index_files != NULL && doc->file_name != NULL)
+	{
+		gchar *locale_filename = utils_get_locale_from_utf8(doc->file_name);
+
+		if (g_hash_table_lookup(index_files, locale_filename) != NULL)
+		{
+			search_index_remove_file(locale_filename);
+			search_index_add_file(locale_filename);
+		}
+		g_free(locale_filename);
+	}
+
 	f = g_build_filename(app->configdir, "ignore.tags", NULL);
 
 	if (utils_str_equal(doc->real_path, f))
@@ -2118,4 +2381,12 @@ void symbols_finalize(void)
 {
 	g_strfreev(html_entities);
 	g_strfreev(c_tags_ignore);
+
+	if (index_files != NULL)
+	{
+		g_hash_table_destroy(index_folders);
+		g_hash_table_destroy(index_files);
+		index_folders = NULL;
+		index_files = NULL;
+	}
 }
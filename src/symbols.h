@@ -63,4 +63,12 @@ gint symbols_get_current_function(GeanyDocument *doc, const gchar **tagname);
 
 gint symbols_get_current_scope(GeanyDocument *doc, const gchar **tagname);
 
+void symbols_index_file(const gchar *utf8_filename);
+
+void symbols_unindex_file(const gchar *utf8_filename);
+
+void symbols_index_project(struct GeanyProject *project);
+
+void symbols_unindex_project(struct GeanyProject *project);
+
 #endif
@@ -39,6 +39,25 @@
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
+#include <fcntl.h>
+#ifdef __linux__
+# include <sys/sendfile.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <linux/fs.h>
+# ifndef FICLONE
+#  define FICLONE _IOW(0x94, 9, int)
+# endif
+#endif
+#ifdef __APPLE__
+# include <sys/clonefile.h>
+#endif
+
+#ifdef G_OS_WIN32
+# include <sys/utime.h>
+#else
+# include <utime.h>
+#endif
 
 #include <glib/gstdio.h>
 
@@ -2269,122 +2288,431 @@ gchar *utils_parse_and_format_build_date(const gchar *input)
 	return g_strdup(input);
 }
 
-gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite, volatile gchar* progress)
+/* buffer size used when copying files in blocks */
+#define UTILS_COPY_BUFFER_SIZE (1024 * 1024)
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
+/* Copies the rest of the open file src_fd, size bytes unless it changes meanwhile, to the current
+ * position of dst_fd. On Linux the kernel copies the data without it passing through user space,
+ * anything left is streamed through a fixed size buffer. length is set to the number of bytes copied. */
+static gboolean utils_copy_file_data( int src_fd, int dst_fd, guint64 size, guint64 *length )
 {
-    g_return_val_if_fail (src != NULL, FALSE);
-    g_return_val_if_fail (dst != NULL, FALSE);
+	guint64 copied = 0;
+	gchar *buffer;
+	gboolean result = TRUE;
+
+#ifdef __linux__
+# ifdef SYS_copy_file_range
+	while ( copied < size )
+	{
+		ssize_t sent = syscall( SYS_copy_file_range, src_fd, NULL, dst_fd, NULL, (size_t) MIN( size - copied, 0x40000000 ), 0 );
+		if ( sent <= 0 )
+			break;
+		copied += sent;
+	}
+# endif
+
+	while ( copied < size )
+	{
+		ssize_t sent = sendfile( dst_fd, src_fd, NULL, (size_t) MIN( size - copied, 0x40000000 ) );
+		if ( sent <= 0 )
+			break;
+		copied += sent;
+	}
+
+	if ( copied >= size )
+	{
+		*length = copied;
+		return TRUE;
+	}
+#endif
+
+	// the kernel copies above leave both offsets after the copied data, so carry on from there
+	buffer = g_malloc( UTILS_COPY_BUFFER_SIZE );
+	while ( result )
+	{
+		gssize read_size = read( src_fd, buffer, UTILS_COPY_BUFFER_SIZE );
+		gssize written = 0;
+
+		if ( read_size == 0 )
+			break;
+		if ( read_size < 0 )
+		{
+			if ( errno != EINTR )
+				result = FALSE;
+			continue;
+		}
+
+		while ( written < read_size )
+		{
+			gssize count = write( dst_fd, buffer + written, read_size - written );
+			if ( count < 0 )
+			{
+				if ( errno == EINTR )
+					continue;
+				result = FALSE;
+				break;
+			}
+			written += count;
+		}
+		copied += written;
+	}
+	g_free( buffer );
+
+	*length = copied;
+	return result;
+}
+
+/* Copies one file, on failure message is set to a description of the problem. The file is cloned
+ * where the file system allows it (APFS on macOS, btrfs and XFS on Linux). */
+static gboolean utils_copy_file_real( const gchar *src, const gchar *dst, gboolean overwrite, gchar **message )
+{
+	struct stat st;
+	int src_fd, dst_fd;
+	guint64 length;
+	gboolean result;
+	gint err = 0;
 
-    /* check source file */
-    if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        if ( progress ) sprintf( (gchar*)progress, "File '%s' not found", src );
-        else g_critical (G_STRLOC ": File '%s' not found.", src);
-        return FALSE;
-    }
-    else if (!g_file_test (src, G_FILE_TEST_IS_REGULAR)) {
-        if ( progress ) sprintf( (gchar*)progress, "'%s' not a regular file.", src );
-        else g_critical (G_STRLOC ": '%s' not a regular file.", src);
-        return FALSE;
-    }
-    
 #ifndef G_OS_WIN32
-    if (g_file_test (src, G_FILE_TEST_IS_SYMLINK)) {
-        gchar* link = g_file_read_link( src, NULL );
-        if ( link )
-        {
-            symlink( link, dst );
-            g_free(link);
-        }
-        return TRUE;
-    }
+	// symlinks are recreated instead of copied, as long as they point somewhere
+	if ( g_lstat( src, &st ) == 0 && S_ISLNK( st.st_mode ) && g_stat( src, &st ) == 0 )
+	{
+		if ( !S_ISREG( st.st_mode ) )
+		{
+			*message = g_strdup_printf( "'%s' not a regular file.", src );
+			return FALSE;
+		}
+
+		gchar* link = g_file_read_link( src, NULL );
+		if ( link )
+		{
+			if ( overwrite )
+				g_unlink( dst );
+			symlink( link, dst );
+			g_free(link);
+		}
+		return TRUE;
+	}
 #endif
 
+	src_fd = g_open( src, O_RDONLY | O_BINARY, 0 );
+	if ( src_fd < 0 || fstat( src_fd, &st ) != 0 )
+	{
+		if ( errno == ENOENT )
+			*message = g_strdup_printf( "File '%s' not found", src );
+		else
+			*message = g_strdup_printf( "Unable to open '%s' for reading. %s.", src, g_strerror (errno) );
+		if ( src_fd >= 0 )
+			close( src_fd );
+		return FALSE;
+	}
 
-    /* check the destination */
-    if (g_file_test (dst, G_FILE_TEST_EXISTS)) {
+	if ( !S_ISREG( st.st_mode ) )
+	{
+		*message = g_strdup_printf( "'%s' not a regular file.", src );
+		close( src_fd );
+		return FALSE;
+	}
 
-        if (!overwrite) {
-            if ( progress ) sprintf( (gchar*)progress, "Destination file '%s' exists and overwrite is disabled.", dst );
-            else g_critical (G_STRLOC ": Destination file '%s' exists and overwrite is disabled.", dst);
-            return FALSE;
-        }
+	if ( !overwrite && g_file_test( dst, G_FILE_TEST_EXISTS ) )
+	{
+		*message = g_strdup_printf( "Destination file '%s' exists and overwrite is disabled.", dst );
+		close( src_fd );
+		return FALSE;
+	}
 
-        /* remove dest fileif overwrite is enabled */
-        if (g_unlink (dst) != 0) {
-            if ( progress ) sprintf( (gchar*)progress, "%s", g_strerror (errno) );
-            else g_critical (G_STRLOC ": %s.", g_strerror (errno));
-            return FALSE;
-        }
-    }
+	/* remove the destination first so hard links and clones of it are left alone */
+	if ( g_unlink( dst ) != 0 && errno != ENOENT )
+	{
+		*message = g_strdup( g_strerror (errno) );
+		close( src_fd );
+		return FALSE;
+	}
 
-	gchar *contents = 0;
-	gsize length = 0;
+#ifdef __APPLE__
+	if ( fclonefileat( src_fd, AT_FDCWD, dst, 0 ) == 0 )
+	{
+		close( src_fd );
+		return TRUE;
+	}
+#endif
 
-	if ( !g_file_get_contents( src, &contents, &length, NULL ) )
+	dst_fd = g_open( dst, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666 );
+	if ( dst_fd < 0 )
 	{
-        if ( progress ) sprintf( (gchar*)progress, "Unable to open '%s' for reading. %s.", src, g_strerror (errno) );
-        else g_critical (G_STRLOC ": Unable to open '%s' for reading. %s.", src, g_strerror (errno));
-        return FALSE;
+		*message = g_strdup_printf( "Unable to open '%s' for writing. %s.", dst, g_strerror (errno) );
+		close( src_fd );
+		return FALSE;
 	}
 
-	if ( !g_file_set_contents( dst, contents, length, NULL ) )
+#ifdef __linux__
+	result = ioctl( dst_fd, FICLONE, src_fd ) == 0;
+	if ( !result )
+#endif
+		result = utils_copy_file_data( src_fd, dst_fd, st.st_size, &length );
+	if ( !result )
+		err = errno;
+
+	close( src_fd );
+	if ( close( dst_fd ) != 0 && result )
 	{
-		g_free(contents);
-        if ( progress ) sprintf( (gchar*)progress, "Unable to open '%s' for writing. %s.", dst, g_strerror (errno) );
-        else g_critical (G_STRLOC ": Unable to open '%s' for writing. %s.", dst, g_strerror (errno));
-        return FALSE;
+		err = errno;
+		result = FALSE;
 	}
-    
-	g_free(contents);
-    
-    return TRUE;
+	if ( !result )
+	{
+		*message = g_strdup_printf( "Unable to write '%s'. %s.", dst, g_strerror (err) );
+		g_unlink( dst );
+	}
+
+	return result;
 }
 
-gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress )
+gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite, volatile gchar* progress)
 {
+	gchar *message = NULL;
+
 	g_return_val_if_fail (src != NULL, FALSE);
-    g_return_val_if_fail (dst != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	if ( utils_copy_file_real( src, dst, overwrite, &message ) )
+		return TRUE;
+
+	if ( progress ) sprintf( (gchar*)progress, "%s", message );
+	else g_critical (G_STRLOC ": %s", message);
+	g_free( message );
+	return FALSE;
+}
+
+
+/* Folder copies walk the tree on the calling thread, creating folders and links as they are found,
+ * and hand the files to a pool of workers. The first failure is kept and stops the rest.
+ * When syncing, files that already match are skipped and anything in the destination that isn't in
+ * the source is deleted. */
+typedef struct UtilsCopyFolderState
+{
+	volatile gchar *progress;
+	gboolean sync;
+	gboolean failed;
+	gchar *message;
+} UtilsCopyFolderState;
+
+typedef struct UtilsCopyFolderTask
+{
+	gchar *src;
+	gchar *dst;
+} UtilsCopyFolderTask;
+
+G_LOCK_DEFINE_STATIC( copy_folder );
+
+
+/* takes ownership of message */
+static void utils_copy_folder_fail( UtilsCopyFolderState *state, gchar *message )
+{
+	G_LOCK( copy_folder );
+	if ( !state->failed )
+	{
+		state->failed = TRUE;
+		state->message = message;
+		message = NULL;
+	}
+	G_UNLOCK( copy_folder );
+
+	g_free( message );
+}
+
+
+static gboolean utils_copy_folder_has_failed( UtilsCopyFolderState *state )
+{
+	gboolean failed;
+
+	G_LOCK( copy_folder );
+	failed = state->failed;
+	G_UNLOCK( copy_folder );
+
+	return failed;
+}
+
+
+static gboolean utils_files_are_equal( const gchar *path1, const gchar *path2 )
+{
+	FILE *fp1, *fp2;
+	gchar *buffer1, *buffer2;
+	gboolean result = TRUE;
+
+	fp1 = g_fopen( path1, "rb" );
+	if ( !fp1 )
+		return FALSE;
+	fp2 = g_fopen( path2, "rb" );
+	if ( !fp2 )
+	{
+		fclose( fp1 );
+		return FALSE;
+	}
+
+	buffer1 = g_malloc( 65536 );
+	buffer2 = g_malloc( 65536 );
+	while ( result )
+	{
+		size_t length1 = fread( buffer1, 1, 65536, fp1 );
+		size_t length2 = fread( buffer2, 1, 65536, fp2 );
+
+		if ( length1 != length2 || memcmp( buffer1, buffer2, length1 ) != 0 )
+			result = FALSE;
+		else if ( length1 == 0 )
+			break;
+	}
+	g_free( buffer1 );
+	g_free( buffer2 );
+	fclose( fp1 );
+	fclose( fp2 );
+
+	return result;
+}
+
+
+/* removes a file, link or folder, without following links */
+static void utils_sync_remove( const gchar *path )
+{
+	struct stat st;
+
+	if ( g_lstat( path, &st ) != 0 )
+		return;
+
+	if ( S_ISDIR( st.st_mode ) )
+		utils_remove_folder_recursive( path );
+	else
+		g_unlink( path );
+}
+
+
+/* Synced copies are given the modification time of their source, so the next sync can tell they
+ * are current from the size and time alone. A file with the same size but another time is compared
+ * by contents, which is still cheaper than writing it. */
+static void utils_sync_file( const gchar *src, const gchar *dst, gchar **message )
+{
+	struct stat src_st, dst_st;
+	struct utimbuf times;
+
+	if ( g_stat( src, &src_st ) != 0 )
+	{
+		*message = g_strdup_printf( "File '%s' not found", src );
+		return;
+	}
+
+	if ( g_lstat( dst, &dst_st ) == 0 && S_ISREG( dst_st.st_mode ) && dst_st.st_size == src_st.st_size )
+	{
+		if ( dst_st.st_mtime == src_st.st_mtime )
+			return;
+		if ( !utils_files_are_equal( src, dst ) && !utils_copy_file_real( src, dst, TRUE, message ) )
+			return;
+	}
+	else if ( !utils_copy_file_real( src, dst, TRUE, message ) )
+		return;
+
+#ifndef G_OS_WIN32
+	if ( g_lstat( src, &dst_st ) == 0 && S_ISLNK( dst_st.st_mode ) )
+		return;
+#endif
+
+	times.actime = src_st.st_mtime;
+	times.modtime = src_st.st_mtime;
+	g_utime( dst, &times );
+}
+
+
+static void utils_copy_folder_worker( gpointer data, gpointer user_data )
+{
+	UtilsCopyFolderTask *task = data;
+	UtilsCopyFolderState *state = user_data;
+	gchar *message = NULL;
+	gboolean skip;
+
+	G_LOCK( copy_folder );
+	skip = state->failed;
+	if ( !skip && state->progress ) strcpy( (gchar*)state->progress, task->dst );
+	G_UNLOCK( copy_folder );
+
+	if ( !skip )
+	{
+		if ( state->sync )
+			utils_sync_file( task->src, task->dst, &message );
+		else
+			utils_copy_file_real( task->src, task->dst, TRUE, &message );
+
+		if ( message )
+			utils_copy_folder_fail( state, message );
+	}
+
+	g_free( task->src );
+	g_free( task->dst );
+	g_free( task );
+}
+
+
+/* keep lists names in dst that a sync leaves alone */
+static gboolean utils_copy_folder_walk( const gchar* src, const gchar* dst, gboolean recursive, const gchar* const* keep,
+                                        UtilsCopyFolderState *state, GThreadPool *pool )
+{
+	GHashTable *dst_names = NULL;
+	const gchar *filename;
+	GDir *dir;
 
 	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        if ( progress ) sprintf( (gchar*)progress, "Location '%s' not found.", src );
-        else g_critical (G_STRLOC ": Location '%s' not found.", src);
-        return FALSE;
-    }
+		utils_copy_folder_fail( state, g_strdup_printf( "Location '%s' not found.", src ) );
+		return FALSE;
+	}
 
 	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
-        if ( progress ) sprintf( (gchar*)progress, "Location '%s' is not a directory.", src );
-        else g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
-        return FALSE;
-    }
-    
+		utils_copy_folder_fail( state, g_strdup_printf( "Location '%s' is not a directory.", src ) );
+		return FALSE;
+	}
+
 #ifndef G_OS_WIN32
-    if (g_file_test (src, G_FILE_TEST_IS_SYMLINK)) {
-        gchar* link = g_file_read_link( src, NULL );
-        if ( link )
-        {
-            symlink( link, dst );
-            g_free( link );
-        }
-        return TRUE;
-    }
+	if (g_file_test (src, G_FILE_TEST_IS_SYMLINK)) {
+		gchar* link = g_file_read_link( src, NULL );
+		if ( link )
+		{
+			if ( state->sync )
+				utils_sync_remove( dst );
+			symlink( link, dst );
+			g_free( link );
+		}
+		return TRUE;
+	}
 #endif
 
+	if ( state->sync && !g_file_test( dst, G_FILE_TEST_IS_DIR ) )
+		utils_sync_remove( dst );
+
+	if ( g_mkdir_with_parents( dst, 0755 ) < 0 )
+	{
+		utils_copy_folder_fail( state, g_strdup_printf( "Failed to make destination directory '%s'", dst ) );
+		return FALSE;
+	}
 
-	if (!g_file_test (dst, G_FILE_TEST_EXISTS)) {
-        if ( g_mkdir_with_parents( dst, 0755 ) < 0 )
+	if ( state->sync )
+	{
+		dst_names = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+		dir = g_dir_open( dst, 0, NULL );
+		if ( dir )
 		{
-            if ( progress ) sprintf( (gchar*)progress, "Failed to make destination directory '%s'", dst );
-            else g_critical (G_STRLOC ": Failed to make destination directory '%s'", dst);
-			return FALSE;
+			foreach_dir( filename, dir )
+				g_hash_table_insert( dst_names, g_strdup( filename ), GINT_TO_POINTER(1) );
+			g_dir_close( dir );
 		}
-    }
+		for ( ; keep && *keep; keep++ )
+			g_hash_table_remove( dst_names, *keep );
+	}
 
-	// scan the directory
-	const gchar *filename;
-	GDir *dir = g_dir_open(src, 0, NULL);
+	dir = g_dir_open(src, 0, NULL);
 	if (dir == NULL)
 	{
-        if ( progress ) sprintf( (gchar*)progress, "Failed to open directory '%s'", src );
-        else g_critical (G_STRLOC ": Failed to open directory '%s'", src);
+		utils_copy_folder_fail( state, g_strdup_printf( "Failed to open directory '%s'", src ) );
+		if ( dst_names ) g_hash_table_destroy( dst_names );
 		return FALSE;
 	}
 
@@ -2392,97 +2720,1379 @@ gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recurs
 	{
 		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
 		gchar* fulldstpath = g_build_filename( dst, filename, NULL );
+		gboolean result = TRUE;
 
 		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
 		{
 			if ( recursive )
 			{
-				if ( !utils_copy_folder( fullsrcpath, fulldstpath, recursive, progress ) ) 
-				{
-					g_dir_close(dir);
-					g_free(fullsrcpath);
-					g_free(fulldstpath);
-					return FALSE;
-				}
+				if ( dst_names ) g_hash_table_remove( dst_names, filename );
+				result = utils_copy_folder_walk( fullsrcpath, fulldstpath, recursive, NULL, state, pool );
 			}
 		}
 		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
 		{
-			if ( progress ) strcpy( progress, fulldstpath );
-			if ( !utils_copy_file( fullsrcpath, fulldstpath, TRUE, progress ) )
+			UtilsCopyFolderTask *task = g_new0( UtilsCopyFolderTask, 1 );
+
+			if ( dst_names )
 			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				g_free(fulldstpath);
-				return FALSE;
+				g_hash_table_remove( dst_names, filename );
+				if ( g_file_test( fulldstpath, G_FILE_TEST_IS_DIR ) )
+					utils_sync_remove( fulldstpath );
 			}
+
+			task->src = fullsrcpath;
+			task->dst = fulldstpath;
+			fullsrcpath = fulldstpath = NULL;
+
+			if ( pool )
+				g_thread_pool_push( pool, task, NULL );
+			else
+				utils_copy_folder_worker( task, state );
+
+			result = !utils_copy_folder_has_failed( state );
 		}
 
 		g_free(fullsrcpath);
 		g_free(fulldstpath);
+
+		if ( !result )
+		{
+			g_dir_close(dir);
+			if ( dst_names ) g_hash_table_destroy( dst_names );
+			return FALSE;
+		}
 	}
 
 	g_dir_close(dir);
-	
+
+	// whatever is left in the destination has gone from the source
+	if ( dst_names )
+	{
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init( &iter, dst_names );
+		while ( g_hash_table_iter_next( &iter, &key, NULL ) )
+		{
+			gchar *path = g_build_filename( dst, (const gchar*) key, NULL );
+			utils_sync_remove( path );
+			g_free( path );
+		}
+		g_hash_table_destroy( dst_names );
+	}
+
 	return TRUE;
 }
 
-gboolean utils_remove_folder_recursive ( const gchar* src )
+
+static gboolean utils_copy_folder_run( const gchar* src, const gchar* dst, gboolean recursive, const gchar* const* keep,
+                                       gboolean sync, volatile gchar* progress )
 {
-	g_return_val_if_fail (src != NULL, FALSE);
-	if ( strcmp(src,"/") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
-	if ( strcmp(src,"C:") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
-	if ( strcmp(src,"C:\\") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	UtilsCopyFolderState state = { progress, sync, FALSE, NULL };
+	GThreadPool *pool;
 
-	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
-        return TRUE;
-    }
+	// copies are mostly waiting on the disk, so a pool the size of the CPU count is plenty
+	pool = g_thread_pool_new( utils_copy_folder_worker, &state, utils_get_worker_count(), FALSE, NULL );
 
-	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
-        g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
-        return FALSE;
-    }
+	utils_copy_folder_walk( src, dst, recursive, keep, &state, pool );
 
-	// scan the directory
-	const gchar *filename;
-	GDir *dir = g_dir_open(src, 0, NULL);
-	if (dir == NULL)
-	{
-		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
-		return FALSE;
-	}
+	// queued files are skipped quickly once something has failed
+	if ( pool )
+		g_thread_pool_free( pool, FALSE, TRUE );
 
-	foreach_dir(filename, dir)
-	{
-		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
+	if ( !state.failed )
+		return TRUE;
 
-		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
-		{
-			if ( !utils_remove_folder_recursive( fullsrcpath ) ) 
-			{
+	if ( progress ) sprintf( (gchar*)progress, "%s", state.message );
+	else g_critical (G_STRLOC ": %s", state.message);
+	g_free( state.message );
+	return FALSE;
+}
+
+
+/* Copies the contents of src into dst, creating it if needed. Files are copied in parallel, so
+ * progress (if not NULL) is set to the file most recently started, or to the error message if the
+ * copy fails. */
+gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress )
+{
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	return utils_copy_folder_run( src, dst, recursive, NULL, FALSE, progress );
+}
+
+
+/* Makes dst a copy of src like utils_copy_folder() does, but only copies files that differ from
+ * what dst already has and deletes anything in dst that isn't in src. Names in the NULL terminated
+ * keep list (may be NULL) are left alone at the top level of dst. Meant for build folders that
+ * are kept between exports, most of which is the same each time. */
+gboolean utils_sync_folder( const gchar* src, const gchar* dst, const gchar* const* keep )
+{
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	return utils_copy_folder_run( src, dst, TRUE, keep, TRUE, NULL );
+}
+
+
+/* Deletes everything in folder except the names in the NULL terminated keep list. */
+void utils_prune_folder( const gchar* folder, const gchar* const* keep )
+{
+	const gchar *filename;
+	GDir *dir;
+
+	g_return_if_fail (folder != NULL);
+
+	dir = g_dir_open( folder, 0, NULL );
+	if ( !dir )
+		return;
+
+	foreach_dir( filename, dir )
+	{
+		const gchar* const* name;
+		gchar *path;
+
+		for ( name = keep; name && *name; name++ )
+		{
+			if ( strcmp( *name, filename ) == 0 )
+				break;
+		}
+		if ( name && *name )
+			continue;
+
+		path = g_build_filename( folder, filename, NULL );
+		utils_sync_remove( path );
+		g_free( path );
+	}
+	g_dir_close( dir );
+}
+
+gboolean utils_remove_folder_recursive ( const gchar* src )
+{
+	g_return_val_if_fail (src != NULL, FALSE);
+	if ( strcmp(src,"/") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	if ( strcmp(src,"C:") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+	if ( strcmp(src,"C:\\") == 0 ) { g_critical (G_STRLOC ": Delete attempt on '%s' ignored.", src); return FALSE; } // don't delete root
+
+	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+        return TRUE;
+    }
+
+	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
+        g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
+        return FALSE;
+    }
+
+	// scan the directory
+	const gchar *filename;
+	GDir *dir = g_dir_open(src, 0, NULL);
+	if (dir == NULL)
+	{
+		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
+		return FALSE;
+	}
+
+	foreach_dir(filename, dir)
+	{
+		gchar* fullsrcpath = g_build_filename( src, filename, NULL );
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		{
+			if ( !utils_remove_folder_recursive( fullsrcpath ) ) 
+			{
+				g_dir_close(dir);
+				g_free(fullsrcpath);
+				return FALSE;
+			}
+		}
+		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			if ( g_unlink( fullsrcpath ) != 0 ) 
+			{
 				g_dir_close(dir);
 				g_free(fullsrcpath);
 				return FALSE;
 			}
 		}
-		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+
+		g_free(fullsrcpath);
+	}
+
+	g_dir_close(dir);
+
+	g_rmdir( src );
+	
+	return TRUE;
+}
+
+/* Parallel zip packaging.
+ * Files are queued on a packer, deflated into memory buffers on a thread pool, and then
+ * appended to the archive by the calling thread in the order they were queued. The deflate
+ * settings and modified times match mz_zip_writer_add_file(), so the archive is byte for
+ * byte the same as one built serially. */
+
+/* upper limit on the size of the source files being compressed at any one time */
+#define UTILS_ZIP_MAX_BYTES_IN_FLIGHT (256 * 1024 * 1024)
+
+typedef struct UtilsZipEntry
+{
+	gchar *src_path;
+	gchar *dst_name;
+	gint level;
+	gboolean auto_level;	/* level was picked by the policy probe, see utils_zip_check_budget() */
+	time_t mtime;
+	guint64 src_size;
+
+	/* written by the worker thread */
+	gboolean failed;
+	gboolean compressed;
+	void *data;
+	GDestroyNotify data_free_func;	/* NULL when the data belongs to a shared payload */
+	gsize data_size;
+	mz_uint64 uncomp_size;
+	mz_uint32 crc32;
+	gchar *hash;
+
+	/* only touched by the writing thread */
+	gboolean finished;
+} UtilsZipEntry;
+
+struct UtilsZipPacker
+{
+	GPtrArray *entries;
+
+	/* optional compressed entry cache, the index is only modified while no workers are running */
+	gchar *cache_folder;
+	GHashTable *cache_index;
+
+	/* finished entries are passed back to the writer through this while writing */
+	GAsyncQueue *done_queue;
+
+	/* called from the writing thread after each entry is added */
+	UtilsZipProgressFunc progress_func;
+	gpointer progress_data;
+
+	/* optional compressed entries shared with other packers */
+	UtilsZipShared *shared;
+
+	/* stored entries are padded like zipalign does when set */
+	gboolean apk_alignment;
+
+	/* optional compression policy for selectively compressed folders, not owned */
+	const UtilsZipPolicy *policy;
+};
+
+/* Shared payloads.
+ * Archives built from mostly the same files (the store variants of an APK) can share a payload,
+ * so each compressed entry is only read and deflated once and the other packers take the
+ * compressed data from memory. An entry is claimed by the first packer that needs it, others
+ * wait for it to finish instead of compressing it again. Entries are kept until the payload
+ * is freed, so only compressed entries are shared and the total size is limited. */
+
+#define UTILS_ZIP_MAX_SHARED_BYTES (512 * 1024 * 1024)
+
+typedef struct UtilsZipSharedEntry
+{
+	guint64 src_size;
+	time_t mtime;
+
+	/* written by the packer that claimed the entry, then read only once ready */
+	gboolean ready;
+	gboolean failed;
+	gboolean compressed;
+	void *data;
+	GDestroyNotify data_free_func;
+	gsize data_size;
+	mz_uint64 uncomp_size;
+	mz_uint32 crc32;
+	gchar *hash;
+} UtilsZipSharedEntry;
+
+struct UtilsZipShared
+{
+	gint ref_count;
+	GHashTable *entries;	/* "level:source path" -> UtilsZipSharedEntry */
+	guint64 bytes;
+};
+
+/* one lock for all shared payloads, waiting for another packer's entry is rare */
+#if GLIB_CHECK_VERSION(2, 32, 0)
+static GMutex zip_shared_mutex_s;
+static GCond zip_shared_cond_s;
+# define zip_shared_mutex (&zip_shared_mutex_s)
+# define zip_shared_cond (&zip_shared_cond_s)
+#else
+static GMutex *zip_shared_mutex = NULL;
+static GCond *zip_shared_cond = NULL;
+G_LOCK_DEFINE_STATIC( zip_shared_init );
+#endif
+
+/* Compressed entry cache.
+ * Each cached entry is a file named after the SHA1 of the source contents and the compression
+ * level, holding a small header followed by the raw deflate stream. The index maps source paths
+ * to the size, mtime, level and hash they had when last compressed, so unchanged files can be
+ * taken from the cache without even being read. Files whose contents match an existing cache
+ * file (touched, renamed or duplicated files) are found by hash. */
+
+#define UTILS_ZIP_CACHE_INDEX "index.txt"
+#define UTILS_ZIP_CACHE_INDEX_HEADER "agk-zip-cache 1"
+#define UTILS_ZIP_CACHE_MAGIC "AGZ1"
+#define UTILS_ZIP_CACHE_HEADER_SIZE 16
+
+typedef struct UtilsZipCacheRecord
+{
+	guint64 size;
+	gint64 mtime;
+	gint level;
+	gchar *hash;
+} UtilsZipCacheRecord;
+
+
+guint utils_get_worker_count( void )
+{
+	static guint count = 0;
+
+	if ( count == 0 )
+	{
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		count = g_get_num_processors();
+#else
+		count = 4;
+#endif
+		count = CLAMP( count, 1, 16 );
+	}
+	return count;
+}
+
+
+/* Compression policy.
+ * Decides the deflate level of each file from rules by extension, with "auto" files probed:
+ * small files always get level 9 since they cost little, files whose first KB looks random
+ * (already compressed) are stored, and bulky compressible files get the faster level. For those
+ * the worker compresses a sample at both levels and falls back to level 9 if the fast level
+ * would make the file more than budget percent bigger. */
+
+#define UTILS_ZIP_LEVEL_AUTO -1
+#define UTILS_ZIP_LEVEL_FAST -2
+
+#define UTILS_ZIP_POLICY_DEFAULT_RULES \
+	"mp3=store;m4a=store;jpg=store;jpeg=store;png=store;gif=store;wav=store;ogg=store;" \
+	"mpg=store;mpeg=store;mp4=store;m4v=store;dat=store;zip=store;*=auto"
+
+#define UTILS_ZIP_AUTO_SMALL_SIZE (64 * 1024)
+#define UTILS_ZIP_AUTO_BULK_SIZE (256 * 1024)
+#define UTILS_ZIP_PROBE_SIZE 1024
+#define UTILS_ZIP_PROBE_MAX_ENTROPY 7.5	/* bits per byte */
+#define UTILS_ZIP_BUDGET_SAMPLE_SIZE (256 * 1024)
+
+struct UtilsZipPolicy
+{
+	GHashTable *rules;	/* lower case extension without the dot -> level */
+	gint default_level;
+	gint fast_level;
+	gint budget;		/* percent */
+};
+
+
+static void utils_zip_policy_parse( UtilsZipPolicy *policy, const gchar *rules )
+{
+	gchar **items = g_strsplit( rules, ";", -1 );
+	gchar **item;
+
+	for ( item = items; *item; item++ )
+	{
+		gchar *value = strchr( *item, '=' );
+		gchar *ext;
+		gint level;
+
+		if ( !value )
+		{
+			if ( *g_strstrip( *item ) )
+				g_warning( "Invalid compression rule '%s'", *item );
+			continue;
+		}
+		*value++ = 0;
+		ext = g_strstrip( *item );
+		value = g_strstrip( value );
+		if ( *ext == '.' )
+			ext++;
+
+		if ( utils_str_casecmp( value, "store" ) == 0 ) level = 0;
+		else if ( utils_str_casecmp( value, "best" ) == 0 ) level = 9;
+		else if ( utils_str_casecmp( value, "fast" ) == 0 ) level = UTILS_ZIP_LEVEL_FAST;
+		else if ( utils_str_casecmp( value, "auto" ) == 0 ) level = UTILS_ZIP_LEVEL_AUTO;
+		else if ( value[0] >= '0' && value[0] <= '9' && value[1] == 0 ) level = value[0] - '0';
+		else
+		{
+			g_warning( "Invalid compression level '%s' for '%s'", value, ext );
+			continue;
+		}
+
+		if ( strcmp( ext, "*" ) == 0 )
+			policy->default_level = level;
+		else if ( *ext )
+			g_hash_table_insert( policy->rules, g_ascii_strdown( ext, -1 ), GINT_TO_POINTER( level ) );
+	}
+
+	g_strfreev( items );
+}
+
+
+/* Creates a policy from rules like "png=store;json=fast;agc=6;*=auto", separated by ';'. Levels can
+ * be 0-9, store, best, fast (fast_level) or auto. The rules are applied on top of the default
+ * rules, so only changes need listing. budget is how many percent bigger than level 9 the fast
+ * level may make an auto file. */
+UtilsZipPolicy* utils_zip_policy_new( const gchar *rules, gint fast_level, gint budget )
+{
+	UtilsZipPolicy *policy = g_new0( UtilsZipPolicy, 1 );
+
+	policy->rules = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	policy->default_level = UTILS_ZIP_LEVEL_AUTO;
+	policy->fast_level = CLAMP( fast_level, 1, 9 );
+	policy->budget = MAX( budget, 0 );
+
+	utils_zip_policy_parse( policy, UTILS_ZIP_POLICY_DEFAULT_RULES );
+	if ( rules )
+		utils_zip_policy_parse( policy, rules );
+
+	return policy;
+}
+
+
+void utils_zip_policy_free( UtilsZipPolicy *policy )
+{
+	if ( !policy )
+		return;
+
+	g_hash_table_destroy( policy->rules );
+	g_free( policy );
+}
+
+
+G_LOCK_DEFINE_STATIC( zip_default_policy );
+
+static const UtilsZipPolicy* utils_zip_get_default_policy( void )
+{
+	static UtilsZipPolicy *policy = NULL;
+
+	G_LOCK( zip_default_policy );
+	if ( !policy )
+		policy = utils_zip_policy_new( NULL, UTILS_ZIP_DEFAULT_FAST_LEVEL, UTILS_ZIP_DEFAULT_BUDGET );
+	G_UNLOCK( zip_default_policy );
+
+	return policy;
+}
+
+
+/* Shannon entropy of the first bytes of a file in bits per byte, 8 means it looks random */
+static gdouble utils_zip_probe_entropy( const gchar *path )
+{
+	guchar buffer[UTILS_ZIP_PROBE_SIZE];
+	guint counts[256];
+	gdouble entropy = 0;
+	size_t length;
+	FILE *fp;
+	gint i;
+
+	fp = g_fopen( path, "rb" );
+	if ( !fp )
+		return 0;
+	length = fread( buffer, 1, sizeof(buffer), fp );
+	fclose( fp );
+
+	if ( length == 0 )
+		return 0;
+
+	memset( counts, 0, sizeof(counts) );
+	for ( i = 0; i < (gint) length; i++ )
+		counts[buffer[i]]++;
+
+	for ( i = 0; i < 256; i++ )
+	{
+		if ( counts[i] )
+		{
+			gdouble p = (gdouble) counts[i] / length;
+			entropy -= p * log( p );
+		}
+	}
+
+	return entropy / log( 2.0 );
+}
+
+
+/* Returns the deflate level to use for path, automatic is set when the level was picked by the
+ * probe and may be raised to level 9 by the budget check. */
+static gint utils_zip_policy_get_level( const UtilsZipPolicy *policy, const gchar *path, gboolean *automatic )
+{
+	const gchar *name = strrchr( path, '/' );
+	const gchar *ext;
+	gint level = policy->default_level;
+	struct stat st;
+
+	*automatic = FALSE;
+
+	ext = strrchr( name ? name : path, '.' );
+	if ( ext && ext[1] )
+	{
+		gchar *lower = g_ascii_strdown( ext + 1, -1 );
+		gpointer value;
+
+		if ( g_hash_table_lookup_extended( policy->rules, lower, NULL, &value ) )
+			level = GPOINTER_TO_INT( value );
+		g_free( lower );
+	}
+
+	if ( level == UTILS_ZIP_LEVEL_FAST )
+		return policy->fast_level;
+	if ( level != UTILS_ZIP_LEVEL_AUTO )
+		return level;
+
+	if ( g_stat( path, &st ) != 0 || st.st_size < UTILS_ZIP_AUTO_SMALL_SIZE )
+		return 9;
+
+	if ( utils_zip_probe_entropy( path ) >= UTILS_ZIP_PROBE_MAX_ENTROPY )
+		return 0;
+
+	if ( st.st_size < UTILS_ZIP_AUTO_BULK_SIZE || policy->fast_level >= 9 )
+		return 9;
+
+	*automatic = TRUE;
+	return policy->fast_level;
+}
+
+
+/* Level for files added with selective compression by utils_add_folder_to_zip() and friends */
+static gint utils_zip_get_level( const UtilsZipPolicy *policy, const gchar *path, gboolean selective_compress, gboolean *automatic )
+{
+	*automatic = FALSE;
+	if ( !selective_compress )
+		return 9;
+
+	return utils_zip_policy_get_level( policy ? policy : utils_zip_get_default_policy(), path, automatic );
+}
+
+
+static void utils_zip_entry_free_data( UtilsZipEntry *entry )
+{
+	if ( !entry->data )
+		return;
+
+	if ( entry->data_free_func )
+		entry->data_free_func( entry->data );
+	entry->data = NULL;
+	entry->data_size = 0;
+}
+
+
+static void utils_zip_entry_free( UtilsZipEntry *entry )
+{
+	utils_zip_entry_free_data( entry );
+	g_free( entry->src_path );
+	g_free( entry->dst_name );
+	g_free( entry->hash );
+	g_free( entry );
+}
+
+
+static void utils_zip_cache_record_free( UtilsZipCacheRecord *record )
+{
+	g_free( record->hash );
+	g_free( record );
+}
+
+
+static gchar* utils_zip_cache_get_blob_path( const gchar *cache_folder, const gchar *hash, gint level )
+{
+	gchar *blob_name = g_strdup_printf( "%s-%d.z", hash, level );
+	gchar *blob_path = g_build_filename( cache_folder, blob_name, NULL );
+	g_free( blob_name );
+	return blob_path;
+}
+
+
+/* Packers running at the same time may share a cache folder (Export All builds several variants of
+ * each project at once), so the index files are only read and written while holding this lock,
+ * and unused cache files are only deleted by the last packer using the folder. */
+G_LOCK_DEFINE_STATIC( zip_cache );
+static GHashTable *zip_cache_users = NULL;
+
+
+static GHashTable* utils_zip_cache_index_new( void )
+{
+	return g_hash_table_new_full( g_str_hash, g_str_equal, g_free, (GDestroyNotify) utils_zip_cache_record_free );
+}
+
+
+/* call with the zip_cache lock held */
+static void utils_zip_cache_load_index( const gchar *cache_folder, GHashTable *cache_index )
+{
+	gchar *index_path = g_build_filename( cache_folder, UTILS_ZIP_CACHE_INDEX, NULL );
+	gchar **lines = utils_read_file_in_array( index_path );
+	gchar **line;
+
+	g_free( index_path );
+	if ( !lines )
+		return;
+
+	if ( lines[0] && strcmp( g_strchomp(lines[0]), UTILS_ZIP_CACHE_INDEX_HEADER ) == 0 )
+	{
+		for ( line = lines + 1; *line; line++ )
+		{
+			gchar **fields = g_strsplit( *line, "\t", 5 );
+
+			if ( g_strv_length( fields ) == 5 )
+			{
+				UtilsZipCacheRecord *record = g_new0( UtilsZipCacheRecord, 1 );
+				record->size = g_ascii_strtoull( fields[0], NULL, 10 );
+				record->mtime = g_ascii_strtoll( fields[1], NULL, 10 );
+				record->level = atoi( fields[2] );
+				record->hash = g_strdup( fields[3] );
+				g_hash_table_replace( cache_index, g_strdup( fields[4] ), record );
+			}
+			g_strfreev( fields );
+		}
+	}
+
+	g_strfreev( lines );
+}
+
+
+/* Saves the index, dropping records for files that no longer exist and deleting cache files
+ * that no record refers to. Records saved by other packers since this one loaded the index are
+ * kept, this packer's records take priority. */
+static void utils_zip_cache_save_index( UtilsZipPacker *packer )
+{
+	GString *index = g_string_new( UTILS_ZIP_CACHE_INDEX_HEADER "\n" );
+	GHashTable *used_blobs = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	GHashTable *saved_index = utils_zip_cache_index_new();
+	GHashTableIter iter;
+	gpointer key, value;
+	gchar *index_path;
+	const gchar *filename;
+	GDir *dir;
+
+	G_LOCK( zip_cache );
+
+	utils_zip_cache_load_index( packer->cache_folder, saved_index );
+	g_hash_table_iter_init( &iter, saved_index );
+	while ( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		if ( g_hash_table_lookup( packer->cache_index, key ) )
+			continue;
+
+		g_hash_table_iter_steal( &iter );
+		g_hash_table_insert( packer->cache_index, key, value );
+	}
+	g_hash_table_destroy( saved_index );
+
+	g_hash_table_iter_init( &iter, packer->cache_index );
+	while ( g_hash_table_iter_next( &iter, &key, &value ) )
+	{
+		const gchar *src_path = key;
+		UtilsZipCacheRecord *record = value;
+
+		if ( !g_file_test( src_path, G_FILE_TEST_IS_REGULAR ) )
+		{
+			g_hash_table_iter_remove( &iter );
+			continue;
+		}
+
+		g_string_append_printf( index, "%" G_GUINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%d\t%s\t%s\n",
+		                        record->size, record->mtime, record->level, record->hash, src_path );
+		g_hash_table_replace( used_blobs, g_strdup_printf( "%s-%d.z", record->hash, record->level ), GINT_TO_POINTER(1) );
+	}
+
+	index_path = g_build_filename( packer->cache_folder, UTILS_ZIP_CACHE_INDEX, NULL );
+	if ( !g_file_set_contents( index_path, index->str, index->len, NULL ) )
+		g_warning( "Failed to write zip cache index '%s'", index_path );
+	g_free( index_path );
+	g_string_free( index, TRUE );
+
+	// other packers may have written cache files they haven't saved records for yet
+	dir = NULL;
+	if ( GPOINTER_TO_INT( g_hash_table_lookup( zip_cache_users, packer->cache_folder ) ) <= 1 )
+		dir = g_dir_open( packer->cache_folder, 0, NULL );
+	if ( dir )
+	{
+		foreach_dir( filename, dir )
+		{
+			if ( g_str_has_suffix( filename, ".z" ) && !g_hash_table_lookup( used_blobs, filename ) )
+			{
+				gchar *blob_path = g_build_filename( packer->cache_folder, filename, NULL );
+				g_unlink( blob_path );
+				g_free( blob_path );
+			}
+		}
+		g_dir_close( dir );
+	}
+
+	G_UNLOCK( zip_cache );
+
+	g_hash_table_destroy( used_blobs );
+}
+
+
+static void utils_zip_cache_release( UtilsZipPacker *packer )
+{
+	gint users;
+
+	if ( packer->cache_index )
+		g_hash_table_destroy( packer->cache_index );
+	packer->cache_index = NULL;
+
+	if ( !packer->cache_folder )
+		return;
+
+	G_LOCK( zip_cache );
+	users = GPOINTER_TO_INT( g_hash_table_lookup( zip_cache_users, packer->cache_folder ) ) - 1;
+	if ( users > 0 )
+		g_hash_table_replace( zip_cache_users, g_strdup( packer->cache_folder ), GINT_TO_POINTER( users ) );
+	else
+		g_hash_table_remove( zip_cache_users, packer->cache_folder );
+	G_UNLOCK( zip_cache );
+
+	SETPTR( packer->cache_folder, NULL );
+}
+
+
+/* Fills in the entry from a cache file, safe to call from worker threads */
+static gboolean utils_zip_cache_read( const gchar *cache_folder, const gchar *hash, UtilsZipEntry *entry )
+{
+	gchar *blob_path = utils_zip_cache_get_blob_path( cache_folder, hash, entry->level );
+	gchar *contents = NULL;
+	gsize length = 0;
+	guint64 uncomp_size;
+	guint32 crc;
+
+	if ( !g_file_get_contents( blob_path, &contents, &length, NULL ) )
+	{
+		g_free( blob_path );
+		return FALSE;
+	}
+	g_free( blob_path );
+
+	if ( length < UTILS_ZIP_CACHE_HEADER_SIZE || memcmp( contents, UTILS_ZIP_CACHE_MAGIC, 4 ) != 0 )
+	{
+		g_free( contents );
+		return FALSE;
+	}
+
+	memcpy( &uncomp_size, contents + 4, 8 );
+	memcpy( &crc, contents + 12, 4 );
+
+	entry->uncomp_size = GUINT64_FROM_LE( uncomp_size );
+	entry->crc32 = GUINT32_FROM_LE( crc );
+	entry->compressed = TRUE;
+	entry->data_size = length - UTILS_ZIP_CACHE_HEADER_SIZE;
+	memmove( contents, contents + UTILS_ZIP_CACHE_HEADER_SIZE, entry->data_size );
+	entry->data = contents;
+	entry->data_free_func = g_free;
+
+	SETPTR( entry->hash, g_strdup( hash ) );
+	return TRUE;
+}
+
+
+/* Stores a compressed entry in the cache, safe to call from worker threads */
+static void utils_zip_cache_write( const gchar *cache_folder, UtilsZipEntry *entry )
+{
+	gchar *blob_path = utils_zip_cache_get_blob_path( cache_folder, entry->hash, entry->level );
+	gchar *tmp_path = g_strdup_printf( "%s.%p.tmp", blob_path, (void*) entry );
+	guint64 uncomp_size = GUINT64_TO_LE( entry->uncomp_size );
+	guint32 crc = GUINT32_TO_LE( entry->crc32 );
+	gboolean written = FALSE;
+	FILE *fp;
+
+	fp = g_fopen( tmp_path, "wb" );
+	if ( fp )
+	{
+		written = fwrite( UTILS_ZIP_CACHE_MAGIC, 1, 4, fp ) == 4
+		       && fwrite( &uncomp_size, 1, 8, fp ) == 8
+		       && fwrite( &crc, 1, 4, fp ) == 4
+		       && fwrite( entry->data, 1, entry->data_size, fp ) == entry->data_size;
+		if ( fclose( fp ) != 0 )
+			written = FALSE;
+	}
+
+	// another worker may have stored the same contents already, either copy will do
+	if ( !written || g_rename( tmp_path, blob_path ) != 0 )
+		g_unlink( tmp_path );
+
+	g_free( tmp_path );
+	g_free( blob_path );
+}
+
+
+/* Uses cache_folder to store compressed entries between runs, see the cache description above.
+ * Only entries that get compressed are cached, stored entries are always read from the source. */
+void utils_zip_packer_set_cache_folder( UtilsZipPacker *packer, const gchar *cache_folder )
+{
+	g_return_if_fail (packer != NULL);
+
+	utils_zip_cache_release( packer );
+
+	if ( !cache_folder )
+		return;
+
+	if ( utils_mkdir( cache_folder, TRUE ) != 0 )
+	{
+		g_warning( "Failed to create zip cache folder '%s'", cache_folder );
+		return;
+	}
+
+	packer->cache_folder = g_strdup( cache_folder );
+	packer->cache_index = utils_zip_cache_index_new();
+
+	G_LOCK( zip_cache );
+	if ( !zip_cache_users )
+		zip_cache_users = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	g_hash_table_replace( zip_cache_users, g_strdup( cache_folder ),
+		GINT_TO_POINTER( GPOINTER_TO_INT( g_hash_table_lookup( zip_cache_users, cache_folder ) ) + 1 ) );
+	utils_zip_cache_load_index( packer->cache_folder, packer->cache_index );
+	G_UNLOCK( zip_cache );
+}
+
+
+void utils_zip_packer_set_progress_func( UtilsZipPacker *packer, UtilsZipProgressFunc func, gpointer user_data )
+{
+	g_return_if_fail (packer != NULL);
+
+	packer->progress_func = func;
+	packer->progress_data = user_data;
+}
+
+
+static void utils_zip_shared_entry_free( UtilsZipSharedEntry *shared_entry )
+{
+	if ( shared_entry->data )
+		shared_entry->data_free_func( shared_entry->data );
+	g_free( shared_entry->hash );
+	g_free( shared_entry );
+}
+
+
+UtilsZipShared* utils_zip_shared_new( void )
+{
+	UtilsZipShared *shared = g_new0( UtilsZipShared, 1 );
+
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+	G_LOCK( zip_shared_init );
+	if ( !zip_shared_mutex )
+	{
+		zip_shared_mutex = g_mutex_new();
+		zip_shared_cond = g_cond_new();
+	}
+	G_UNLOCK( zip_shared_init );
+#endif
+
+	shared->ref_count = 1;
+	shared->entries = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, (GDestroyNotify) utils_zip_shared_entry_free );
+	return shared;
+}
+
+
+UtilsZipShared* utils_zip_shared_ref( UtilsZipShared *shared )
+{
+	g_return_val_if_fail (shared != NULL, NULL);
+
+	g_atomic_int_inc( &shared->ref_count );
+	return shared;
+}
+
+
+/* Frees the payload once the last packer using it has been freed */
+void utils_zip_shared_unref( UtilsZipShared *shared )
+{
+	if ( !shared || !g_atomic_int_dec_and_test( &shared->ref_count ) )
+		return;
+
+	g_hash_table_destroy( shared->entries );
+	g_free( shared );
+}
+
+
+/* Shares compressed entries with every other packer using the same payload, see the description above.
+ * The packer holds a reference until it is freed. */
+void utils_zip_packer_set_shared( UtilsZipPacker *packer, UtilsZipShared *shared )
+{
+	g_return_if_fail (packer != NULL);
+
+	if ( shared )
+		utils_zip_shared_ref( shared );
+	utils_zip_shared_unref( packer->shared );
+	packer->shared = shared;
+}
+
+
+/* Returns the data alignment Android expects for a stored APK entry, shared libraries must be page
+ * aligned so they can be mapped straight from the APK, everything else 4 byte aligned. */
+guint utils_zip_get_apk_alignment( const gchar *name )
+{
+	if ( g_str_has_suffix( name, ".so" ) )
+		return 4096;
+	return 4;
+}
+
+
+/* Pads the data of stored entries to the alignment zipalign would use, so the archive doesn't need
+ * aligning again after it is written. */
+void utils_zip_packer_set_apk_alignment( UtilsZipPacker *packer, gboolean apk_alignment )
+{
+	g_return_if_fail (packer != NULL);
+
+	packer->apk_alignment = apk_alignment;
+}
+
+
+UtilsZipPacker* utils_zip_packer_new( void )
+{
+	UtilsZipPacker *packer = g_new0( UtilsZipPacker, 1 );
+	packer->entries = g_ptr_array_new();
+	return packer;
+}
+
+
+void utils_zip_packer_free( UtilsZipPacker *packer )
+{
+	guint i;
+
+	if ( !packer )
+		return;
+
+	for ( i = 0; i < packer->entries->len; i++ )
+		utils_zip_entry_free( g_ptr_array_index( packer->entries, i ) );
+	g_ptr_array_free( packer->entries, TRUE );
+	utils_zip_cache_release( packer );
+	utils_zip_shared_unref( packer->shared );
+	g_free( packer );
+}
+
+
+/* Sets the policy used to pick compression levels for folders added with selective compression,
+ * the default policy is used when NULL. The policy must outlive the packer. */
+void utils_zip_packer_set_policy( UtilsZipPacker *packer, const UtilsZipPolicy *policy )
+{
+	g_return_if_fail (packer != NULL);
+
+	packer->policy = policy;
+}
+
+
+static gboolean utils_zip_packer_queue_file( UtilsZipPacker *packer, const gchar* src, const gchar* dst, gint level, gboolean auto_level )
+{
+	struct stat st;
+	UtilsZipEntry *entry;
+
+	if ( g_stat( src, &st ) != 0 )
+	{
+		g_critical (G_STRLOC ": File '%s' not found.", src);
+		return FALSE;
+	}
+
+	entry = g_new0( UtilsZipEntry, 1 );
+	entry->src_path = g_strdup( src );
+	entry->dst_name = g_strdup( dst );
+	entry->level = CLAMP( level, 0, 10 );
+	entry->auto_level = auto_level;
+	entry->mtime = st.st_mtime;
+	entry->src_size = st.st_size;
+	g_ptr_array_add( packer->entries, entry );
+
+	return TRUE;
+}
+
+
+/* Queues a single file to be added to the archive as dst with the given compression level.
+ * Returns FALSE if the file does not exist. */
+gboolean utils_zip_packer_add_file( UtilsZipPacker *packer, const gchar* src, const gchar* dst, gint level )
+{
+	g_return_val_if_fail (packer != NULL, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	return utils_zip_packer_queue_file( packer, src, dst, level, FALSE );
+}
+
+
+/* Queues the contents of a folder in the order utils_add_folder_to_zip() would add them. */
+gboolean utils_zip_packer_add_folder( UtilsZipPacker *packer, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
+{
+	const gchar *filename;
+	GDir *dir;
+	gboolean result = TRUE;
+
+	g_return_val_if_fail (packer != NULL, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (dst != NULL, FALSE);
+
+	if (!g_file_test (src, G_FILE_TEST_EXISTS)) {
+		g_critical (G_STRLOC ": Location '%s' not found.", src);
+		return FALSE;
+	}
+
+	if (!g_file_test (src, G_FILE_TEST_IS_DIR)) {
+		g_critical (G_STRLOC ": Location '%s' is not a directory.", src);
+		return FALSE;
+	}
+
+	dir = g_dir_open(src, 0, NULL);
+	if (dir == NULL)
+	{
+		g_critical (G_STRLOC ": Failed to open directory '%s'", src);
+		return FALSE;
+	}
+
+	foreach_dir(filename, dir)
+	{
+		gchar* fullsrcpath = g_build_path( "/", src, filename, NULL );
+		gchar* fulldstpath = g_build_path( "/", dst, filename, NULL );
+
+		if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_DIR ) )
+		{
+			if ( recursive )
+				result = utils_zip_packer_add_folder( packer, fullsrcpath, fulldstpath, recursive, selective_compress );
+		}
+		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
+		{
+			gboolean auto_level;
+			gint level = utils_zip_get_level( packer->policy, fullsrcpath, selective_compress, &auto_level );
+			result = utils_zip_packer_queue_file( packer, fullsrcpath, fulldstpath, level, auto_level );
+		}
+
+		g_free(fullsrcpath);
+		g_free(fulldstpath);
+
+		if ( !result )
+			break;
+	}
+
+	g_dir_close(dir);
+
+	return result;
+}
+
+
+static size_t utils_zip_deflated_size( const void *data, size_t length, gint level )
+{
+	size_t comp_size = 0;
+	mz_uint flags = tdefl_create_comp_flags_from_zip_params( level, -15, MZ_DEFAULT_STRATEGY );
+	void *comp_data = tdefl_compress_mem_to_heap( data, length, &comp_size, flags );
+
+	if ( !comp_data )
+		return length;
+	mz_free( comp_data );
+	return comp_size;
+}
+
+
+/* Returns the level to compress an automatic entry with, the fast level unless a sample from the
+ * start of the data compresses more than the budget allows worse than at level 9. Level 9 is
+ * slow to compress but costs nothing to decompress, so it is only given up where it is worth it. */
+static gint utils_zip_check_budget( const UtilsZipPolicy *policy, const void *data, size_t length, gint level )
+{
+	size_t sample = MIN( length, UTILS_ZIP_BUDGET_SAMPLE_SIZE );
+	size_t fast_size, best_size;
+
+	if ( !policy )
+		policy = utils_zip_get_default_policy();
+	if ( level >= 9 )
+		return level;
+
+	fast_size = utils_zip_deflated_size( data, sample, level );
+	best_size = utils_zip_deflated_size( data, sample, 9 );
+
+	if ( (guint64) fast_size * 100 > (guint64) best_size * (100 + policy->budget) )
+		return 9;
+	return level;
+}
+
+
+/* reads and deflates one entry or takes it from the cache, sets entry->failed on error */
+static void utils_zip_compress_entry_data( UtilsZipPacker *packer, UtilsZipEntry *entry )
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	gboolean use_cache = packer->cache_folder && entry->level > 0 && entry->src_size > 3;
+
+	if ( use_cache )
+	{
+		UtilsZipCacheRecord *record = g_hash_table_lookup( packer->cache_index, entry->src_path );
+
+		if ( record && record->size == entry->src_size && record->mtime == (gint64) entry->mtime
+		  && record->level == entry->level && utils_zip_cache_read( packer->cache_folder, record->hash, entry ) )
+		{
+			return;
+		}
+	}
+
+	if ( !g_file_get_contents( entry->src_path, &contents, &length, NULL ) || length > 0xFFFFFFFF )
+	{
+		g_free( contents );
+		entry->failed = TRUE;
+		return;
+	}
+
+	// the file may have changed since it was queued, so check again
+	use_cache = use_cache && length > 3;
+	if ( use_cache )
+	{
+		gchar *hash = g_compute_checksum_for_data( G_CHECKSUM_SHA1, (const guchar*) contents, length );
+		gboolean found = utils_zip_cache_read( packer->cache_folder, hash, entry );
+
+		SETPTR( entry->hash, hash );
+		if ( found )
+		{
+			g_free( contents );
+			return;
+		}
+	}
+
+	entry->uncomp_size = length;
+	entry->crc32 = (mz_uint32) mz_crc32( MZ_CRC32_INIT, (const unsigned char*) contents, length );
+
+	/* mz_zip_writer_add_file() stores anything this small */
+	if ( entry->level > 0 && length > 3 )
+	{
+		size_t comp_size = 0;
+		gint level = entry->auto_level ? utils_zip_check_budget( packer->policy, contents, length, entry->level ) : entry->level;
+		mz_uint flags = tdefl_create_comp_flags_from_zip_params( level, -15, MZ_DEFAULT_STRATEGY );
+		void *comp_data = tdefl_compress_mem_to_heap( contents, length, &comp_size, flags );
+
+		g_free( contents );
+
+		if ( !comp_data )
+			entry->failed = TRUE;
+		else
+		{
+			entry->compressed = TRUE;
+			entry->data = comp_data;
+			entry->data_free_func = mz_free;
+			entry->data_size = comp_size;
+
+			if ( use_cache )
+				utils_zip_cache_write( packer->cache_folder, entry );
+		}
+	}
+	else
+	{
+		entry->data = contents;
+		entry->data_free_func = g_free;
+		entry->data_size = length;
+	}
+}
+
+
+/* Takes the entry from the shared payload, or claims it there and shares it once compressed.
+ * Returns FALSE if the entry can't be shared and the caller should compress it as usual. */
+static gboolean utils_zip_compress_shared_entry( UtilsZipPacker *packer, UtilsZipEntry *entry )
+{
+	UtilsZipShared *shared = packer->shared;
+	UtilsZipSharedEntry *shared_entry;
+	gchar *key = g_strdup_printf( "%d:%s", entry->level, entry->src_path );
+
+	g_mutex_lock( zip_shared_mutex );
+
+	shared_entry = g_hash_table_lookup( shared->entries, key );
+	if ( shared_entry )
+	{
+		g_free( key );
+
+		while ( !shared_entry->ready )
+			g_cond_wait( zip_shared_cond, zip_shared_mutex );
+
+		if ( shared_entry->failed || shared_entry->src_size != entry->src_size || shared_entry->mtime != entry->mtime )
+		{
+			g_mutex_unlock( zip_shared_mutex );
+			return FALSE;
+		}
+
+		// the data stays with the payload, which outlives this packer's entries
+		entry->compressed = shared_entry->compressed;
+		entry->data = shared_entry->data;
+		entry->data_free_func = NULL;
+		entry->data_size = shared_entry->data_size;
+		entry->uncomp_size = shared_entry->uncomp_size;
+		entry->crc32 = shared_entry->crc32;
+		SETPTR( entry->hash, g_strdup( shared_entry->hash ) );
+
+		g_mutex_unlock( zip_shared_mutex );
+		return TRUE;
+	}
+
+	if ( shared->bytes + entry->src_size > UTILS_ZIP_MAX_SHARED_BYTES )
+	{
+		g_mutex_unlock( zip_shared_mutex );
+		g_free( key );
+		return FALSE;
+	}
+
+	shared_entry = g_new0( UtilsZipSharedEntry, 1 );
+	shared_entry->src_size = entry->src_size;
+	shared_entry->mtime = entry->mtime;
+	shared->bytes += entry->src_size;
+	g_hash_table_insert( shared->entries, key, shared_entry );
+
+	g_mutex_unlock( zip_shared_mutex );
+
+	utils_zip_compress_entry_data( packer, entry );
+
+	g_mutex_lock( zip_shared_mutex );
+
+	shared_entry->failed = entry->failed;
+	if ( !entry->failed )
+	{
+		// hand the data over to the payload
+		shared_entry->compressed = entry->compressed;
+		shared_entry->data = entry->data;
+		shared_entry->data_free_func = entry->data_free_func;
+		shared_entry->data_size = entry->data_size;
+		shared_entry->uncomp_size = entry->uncomp_size;
+		shared_entry->crc32 = entry->crc32;
+		shared_entry->hash = g_strdup( entry->hash );
+		entry->data_free_func = NULL;
+	}
+	shared_entry->ready = TRUE;
+	g_cond_broadcast( zip_shared_cond );
+
+	g_mutex_unlock( zip_shared_mutex );
+	return TRUE;
+}
+
+
+/* thread pool function, compresses one entry then hands it back to the writer */
+static void utils_zip_compress_entry( gpointer data, gpointer user_data )
+{
+	UtilsZipEntry *entry = data;
+	UtilsZipPacker *packer = user_data;
+
+	if ( !packer->shared || entry->level == 0 || entry->src_size <= 3 || !utils_zip_compress_shared_entry( packer, entry ) )
+		utils_zip_compress_entry_data( packer, entry );
+
+	g_async_queue_push( packer->done_queue, entry );
+}
+
+
+static gboolean utils_zip_write_entry( UtilsZipPacker *packer, mz_zip_archive *pZip, UtilsZipEntry *entry )
+{
+	guint alignment = packer->apk_alignment ? utils_zip_get_apk_alignment( entry->dst_name ) : 0;
+
+	if ( entry->failed )
+	{
+		g_critical (G_STRLOC ": Failed to compress file '%s'", entry->src_path);
+		return FALSE;
+	}
+
+	if ( entry->compressed )
+	{
+		return mz_zip_writer_add_mem_ex_v2( pZip, entry->dst_name, entry->data, entry->data_size, NULL, 0,
+		                                    entry->level | MZ_ZIP_FLAG_COMPRESSED_DATA, entry->uncomp_size, entry->crc32, &entry->mtime, 0 );
+	}
+
+	return mz_zip_writer_add_mem_ex_v2( pZip, entry->dst_name, entry->data, entry->data_size, NULL, 0, 0, 0, 0, &entry->mtime, alignment );
+}
+
+
+/* Compresses all queued entries in parallel and appends them to pZip in the order they were queued.
+ * This blocks until the archive is written, so call it from an export job rather than the main loop.
+ * Returns FALSE if an entry could not be added or the progress function asked to stop. */
+gboolean utils_zip_packer_write( UtilsZipPacker *packer, mz_zip_archive *pZip )
+{
+	GThreadPool *pool;
+	guint next_push = 0;
+	guint next_write = 0;
+	guint64 bytes_in_flight = 0;
+	guint64 bytes_done = 0;
+	guint64 bytes_total = 0;
+	gboolean result = TRUE;
+	guint i;
+
+	g_return_val_if_fail (packer != NULL, FALSE);
+	g_return_val_if_fail (pZip != NULL, FALSE);
+
+	if ( packer->entries->len == 0 )
+		return TRUE;
+
+	for ( i = 0; i < packer->entries->len; i++ )
+		bytes_total += ((UtilsZipEntry*) g_ptr_array_index( packer->entries, i ))->src_size;
+
+	packer->done_queue = g_async_queue_new();
+	pool = g_thread_pool_new( utils_zip_compress_entry, packer, utils_get_worker_count(), FALSE, NULL );
+
+	while ( result && next_write < packer->entries->len )
+	{
+		UtilsZipEntry *entry;
+
+		// keep the workers busy without holding too much of the archive in memory at once
+		while ( next_push < packer->entries->len
+		     && (next_push == next_write || bytes_in_flight < UTILS_ZIP_MAX_BYTES_IN_FLIGHT) )
+		{
+			entry = g_ptr_array_index( packer->entries, next_push++ );
+			bytes_in_flight += entry->src_size;
+			g_thread_pool_push( pool, entry, NULL );
+		}
+
+		entry = g_ptr_array_index( packer->entries, next_write );
+		while ( !entry->finished )
 		{
-			if ( g_unlink( fullsrcpath ) != 0 ) 
-			{
-				g_dir_close(dir);
-				g_free(fullsrcpath);
-				return FALSE;
-			}
+			UtilsZipEntry *done = g_async_queue_pop( packer->done_queue );
+			done->finished = TRUE;
 		}
 
-		g_free(fullsrcpath);
+		result = utils_zip_write_entry( packer, pZip, entry );
+		utils_zip_entry_free_data( entry );
+		bytes_in_flight -= entry->src_size;
+		bytes_done += entry->src_size;
+		next_write++;
+
+		if ( result && packer->progress_func && !packer->progress_func( bytes_done, bytes_total, packer->progress_data ) )
+			result = FALSE;
 	}
 
-	g_dir_close(dir);
+	// on failure drop anything not yet started and wait for the rest
+	g_thread_pool_free( pool, TRUE, TRUE );
+	g_async_queue_unref( packer->done_queue );
+	packer->done_queue = NULL;
 
-	g_rmdir( src );
-	
-	return TRUE;
+	if ( packer->cache_folder )
+	{
+		for ( i = 0; i < packer->entries->len; i++ )
+		{
+			UtilsZipEntry *entry = g_ptr_array_index( packer->entries, i );
+			UtilsZipCacheRecord *record;
+
+			if ( !entry->hash || entry->failed )
+				continue;
+
+			record = g_new0( UtilsZipCacheRecord, 1 );
+			record->size = entry->src_size;
+			record->mtime = entry->mtime;
+			record->level = entry->level;
+			record->hash = g_strdup( entry->hash );
+			g_hash_table_replace( packer->cache_index, g_strdup( entry->src_path ), record );
+		}
+		utils_zip_cache_save_index( packer );
+	}
+
+	return result;
+}
+
+
+/* policy picks the levels for selective compression, NULL for the default rules */
+gboolean utils_add_folder_to_zip_parallel( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress, const UtilsZipPolicy *policy )
+{
+	UtilsZipPacker *packer;
+	gboolean result;
+
+	g_return_val_if_fail (pZip != NULL, FALSE);
+
+	packer = utils_zip_packer_new();
+	utils_zip_packer_set_policy( packer, policy );
+	result = utils_zip_packer_add_folder( packer, src, dst, recursive, selective_compress )
+	      && utils_zip_packer_write( packer, pZip );
+	utils_zip_packer_free( packer );
+
+	return result;
 }
 
 gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress )
@@ -2530,24 +4140,9 @@ gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const
 		}
 		else if ( g_file_test( fullsrcpath, G_FILE_TEST_IS_REGULAR ) )
 		{
-			int level = 9;
-			gchar *ext = strrchr( filename, '.' );
-			if ( ext && selective_compress )
-			{
-				if ( utils_str_casecmp( ext, ".mp3" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".m4a" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".jpg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".png" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".gif" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".wav" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".ogg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mpg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mpeg" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".mp4" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".m4v" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".dat" ) == 0 ) level = 0;
-				if ( utils_str_casecmp( ext, ".zip" ) == 0 ) level = 0;
-			}
+			// serial archives have no sample to check the budget against, so keep the probed level
+			gboolean auto_level;
+			int level = utils_zip_get_level( NULL, fullsrcpath, selective_compress, &auto_level );
 
 			if ( !mz_zip_writer_add_file( pZip, fulldstpath, fullsrcpath, NULL, 0, level ) )
 			{
@@ -2567,7 +4162,36 @@ gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const
 	return TRUE;
 }
 
-gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, gchar* load_package_string, gchar* additional_folders_string, int* currpos )
+/* Appends the contents of src to dst with utils_copy_file_data(), so files of any size are copied
+ * with a fixed amount of memory. length is set to the number of bytes appended. */
+gboolean utils_append_file_to_stream( FILE *dst, const gchar* src, guint64 *length )
+{
+	struct stat st;
+	int src_fd;
+	gboolean result;
+
+	g_return_val_if_fail (dst != NULL, FALSE);
+	g_return_val_if_fail (src != NULL, FALSE);
+	g_return_val_if_fail (length != NULL, FALSE);
+
+	*length = 0;
+
+	src_fd = g_open( src, O_RDONLY | O_BINARY, 0 );
+	if ( src_fd < 0 )
+		return FALSE;
+
+	// the stream must be flushed before writing to its file descriptor directly
+	result = fstat( src_fd, &st ) == 0 && fflush( dst ) == 0
+	      && utils_copy_file_data( src_fd, fileno( dst ), st.st_size, length );
+	fseek( dst, 0, SEEK_END );
+
+	close( src_fd );
+	return result;
+}
+
+/* Appends every file in srcfull to pHTML5Data and adds its entry to the load package manifest, sub
+ * folders are added to additional_folders_string. currpos is the current size of the data file. */
+gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, GString *load_package_string, GString *additional_folders_string, guint64 *currpos )
 {
 	g_return_val_if_fail (pHTML5Data != NULL, FALSE);
 	g_return_val_if_fail (srcfull != NULL, FALSE);
@@ -2602,11 +4226,7 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 			
 		if ( g_file_test( filepath, G_FILE_TEST_IS_DIR ) )
 		{
-			strcat( additional_folders_string, "Module[\"FS_createPath\"](\"" ); 
-			strcat( additional_folders_string, src ); 
-			strcat( additional_folders_string, "\", \"" );
-			strcat( additional_folders_string, filename );
-			strcat( additional_folders_string, "\", true, true);" );
+			g_string_append_printf( additional_folders_string, "Module[\"FS_createPath\"](\"%s\", \"%s\", true, true);", src, filename );
 
 			if ( !utils_add_folder_to_html5_data_file( pHTML5Data, filepath, shortfilepath, load_package_string, additional_folders_string, currpos ) ) 
 			{
@@ -2618,33 +4238,18 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 		}
 		else if ( g_file_test( filepath, G_FILE_TEST_IS_REGULAR ) )
 		{
-			gchar *contents = 0;
-			gsize length = 0;
+			guint64 length = 0;
 
-			if ( !g_file_get_contents( filepath, &contents, &length, NULL ) )
+			if ( !utils_append_file_to_stream( pHTML5Data, filepath, &length ) )
 			{
-				g_dir_close(dir);
-				g_free(filepath);
-				g_free(shortfilepath);
-				if ( contents ) g_free(contents);
+				g_critical (G_STRLOC ": Failed to convert file '%s' to HTML5 data", filepath);
 
-				g_critical (G_STRLOC ": Failed to open file '%s'", filepath);
-				return FALSE;
-			}
-			
-			if ( length > 0 && fwrite( contents, 1, length, pHTML5Data ) != length )
-			{
 				g_dir_close(dir);
 				g_free(filepath);
 				g_free(shortfilepath);
-				g_free(contents);
-
-				g_critical (G_STRLOC ": Failed to convert file '%s' to HTML5 data", filepath);
 				return FALSE;
 			}
 
-			g_free(contents);
-
 			int audio = 0;
 			gchar *ext = strrchr( filename, '.' );
 			if ( ext )
@@ -2656,12 +4261,9 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 			}
 
 			// append file data to load packing string
-			char str[ 30 ];
-			strcat( load_package_string, "{\"audio\":" ); strcat( load_package_string, audio ? "1" : "0" );
-			strcat( load_package_string, ",\"start\":" ); sprintf( str, "%d", *currpos ); strcat( load_package_string, str );
-			strcat( load_package_string, ",\"crunched\":0" ); 
-			strcat( load_package_string, ",\"end\":" ); sprintf( str, "%d", *currpos+length ); strcat( load_package_string, str );
-			strcat( load_package_string, ",\"filename\":\"" ); strcat( load_package_string, shortfilepath ); strcat( load_package_string, "\"}," );
+			g_string_append_printf( load_package_string,
+				"{\"audio\":%d,\"start\":%" G_GUINT64_FORMAT ",\"crunched\":0,\"end\":%" G_GUINT64_FORMAT ",\"filename\":\"%s\"},",
+				audio, *currpos, *currpos + length, shortfilepath );
 
 			*currpos += length;
 		}
@@ -2675,6 +4277,494 @@ gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* src
 	return TRUE;
 }
 
+static void utils_png_append_chunk( GByteArray *png, const gchar *type, const guint8 *data, guint32 length )
+{
+	guint8 header[8];
+	guint8 footer[4];
+	mz_ulong crc;
+
+	header[0] = (length >> 24) & 0xFF;
+	header[1] = (length >> 16) & 0xFF;
+	header[2] = (length >> 8) & 0xFF;
+	header[3] = length & 0xFF;
+	memcpy( header + 4, type, 4 );
+	g_byte_array_append( png, header, 8 );
+	if ( length > 0 )
+		g_byte_array_append( png, data, length );
+
+	crc = mz_crc32( MZ_CRC32_INIT, header + 4, 4 );
+	if ( length > 0 )
+		crc = mz_crc32( crc, data, length );
+	footer[0] = (crc >> 24) & 0xFF;
+	footer[1] = (crc >> 16) & 0xFF;
+	footer[2] = (crc >> 8) & 0xFF;
+	footer[3] = crc & 0xFF;
+	g_byte_array_append( png, footer, 4 );
+}
+
+
+static guint8 utils_png_paeth( guint8 a, guint8 b, guint8 c )
+{
+	gint p = (gint) a + b - c;
+	gint pa = ABS( p - a );
+	gint pb = ABS( p - b );
+	gint pc = ABS( p - c );
+
+	if ( pa <= pb && pa <= pc ) return a;
+	if ( pb <= pc ) return b;
+	return c;
+}
+
+
+/* Filters one row of 4 byte pixels with each PNG filter type and keeps the one with the smallest sum
+ * of absolute values, the usual heuristic for choosing filters. out must hold 1 + row_bytes. */
+static void utils_png_filter_row( const guint8 *row, const guint8 *prev, gsize row_bytes, guint8 *out, guint8 *scratch )
+{
+	guint best_sum = G_MAXUINT;
+	gint filter;
+	gsize i;
+
+	for ( filter = 0; filter < 5; filter++ )
+	{
+		guint sum = 0;
+
+		for ( i = 0; i < row_bytes; i++ )
+		{
+			guint8 left = (i >= 4) ? row[i - 4] : 0;
+			guint8 up = prev ? prev[i] : 0;
+			guint8 upleft = (prev && i >= 4) ? prev[i - 4] : 0;
+			guint8 value;
+
+			switch ( filter )
+			{
+				case 1: value = row[i] - left; break;
+				case 2: value = row[i] - up; break;
+				case 3: value = row[i] - (guint8) (((guint) left + up) / 2); break;
+				case 4: value = row[i] - utils_png_paeth( left, up, upleft ); break;
+				default: value = row[i]; break;
+			}
+
+			scratch[i] = value;
+			sum += (value < 128) ? value : 256 - value;
+		}
+
+		if ( sum < best_sum )
+		{
+			best_sum = sum;
+			out[0] = filter;
+			memcpy( out + 1, scratch, row_bytes );
+		}
+	}
+}
+
+
+/* Saves pixbuf as an Apple CgBI PNG, the format "xcrun pngcrush -iphone" produces for iOS app icons.
+ * It differs from a normal PNG in three ways: a CgBI chunk comes before IHDR, the pixels are stored
+ * as BGRA with premultiplied alpha, and the IDAT stream is raw deflate without the zlib header and
+ * checksum. Safe to call from any thread. */
+gboolean utils_save_cgbi_png( GdkPixbuf *pixbuf, const gchar *filename, GError **error )
+{
+	static const guint8 png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	static const guint8 cgbi_data[4] = { 0x50, 0x00, 0x20, 0x02 };
+	guint8 ihdr_data[13];
+	gint width, height, channels, rowstride;
+	const guint8 *pixels;
+	gsize row_bytes;
+	guint8 *rows, *filtered, *scratch;
+	void *comp_data;
+	size_t comp_size = 0;
+	mz_uint flags;
+	GByteArray *png;
+	gboolean result;
+	gint x, y;
+
+	g_return_val_if_fail (pixbuf != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	width = gdk_pixbuf_get_width( pixbuf );
+	height = gdk_pixbuf_get_height( pixbuf );
+	channels = gdk_pixbuf_get_n_channels( pixbuf );
+	rowstride = gdk_pixbuf_get_rowstride( pixbuf );
+	pixels = gdk_pixbuf_get_pixels( pixbuf );
+
+	if ( gdk_pixbuf_get_bits_per_sample( pixbuf ) != 8 || (channels != 3 && channels != 4) )
+	{
+		g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_INVAL, _("Unsupported image format") );
+		return FALSE;
+	}
+
+	// swizzle to premultiplied BGRA, always with an alpha channel like pngcrush does
+	row_bytes = (gsize) width * 4;
+	rows = g_malloc( row_bytes * height );
+	for ( y = 0; y < height; y++ )
+	{
+		const guint8 *src = pixels + (gsize) y * rowstride;
+		guint8 *dst = rows + (gsize) y * row_bytes;
+
+		for ( x = 0; x < width; x++ )
+		{
+			guint a = (channels == 4) ? src[3] : 255;
+
+			dst[0] = (src[2] * a + 127) / 255;
+			dst[1] = (src[1] * a + 127) / 255;
+			dst[2] = (src[0] * a + 127) / 255;
+			dst[3] = a;
+
+			src += channels;
+			dst += 4;
+		}
+	}
+
+	filtered = g_malloc( (row_bytes + 1) * height );
+	scratch = g_malloc( row_bytes );
+	for ( y = 0; y < height; y++ )
+	{
+		const guint8 *prev = (y > 0) ? rows + (gsize) (y - 1) * row_bytes : NULL;
+		utils_png_filter_row( rows + (gsize) y * row_bytes, prev, row_bytes, filtered + (gsize) y * (row_bytes + 1), scratch );
+	}
+	g_free( scratch );
+	g_free( rows );
+
+	// negative window bits gives a raw deflate stream
+	flags = tdefl_create_comp_flags_from_zip_params( 9, -15, MZ_DEFAULT_STRATEGY );
+	comp_data = tdefl_compress_mem_to_heap( filtered, (row_bytes + 1) * height, &comp_size, flags );
+	g_free( filtered );
+	if ( !comp_data )
+	{
+		g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, _("Failed to compress image data") );
+		return FALSE;
+	}
+
+	ihdr_data[0] = (width >> 24) & 0xFF;
+	ihdr_data[1] = (width >> 16) & 0xFF;
+	ihdr_data[2] = (width >> 8) & 0xFF;
+	ihdr_data[3] = width & 0xFF;
+	ihdr_data[4] = (height >> 24) & 0xFF;
+	ihdr_data[5] = (height >> 16) & 0xFF;
+	ihdr_data[6] = (height >> 8) & 0xFF;
+	ihdr_data[7] = height & 0xFF;
+	ihdr_data[8] = 8;	// bit depth
+	ihdr_data[9] = 6;	// color type, truecolor with alpha
+	ihdr_data[10] = 0;	// compression
+	ihdr_data[11] = 0;	// filter
+	ihdr_data[12] = 0;	// interlace
+
+	png = g_byte_array_sized_new( comp_size + 64 );
+	g_byte_array_append( png, png_signature, 8 );
+	utils_png_append_chunk( png, "CgBI", cgbi_data, 4 );
+	utils_png_append_chunk( png, "IHDR", ihdr_data, 13 );
+	utils_png_append_chunk( png, "IDAT", comp_data, comp_size );
+	utils_png_append_chunk( png, "IEND", NULL, 0 );
+	mz_free( comp_data );
+
+	result = g_file_set_contents( filename, (const gchar*) png->data, png->len, error );
+	g_byte_array_free( png, TRUE );
+
+	return result;
+}
+
+
+/* Icon sets.
+ * All the sizes an exporter needs from one source image are generated together: the source is
+ * decoded once, halved repeatedly into a mip chain, and each size is resampled from the smallest
+ * level that is still at least as big, so the expensive filter never covers more than a 2:1
+ * reduction. Sizes are scaled and encoded on a thread pool. Finished PNGs are kept in the cache
+ * folder named after the SHA1 of the source file and the target size, so icons whose source
+ * hasn't changed are copied from the cache without decoding anything. Using a cached icon
+ * touches it, and icons that haven't been used for UTILS_ICON_CACHE_MAX_AGE are deleted. */
+
+#define UTILS_ICON_CACHE_VERSION 1
+#define UTILS_ICON_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+
+typedef struct UtilsIcon
+{
+	gchar *filename;
+	gint width;
+	gint height;
+	gboolean cgbi;
+	gchar *cache_path;
+	GPtrArray *levels;	/* borrowed from the set while generating */
+	gchar *error;
+} UtilsIcon;
+
+struct UtilsIconSet
+{
+	gchar *cache_folder;
+	GPtrArray *icons;
+};
+
+
+UtilsIconSet* utils_icon_set_new( const gchar *cache_folder )
+{
+	UtilsIconSet *set = g_new0( UtilsIconSet, 1 );
+
+	set->cache_folder = g_strdup( cache_folder );
+	set->icons = g_ptr_array_new();
+	return set;
+}
+
+
+void utils_icon_set_free( UtilsIconSet *set )
+{
+	guint i;
+
+	if ( !set )
+		return;
+
+	for ( i = 0; i < set->icons->len; i++ )
+	{
+		UtilsIcon *icon = g_ptr_array_index( set->icons, i );
+		g_free( icon->filename );
+		g_free( icon->cache_path );
+		g_free( icon->error );
+		g_free( icon );
+	}
+	g_ptr_array_free( set->icons, TRUE );
+	g_free( set->cache_folder );
+	g_free( set );
+}
+
+
+/* Queues filename to be written as a width x height PNG, in Apple's CgBI format if cgbi is TRUE. */
+void utils_icon_set_add( UtilsIconSet *set, const gchar *filename, gint width, gint height, gboolean cgbi )
+{
+	UtilsIcon *icon;
+
+	g_return_if_fail (set != NULL);
+	g_return_if_fail (filename != NULL);
+	g_return_if_fail (width > 0 && height > 0);
+
+	icon = g_new0( UtilsIcon, 1 );
+	icon->filename = g_strdup( filename );
+	icon->width = width;
+	icon->height = height;
+	icon->cgbi = cgbi;
+	g_ptr_array_add( set->icons, icon );
+}
+
+
+static void utils_icon_generate( gpointer data, gpointer user_data )
+{
+	UtilsIcon *icon = data;
+	GdkPixbuf *level = g_ptr_array_index( icon->levels, 0 );
+	GdkPixbuf *scaled_image;
+	GError *error = NULL;
+	gboolean saved;
+	guint i;
+
+	// smallest level that doesn't need enlarging
+	for ( i = 1; i < icon->levels->len; i++ )
+	{
+		GdkPixbuf *next = g_ptr_array_index( icon->levels, i );
+		if ( gdk_pixbuf_get_width( next ) < icon->width || gdk_pixbuf_get_height( next ) < icon->height )
+			break;
+		level = next;
+	}
+
+	if ( gdk_pixbuf_get_width( level ) == icon->width && gdk_pixbuf_get_height( level ) == icon->height )
+		scaled_image = g_object_ref( level );
+	else
+		scaled_image = gdk_pixbuf_scale_simple( level, icon->width, icon->height, GDK_INTERP_HYPER );
+
+	if ( !scaled_image )
+	{
+		icon->error = g_strdup_printf( _("Failed to scale image to %dx%d"), icon->width, icon->height );
+		return;
+	}
+
+	if ( icon->cgbi )
+		saved = utils_save_cgbi_png( scaled_image, icon->filename, &error );
+	else
+		saved = gdk_pixbuf_save( scaled_image, icon->filename, "png", &error, "compression", "9", NULL );
+	g_object_unref( scaled_image );
+
+	if ( !saved )
+	{
+		gchar *name = g_path_get_basename( icon->filename );
+		icon->error = g_strdup_printf( _("Failed to save %s: %s"), name, error->message );
+		g_error_free( error );
+		g_free( name );
+		return;
+	}
+
+	// copy into the cache under a temporary name first, another export may be storing the same icon
+	if ( icon->cache_path )
+	{
+		gchar *temp_path = g_strdup_printf( "%s.%p.tmp", icon->cache_path, (gpointer) icon );
+		if ( utils_copy_file( icon->filename, temp_path, TRUE, NULL ) )
+		{
+			g_unlink( icon->cache_path );
+			if ( g_rename( temp_path, icon->cache_path ) != 0 )
+				g_unlink( temp_path );
+		}
+		g_free( temp_path );
+	}
+}
+
+
+/* Deletes icons, and temporary files left by interrupted exports, that haven't been used for a while */
+static void utils_icon_cache_prune( const gchar *cache_folder )
+{
+	time_t oldest = time( NULL ) - UTILS_ICON_CACHE_MAX_AGE;
+	const gchar *filename;
+	GDir *dir;
+
+	dir = g_dir_open( cache_folder, 0, NULL );
+	if ( !dir )
+		return;
+
+	foreach_dir( filename, dir )
+	{
+		gchar *path;
+		struct stat st;
+
+		if ( !g_str_has_suffix( filename, ".png" ) && !g_str_has_suffix( filename, ".tmp" ) )
+			continue;
+
+		path = g_build_filename( cache_folder, filename, NULL );
+		if ( g_stat( path, &st ) == 0 && st.st_mtime < oldest )
+			g_unlink( path );
+		g_free( path );
+	}
+	g_dir_close( dir );
+}
+
+
+/* Writes every icon added to the set from the image src_file. Returns FALSE and sets error if the
+ * source could not be loaded or an icon could not be written. */
+gboolean utils_icon_set_write( UtilsIconSet *set, const gchar *src_file, GError **error )
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	gchar *hash = NULL;
+	GPtrArray *missing;
+	gboolean result = TRUE;
+	guint i;
+
+	g_return_val_if_fail (set != NULL, FALSE);
+	g_return_val_if_fail (src_file != NULL, FALSE);
+
+	if ( set->cache_folder )
+	{
+		if ( !g_file_get_contents( src_file, &contents, &length, error ) )
+			return FALSE;
+		hash = g_compute_checksum_for_data( G_CHECKSUM_SHA1, (const guchar*) contents, length );
+		g_free( contents );
+		g_mkdir_with_parents( set->cache_folder, 0755 );
+	}
+
+	missing = g_ptr_array_new();
+	for ( i = 0; i < set->icons->len; i++ )
+	{
+		UtilsIcon *icon = g_ptr_array_index( set->icons, i );
+		gchar *folder = g_path_get_dirname( icon->filename );
+		g_mkdir_with_parents( folder, 0755 );
+		g_free( folder );
+
+		g_free( icon->cache_path );
+		icon->cache_path = NULL;
+		g_free( icon->error );
+		icon->error = NULL;
+
+		if ( hash )
+		{
+			gchar *name = g_strdup_printf( "%s-%dx%d%s-%d.png", hash, icon->width, icon->height,
+			                               icon->cgbi ? "-cgbi" : "", UTILS_ICON_CACHE_VERSION );
+			icon->cache_path = g_build_filename( set->cache_folder, name, NULL );
+			g_free( name );
+
+			if ( g_file_test( icon->cache_path, G_FILE_TEST_IS_REGULAR )
+			  && utils_copy_file( icon->cache_path, icon->filename, TRUE, NULL ) )
+			{
+				g_utime( icon->cache_path, NULL );
+				continue;
+			}
+		}
+
+		g_ptr_array_add( missing, icon );
+	}
+	g_free( hash );
+
+	if ( missing->len > 0 )
+	{
+		GPtrArray *levels = g_ptr_array_new();
+		GdkPixbuf *source = gdk_pixbuf_new_from_file( src_file, error );
+		gint min_width = G_MAXINT;
+		gint min_height = G_MAXINT;
+
+		if ( !source )
+		{
+			g_ptr_array_free( levels, TRUE );
+			g_ptr_array_free( missing, TRUE );
+			return FALSE;
+		}
+
+		for ( i = 0; i < missing->len; i++ )
+		{
+			UtilsIcon *icon = g_ptr_array_index( missing, i );
+			min_width = MIN( min_width, icon->width );
+			min_height = MIN( min_height, icon->height );
+		}
+
+		// bilinear reduction averages the pixels each result pixel covers, an exact 2x2 box
+		// filter for even sizes and slightly more than 2x2 when an odd size is rounded down
+		g_ptr_array_add( levels, source );
+		for (;;)
+		{
+			GdkPixbuf *prev = g_ptr_array_index( levels, levels->len - 1 );
+			gint width = gdk_pixbuf_get_width( prev ) / 2;
+			gint height = gdk_pixbuf_get_height( prev ) / 2;
+			GdkPixbuf *next;
+
+			if ( width < min_width || height < min_height )
+				break;
+			next = gdk_pixbuf_scale_simple( prev, width, height, GDK_INTERP_BILINEAR );
+			if ( !next )
+				break;
+			g_ptr_array_add( levels, next );
+		}
+
+		if ( missing->len == 1 )
+		{
+			((UtilsIcon*) g_ptr_array_index( missing, 0 ))->levels = levels;
+			utils_icon_generate( g_ptr_array_index( missing, 0 ), NULL );
+		}
+		else
+		{
+			GThreadPool *pool = g_thread_pool_new( utils_icon_generate, NULL, MIN( missing->len, utils_get_worker_count() ), FALSE, NULL );
+			for ( i = 0; i < missing->len; i++ )
+			{
+				((UtilsIcon*) g_ptr_array_index( missing, i ))->levels = levels;
+				g_thread_pool_push( pool, g_ptr_array_index( missing, i ), NULL );
+			}
+			g_thread_pool_free( pool, FALSE, TRUE );
+		}
+
+		for ( i = 0; i < missing->len; i++ )
+		{
+			UtilsIcon *icon = g_ptr_array_index( missing, i );
+			icon->levels = NULL;
+			if ( result && icon->error )
+			{
+				g_set_error( error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "%s", icon->error );
+				result = FALSE;
+			}
+		}
+
+		for ( i = 0; i < levels->len; i++ )
+			g_object_unref( g_ptr_array_index( levels, i ) );
+		g_ptr_array_free( levels, TRUE );
+	}
+
+	g_ptr_array_free( missing, TRUE );
+
+	if ( set->cache_folder )
+		utils_icon_cache_prune( set->cache_folder );
+
+	return result;
+}
+
+
 gchar* utils_create_relative_path( const gchar* base_path, const gchar* path )
 {
 	if ( !base_path || !path ) return g_strdup("");
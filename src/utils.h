@@ -301,11 +301,78 @@ gboolean utils_copy_file (const gchar *src, const gchar *dst, gboolean overwrite
 
 gboolean utils_copy_folder ( const gchar* src, const gchar* dst, gboolean recursive, volatile gchar* progress );
 
+gboolean utils_sync_folder( const gchar* src, const gchar* dst, const gchar* const* keep );
+
+void utils_prune_folder( const gchar* folder, const gchar* const* keep );
+
 gboolean utils_remove_folder_recursive ( const gchar* src );
 
 gboolean utils_add_folder_to_zip ( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress );
 
-gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, gchar* load_package_string, gchar* additional_folders_string, int* currpos );
+typedef struct UtilsZipPacker UtilsZipPacker;
+
+typedef struct UtilsZipShared UtilsZipShared;
+
+/* return FALSE to stop writing the archive */
+typedef gboolean (*UtilsZipProgressFunc)( guint64 bytes_done, guint64 bytes_total, gpointer user_data );
+
+guint utils_get_worker_count( void );
+
+UtilsZipPacker* utils_zip_packer_new( void );
+
+void utils_zip_packer_free( UtilsZipPacker *packer );
+
+void utils_zip_packer_set_cache_folder( UtilsZipPacker *packer, const gchar *cache_folder );
+
+void utils_zip_packer_set_progress_func( UtilsZipPacker *packer, UtilsZipProgressFunc func, gpointer user_data );
+
+UtilsZipShared* utils_zip_shared_new( void );
+
+UtilsZipShared* utils_zip_shared_ref( UtilsZipShared *shared );
+
+void utils_zip_shared_unref( UtilsZipShared *shared );
+
+void utils_zip_packer_set_shared( UtilsZipPacker *packer, UtilsZipShared *shared );
+
+guint utils_zip_get_apk_alignment( const gchar *name );
+
+void utils_zip_packer_set_apk_alignment( UtilsZipPacker *packer, gboolean apk_alignment );
+
+typedef struct UtilsZipPolicy UtilsZipPolicy;
+
+#define UTILS_ZIP_DEFAULT_FAST_LEVEL 5
+
+#define UTILS_ZIP_DEFAULT_BUDGET 5
+
+UtilsZipPolicy* utils_zip_policy_new( const gchar *rules, gint fast_level, gint budget );
+
+void utils_zip_policy_free( UtilsZipPolicy *policy );
+
+void utils_zip_packer_set_policy( UtilsZipPacker *packer, const UtilsZipPolicy *policy );
+
+gboolean utils_zip_packer_add_file( UtilsZipPacker *packer, const gchar* src, const gchar* dst, gint level );
+
+gboolean utils_zip_packer_add_folder( UtilsZipPacker *packer, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress );
+
+gboolean utils_zip_packer_write( UtilsZipPacker *packer, mz_zip_archive *pZip );
+
+gboolean utils_add_folder_to_zip_parallel( mz_zip_archive *pZip, const gchar* src, const gchar* dst, gboolean recursive, gboolean selective_compress, const UtilsZipPolicy *policy );
+
+gboolean utils_append_file_to_stream( FILE *dst, const gchar* src, guint64 *length );
+
+gboolean utils_add_folder_to_html5_data_file( FILE *pHTML5Data, const gchar* srcfull, const gchar* src, GString *load_package_string, GString *additional_folders_string, guint64 *currpos );
+
+gboolean utils_save_cgbi_png( GdkPixbuf *pixbuf, const gchar *filename, GError **error );
+
+typedef struct UtilsIconSet UtilsIconSet;
+
+UtilsIconSet* utils_icon_set_new( const gchar *cache_folder );
+
+void utils_icon_set_free( UtilsIconSet *set );
+
+void utils_icon_set_add( UtilsIconSet *set, const gchar *filename, gint width, gint height, gboolean cgbi );
+
+gboolean utils_icon_set_write( UtilsIconSet *set, const gchar *src_file, GError **error );
 
 gchar* utils_create_relative_path( const gchar* base_path, const gchar* path );
 
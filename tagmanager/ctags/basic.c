@@ -48,7 +48,13 @@ static kindOption BasicKinds[] = {
 	{TRUE, 'm', "member", "members"}
 };
 
-static char g_szTypeName[ 50 ];
+/* Parser state, so that several files can be parsed at once */
+typedef struct {
+	char typeName[ 50 ];	/* the type being declared, empty outside of a type */
+	unsigned long lineNumber;
+	agkTagFunction func;	/* NULL when parsing through ctags */
+	void *userData;
+} agkState;
 
 /*
 static KeyWord agk_keywords[] = {
@@ -255,8 +261,44 @@ static int match_keyword (const char *p, KeyWord const *kw)
 }
 */
 
+/* Makes a tag through ctags, or passes it to the callback of parseAGKBuffer() */
+static void makeAGKTag( agkState *st, const vString *name, BasicKind kind,
+	const char *scope, const char *vartype, const char *arglist )
+{
+	tagEntryInfo e;
+
+	if ( st->func == NULL )
+	{
+		if ( kind == K_LABEL )
+			makeSimpleTag (name, BasicKinds, kind);
+		else if ( arglist )
+			makeBasicFunctionTag (name, BasicKinds, kind, arglist);
+		else
+			makeBasicTag (name, BasicKinds, kind, scope, vartype);
+		return;
+	}
+
+	if ( vStringLength (name) == 0 )
+		return;
+
+	/* the same fields as makeSimpleTag(), makeBasicTag() and makeBasicFunctionTag() */
+	memset (&e, 0, sizeof (tagEntryInfo));
+	e.lineNumberEntry = TRUE;
+	e.lineNumber = st->lineNumber;
+	e.language = "AGK";
+	e.name = vStringValue (name);
+	e.kindName = BasicKinds [kind].name;
+	e.kind = BasicKinds [kind].letter;
+	if ( kind != K_LABEL )
+		e.extensionFields.access = "public";
+	e.extensionFields.scope[1] = scope;
+	e.extensionFields.varType = vartype;
+	e.extensionFields.arglist = arglist;
+	st->func (&e, st->userData);
+}
+
 /* Match a "label:" style label. */
-static int parse_label( const char* p )
+static int parse_label( agkState *st, const char* p )
 {
 	if ( !IsIdentifierChar(*p) ) return 0;
 
@@ -268,7 +310,7 @@ static int parse_label( const char* p )
 	{
 		vString *name = vStringNew ();
 		vStringNCatS (name, p, cur - p);
-		makeSimpleTag (name, BasicKinds, K_LABEL);
+		makeAGKTag( st, name, K_LABEL, 0, 0, 0 );
 		vStringDelete (name);
 		return 1;
 	}
@@ -276,7 +318,7 @@ static int parse_label( const char* p )
 	return 0;
 }
 
-static int parse_dim( const char* p )
+static int parse_dim( agkState *st, const char* p )
 {
 	// ignore any global or local qualifiers
 	if ( basic_str_n_casecmp(p,"global",6) == 0 && isspace(*(p+6)) ) 
@@ -342,7 +384,7 @@ static int parse_dim( const char* p )
 
 			vString *name = vStringNew ();
 			vStringNCatS (name, start, len);
-			makeBasicTag( name, BasicKinds, K_VARIABLE, 0, vartype );
+			makeAGKTag( st, name, K_VARIABLE, 0, vartype, 0 );
 			vStringDelete (name);
 
 			return 1;
@@ -375,14 +417,14 @@ static int parse_dim( const char* p )
 	strncpy( vartype, start2, len2 );
 	vartype[ len2 ] = 0;	
 	
-	makeBasicTag( name, BasicKinds, K_VARIABLE, 0, vartype );
+	makeAGKTag( st, name, K_VARIABLE, 0, vartype, 0 );
 
 	vStringDelete (name);
 
 	return 1;
 }
 
-static int parse_variable( const char* p )
+static int parse_variable( agkState *st, const char* p )
 {
 	// ignore any global or local qualifiers
 	if ( basic_str_n_casecmp(p,"global",6) == 0 && isspace(*(p+6)) ) 
@@ -412,7 +454,7 @@ static int parse_variable( const char* p )
 	if ( basic_str_n_casecmp(p," as ", 4) != 0 ) 
 	{
 		// variables do not require types, but only account for them in types here
-		if ( g_szTypeName[0] )
+		if ( st->typeName[0] )
 		{
 			while (isspace(*p)) 
 				p++;
@@ -423,7 +465,7 @@ static int parse_variable( const char* p )
 				if ( start[len-1] == '$' ) vartype = "string";
 				vString *name = vStringNew ();
 				vStringNCatS (name, start, len);
-				makeBasicTag( name, BasicKinds, K_MEMBER, g_szTypeName, vartype );
+				makeAGKTag( st, name, K_MEMBER, st->typeName, vartype, 0 );
 				vStringDelete (name);
 
 				if ( *p == ',' ) 
@@ -431,7 +473,7 @@ static int parse_variable( const char* p )
 					p++;
 					while (isspace(*p)) 
 						p++;
-					parse_variable( p );
+					parse_variable( st, p );
 				}
 
 				return 1;
@@ -480,7 +522,7 @@ static int parse_variable( const char* p )
 		strncpy( vartype, start2, len2 );
 		vartype[ len2 ] = 0;	
 		
-		makeBasicTag( name, BasicKinds, g_szTypeName[0] ? K_MEMBER : K_VARIABLE, g_szTypeName[0] ? g_szTypeName : 0, vartype );
+		makeAGKTag( st, name, st->typeName[0] ? K_MEMBER : K_VARIABLE, st->typeName[0] ? st->typeName : 0, vartype, 0 );
 	}
 
 	vStringDelete (name);
@@ -494,13 +536,13 @@ static int parse_variable( const char* p )
 		p++;
 		while (isspace(*p)) 
 			p++;
-		parse_variable( p );
+		parse_variable( st, p );
 	}
 
 	return 1;
 }
 
-static int parse_constant( const char* p )
+static int parse_constant( agkState *st, const char* p )
 {
 	if ( basic_str_n_casecmp(p,"#constant",9) == 0 && isspace(*(p+9)) ) 
 	{
@@ -516,7 +558,7 @@ static int parse_constant( const char* p )
 
 		vString *name = vStringNew ();
 		vStringNCatS (name, start, len);
-		makeBasicTag( name, BasicKinds, K_CONST, 0, 0 );
+		makeAGKTag( st, name, K_CONST, 0, 0, 0 );
 		vStringDelete (name);
 
 		return 1;
@@ -525,7 +567,7 @@ static int parse_constant( const char* p )
 	return 0;
 }
 
-static int parse_function( const char* p )
+static int parse_function( agkState *st, const char* p )
 {
 	if ( basic_str_n_casecmp(p,"function",8) == 0 && isspace(*(p+8)) ) 
 	{
@@ -554,7 +596,7 @@ static int parse_function( const char* p )
 		vStringNCatS (name, start, len);		
 		vStringNCatS (args, start2, len2);		
 
-		makeBasicFunctionTag( name, BasicKinds, K_FUNCTION, args->buffer );
+		makeAGKTag( st, name, K_FUNCTION, 0, 0, args->buffer );
 
 		vStringDelete (name);
 		vStringDelete (args);
@@ -565,18 +607,18 @@ static int parse_function( const char* p )
 	return 0;
 }
 
-static int parse_endtype( const char* p )
+static int parse_endtype( agkState *st, const char* p )
 {
 	if ( basic_str_n_casecmp(p,"endtype",7) == 0 && !IsIdentifierChar(*(p+7)) ) 
 	{
-		g_szTypeName[0] = 0;
+		st->typeName[0] = 0;
 		return 1;
 	}
 
 	return 0;
 }
 
-static int parse_type( const char* p )
+static int parse_type( agkState *st, const char* p )
 {
 	if ( basic_str_n_casecmp(p,"type",4) == 0 && isspace(*(p+4)) ) 
 	{
@@ -590,12 +632,12 @@ static int parse_type( const char* p )
 		int len = (int)(p-start);
 		if ( len >= 50 ) len = 50;
 
-		strncpy( g_szTypeName, start, len );
-		g_szTypeName[ len ] = 0;
+		strncpy( st->typeName, start, len );
+		st->typeName[ len ] = 0;
 
 		vString *name = vStringNew ();
 		vStringNCatS (name, start, len);
-		makeBasicTag( name, BasicKinds, K_TYPE, 0, 0 );
+		makeAGKTag( st, name, K_TYPE, 0, 0, 0 );
 		vStringDelete (name);
 
 		return 1;
@@ -604,90 +646,116 @@ static int parse_type( const char* p )
 	return 0;
 }
 
-static int parse_line( const char* p )
+static int parse_line( agkState *st, const char* p )
 {
-	if ( g_szTypeName[0] )
+	if ( st->typeName[0] )
 	{
-		if ( parse_endtype( p ) ) return 1;
+		if ( parse_endtype( st, p ) ) return 1;
 		
 		// if any of these are true then the type is not formatted correctly or is missing its EndType
-		if ( parse_function( p )
-		  || parse_constant( p )
-		  || parse_dim( p )
-		  || parse_label( p ) ) 
+		if ( parse_function( st, p )
+		  || parse_constant( st, p )
+		  || parse_dim( st, p )
+		  || parse_label( st, p ) ) 
 		{
-			g_szTypeName[0] = 0;
+			st->typeName[0] = 0;
 			return 1;
 		}
 
-		if ( parse_type( p ) ) return 1;
-		if ( parse_variable( p ) ) return 1;
+		if ( parse_type( st, p ) ) return 1;
+		if ( parse_variable( st, p ) ) return 1;
 	}
 	else
 	{
-		if ( parse_function( p ) ) return 1;
-		if ( parse_constant( p ) ) return 1;
-		if ( parse_type( p ) ) return 1;
-		if ( parse_dim( p ) ) return 1;
-		if ( parse_label( p ) ) return 1;
-		if ( parse_variable( p ) ) return 1;
+		if ( parse_function( st, p ) ) return 1;
+		if ( parse_constant( st, p ) ) return 1;
+		if ( parse_type( st, p ) ) return 1;
+		if ( parse_dim( st, p ) ) return 1;
+		if ( parse_label( st, p ) ) return 1;
+		if ( parse_variable( st, p ) ) return 1;
 	}
 	
 	return 0;
 }
 
-static void findBasicTags (void)
+static void parseAGKLine( agkState *st, const char *line, int *inComment )
 {
-	const char *line;
-	//KeyWord *keywords;
+	const char *p = line;
 
-	//keywords = agk_keywords;
-	int inComment = 0;
+	while (isspace (*p))
+		p++;
 
-	while ((line = (const char *) fileReadLine ()) != NULL)
-	{
-		const char *p = line;
-		KeyWord const *kw;
+	/* Empty line or comment? */
+	if (!*p || isAGKComment(p) )
+		return;
 
-		while (isspace (*p))
-			p++;
+	// start comment block
+	if ( isAGKCommentBlock(p) > 0 ) 
+	{
+		*inComment = 1;
+		p += 2; // block comment start is at least 2 characters
+	}
 
-		/* Empty line or comment? */
-		if (!*p || isAGKComment(p) )
-			continue;
+	if ( !*inComment )
+		parse_line( st, p );
+	
+	// must check for comment changes
+	while ( *p )
+	{
+		if ( *inComment == 0 && isAGKComment(p) ) break;
 
 		// start comment block
-		if ( isAGKCommentBlock(p) > 0 ) 
-		{
-			inComment = 1;
-			p += 2; // block comment start is at least 2 characters
-		}
-
-		if ( !inComment )
-		{
-			parse_line( p );
-			/*
-			for (kw = keywords; kw->token; kw++)
-				if (match_keyword (p, kw)) break;
+		if ( isAGKCommentBlock(p) > 0 ) *inComment = 1;
 
-			match_colon_label (p);
-			*/
-		}
+		// end comment block
+		if ( isAGKCommentBlock(p) < 0 ) *inComment = 0;
 		
-		// must check for comment changes
-		while ( *p )
-		{
-			if ( inComment == 0 && isAGKComment(p) ) break;
+		p++;
+	}
+}
 
-			// start comment block
-			if ( isAGKCommentBlock(p) > 0 ) inComment = 1;
+static void findBasicTags (void)
+{
+	const char *line;
+	agkState st;
+	int inComment = 0;
 
-			// end comment block
-			if ( isAGKCommentBlock(p) < 0 ) inComment = 0;
-			
-			p++;
-		}
+	memset (&st, 0, sizeof (agkState));
+	while ((line = (const char *) fileReadLine ()) != NULL)
+		parseAGKLine( &st, line, &inComment );
+}
+
+/* Parses AGK source without going through the ctags input and tag output
+ * functions, which use global state. Each tag is passed to func, whose tag
+ * entry is only valid during the call. This can be called from any thread. */
+extern void parseAGKBuffer (const unsigned char *buffer, size_t size,
+							agkTagFunction func, void *user_data)
+{
+	const char *pos = (const char *) buffer;
+	const char *end = pos + size;
+	vString *line = vStringNew ();
+	agkState st;
+	int inComment = 0;
+
+	memset (&st, 0, sizeof (agkState));
+	st.func = func;
+	st.userData = user_data;
+	while (pos < end)
+	{
+		const char *eol = pos;
+
+		while (eol < end && *eol != '\n' && *eol != '\r')
+			eol++;
+		vStringClear (line);
+		vStringNCatS (line, pos, eol - pos);
+		st.lineNumber++;
+		parseAGKLine( &st, vStringValue (line), &inComment );
+
+		if (eol < end && *eol == '\r' && eol + 1 < end && eol[1] == '\n')
+			eol++;
+		pos = eol + 1;
 	}
+	vStringDelete (line);
 }
 
 parserDefinition *AGKParser (void)
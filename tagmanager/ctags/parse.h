@@ -38,6 +38,7 @@ typedef boolean (*rescanParser) (const unsigned int passCount);
 typedef void (*parserInitialize) (langType language);
 typedef int (*tagEntryFunction) (const tagEntryInfo *const tag);
 typedef void (*tagEntrySetArglistFunction) (const char *tag_name, const char *arglist);
+typedef void (*agkTagFunction) (const tagEntryInfo *const tag, void *user_data);
 
 typedef struct sKindOption {
     boolean enabled;			/* are tags for kind enabled? */
@@ -93,6 +94,7 @@ extern void makeSimpleTag (const vString* const name, kindOption* const kinds, c
 extern void makeSimpleScopedTag (const vString* const name, kindOption* const kinds, const int kind, const char* scope, const char* scope2, const char *access);
 extern void makeBasicTag (const vString* const name, kindOption* const kinds, const int kind, const char* scope, const char *vartype);
 extern void makeBasicFunctionTag (const vString* const name, kindOption* const kinds, const int kind, const char *arglist);
+extern void parseAGKBuffer (const unsigned char *buffer, size_t size, agkTagFunction func, void *user_data);
 
 extern parserDefinition* parserNew (const char* name);
 extern const char *getLanguageName (const langType language);
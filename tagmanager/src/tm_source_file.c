@@ -28,11 +28,17 @@
 
 #include "tm_source_file.h"
 #include "tm_tag.h"
+#include "tm_workspace.h"
 
 
 guint source_file_class_id = 0;
 static TMSourceFile *current_source_file = NULL;
 
+/* The ctags parsers keep their state in globals, so only one file can be parsed at a time.
+ Files are parsed on the main thread and by the project index threads (see tm_workspace.c).
+ AGK files don't take the lock, they are parsed with the reentrant parseAGKBuffer(). */
+G_LOCK_DEFINE_STATIC(parse);
+
 gboolean tm_source_file_init(TMSourceFile *source_file, const char *file_name
   , gboolean update, const char* name)
 {
@@ -103,7 +109,7 @@ void tm_source_file_free(gpointer source_file)
 	}
 }
 
-gboolean tm_source_file_parse(TMSourceFile *source_file)
+static gboolean tm_source_file_parse_locked(TMSourceFile *source_file)
 {
 	const char *file_name;
 	gboolean status = TRUE;
@@ -159,7 +165,113 @@ gboolean tm_source_file_parse(TMSourceFile *source_file)
 	return status;
 }
 
-gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf, gint buf_size)
+typedef struct
+{
+	TMSourceFile *source_file;
+	GPtrArray *tags_array;
+	TMTagArena *arena;
+} AGKParseData;
+
+static void tm_source_file_agk_tag(const tagEntryInfo *const tag, void *user_data)
+{
+	AGKParseData *data = user_data;
+	TMTag *tm_tag = tm_tag_arena_new_tag(data->arena, data->source_file, tag);
+
+	if (tm_tag)
+		g_ptr_array_add(data->tags_array, tm_tag);
+}
+
+/* Parses AGK source with the reentrant AGK parser instead of through ctags, so
+ unlike tm_source_file_buffer_parse() this uses no global state and can be
+ called from any thread, for several files at once. The tags array of
+ source_file is left alone.
+ \param source_file The source file the tags will belong to.
+ \param text_buf The AGK source.
+ \param buf_size The size of text_buf.
+ \return A new array of unsorted tags, to be freed with tm_tags_array_free().
+*/
+GPtrArray *tm_source_file_parse_agk_buffer(TMSourceFile *source_file, const guchar *text_buf,
+	gsize buf_size)
+{
+	AGKParseData data;
+
+	data.source_file = source_file;
+	data.tags_array = g_ptr_array_new();
+	/* the tags of a file are freed together when it is parsed again */
+	data.arena = tm_tag_arena_new();
+	if (text_buf && buf_size)
+		parseAGKBuffer(text_buf, buf_size, tm_source_file_agk_tag, &data);
+	tm_tag_arena_release(data.arena);
+	return data.tags_array;
+}
+
+/* Whether source_file can be parsed with tm_source_file_parse_agk_buffer()
+ rather than through ctags. Detects the language first if needed. */
+static gboolean tm_source_file_is_agk(TMSourceFile *source_file)
+{
+	langType agk_lang;
+
+	if ((NULL == source_file) || (NULL == source_file->work_object.file_name))
+		return FALSE;
+
+	/* the language table is only changed while initialising and detecting the language */
+	if (NULL == LanguageTable || LANG_AUTO == source_file->lang)
+	{
+		G_LOCK(parse);
+		if (NULL == LanguageTable)
+		{
+			initializeParsing();
+			installLanguageMapDefaults();
+			if (NULL == TagEntryFunction)
+				TagEntryFunction = tm_source_file_tags;
+			if (NULL == TagEntrySetArglistFunction)
+				TagEntrySetArglistFunction = tm_source_file_set_tag_arglist;
+		}
+		if (LANG_AUTO == source_file->lang)
+			source_file->lang = getFileLanguage(source_file->work_object.file_name);
+		G_UNLOCK(parse);
+	}
+
+	agk_lang = getNamedLanguage("AGK");
+	return agk_lang >= 0 && source_file->lang == agk_lang && LanguageTable[agk_lang]->enabled;
+}
+
+static void tm_source_file_set_tags(TMSourceFile *source_file, GPtrArray *tags_array)
+{
+	if (source_file->work_object.tags_array)
+		tm_tags_array_free(source_file->work_object.tags_array, TRUE);
+	source_file->work_object.tags_array = tags_array;
+}
+
+gboolean tm_source_file_parse(TMSourceFile *source_file)
+{
+	gboolean status;
+
+	if (tm_source_file_is_agk(source_file))
+	{
+		gchar *contents;
+		gsize length;
+
+		if (! g_file_get_contents(source_file->work_object.file_name, &contents, &length, NULL))
+		{
+			g_warning("%s: Unable to open %s", G_STRFUNC, source_file->work_object.file_name);
+			return FALSE;
+		}
+		tm_source_file_set_tags(source_file,
+			tm_source_file_parse_agk_buffer(source_file, (guchar *) contents, length));
+		g_free(contents);
+		return TRUE;
+	}
+
+	G_LOCK(parse);
+	status = tm_source_file_parse_locked(source_file);
+	current_source_file = NULL;
+	G_UNLOCK(parse);
+
+	return status;
+}
+
+static gboolean tm_source_file_buffer_parse_locked(TMSourceFile *source_file, guchar* text_buf, gint buf_size)
 {
 	const char *file_name;
 	gboolean status = TRUE;
@@ -231,10 +343,38 @@ gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf
 	return status;
 }
 
+gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf, gint buf_size)
+{
+	gboolean status;
+
+	if (tm_source_file_is_agk(source_file))
+	{
+		tm_source_file_set_tags(source_file,
+			tm_source_file_parse_agk_buffer(source_file, text_buf, buf_size > 0 ? buf_size : 0));
+		return TRUE;
+	}
+
+	G_LOCK(parse);
+	status = tm_source_file_buffer_parse_locked(source_file, text_buf, buf_size);
+	current_source_file = NULL;
+	G_UNLOCK(parse);
+
+	return status;
+}
+
+/* Searched here rather than with tm_tags_find(), which uses shared state that the main thread
+ may be using while a project index thread parses a file. */
+static gboolean tag_name_matches(GPtrArray *tags_array, gint i, const char *tag_name)
+{
+	return i >= 0 && i < (gint) tags_array->len &&
+		0 == g_ascii_strcasecmp(TM_TAG(tags_array->pdata[i])->name, tag_name);
+}
+
 void tm_source_file_set_tag_arglist(const char *tag_name, const char *arglist)
 {
-	int count;
-	TMTag **tags, *tag;
+	GPtrArray *tags_array;
+	TMTag *tag;
+	gint i;
 
 	if (NULL == arglist ||
 		NULL == tag_name ||
@@ -244,11 +384,17 @@ void tm_source_file_set_tag_arglist(const char *tag_name, const char *arglist)
 		return;
 	}
 
-	tags = tm_tags_find(current_source_file->work_object.tags_array, tag_name, FALSE, FALSE,
-			&count);
-	if (tags != NULL && count == 1)
+	/* the tag added last with this name, if it is the only one there */
+	tags_array = current_source_file->work_object.tags_array;
+	for (i = tags_array->len - 1; i >= 0; i--)
+	{
+		if (tag_name_matches(tags_array, i, tag_name))
+			break;
+	}
+	if (i >= 0 && !tag_name_matches(tags_array, i - 1, tag_name) &&
+		!tag_name_matches(tags_array, i + 1, tag_name))
 	{
-		tag = tags[0];
+		tag = TM_TAG(tags_array->pdata[i]);
 		g_free(tag->atts.entry.arglist);
 		tag->atts.entry.arglist = g_strdup(arglist);
 	}
@@ -273,6 +419,8 @@ gboolean tm_source_file_update(TMWorkObject *source_file, gboolean force
 		tm_source_file_parse(TM_SOURCE_FILE(source_file));
 		tm_tags_sort(source_file->tags_array, NULL, FALSE);
 		/* source_file->analyze_time = tm_get_file_timestamp(source_file->file_name); */
+		if (source_file->parent)
+			tm_workspace_object_changed(source_file);
 		if ((source_file->parent) && update_parent)
 		{
 			tm_work_object_update(source_file->parent, TRUE, FALSE, TRUE);
@@ -298,6 +446,8 @@ gboolean tm_source_file_buffer_update(TMWorkObject *source_file, guchar* text_bu
 	tm_source_file_buffer_parse (TM_SOURCE_FILE(source_file), text_buf, buf_size);
 	tm_tags_sort(source_file->tags_array, NULL, FALSE);
 	/* source_file->analyze_time = time(NULL); */
+	if (source_file->parent)
+		tm_workspace_object_changed(source_file);
 	if ((source_file->parent) && update_parent)
 	{
 #ifdef TM_DEBUG
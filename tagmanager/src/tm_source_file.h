@@ -114,6 +114,17 @@ gboolean tm_source_file_parse(TMSourceFile *source_file);
 */
 gboolean tm_source_file_buffer_parse(TMSourceFile *source_file, guchar* text_buf, gint buf_size);
 
+/* Parses AGK source into a new array of tags without touching global state,
+ so it can be called from any thread.
+ \param source_file The source file the tags will belong to. It is not modified.
+ \param text_buf The text buffer to parse
+ \param buf_size The size of text_buf.
+ \return A new array of unsorted tags.
+ \sa tm_source_file_buffer_parse()
+*/
+GPtrArray *tm_source_file_parse_agk_buffer(TMSourceFile *source_file, const guchar *text_buf,
+	gsize buf_size);
+
 /*
  This function is registered into the ctags parser when a file is parsed for
  the first time. The function is then called by the ctags parser each time
@@ -210,7 +210,107 @@ static char get_tag_access(const char *access)
 	return TAG_ACCESS_UNKNOWN;
 }
 
-gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_entry)
+/* Tag arenas.
+ A tag allocated from an arena holds a reference to the arena instead of being
+ freed on its own, and its strings come from the arena's string chunk. Variable
+ types, scopes and parent classes have few distinct values, so they are
+ interned once for all tags instead, which also lets tm_tag_compare() compare
+ them by pointer. */
+#define TM_TAG_ARENA_MIN_BLOCK 16
+#define TM_TAG_ARENA_MAX_BLOCK 1024
+
+struct _TMTagArena
+{
+	gint refcount;	/* one for the creator and one for each tag alive */
+	GSList *blocks;	/* arrays of tags, the first one being filled */
+	guint block_size;
+	guint block_used;
+	GStringChunk *strings;
+};
+
+G_LOCK_DEFINE_STATIC(intern);
+static GStringChunk *s_interned = NULL;
+
+const char *tm_tag_intern(const char *str)
+{
+	const char *result;
+
+	if (NULL == str)
+		return NULL;
+	G_LOCK(intern);
+	if (NULL == s_interned)
+		s_interned = g_string_chunk_new(4096);
+	result = g_string_chunk_insert_const(s_interned, str);
+	G_UNLOCK(intern);
+	return result;
+}
+
+TMTagArena *tm_tag_arena_new(void)
+{
+	TMTagArena *arena = g_new0(TMTagArena, 1);
+
+	arena->refcount = 1;
+	arena->strings = g_string_chunk_new(1024);
+	return arena;
+}
+
+static void tm_tag_arena_unref(TMTagArena *arena)
+{
+	if (g_atomic_int_dec_and_test(&arena->refcount))
+	{
+		g_slist_foreach(arena->blocks, (GFunc) g_free, NULL);
+		g_slist_free(arena->blocks);
+		g_string_chunk_free(arena->strings);
+		g_free(arena);
+	}
+}
+
+void tm_tag_arena_release(TMTagArena *arena)
+{
+	if (arena)
+		tm_tag_arena_unref(arena);
+}
+
+/* small files get small blocks, the blocks grow with the number of tags */
+static TMTag *tm_tag_arena_alloc(TMTagArena *arena)
+{
+	TMTag *tag;
+
+	if (NULL == arena->blocks || arena->block_used == arena->block_size)
+	{
+		arena->block_size = arena->blocks ?
+			MIN(arena->block_size * 2, TM_TAG_ARENA_MAX_BLOCK) : TM_TAG_ARENA_MIN_BLOCK;
+		arena->blocks = g_slist_prepend(arena->blocks, g_new0(TMTag, arena->block_size));
+		arena->block_used = 0;
+	}
+	tag = (TMTag *) arena->blocks->data + arena->block_used++;
+	tag->refcount = 1;
+	tag->static_strings = TRUE;
+	tag->arena = arena;
+	g_atomic_int_inc(&arena->refcount);
+	return tag;
+}
+
+static char *tm_tag_arena_strdup(TMTagArena *arena, const char *str)
+{
+	if (NULL == str)
+		return NULL;
+	if (NULL == arena)
+		return g_strdup(str);
+	return g_string_chunk_insert_const(arena->strings, str);
+}
+
+static char *tm_tag_intern_strdup(TMTagArena *arena, const char *str)
+{
+	if (NULL == str)
+		return NULL;
+	if (NULL == arena)
+		return g_strdup(str);
+	return (char *) tm_tag_intern(str);
+}
+
+static gboolean tm_tag_init_full(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_entry,
+	TMTagArena *arena)
 {
 	tag->refcount = 1;
 	if (NULL == tag_entry)
@@ -220,7 +320,7 @@ gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_ent
 			return FALSE;
 		else
 		{
-			tag->name = g_strdup(file->work_object.file_name);
+			tag->name = tm_tag_arena_strdup(arena, file->work_object.file_name);
 			tag->type = tm_tag_file_t;
 			/* tag->atts.file.timestamp = file->work_object.analyze_time; */
 			tag->atts.file.lang = file->lang;
@@ -233,22 +333,22 @@ gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_ent
 		/* This is a normal tag entry */
 		if (NULL == tag_entry->name)
 			return FALSE;
-		tag->name = g_strdup(tag_entry->name);
+		tag->name = tm_tag_arena_strdup(arena, tag_entry->name);
 		tag->type = get_tag_type(tag_entry->kindName);
 		tag->atts.entry.local = tag_entry->isFileScope;
 		tag->atts.entry.pointerOrder = 0;	/* backward compatibility (use var_type instead) */
 		tag->atts.entry.line = tag_entry->lineNumber;
 		if (NULL != tag_entry->extensionFields.arglist)
-			tag->atts.entry.arglist = g_strdup(tag_entry->extensionFields.arglist);
+			tag->atts.entry.arglist = tm_tag_arena_strdup(arena, tag_entry->extensionFields.arglist);
 		if ((NULL != tag_entry->extensionFields.scope[1]) &&
 			(isalpha(tag_entry->extensionFields.scope[1][0]) ||
 			 tag_entry->extensionFields.scope[1][0] == '_' ||
 			 tag_entry->extensionFields.scope[1][0] == '$'))
-			tag->atts.entry.scope = g_strdup(tag_entry->extensionFields.scope[1]);
+			tag->atts.entry.scope = tm_tag_intern_strdup(arena, tag_entry->extensionFields.scope[1]);
 		if (tag_entry->extensionFields.inheritance != NULL)
-			tag->atts.entry.inheritance = g_strdup(tag_entry->extensionFields.inheritance);
+			tag->atts.entry.inheritance = tm_tag_intern_strdup(arena, tag_entry->extensionFields.inheritance);
 		if (tag_entry->extensionFields.varType != NULL)
-			tag->atts.entry.var_type = g_strdup(tag_entry->extensionFields.varType);
+			tag->atts.entry.var_type = tm_tag_intern_strdup(arena, tag_entry->extensionFields.varType);
 		if (tag_entry->extensionFields.access != NULL)
 			tag->atts.entry.access = get_tag_access(tag_entry->extensionFields.access);
 		if (tag_entry->extensionFields.implementation != NULL)
@@ -260,6 +360,42 @@ gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_ent
 	}
 }
 
+gboolean tm_tag_init(TMTag *tag, TMSourceFile *file, const tagEntryInfo *tag_entry)
+{
+	tag->refcount = 1;
+	return tm_tag_init_full(tag, file, tag_entry, NULL);
+}
+
+TMTag *tm_tag_arena_new_tag(TMTagArena *arena, TMSourceFile *file, const tagEntryInfo *tag_entry)
+{
+	TMTag *tag = tm_tag_arena_alloc(arena);
+
+	if (FALSE == tm_tag_init_full(tag, file, tag_entry, arena))
+	{
+		/* the slot is simply left unused */
+		tm_tag_arena_unref(arena);
+		return NULL;
+	}
+	return tag;
+}
+
+TMTag *tm_tag_arena_copy_tag(TMTagArena *arena, const TMTag *tag)
+{
+	TMTag *copy = tm_tag_arena_alloc(arena);
+
+	copy->name = tm_tag_arena_strdup(arena, tag->name);
+	copy->type = tag->type;
+	copy->atts = tag->atts;
+	if (tm_tag_file_t != tag->type)
+	{
+		copy->atts.entry.arglist = tm_tag_arena_strdup(arena, tag->atts.entry.arglist);
+		copy->atts.entry.scope = tm_tag_intern_strdup(arena, tag->atts.entry.scope);
+		copy->atts.entry.inheritance = tm_tag_intern_strdup(arena, tag->atts.entry.inheritance);
+		copy->atts.entry.var_type = tm_tag_intern_strdup(arena, tag->atts.entry.var_type);
+	}
+	return copy;
+}
+
 TMTag *tm_tag_new(TMSourceFile *file, const tagEntryInfo *tag_entry)
 {
 	TMTag *tag;
@@ -273,6 +409,16 @@ TMTag *tm_tag_new(TMSourceFile *file, const tagEntryInfo *tag_entry)
 	return tag;
 }
 
+TMTag *tm_tag_new_static(void)
+{
+	TMTag *tag;
+
+	TAG_NEW(tag);
+	tag->refcount = 1;
+	tag->static_strings = TRUE;
+	return tag;
+}
+
 gboolean tm_tag_init_from_file(TMTag *tag, TMSourceFile *file, FILE *fp)
 {
 	guchar buf[BUFSIZ];
@@ -634,6 +780,8 @@ gboolean tm_tag_write(TMTag *tag, FILE *fp, guint attrs)
 
 static void tm_tag_destroy(TMTag *tag)
 {
+	if (tag->static_strings)
+		return;
 	g_free(tag->name);
 	if (tm_tag_file_t != tag->type)
 	{
@@ -657,8 +805,13 @@ void tm_tag_unref(TMTag *tag)
 	 * drop-in replacment of it */
 	if (NULL != tag && g_atomic_int_dec_and_test(&tag->refcount))
 	{
-		tm_tag_destroy(tag);
-		TAG_FREE(tag);
+		if (tag->arena)
+			tm_tag_arena_unref(tag->arena);
+		else
+		{
+			tm_tag_destroy(tag);
+			TAG_FREE(tag);
+		}
 	}
 }
 
@@ -724,12 +877,56 @@ int tm_str_ncmp_case( const char* s1, const char* s2, int len )
 	else return 0;
 }
 
+/* The length of a tag name for comparisons, which ignore any array size appended to it */
+static gsize tm_tag_name_length(const char *name)
+{
+	const char *bracket = strchr(name, '[');
+	gsize len;
+
+	if (NULL == bracket)
+		return strlen(name);
+	len = bracket - name;
+	while (len > 1 && isspace((guchar) name[len - 1]))
+		len--;
+	return len;
+}
+
+/* Compares tag names case insensitively and without their array sizes, like
+ * strcmp() on lower case copies of them but without making the copies.
+ * If partial is set, s1 only has to be a prefix of s2. */
+static int tm_tag_name_compare(const char *s1, const char *s2, gboolean partial)
+{
+	gsize len1 = tm_tag_name_length(s1);
+	gsize len2 = tm_tag_name_length(s2);
+	gsize i;
+
+	for (i = 0; i < len1; ++i)
+	{
+		guchar c1 = (guchar) g_ascii_tolower(s1[i]);
+		guchar c2 = (i < len2) ? (guchar) g_ascii_tolower(s2[i]) : 0;
+
+		if (c1 != c2)
+			return (c1 < c2) ? -1 : 1;
+	}
+	/* s1 is a prefix of s2 */
+	return (partial || len1 == len2) ? 0 : -1;
+}
+
+/* Interned strings are equal if they are the same pointer */
+static int tm_tag_string_compare(const char *s1, const char *s2)
+{
+	if (s1 == s2)
+		return 0;
+	return strcmp(FALLBACK(s1, ""), FALLBACK(s2, ""));
+}
+
 int tm_tag_compare(const void *ptr1, const void *ptr2)
 {
 	unsigned int *sort_attr;
 	int returnval = 0;
 	TMTag *t1 = *((TMTag **) ptr1);
 	TMTag *t2 = *((TMTag **) ptr2);
+	const char *s1, *s2;
 
 	if ((NULL == t1) || (NULL == t2))
 	{
@@ -737,101 +934,51 @@ int tm_tag_compare(const void *ptr1, const void *ptr2)
 		return t2 - t1;
 	}
 
-	int ignoreCase = 1;
-	
-	char* s1 = g_strdup(t1->name ? t1->name : "");
-	char* s2 = g_strdup(t2->name ? t2->name : "");
-
-	// ignore any array size appended to the name
-	char* bracket = strchr(s1,'[');
-	if ( bracket ) 
-	{
-		*bracket = 0;
-		bracket--;
-		while( isspace(*bracket) && bracket > s1 )
-		{
-			*bracket = 0;
-			bracket--;
-		}
-	}
-
-	bracket = strchr(s2,'[');
-	if ( bracket ) 
-	{
-		*bracket = 0;
-		bracket--;
-		while( isspace(*bracket) && bracket > s2 )
-		{
-			*bracket = 0;
-			bracket--;
-		}
-	}
-
-	if ( ignoreCase )
-	{
-		toLowerString(s1);
-		toLowerString(s2);
-	}
+	/* names are compared case insensitively */
+	s1 = t1->name ? t1->name : "";
+	s2 = t2->name ? t2->name : "";
 
 	if (NULL == s_sort_attrs)
-	{
-		if (s_partial)
-			returnval = strncmp(s1, s2, strlen(s1));
-		else
-			returnval = strcmp(s1,s2);
-
-		goto cleanup_and_return;
-	}
+		return tm_tag_name_compare(s1, s2, s_partial);
 
 	for (sort_attr = s_sort_attrs; *sort_attr != tm_tag_attr_none_t; ++ sort_attr)
 	{
 		switch (*sort_attr)
 		{
 			case tm_tag_attr_name_t:
-				if (s_partial)
-					returnval = strncmp(s1, s2, strlen(s1));
-				else
-					returnval = strcmp(s1,s2);
-				
-				if (0 != returnval) 
-					goto cleanup_and_return;
+				if (0 != (returnval = tm_tag_name_compare(s1, s2, s_partial)))
+					return returnval;
 				break;
 			case tm_tag_attr_type_t:
 				if (0 != (returnval = (t1->type - t2->type)))
-					goto cleanup_and_return;
+					return returnval;
 				break;
 			case tm_tag_attr_file_t:
 				if (0 != (returnval = (t1->atts.entry.file - t2->atts.entry.file)))
-					goto cleanup_and_return;
+					return returnval;
 				break;
 			case tm_tag_attr_scope_t:
-				if (0 != (returnval = strcmp(FALLBACK(t1->atts.entry.scope, ""), FALLBACK(t2->atts.entry.scope, ""))))
-					goto cleanup_and_return;
+				if (0 != (returnval = tm_tag_string_compare(t1->atts.entry.scope, t2->atts.entry.scope)))
+					return returnval;
 				break;
 			case tm_tag_attr_arglist_t:
-				if (0 != (returnval = strcmp(FALLBACK(t1->atts.entry.arglist, ""), FALLBACK(t2->atts.entry.arglist, ""))))
+				if (0 != (returnval = tm_tag_string_compare(t1->atts.entry.arglist, t2->atts.entry.arglist)))
 				{
 					int line_diff = (t1->atts.entry.line - t2->atts.entry.line);
 
-					g_free(s1);
-					g_free(s2);
 					return line_diff ? line_diff : returnval;
 				}
 				break;
 			case tm_tag_attr_vartype_t:
-				if (0 != (returnval = strcmp(FALLBACK(t1->atts.entry.var_type, ""), FALLBACK(t2->atts.entry.var_type, ""))))
-					goto cleanup_and_return;
+				if (0 != (returnval = tm_tag_string_compare(t1->atts.entry.var_type, t2->atts.entry.var_type)))
+					return returnval;
 				break;
 			case tm_tag_attr_line_t:
 				if (0 != (returnval = (t1->atts.entry.line - t2->atts.entry.line)))
-					goto cleanup_and_return;
+					return returnval;
 				break;
 		}
 	}
-
-cleanup_and_return:
-	g_free(s1);
-	g_free(s2);
 	return returnval;
 }
 
@@ -927,6 +1074,84 @@ gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 	return TRUE;
 }
 
+/* orders the heap of tm_tags_merge_sorted() by the next tag of each array,
+ * and equal tags by array index */
+static gint tm_tags_heap_compare(GPtrArray **arrays, guint *pos, guint a, guint b)
+{
+	gint cmp = tm_tag_compare(&arrays[a]->pdata[pos[a]], &arrays[b]->pdata[pos[b]]);
+
+	return cmp ? cmp : (gint) a - (gint) b;
+}
+
+static void tm_tags_heap_sift_down(guint *heap, guint heap_len, GPtrArray **arrays,
+	guint *pos, guint i)
+{
+	for (;;)
+	{
+		guint child = 2 * i + 1, top = heap[i];
+
+		if (child >= heap_len)
+			break;
+		if (child + 1 < heap_len &&
+			tm_tags_heap_compare(arrays, pos, heap[child + 1], heap[child]) < 0)
+			child++;
+		if (tm_tags_heap_compare(arrays, pos, top, heap[child]) <= 0)
+			break;
+		heap[i] = heap[child];
+		heap[child] = top;
+		i = child;
+	}
+}
+
+/* Merges arrays which are each sorted on sort_attributes into tags_array,
+ * replacing its contents. This is a k-way merge, so it only needs
+ * O(n log k) comparisons instead of sorting all n tags again.
+ * Tags from one array keep their order, so each array stays a subsequence
+ * of the result.
+ * tags_array: array receiving the merged tags, must not be one of arrays.
+ * arrays: count arrays of sorted tags. */
+gboolean tm_tags_merge_sorted(GPtrArray *tags_array, GPtrArray **arrays, guint count,
+	TMTagAttrType *sort_attributes)
+{
+	guint *heap, *pos;
+	guint heap_len = 0, len = 0, i;
+
+	if (!tags_array)
+		return FALSE;
+	for (i = 0; i < count; ++i)
+		len += arrays[i] ? arrays[i]->len : 0;
+	g_ptr_array_set_size(tags_array, len);
+	if (!len)
+		return TRUE;
+
+	heap = g_new(guint, count);
+	pos = g_new0(guint, count);
+	for (i = 0; i < count; ++i)
+	{
+		if (arrays[i] && arrays[i]->len)
+			heap[heap_len++] = i;
+	}
+	s_sort_attrs = sort_attributes;
+	s_partial = FALSE;
+	for (i = heap_len / 2; i > 0; --i)
+		tm_tags_heap_sift_down(heap, heap_len, arrays, pos, i - 1);
+
+	for (i = 0; i < len; ++i)
+	{
+		guint top = heap[0];
+
+		tags_array->pdata[i] = arrays[top]->pdata[pos[top]++];
+		if (pos[top] == arrays[top]->len)
+			heap[0] = heap[--heap_len];
+		if (heap_len > 1)
+			tm_tags_heap_sift_down(heap, heap_len, arrays, pos, 0);
+	}
+	s_sort_attrs = NULL;
+	g_free(heap);
+	g_free(pos);
+	return TRUE;
+}
+
 gboolean tm_tags_sort(GPtrArray *tags_array, TMTagAttrType *sort_attributes, gboolean dedup)
 {
 	if ((!tags_array) || (!tags_array->len))
@@ -113,6 +113,9 @@ typedef enum
 #define TAG_IMPL_VIRTUAL 'v' /*!< Virtual implementation */
 #define TAG_IMPL_UNKNOWN 'x' /*!< Unknown implementation */
 
+/*! An arena tags can be allocated from, see tm_tag_arena_new() */
+typedef struct _TMTagArena TMTagArena;
+
 /*!
  This structure holds all information about a tag, including the file
  pseudo tag. It should always be created indirectly with one of the tag
@@ -149,6 +152,8 @@ typedef struct _TMTag
 		} file;
 	} atts;
 	gint refcount; /*!< the reference count of the tag */
+	gboolean static_strings; /*!< Whether the strings belong to something else (e.g. a tag cache) and aren't freed with the tag */
+	TMTagArena *arena; /*!< The arena the tag was allocated from, or NULL */
 } TMTag;
 
 typedef enum {
@@ -214,6 +219,46 @@ gboolean tm_tag_init_from_file_ctags(TMTag *tag, TMSourceFile *file, FILE *fp);
 */
 TMTag *tm_tag_new(TMSourceFile *file, const tagEntryInfo *tag_entry);
 
+/*!
+ Creates an empty tag with a reference count of one, to be filled in by the caller.
+ The strings of the tag are not freed with it, so they must outlive the tag.
+ \return the new TMTag structure. This should be free()-ed using tm_tag_unref()
+*/
+TMTag *tm_tag_new_static(void);
+
+/*!
+ Creates a tag arena. Tags allocated from an arena share its memory blocks
+ and string pool, and everything is freed at once when the last of them is
+ unreferenced and the arena itself has been released.
+ \return the new arena. Release it with tm_tag_arena_release() once all tags are allocated.
+*/
+TMTagArena *tm_tag_arena_new(void);
+
+/*!
+ Same as tm_tag_new() except that the tag and its strings are allocated from arena.
+ An arena is not thread safe, but different arenas can be used on different threads.
+*/
+TMTag *tm_tag_arena_new_tag(TMTagArena *arena, TMSourceFile *file, const tagEntryInfo *tag_entry);
+
+/*!
+ Copies a tag into arena.
+ \return the new tag, with a reference count of one.
+*/
+TMTag *tm_tag_arena_copy_tag(TMTagArena *arena, const TMTag *tag);
+
+/*!
+ Drops the reference to arena held by its creator. The arena is freed when its
+ tags have been unreferenced too.
+*/
+void tm_tag_arena_release(TMTagArena *arena);
+
+/*!
+ Returns a copy of str from a string pool shared by all tags, which is only
+ freed with the program. Only meant for strings with few distinct values,
+ such as variable types and scopes. Equal strings share one pointer.
+*/
+const char *tm_tag_intern(const char *str);
+
 /*!
  Same as tm_tag_new() except that the tag attributes are read from file.
  \param mode langType to use for the tag.
@@ -239,6 +284,18 @@ int tm_tag_compare(const void *ptr1, const void *ptr2);
 gboolean tm_tags_merge(GPtrArray *tags_array, gsize orig_len,
 	TMTagAttrType *sort_attributes, gboolean dedup);
 
+/*!
+ Merges arrays of tags which are each already sorted on sort_attributes.
+ \param tags_array The array receiving the merged tags. Its contents are replaced.
+ It must not be one of the merged arrays.
+ \param arrays The sorted arrays to merge. Each stays a subsequence of the result.
+ \param count The number of arrays.
+ \param sort_attributes Attributes the arrays are sorted on (int array terminated by 0)
+ \return TRUE on success, FALSE on failure
+*/
+gboolean tm_tags_merge_sorted(GPtrArray *tags_array, GPtrArray **arrays, guint count,
+	TMTagAttrType *sort_attributes);
+
 /*!
  Sort an array of tags on the specified attribuites using the inbuilt comparison
  function.
@@ -36,11 +36,17 @@
 #include "tm_tag.h"
 #include "tm_workspace.h"
 #include "tm_project.h"
+#include "tm_source_file.h"
 
 
 static TMWorkspace *theWorkspace = NULL;
 guint workspace_class_id = 0;
 
+static void tm_index_free(void);
+static void tm_workspace_runs_free(void);
+static void tm_workspace_update_tags_array(gboolean all);
+static void tm_completion_free(void);
+
 static gboolean tm_create_workspace(void)
 {
 	workspace_class_id = tm_work_object_register(tm_workspace_free, tm_workspace_update
@@ -73,6 +79,9 @@ void tm_workspace_free(gpointer workspace)
 
 	if (theWorkspace)
 	{
+		tm_completion_free();
+		tm_workspace_runs_free();
+		tm_index_free();
 		if (theWorkspace->work_objects)
 		{
 			for (i=0; i < theWorkspace->work_objects->len; ++i)
@@ -106,6 +115,7 @@ gboolean tm_workspace_add_object(TMWorkObject *work_object)
 	if (NULL == theWorkspace->work_objects)
 		theWorkspace->work_objects = g_ptr_array_new();
 	g_ptr_array_add(theWorkspace->work_objects, work_object);
+	tm_workspace_object_changed(work_object);
 	work_object->parent = TM_WORK_OBJECT(theWorkspace);
 	return TRUE;
 }
@@ -122,6 +132,7 @@ gboolean tm_workspace_remove_object(TMWorkObject *w, gboolean do_free, gboolean
 	{
 		if (theWorkspace->work_objects->pdata[i] == w)
 		{
+			tm_workspace_object_changed(w);
 			if (do_free)
 				tm_work_object_free(w);
 			g_ptr_array_remove_index_fast(theWorkspace->work_objects, i);
@@ -140,12 +151,15 @@ static TMTagAttrType global_tags_sort_attrs[] =
 	tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0
 };
 
+static guint global_tags_generation = 1;	/* changes whenever global_tags changes */
+
 gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode)
 {
 	gsize orig_len;
 	guchar buf[BUFSIZ];
 	FILE *fp;
 	TMTag *tag;
+	TMTagArena *arena;
 	TMFileFormat format = TM_FILE_FORMAT_TAGMANAGER;
 
 	if (NULL == theWorkspace)
@@ -189,12 +203,19 @@ gboolean tm_workspace_load_global_tags(const char *tags_file, gint mode)
 		}
 		rewind(fp); /* reset the file pointer, to start reading again from the beginning */
 	}
+	/* the global tags stay loaded, so they are packed into an arena */
+	arena = tm_tag_arena_new();
 	while (NULL != (tag = tm_tag_new_from_file(NULL, fp, mode, format)))
-		g_ptr_array_add(theWorkspace->global_tags, tag);
+	{
+		g_ptr_array_add(theWorkspace->global_tags, tm_tag_arena_copy_tag(arena, tag));
+		tm_tag_unref(tag);
+	}
+	tm_tag_arena_release(arena);
 	fclose(fp);
 
 	/* reorder the whole array, because tm_tags_find expects a sorted array */
 	tm_tags_merge(theWorkspace->global_tags, orig_len, global_tags_sort_attrs, TRUE);
+	global_tags_generation++;
 	return TRUE;
 }
 
@@ -483,46 +504,893 @@ TMWorkObject *tm_workspace_find_object(TMWorkObject *work_object, const char *fi
 	return NULL;
 }
 
-void tm_workspace_recreate_tags_array(void)
+/* Project index.
+ Files added with tm_workspace_index_add_file() are parsed by background
+ threads, and their tags are merged into the workspace tags array
+ from the main loop. That way tm_workspace_find() also finds tags of files
+ that are not open. Only the tags of indexed files are kept, not their
+ contents. Indexed files that are open as work objects are skipped when
+ merging, because their tags come from the (possibly unsaved) buffer instead.
+
+ The tags of indexed files can be saved to a cache file and loaded back from
+ it, so that files which haven't changed since don't need to be parsed again. */
+
+/* Tag cache file layout, in native byte order: a header, the file records, the
+ tag records and a string table. Strings are offsets into the string table, with
+ 0 meaning NULL. The file is mapped into memory and tags loaded from it point
+ into the string table instead of copying their strings. */
+#define TM_CACHE_MAGIC "TMCACHE"
+#define TM_CACHE_VERSION 1
+
+typedef struct
 {
-	guint i, j;
-	TMWorkObject *w;
-	TMTagAttrType sort_attrs[] = { tm_tag_attr_name_t, tm_tag_attr_file_t
-		, tm_tag_attr_scope_t, tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0};
+	gchar magic[8];
+	guint32 version;
+	guint32 byte_order;
+	guint32 file_record_size;	/* sizeof(TMCacheFile), catches layout changes */
+	guint32 tag_record_size;	/* sizeof(TMCacheTag) */
+	guint32 file_count;
+	guint32 tag_count;
+	guint32 strings_size;
+	guint32 reserved;
+} TMCacheHeader;
+
+typedef struct
+{
+	gint64 mtime;
+	gint64 size;
+	guint64 hash;	/* of the file contents, see tm_index_hash_file() */
+	guint32 path;	/* real path */
+	guint32 lang;	/* language name */
+	guint32 first_tag;
+	guint32 tag_count;	/* the tags are sorted with tm_tags_sort() */
+} TMCacheFile;
+
+typedef struct
+{
+	guint32 name;
+	guint32 arglist;
+	guint32 scope;
+	guint32 inheritance;
+	guint32 var_type;
+	guint32 type;
+	guint32 line;
+	guint32 pointer_order;
+	guint8 local;
+	gchar access;
+	gchar impl;
+	guint8 reserved;
+} TMCacheTag;
+
+/* A loaded cache file. It is kept alive by the tags loaded from it. */
+typedef struct
+{
+	GMappedFile *map;
+	gchar *contents;	/* when not mapped */
+	const TMCacheHeader *header;
+	const TMCacheFile *files;
+	const TMCacheTag *tags;
+	const gchar *strings;
+	gint refcount;
+} TMCache;
+
+/* A file in a loaded cache which hasn't been indexed yet */
+typedef struct
+{
+	TMCache *cache;
+	const TMCacheFile *file;
+} TMCacheRef;
 
-#ifdef TM_DEBUG
-	g_message("Recreating workspace tags array");
+typedef struct
+{
+	TMSourceFile *source_file;	/* NULL until first parsed */
+	TMCache *cache;	/* set if the tags of source_file were loaded from it */
+	time_t mtime;
+	gint64 size;
+	guint64 hash;
+	guint generation;	/* changed whenever the file is queued again or removed */
+} TMIndexEntry;
+
+typedef struct
+{
+	TMSourceFile *source_file;	/* created on the main thread, parsed on an index thread */
+	TMCache *cache;
+	const TMCacheFile *cached;	/* NULL if the tags don't come from the cache */
+	time_t mtime;
+	gint64 size;
+	guint64 hash;
+	guint generation;
+} TMIndexJob;
+
+static GHashTable *index_entries = NULL;	/* real path -> TMIndexEntry, main thread only */
+static GHashTable *index_cache = NULL;	/* real path -> TMCacheRef, main thread only */
+static GThreadPool *index_pool = NULL;
+static GAsyncQueue *index_done = NULL;
+static gint index_merge_queued = 0;
+static guint index_generation = 0;
+static TMIndexUpdateFunc index_update_func = NULL;
+static gpointer index_update_data = NULL;
+
+
+static TMCache *tm_cache_ref(TMCache *cache)
+{
+	g_atomic_int_inc(&cache->refcount);
+	return cache;
+}
+
+static void tm_cache_unref(TMCache *cache)
+{
+	if (NULL != cache && g_atomic_int_dec_and_test(&cache->refcount))
+	{
+		if (cache->map)
+#if GLIB_CHECK_VERSION(2, 22, 0)
+			g_mapped_file_unref(cache->map);
+#else
+			g_mapped_file_free(cache->map);
 #endif
+		g_free(cache->contents);
+		g_free(cache);
+	}
+}
 
-	if ((NULL == theWorkspace) || (NULL == theWorkspace->work_objects))
-		return;
-	if (NULL != theWorkspace->work_object.tags_array)
-		g_ptr_array_set_size(theWorkspace->work_object.tags_array, 0);
+static void tm_cache_ref_free(gpointer data)
+{
+	TMCacheRef *ref = data;
+
+	tm_cache_unref(ref->cache);
+	g_free(ref);
+}
+
+#define TM_CACHE_STRING(cache, offset) ((offset) ? (gchar *) (cache)->strings + (offset) : NULL)
+
+/* Replaces the tags of source_file with the tags of a file in the cache */
+static void tm_index_load_cached(TMSourceFile *source_file, TMCache *cache, const TMCacheFile *cached)
+{
+	GPtrArray *tags_array = g_ptr_array_sized_new(cached->tag_count);
+	guint i;
+
+	for (i = 0; i < cached->tag_count; ++i)
+	{
+		const TMCacheTag *record = &cache->tags[cached->first_tag + i];
+		TMTag *tag = tm_tag_new_static();
+
+		tag->name = TM_CACHE_STRING(cache, record->name);
+		tag->type = (TMTagType) record->type;
+		tag->atts.entry.file = source_file;
+		tag->atts.entry.line = record->line;
+		tag->atts.entry.local = record->local;
+		tag->atts.entry.pointerOrder = record->pointer_order;
+		tag->atts.entry.arglist = TM_CACHE_STRING(cache, record->arglist);
+		tag->atts.entry.scope = TM_CACHE_STRING(cache, record->scope);
+		tag->atts.entry.inheritance = TM_CACHE_STRING(cache, record->inheritance);
+		tag->atts.entry.var_type = TM_CACHE_STRING(cache, record->var_type);
+		tag->atts.entry.access = record->access;
+		tag->atts.entry.impl = record->impl;
+		g_ptr_array_add(tags_array, tag);
+	}
+
+	if (source_file->work_object.tags_array)
+		tm_tags_array_free(source_file->work_object.tags_array, TRUE);
+	source_file->work_object.tags_array = tags_array;
+}
+
+/* FNV-1a over the contents of a file */
+static gboolean tm_index_hash_file(const char *file_name, guint64 *hash)
+{
+	guchar buf[65536];
+	size_t n, i;
+	FILE *fp = g_fopen(file_name, "rb");
+
+	*hash = G_GUINT64_CONSTANT(14695981039346656037);
+	if (NULL == fp)
+		return FALSE;
+	while (0 < (n = fread(buf, 1, sizeof buf, fp)))
+	{
+		for (i = 0; i < n; ++i)
+		{
+			*hash ^= buf[i];
+			*hash *= G_GUINT64_CONSTANT(1099511628211);
+		}
+	}
+	n = ferror(fp);
+	fclose(fp);
+	return 0 == n;
+}
+
+static void tm_index_entry_free(gpointer data)
+{
+	TMIndexEntry *entry = data;
+
+	if (entry->source_file)
+		tm_source_file_free(entry->source_file);
+	tm_cache_unref(entry->cache);
+	g_free(entry);
+}
+
+static void tm_index_job_free(TMIndexJob *job)
+{
+	tm_source_file_free(job->source_file);
+	tm_cache_unref(job->cache);
+	g_free(job);
+}
+
+static gboolean tm_index_merge_idle(gpointer UNUSED data)
+{
+	TMIndexJob *job;
+	gboolean changed = FALSE;
+
+	g_atomic_int_set(&index_merge_queued, 0);
+
+	while (NULL != (job = g_async_queue_try_pop(index_done)))
+	{
+		TMIndexEntry *entry = index_entries ? g_hash_table_lookup(index_entries,
+			job->source_file->work_object.file_name) : NULL;
+
+		/* removed or queued again since */
+		if (entry == NULL || entry->generation != job->generation)
+		{
+			tm_index_job_free(job);
+			continue;
+		}
+
+		/* sorting uses shared state, so it is done here rather than on the index
+		 thread. Cached tags were sorted when they were saved. */
+		if (NULL == job->cached)
+		{
+			tm_tags_sort(job->source_file->work_object.tags_array, NULL, FALSE);
+			tm_cache_unref(job->cache);
+			job->cache = NULL;
+		}
+		if (entry->source_file)
+		{
+			tm_workspace_object_changed(TM_WORK_OBJECT(entry->source_file));
+			tm_source_file_free(entry->source_file);
+		}
+		tm_cache_unref(entry->cache);
+		entry->source_file = job->source_file;
+		entry->cache = job->cache;
+		entry->mtime = job->mtime;
+		entry->size = job->size;
+		entry->hash = job->hash;
+		g_free(job);
+		changed = TRUE;
+	}
+
+	if (changed)
+	{
+		tm_workspace_update_tags_array(FALSE);
+		if (index_update_func)
+			index_update_func(index_update_data);
+	}
+	return FALSE;
+}
+
+static void tm_index_job_done(TMIndexJob *job)
+{
+	g_async_queue_push(index_done, job);
+
+	if (g_atomic_int_compare_and_exchange(&index_merge_queued, 0, 1))
+		g_idle_add(tm_index_merge_idle, NULL);
+}
+
+static void tm_index_parse_func(gpointer data, gpointer UNUSED user_data)
+{
+	TMIndexJob *job = data;
+	gboolean hashed = tm_index_hash_file(job->source_file->work_object.file_name, &job->hash);
+
+	/* the file was touched, but its contents are the same as when it was cached */
+	if (job->cached && hashed && job->hash == job->cached->hash)
+		tm_index_load_cached(job->source_file, job->cache, job->cached);
 	else
-		theWorkspace->work_object.tags_array = g_ptr_array_new();
+	{
+		job->cached = NULL;
+		tm_source_file_parse(job->source_file);
+	}
+	tm_index_job_done(job);
+}
 
-#ifdef TM_DEBUG
-	g_message("Total %d objects", theWorkspace->work_objects->len);
+static gint tm_index_thread_count(void)
+{
+	gint count;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	count = g_get_num_processors();
+#else
+	count = 4;
 #endif
-	for (i=0; i < theWorkspace->work_objects->len; ++i)
+	return CLAMP(count, 1, 8);
+}
+
+/* Adds a file to the project index, or parses it again if it has changed
+ since it was last parsed.
+ \param file_name The file name in locale encoding.
+ \param lang_name The language of the file, NULL to detect it from the name.
+ \return TRUE if the file will be (re)parsed.
+*/
+gboolean tm_workspace_index_add_file(const char *file_name, const char *lang_name)
+{
+	TMIndexEntry *entry;
+	TMIndexJob *job;
+	TMCacheRef *cached = NULL;
+	struct stat st;
+	gchar *real_path;
+
+	if (NULL == theWorkspace || NULL == file_name || 0 != g_stat(file_name, &st))
+		return FALSE;
+
+	if (NULL == index_entries)
 	{
-		w = TM_WORK_OBJECT(theWorkspace->work_objects->pdata[i]);
-#ifdef TM_DEBUG
-		g_message("Adding tags of %s", w->file_name);
+		index_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, tm_index_entry_free);
+		index_done = g_async_queue_new();
+		/* AGK files are parsed with the reentrant parser, so several can be
+		 parsed at once; other languages take turns on the ctags parse lock */
+		index_pool = g_thread_pool_new(tm_index_parse_func, NULL, tm_index_thread_count(),
+			FALSE, NULL);
+	}
+	if (NULL == index_pool)
+		return FALSE;
+
+	real_path = tm_get_real_path(file_name);
+	entry = g_hash_table_lookup(index_entries, real_path);
+	if (entry && entry->mtime == st.st_mtime)
+	{
+		g_free(real_path);
+		return FALSE;
+	}
+	if (NULL == entry)
+	{
+		entry = g_new0(TMIndexEntry, 1);
+		g_hash_table_insert(index_entries, g_strdup(real_path), entry);
+	}
+
+	job = g_new0(TMIndexJob, 1);
+	/* created here because registering the work object class and initialising the
+	 language table are not thread safe */
+	job->source_file = TM_SOURCE_FILE(tm_source_file_new(file_name, FALSE, lang_name));
+	if (NULL == job->source_file)
+	{
+		g_free(job);
+		g_free(real_path);
+		return FALSE;
+	}
+	job->mtime = st.st_mtime;
+	job->size = st.st_size;
+	job->generation = entry->generation = ++index_generation;
+	/* marks the entry as up to date, so it isn't queued again until it changes */
+	entry->mtime = st.st_mtime;
+
+	if (index_cache)
+		cached = g_hash_table_lookup(index_cache, real_path);
+	if (cached && cached->file->size == (gint64) st.st_size && (NULL == lang_name ||
+		0 == strcmp(lang_name, cached->cache->strings + cached->file->lang)))
+	{
+		job->cache = tm_cache_ref(cached->cache);
+		job->cached = cached->file;
+		job->hash = cached->file->hash;
+	}
+	if (cached)
+		g_hash_table_remove(index_cache, real_path);
+	g_free(real_path);
+
+	if (job->cached && job->cached->mtime == (gint64) st.st_mtime)
+	{
+		/* unchanged since it was cached */
+		tm_index_load_cached(job->source_file, job->cache, job->cached);
+		tm_index_job_done(job);
+	}
+	else
+		g_thread_pool_push(index_pool, job, NULL);
+	return TRUE;
+}
+
+/* Removes a file from the project index.
+ \param file_name The file name in locale encoding.
+*/
+void tm_workspace_index_remove_file(const char *file_name)
+{
+	TMIndexEntry *entry;
+	gchar *real_path;
+
+	if (NULL == index_entries || NULL == file_name)
+		return;
+
+	real_path = tm_get_real_path(file_name);
+	entry = g_hash_table_lookup(index_entries, real_path);
+	if (entry)
+	{
+		if (entry->source_file)
+			tm_workspace_object_changed(TM_WORK_OBJECT(entry->source_file));
+		g_hash_table_remove(index_entries, real_path);
+		tm_workspace_update_tags_array(FALSE);
+	}
+	g_free(real_path);
+}
+
+/* Sets a function to call from the main loop when indexed files have been
+ parsed and the workspace tags array has been updated with their tags. */
+void tm_workspace_index_set_update_func(TMIndexUpdateFunc func, gpointer user_data)
+{
+	index_update_func = func;
+	index_update_data = user_data;
+}
+
+static gboolean tm_cache_check_string(const TMCacheHeader *header, guint32 offset)
+{
+	return offset < header->strings_size;
+}
+
+/* Loads a tag cache written by tm_workspace_index_save_cache(). The cached tags
+ are used by tm_workspace_index_add_file() for files which haven't changed since.
+ \param cache_file The cache file name in locale encoding.
+ \return TRUE if the cache was loaded, FALSE if it doesn't exist or is invalid.
+ \sa tm_workspace_index_release_cache()
+*/
+gboolean tm_workspace_index_load_cache(const char *cache_file)
+{
+	TMCache *cache = g_new0(TMCache, 1);
+	const TMCacheHeader *header;
+	const gchar *contents;
+	gsize length;
+	guint i;
+
+	if (NULL == theWorkspace || NULL == cache_file)
+	{
+		g_free(cache);
+		return FALSE;
+	}
+
+	cache->refcount = 1;
+#ifdef G_OS_WIN32
+	/* a mapped file can't be replaced on Windows, which would stop the cache
+	 from being saved while its tags are in use */
+	if (! g_file_get_contents(cache_file, &cache->contents, &length, NULL))
+		goto fail;
+	contents = cache->contents;
+#else
+	cache->map = g_mapped_file_new(cache_file, FALSE, NULL);
+	if (NULL == cache->map)
+		goto fail;
+	contents = g_mapped_file_get_contents(cache->map);
+	length = g_mapped_file_get_length(cache->map);
 #endif
-		if ((NULL != w) && (NULL != w->tags_array) && (w->tags_array->len > 0))
+
+	header = (const TMCacheHeader *) contents;
+	if (length < sizeof(TMCacheHeader) || 0 != memcmp(header->magic, TM_CACHE_MAGIC, sizeof header->magic)
+		|| TM_CACHE_VERSION != header->version || G_BYTE_ORDER != header->byte_order
+		|| sizeof(TMCacheFile) != header->file_record_size || sizeof(TMCacheTag) != header->tag_record_size)
+		goto fail;
+	length -= sizeof(TMCacheHeader);
+	if (header->file_count > length / sizeof(TMCacheFile))
+		goto fail;
+	length -= header->file_count * sizeof(TMCacheFile);
+	if (header->tag_count > length / sizeof(TMCacheTag))
+		goto fail;
+	length -= header->tag_count * sizeof(TMCacheTag);
+	if (0 == header->strings_size || length != header->strings_size)
+		goto fail;
+
+	cache->header = header;
+	cache->files = (const TMCacheFile *) (contents + sizeof(TMCacheHeader));
+	cache->tags = (const TMCacheTag *) (cache->files + header->file_count);
+	cache->strings = (const gchar *) (cache->tags + header->tag_count);
+	if ('\0' != cache->strings[header->strings_size - 1])
+		goto fail;
+
+	/* check all offsets once, so the tags can be loaded without checks */
+	for (i = 0; i < header->tag_count; ++i)
+	{
+		const TMCacheTag *tag = &cache->tags[i];
+
+		if (0 == tag->name || ! tm_cache_check_string(header, tag->name)
+			|| ! tm_cache_check_string(header, tag->arglist) || ! tm_cache_check_string(header, tag->scope)
+			|| ! tm_cache_check_string(header, tag->inheritance) || ! tm_cache_check_string(header, tag->var_type))
+			goto fail;
+	}
+	for (i = 0; i < header->file_count; ++i)
+	{
+		const TMCacheFile *file = &cache->files[i];
+
+		if (0 == file->path || ! tm_cache_check_string(header, file->path)
+			|| 0 == file->lang || ! tm_cache_check_string(header, file->lang)
+			|| file->first_tag > header->tag_count || file->tag_count > header->tag_count - file->first_tag)
+			goto fail;
+	}
+
+	if (NULL == index_cache)
+		index_cache = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, tm_cache_ref_free);
+	for (i = 0; i < header->file_count; ++i)
+	{
+		TMCacheRef *ref = g_new(TMCacheRef, 1);
+
+		ref->cache = tm_cache_ref(cache);
+		ref->file = &cache->files[i];
+		g_hash_table_replace(index_cache, (gpointer) (cache->strings + ref->file->path), ref);
+	}
+	tm_cache_unref(cache);
+	return TRUE;
+
+fail:
+	tm_cache_unref(cache);
+	return FALSE;
+}
+
+/* Forgets the cached tags of files that haven't been added to the index since
+ the cache was loaded. */
+void tm_workspace_index_release_cache(void)
+{
+	if (index_cache)
+		g_hash_table_destroy(index_cache);
+	index_cache = NULL;
+}
+
+static guint32 tm_cache_add_string(GString *strings, GHashTable *offsets, const gchar *str)
+{
+	gpointer offset;
+
+	if (NULL == str)
+		return 0;
+	offset = g_hash_table_lookup(offsets, str);
+	if (NULL == offset)
+	{
+		offset = GUINT_TO_POINTER(strings->len);
+		g_string_append_len(strings, str, strlen(str) + 1);
+		g_hash_table_insert(offsets, (gpointer) str, offset);
+	}
+	return GPOINTER_TO_UINT(offset);
+}
+
+/* Saves the tags of the given indexed files to a cache file, which can be loaded
+ with tm_workspace_index_load_cache(). Files which haven't been parsed yet are
+ left out.
+ \param cache_file The cache file name in locale encoding.
+ \param file_names The file names in locale encoding.
+ \return TRUE on success.
+*/
+gboolean tm_workspace_index_save_cache(const char *cache_file, GPtrArray *file_names)
+{
+	TMCacheHeader header;
+	GArray *files, *tags;
+	GString *strings;
+	GHashTable *offsets;
+	gchar *tmp_file;
+	FILE *fp;
+	gboolean ok;
+	guint i, j;
+
+	if (NULL == index_entries || NULL == cache_file || NULL == file_names)
+		return FALSE;
+
+	files = g_array_new(FALSE, TRUE, sizeof(TMCacheFile));
+	tags = g_array_new(FALSE, TRUE, sizeof(TMCacheTag));
+	/* offset 0 is NULL */
+	strings = g_string_new_len("", 1);
+	/* the keys are the strings of the tags and entries, which stay alive meanwhile */
+	offsets = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for (i = 0; i < file_names->len; ++i)
+	{
+		gchar *real_path = tm_get_real_path(file_names->pdata[i]);
+		gpointer key, value;
+		TMIndexEntry *entry;
+		GPtrArray *tags_array;
+		TMCacheFile file;
+
+		if (! g_hash_table_lookup_extended(index_entries, real_path, &key, &value))
 		{
-			for (j = 0; j < w->tags_array->len; ++j)
-			{
-				g_ptr_array_add(theWorkspace->work_object.tags_array,
-					  w->tags_array->pdata[j]);
-			}
+			g_free(real_path);
+			continue;
+		}
+		g_free(real_path);
+		entry = value;
+		if (NULL == entry->source_file)
+			continue;
+
+		memset(&file, 0, sizeof file);
+		file.mtime = entry->mtime;
+		file.size = entry->size;
+		file.hash = entry->hash;
+		file.path = tm_cache_add_string(strings, offsets, key);
+		file.lang = tm_cache_add_string(strings, offsets,
+			tm_source_file_get_lang_name(entry->source_file->lang));
+		file.first_tag = tags->len;
+
+		tags_array = entry->source_file->work_object.tags_array;
+		for (j = 0; tags_array && j < tags_array->len; ++j)
+		{
+			TMTag *tag = tags_array->pdata[j];
+			TMCacheTag record;
+
+			if (NULL == tag->name || tm_tag_file_t == tag->type)
+				continue;
+
+			memset(&record, 0, sizeof record);
+			record.name = tm_cache_add_string(strings, offsets, tag->name);
+			record.arglist = tm_cache_add_string(strings, offsets, tag->atts.entry.arglist);
+			record.scope = tm_cache_add_string(strings, offsets, tag->atts.entry.scope);
+			record.inheritance = tm_cache_add_string(strings, offsets, tag->atts.entry.inheritance);
+			record.var_type = tm_cache_add_string(strings, offsets, tag->atts.entry.var_type);
+			record.type = tag->type;
+			record.line = tag->atts.entry.line;
+			record.pointer_order = tag->atts.entry.pointerOrder;
+			record.local = tag->atts.entry.local ? 1 : 0;
+			record.access = tag->atts.entry.access;
+			record.impl = tag->atts.entry.impl;
+			g_array_append_val(tags, record);
 		}
+		file.tag_count = tags->len - file.first_tag;
+		if (0 == file.lang)
+			g_array_set_size(tags, file.first_tag);
+		else
+			g_array_append_val(files, file);
+	}
+	g_hash_table_destroy(offsets);
+
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, TM_CACHE_MAGIC, sizeof header.magic);
+	header.version = TM_CACHE_VERSION;
+	header.byte_order = G_BYTE_ORDER;
+	header.file_record_size = sizeof(TMCacheFile);
+	header.tag_record_size = sizeof(TMCacheTag);
+	header.file_count = files->len;
+	header.tag_count = tags->len;
+	header.strings_size = strings->len;
+
+	/* written to a temporary file first, so a cache in use is never left half written */
+	tmp_file = g_strconcat(cache_file, ".tmp", NULL);
+	fp = g_fopen(tmp_file, "wb");
+	ok = (NULL != fp);
+	if (ok)
+	{
+		ok = (1 == fwrite(&header, sizeof header, 1, fp))
+			&& (files->len == fwrite(files->data, sizeof(TMCacheFile), files->len, fp))
+			&& (tags->len == fwrite(tags->data, sizeof(TMCacheTag), tags->len, fp))
+			&& (1 == fwrite(strings->str, strings->len, 1, fp));
+		ok = (0 == fclose(fp)) && ok;
+		ok = ok && (0 == g_rename(tmp_file, cache_file));
+		if (! ok)
+			g_unlink(tmp_file);
 	}
+	g_free(tmp_file);
+
+	g_array_free(files, TRUE);
+	g_array_free(tags, TRUE);
+	g_string_free(strings, TRUE);
+	return ok;
+}
+
+static void tm_index_free(void)
+{
+	TMIndexJob *job;
+
+	tm_workspace_index_release_cache();
+	if (NULL == index_entries)
+		return;
+
+	/* parses in progress are finished, queued files are dropped */
+	if (index_pool)
+		g_thread_pool_free(index_pool, TRUE, TRUE);
+	index_pool = NULL;
+	while (NULL != (job = g_async_queue_try_pop(index_done)))
+		tm_index_job_free(job);
+	g_async_queue_unref(index_done);
+	index_done = NULL;
+	g_hash_table_destroy(index_entries);
+	index_entries = NULL;
+}
+
+/* Workspace tags array.
+ The tags of each work object and indexed file are kept as a sorted run,
+ which holds a reference to each of its tags. The workspace tags array is
+ the merge of all runs. When the tags of one work object change, its old run
+ is removed from the array and its new run merged in, both in linear time,
+ so the tags of the other files don't have to be sorted again. */
+static TMTagAttrType workspace_sort_attrs[] =
+{
+	tm_tag_attr_name_t, tm_tag_attr_file_t, tm_tag_attr_scope_t,
+	tm_tag_attr_type_t, tm_tag_attr_arglist_t, 0
+};
+
+static GHashTable *workspace_runs = NULL;	/* TMWorkObject -> GPtrArray of its sorted tags */
+static GHashTable *workspace_changed = NULL;	/* work objects whose run is out of date */
+static guint workspace_tags_generation = 1;	/* changes whenever the workspace tags array changes */
+
+
+static GPtrArray *tm_workspace_run_new(const GPtrArray *tags_array)
+{
+	GPtrArray *run;
+	guint i;
+
+	if (NULL == tags_array)
+		return g_ptr_array_new();
+	run = g_ptr_array_sized_new(tags_array->len);
+	for (i = 0; i < tags_array->len; ++i)
+		g_ptr_array_add(run, tags_array->pdata[i]);
+	tm_tags_sort(run, workspace_sort_attrs, TRUE);
+	for (i = 0; i < run->len; ++i)
+		tm_tag_ref(run->pdata[i]);
+	return run;
+}
+
+static void tm_workspace_run_free(gpointer run)
+{
+	tm_tags_array_free(run, TRUE);
+}
+
+static void tm_workspace_runs_free(void)
+{
+	if (workspace_runs)
+		g_hash_table_destroy(workspace_runs);
+	workspace_runs = NULL;
+	if (workspace_changed)
+		g_hash_table_destroy(workspace_changed);
+	workspace_changed = NULL;
+}
+
+/* Marks the tags of a work object as changed, so they are replaced in the
+ workspace tags array on the next update. This is called when a source file is
+ parsed and when a work object is added or removed.
+ \param work_object A work object of the workspace or one of its children.
+ It is not dereferenced later, so it may be freed before the update.
+*/
+void tm_workspace_object_changed(TMWorkObject *work_object)
+{
+	if (NULL == theWorkspace || NULL == work_object)
+		return;
+
+	/* children of projects are merged as part of the project */
+	while (work_object->parent && work_object->parent != TM_WORK_OBJECT(theWorkspace))
+		work_object = work_object->parent;
+	if (NULL == workspace_changed)
+		workspace_changed = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_insert(workspace_changed, work_object, work_object);
+}
+
+/* Removes the tags of a run from the workspace tags array. The run must be a
+ subsequence of the array, which tm_tags_merge_sorted() guarantees. */
+static gboolean tm_workspace_remove_run(GPtrArray *tags_array, const GPtrArray *run)
+{
+	guint i, j = 0, count = 0;
+
+	for (i = 0; i < tags_array->len; ++i)
+	{
+		if (j < run->len && tags_array->pdata[i] == run->pdata[j])
+			j++;
+		else
+			tags_array->pdata[count++] = tags_array->pdata[i];
+	}
+	g_ptr_array_set_size(tags_array, count);
+	return j == run->len;
+}
+
+static void tm_workspace_merge_all_runs(GPtrArray *tags_array)
+{
+	GPtrArray *runs = g_ptr_array_sized_new(g_hash_table_size(workspace_runs));
+	GHashTableIter iter;
+	gpointer run;
+
+	g_hash_table_iter_init(&iter, workspace_runs);
+	while (g_hash_table_iter_next(&iter, NULL, &run))
+		g_ptr_array_add(runs, run);
+	tm_tags_merge_sorted(tags_array, (GPtrArray **) runs->pdata, runs->len, workspace_sort_attrs);
+	g_ptr_array_free(runs, TRUE);
+}
+
+/* Brings the workspace tags array up to date with the tags of the work objects
+ and of the indexed files that aren't open.
+ \param all Whether to sort the tags of all work objects again, rather than
+ only those marked with tm_workspace_object_changed().
+*/
+static void tm_workspace_update_tags_array(gboolean all)
+{
+	GPtrArray *tags_array, *dropped, *added;
+	GHashTable *current;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint i;
+
+	if (NULL == theWorkspace)
+		return;
+	if (NULL == workspace_runs)
+		workspace_runs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, tm_workspace_run_free);
+	if (NULL == theWorkspace->work_object.tags_array)
+	{
+		theWorkspace->work_object.tags_array = g_ptr_array_new();
+		all = TRUE;
+	}
+	tags_array = theWorkspace->work_object.tags_array;
+
+	/* the work objects whose tags belong in the array: all members, and
+	 indexed files that aren't open since the tags of an open file come from its buffer */
+	current = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; theWorkspace->work_objects && i < theWorkspace->work_objects->len; ++i)
+	{
+		TMWorkObject *w = theWorkspace->work_objects->pdata[i];
+
+		if (w)
+			g_hash_table_insert(current, w, w);
+	}
+	if (index_entries)
+	{
+		GHashTable *open_files = g_hash_table_new(g_str_hash, g_str_equal);
+
+		for (i = 0; theWorkspace->work_objects && i < theWorkspace->work_objects->len; ++i)
+		{
+			TMWorkObject *w = theWorkspace->work_objects->pdata[i];
+
+			if (w && w->file_name)
+				g_hash_table_insert(open_files, w->file_name, w);
+		}
+		g_hash_table_iter_init(&iter, index_entries);
+		while (g_hash_table_iter_next(&iter, &key, &value))
+		{
+			TMIndexEntry *entry = value;
+
+			if (entry->source_file && NULL == g_hash_table_lookup(open_files, key))
+				g_hash_table_insert(current, entry->source_file, entry->source_file);
+		}
+		g_hash_table_destroy(open_files);
+	}
+
+	/* runs which are out of date or whose work object is gone; their tags stay
+	 referenced until they have been removed from the array */
+	dropped = g_ptr_array_new();
+	g_hash_table_iter_init(&iter, workspace_runs);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		if (all || NULL == g_hash_table_lookup(current, key) ||
+			(workspace_changed && g_hash_table_lookup(workspace_changed, key)))
+		{
+			g_ptr_array_add(dropped, value);
+			g_hash_table_iter_steal(&iter);
+		}
+	}
+	if (workspace_changed)
+		g_hash_table_remove_all(workspace_changed);
+
+	added = g_ptr_array_new();
+	g_hash_table_iter_init(&iter, current);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		if (NULL == g_hash_table_lookup(workspace_runs, key))
+		{
+			GPtrArray *run = tm_workspace_run_new(TM_WORK_OBJECT(key)->tags_array);
+
+			g_hash_table_insert(workspace_runs, key, run);
+			g_ptr_array_add(added, run);
+		}
+	}
+	g_hash_table_destroy(current);
+
+	if (all || dropped->len > 1 || added->len > 1 ||
+		(dropped->len && ! tm_workspace_remove_run(tags_array, dropped->pdata[0])))
+		tm_workspace_merge_all_runs(tags_array);
+	else if (added->len)
+	{
+		GPtrArray *merge[2];
+
+		merge[0] = g_ptr_array_sized_new(tags_array->len);
+		g_ptr_array_set_size(merge[0], tags_array->len);
+		memcpy(merge[0]->pdata, tags_array->pdata, tags_array->len * sizeof(gpointer));
+		merge[1] = added->pdata[0];
+		tm_tags_merge_sorted(tags_array, merge, 2, workspace_sort_attrs);
+		g_ptr_array_free(merge[0], TRUE);
+	}
+
 #ifdef TM_DEBUG
-	g_message("Total: %d tags", theWorkspace->work_object.tags_array->len);
+	g_message("Workspace tags: %d removed and %d added runs, %d tags", dropped->len,
+		added->len, tags_array->len);
 #endif
-	tm_tags_sort(theWorkspace->work_object.tags_array, sort_attrs, TRUE);
+	for (i = 0; i < dropped->len; ++i)
+		tm_workspace_run_free(dropped->pdata[i]);
+	g_ptr_array_free(dropped, TRUE);
+	g_ptr_array_free(added, TRUE);
+	workspace_tags_generation++;
+}
+
+void tm_workspace_recreate_tags_array(void)
+{
+	tm_workspace_update_tags_array(TRUE);
 }
 
 gboolean tm_workspace_update(TMWorkObject *workspace, gboolean force
@@ -548,8 +1416,10 @@ gboolean tm_workspace_update(TMWorkObject *workspace, gboolean force
 				update_tags = TRUE;
 		}
 	}
+	/* a full update unless the changed work objects are known */
 	if (update_tags)
-		tm_workspace_recreate_tags_array();
+		tm_workspace_update_tags_array(NULL == workspace_changed
+			|| 0 == g_hash_table_size(workspace_changed));
 	/* workspace->analyze_time = time(NULL); */
 	return update_tags;
 }
@@ -676,6 +1546,372 @@ const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *at
 	return tags;
 }
 
+/* The names of a sorted tags array for autocompletion. Tags with the same name
+ * are next to each other in the array, and are listed once by their lower case
+ * name without array size, so the names starting with a prefix are a range of
+ * the list and finding them doesn't depend on how many tags there are. */
+typedef struct
+{
+	const gchar *key;	/* lower case name */
+	const gchar *humps;	/* lower case first letters of the words in the name */
+	guint first;	/* index of the first tag with this name in the tags array */
+	guint count;
+} TMCompletionName;
+
+typedef struct
+{
+	GArray *names;	/* TMCompletionName, sorted by key */
+	GStringChunk *strings;
+	guint generation;	/* of the tags array the names were built from */
+	gboolean global;
+	/* positions in names grouped by the first letter of their humps, each group
+	 * sorted, so approximate matches only look at names with the right first
+	 * letter; the group for letter c is hump_order[hump_start[c]..hump_start[c + 1]] */
+	guint *hump_order;
+	guint hump_start[257];
+} TMCompletionIndex;
+
+typedef struct
+{
+	const gchar *key;
+	const TMTag *tag;
+	guint index;
+} TMCompletionMatch;
+
+/* for the workspace and the global tags, main thread only */
+static TMCompletionIndex completion_index[2] = {{NULL, NULL, 0, FALSE, NULL, {0}}, {NULL, NULL, 0, TRUE, NULL, {0}}};
+
+static void tm_completion_free(void)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(completion_index); ++i)
+	{
+		if (completion_index[i].names)
+			g_array_free(completion_index[i].names, TRUE);
+		if (completion_index[i].strings)
+			g_string_chunk_free(completion_index[i].strings);
+		g_free(completion_index[i].hump_order);
+		completion_index[i].names = NULL;
+		completion_index[i].strings = NULL;
+		completion_index[i].hump_order = NULL;
+		completion_index[i].generation = 0;
+	}
+}
+
+/* Appends the first letter of each word of name to humps, so that
+ * "GetSpritePositionX" and "get_sprite_position_x" both give "gspx" */
+static void tm_completion_append_humps(GString *humps, const gchar *name, gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; ++i)
+	{
+		guchar c = name[i];
+		guchar prev = i ? name[i - 1] : 0;
+
+		if (! g_ascii_isalnum(c))
+			continue;
+		if (0 == i || ! g_ascii_isalnum(prev) ||
+			(g_ascii_isupper(c) && ! g_ascii_isupper(prev)) ||
+			(g_ascii_isdigit(c) && ! g_ascii_isdigit(prev)))
+			g_string_append_c(humps, g_ascii_tolower(c));
+	}
+}
+
+/* Rebuilds the names of index if tags has changed since they were built */
+static void tm_completion_index_update(TMCompletionIndex *index, const GPtrArray *tags,
+	guint generation)
+{
+	GString *key, *humps;
+	TMCompletionName *last = NULL;
+	guint i;
+
+	if (index->names && index->generation == generation)
+		return;
+	if (index->names)
+		g_array_set_size(index->names, 0);
+	else
+		index->names = g_array_new(FALSE, FALSE, sizeof(TMCompletionName));
+	if (index->strings)
+		g_string_chunk_free(index->strings);
+	index->strings = g_string_chunk_new(4096);
+	index->generation = generation;
+
+	key = g_string_new(NULL);
+	humps = g_string_new(NULL);
+	for (i = 0; tags && i < tags->len; ++i)
+	{
+		const gchar *name = FALLBACK(TM_TAG(tags->pdata[i])->name, "");
+		const gchar *bracket = strchr(name, '[');
+		gsize len = bracket ? (gsize) (bracket - name) : strlen(name);
+		gsize j;
+
+		/* same as the name comparison used for sorting */
+		while (bracket && len > 1 && g_ascii_isspace(name[len - 1]))
+			len--;
+		g_string_truncate(key, 0);
+		for (j = 0; j < len; ++j)
+			g_string_append_c(key, g_ascii_tolower(name[j]));
+
+		if (last && 0 == strcmp(last->key, key->str))
+			last->count++;
+		else
+		{
+			TMCompletionName entry;
+
+			g_string_truncate(humps, 0);
+			tm_completion_append_humps(humps, name, len);
+			entry.key = g_string_chunk_insert_len(index->strings, key->str, key->len);
+			entry.humps = g_string_chunk_insert_len(index->strings, humps->str, humps->len);
+			entry.first = i;
+			entry.count = 1;
+			g_array_append_val(index->names, entry);
+			last = &g_array_index(index->names, TMCompletionName, index->names->len - 1);
+		}
+	}
+	g_string_free(key, TRUE);
+	g_string_free(humps, TRUE);
+
+	/* counting sort of the names by the first letter of their humps */
+	memset(index->hump_start, 0, sizeof(index->hump_start));
+	for (i = 0; i < index->names->len; ++i)
+		index->hump_start[(guchar) g_array_index(index->names, TMCompletionName, i).humps[0] + 1]++;
+	for (i = 1; i < G_N_ELEMENTS(index->hump_start); ++i)
+		index->hump_start[i] += index->hump_start[i - 1];
+	g_free(index->hump_order);
+	index->hump_order = g_new(guint, MAX(index->names->len, 1));
+	{
+		guint next[256];
+
+		memcpy(next, index->hump_start, sizeof(next));
+		for (i = 0; i < index->names->len; ++i)
+			index->hump_order[next[(guchar) g_array_index(index->names, TMCompletionName, i).humps[0]]++] = i;
+	}
+}
+
+/* Returns the position of the first name which doesn't come before the names
+ * starting with prefix, or if upper is set, after them */
+static guint tm_completion_bound(const GArray *names, const gchar *prefix, gsize len,
+	gboolean upper)
+{
+	guint lo = 0, hi = names->len;
+
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+		gint cmp = strncmp(g_array_index(names, TMCompletionName, mid).key, prefix, len);
+
+		if (cmp < 0 || (upper && 0 == cmp))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Returns the first tag called name of the given types and language, or NULL */
+static const TMTag *tm_completion_find_tag(const TMCompletionIndex *index, const GPtrArray *tags,
+	const TMCompletionName *name, int type, langType lang)
+{
+	guint i;
+
+	for (i = name->first; i < name->first + name->count; ++i)
+	{
+		const TMTag *tag = tags->pdata[i];
+
+		if (! (type & tag->type))
+			continue;
+		if (lang == -1)
+			return tag;
+		if (index->global)
+		{
+			/* global C tags are also used for C++ (lang = 0 is C, lang = 1 is C++) */
+			if (tag->atts.file.lang == lang || (0 == tag->atts.file.lang && 1 == lang))
+				return tag;
+		}
+		else if (tag->atts.entry.file && tag->atts.entry.file->lang == lang)
+			return tag;
+	}
+	return NULL;
+}
+
+/* Whether the letters of query appear in key in the same order. The first
+ * letters have to be the same, otherwise too many names would match. */
+static gboolean tm_completion_is_subsequence(const gchar *query, const gchar *key)
+{
+	if (*query != *key)
+		return FALSE;
+	for (; *key && *query; ++key)
+	{
+		if (*key == *query)
+			++query;
+	}
+	return '\0' == *query;
+}
+
+static gint tm_completion_match_compare(gconstpointer a, gconstpointer b)
+{
+	const TMCompletionMatch *m1 = a;
+	const TMCompletionMatch *m2 = b;
+	gint cmp = strcmp(m1->key, m2->key);
+
+	return cmp ? cmp : (gint) m1->index - (gint) m2->index;
+}
+
+/* Appends the tags whose names don't start with query but match it by the
+ * first letters of their words, then those which contain its letters in order,
+ * each sorted by name, until tags has max entries */
+static void tm_completion_add_approximate(GPtrArray *tags, const GPtrArray **arrays,
+	const gchar *query, gsize len, int type, langType lang, guint max)
+{
+	GArray *matches[2];
+	GHashTable *added;
+	guint wanted = max - tags->len;
+	guint i, j, kind;
+
+	matches[0] = g_array_new(FALSE, FALSE, sizeof(TMCompletionMatch));
+	matches[1] = g_array_new(FALSE, FALSE, sizeof(TMCompletionMatch));
+	for (i = 0; i < G_N_ELEMENTS(completion_index); ++i)
+	{
+		const TMCompletionIndex *index = &completion_index[i];
+		guint found[2] = {0, 0};
+		guint first, last;
+
+		/* Both kinds of match need the first letter of query to start the name
+		 * or its humps. For a letter or digit, the names starting with it also
+		 * have it first in their humps, otherwise humps can't match and only the
+		 * names starting with it can. */
+		if (g_ascii_isalnum(*query))
+		{
+			first = index->hump_start[(guchar) *query];
+			last = index->hump_start[(guchar) *query + 1];
+		}
+		else
+		{
+			first = tm_completion_bound(index->names, query, 1, FALSE);
+			last = tm_completion_bound(index->names, query, 1, TRUE);
+		}
+
+		/* the names are sorted, so no more than wanted of each kind are needed
+		 * from each index */
+		for (j = first; j < last && (found[0] < wanted || found[1] < wanted); ++j)
+		{
+			const TMCompletionName *name = &g_array_index(index->names, TMCompletionName,
+				g_ascii_isalnum(*query) ? index->hump_order[j] : j);
+			TMCompletionMatch match;
+
+			if (0 == strncmp(name->key, query, len))
+				continue;	/* already found */
+			if (g_str_has_prefix(name->humps, query))
+				kind = 0;
+			else if (tm_completion_is_subsequence(query, name->key))
+				kind = 1;
+			else
+				continue;
+			if (found[kind] >= wanted ||
+				NULL == (match.tag = tm_completion_find_tag(index, arrays[i], name, type, lang)))
+				continue;
+			match.key = name->key;
+			match.index = i;
+			g_array_append_val(matches[kind], match);
+			found[kind]++;
+		}
+	}
+
+	added = g_hash_table_new(g_str_hash, g_str_equal);
+	for (kind = 0; kind < 2; ++kind)
+	{
+		g_array_sort(matches[kind], tm_completion_match_compare);
+		for (j = 0; j < matches[kind]->len && tags->len < max; ++j)
+		{
+			TMCompletionMatch *match = &g_array_index(matches[kind], TMCompletionMatch, j);
+
+			/* a name can be both in the workspace and in the global tags */
+			if (g_hash_table_lookup(added, match->key))
+				continue;
+			g_hash_table_insert(added, (gpointer) match->key, (gpointer) match->key);
+			g_ptr_array_add(tags, (gpointer) match->tag);
+		}
+		g_array_free(matches[kind], TRUE);
+	}
+	g_hash_table_destroy(added);
+}
+
+const GPtrArray *tm_workspace_find_completions(const char *prefix, int type, langType lang,
+	guint max, gboolean approximate, guint *prefix_count)
+{
+	static GPtrArray *tags = NULL;
+	const GPtrArray *arrays[2];
+	guint pos[2], end[2];
+	gchar *query;
+	gsize len;
+	guint i;
+
+	if (prefix_count)
+		*prefix_count = 0;
+	if ((!theWorkspace) || (!prefix) || (!*prefix) || 0 == max)
+		return NULL;
+	if (tags)
+		g_ptr_array_set_size(tags, 0);
+	else
+		tags = g_ptr_array_new();
+
+	arrays[0] = theWorkspace->work_object.tags_array;
+	arrays[1] = theWorkspace->global_tags;
+	tm_completion_index_update(&completion_index[0], arrays[0], workspace_tags_generation);
+	tm_completion_index_update(&completion_index[1], arrays[1], global_tags_generation);
+
+	query = g_ascii_strdown(prefix, -1);
+	len = strlen(query);
+	for (i = 0; i < G_N_ELEMENTS(completion_index); ++i)
+	{
+		pos[i] = tm_completion_bound(completion_index[i].names, query, len, FALSE);
+		end[i] = tm_completion_bound(completion_index[i].names, query, len, TRUE);
+	}
+
+	/* merge the names of both indexes, preferring workspace tags */
+	while (tags->len < max && (pos[0] < end[0] || pos[1] < end[1]))
+	{
+		const TMCompletionName *name[2] = {NULL, NULL};
+		const TMTag *tag = NULL, *global_tag = NULL;
+		gint cmp;
+
+		for (i = 0; i < G_N_ELEMENTS(completion_index); ++i)
+		{
+			if (pos[i] < end[i])
+				name[i] = &g_array_index(completion_index[i].names, TMCompletionName, pos[i]);
+		}
+		if (NULL == name[1])
+			cmp = -1;
+		else if (NULL == name[0])
+			cmp = 1;
+		else
+			cmp = strcmp(name[0]->key, name[1]->key);
+
+		if (cmp <= 0)
+		{
+			tag = tm_completion_find_tag(&completion_index[0], arrays[0], name[0], type, lang);
+			pos[0]++;
+		}
+		if (cmp >= 0)
+		{
+			global_tag = tm_completion_find_tag(&completion_index[1], arrays[1], name[1], type, lang);
+			pos[1]++;
+		}
+		if (tag || global_tag)
+			g_ptr_array_add(tags, (gpointer) (tag ? tag : global_tag));
+	}
+	if (prefix_count)
+		*prefix_count = tags->len;
+
+	/* a single letter would match almost everything */
+	if (approximate && len > 1 && tags->len < max)
+		tm_completion_add_approximate(tags, arrays, query, len, type, lang, max);
+	g_free(query);
+	return tags;
+}
+
 static gboolean match_langs(gint lang, const TMTag *tag)
 {
 	if (tag->atts.entry.file)
@@ -98,6 +98,14 @@ gboolean tm_workspace_create_global_tags(const char *pre_process, const char **i
 */
 void tm_workspace_recreate_tags_array(void);
 
+/* Marks the tags of a work object as changed. The next update of the workspace
+ then only replaces the tags of the marked work objects in the workspace tag
+ array instead of sorting all tags again. tm_source_file_update() and
+ tm_source_file_buffer_update() call this for you.
+ \param work_object The work object whose tags have changed, or which was added or removed.
+*/
+void tm_workspace_object_changed(TMWorkObject *work_object);
+
 /* Calls tm_work_object_update() for all workspace member work objects.
  Use if you want to globally refresh the workspace.
  \param workspace Pointer to the workspace.
@@ -110,6 +118,50 @@ void tm_workspace_recreate_tags_array(void);
 gboolean tm_workspace_update(TMWorkObject *workspace, gboolean force
   , gboolean recurse, gboolean update_parent);
 
+/* Called from the main loop when the project index has added tags to the workspace.
+ \sa tm_workspace_index_set_update_func() */
+typedef void (*TMIndexUpdateFunc)(gpointer user_data);
+
+/* Adds a file to the project index, which parses it on a background thread and
+ adds its tags to the workspace tags array while it isn't open, so they can be
+ found with tm_workspace_find(). Files already in the index are only parsed
+ again if their modification time has changed.
+ \param file_name The file name in locale encoding.
+ \param lang_name The name of the language of the file, NULL to detect it from the name.
+ \return TRUE if the file will be (re)parsed.
+*/
+gboolean tm_workspace_index_add_file(const char *file_name, const char *lang_name);
+
+/* Removes a file and its tags from the project index.
+ \param file_name The file name in locale encoding.
+*/
+void tm_workspace_index_remove_file(const char *file_name);
+
+/* Sets a function to call when parsed files have been added to the workspace tags array.
+ \param func The function, NULL for none.
+ \param user_data Passed to func.
+*/
+void tm_workspace_index_set_update_func(TMIndexUpdateFunc func, gpointer user_data);
+
+/* Loads the tags of indexed files saved with tm_workspace_index_save_cache().
+ Files added to the index afterwards use the cached tags instead of being parsed
+ if they haven't changed since.
+ \param cache_file The cache file name in locale encoding.
+ \return TRUE if the cache was loaded.
+*/
+gboolean tm_workspace_index_load_cache(const char *cache_file);
+
+/* Drops the cached tags of files which haven't been added to the index since
+ tm_workspace_index_load_cache(). */
+void tm_workspace_index_release_cache(void);
+
+/* Saves the tags of indexed files to a cache file.
+ \param cache_file The cache file name in locale encoding.
+ \param file_names The names of the files to save, in locale encoding.
+ \return TRUE on success.
+*/
+gboolean tm_workspace_index_save_cache(const char *cache_file, GPtrArray *file_names);
+
 /* Dumps the workspace tree - useful for debugging */
 void tm_workspace_dump(void);
 
@@ -125,6 +177,23 @@ void tm_workspace_dump(void);
 const GPtrArray *tm_workspace_find(const char *name, int type, TMTagAttrType *attrs
  , gboolean partial, langType lang);
 
+/* Returns one tag for each name in the workspace and global tags which starts
+ with prefix, ignoring case, sorted by name. Unlike tm_workspace_find() this only
+ looks at as many names as are returned, so it is fast enough to call on every key press.
+ \param prefix The typed text to complete.
+ \param type The tag types to return (TMTagType). Can be a bitmask.
+ \param lang Specifies the language(see the table in parsers.h) of the tags to be found,
+             -1 for all
+ \param max The maximum number of tags to return.
+ \param approximate Whether to add names which don't start with prefix after the
+ others, first those whose word initials start with it ("gsp" for GetSpritePosition),
+ then those which contain its letters in order.
+ \param prefix_count Where to store how many of the returned tags start with prefix, or NULL.
+ \return Array of matching tags. Do not free() it since it is a static member.
+*/
+const GPtrArray *tm_workspace_find_completions(const char *prefix, int type, langType lang,
+ guint max, gboolean approximate, guint *prefix_count);
+
 /* Returns all matching tags found in the workspace.
  \param name The name of the tag to find.
  \param scope The scope name of the tag to find, or NULL.